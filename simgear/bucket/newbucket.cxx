@@ -27,9 +27,11 @@
 #  include <simgear_config.h>
 #endif
 
+#include <algorithm>
 #include <cmath>
 #include <cstdio> // some platforms need this for ::snprintf
 #include <iostream>
+#include <unordered_set>
 
 #include <simgear/misc/sg_path.hxx>
 #include <simgear/debug/logstream.hxx>
@@ -514,6 +516,72 @@ void sgGetBuckets( const SGGeod& min, const SGGeod& max, std::vector<SGBucket>&
     }
 }
 
+// Distance from pos to the closest point of the bucket
+static double distanceToBucket( const SGGeod& pos, const SGBucket& b )
+{
+    double dlon = SGMiscd::normalizePeriodic(-180.0, 180.0,
+                                             pos.getLongitudeDeg() - b.get_center_lon());
+    dlon = SGMiscd::clip(dlon, -0.5*b.get_width(), 0.5*b.get_width());
+    double lat = SGMiscd::clip(pos.getLatitudeDeg(),
+                               b.get_center_lat() - 0.5*b.get_height(),
+                               b.get_center_lat() + 0.5*b.get_height());
+    SGGeod closest = SGGeod::fromDeg(b.get_center_lon() + dlon, lat);
+    return SGGeodesy::distanceM(pos, closest);
+}
+
+void sgGetBucketsAlongTrack( const SGGeod& start, double track, double distance,
+                             double radius, std::vector<SGBucket>& list )
+{
+    // Sample the track, a bucket within radius of a point between two
+    // samples is within radius + step/2 of one of them.
+    const double step = 2000;
+    const double reach = radius + 0.5*std::min(step, std::max(distance, 0.0));
+
+    std::unordered_set<long> found;
+    for (SGBucket b : list)
+        found.insert(b.gen_index());
+
+    int numSteps = std::max(0, int(std::ceil(distance/step)));
+    for (int i = 0; i <= numSteps; ++i) {
+        SGGeod pos = start;
+        if (i > 0) {
+            double az2;
+            SGGeodesy::direct(start, track, std::min(i*step, distance), pos, az2);
+        }
+        SGBucket center(pos);
+        if (!center.isValid())
+            continue;
+
+        std::vector<std::pair<double, SGBucket> > reached;
+        int ny = int(std::ceil(reach/center.get_height_m()));
+        for (int dy = -ny; dy <= ny; ++dy) {
+            SGBucket row = center.sibling(0, dy);
+            if (!row.isValid())
+                continue;
+            // Never go around the earth more than once
+            int nx = int(std::ceil(reach/std::max(row.get_width_m(), 1.0))) + 1;
+            nx = std::min(nx, int(180.0/row.get_width()));
+            for (int dx = -nx; dx <= nx; ++dx) {
+                SGBucket b = center.sibling(dx, dy);
+                if (!b.isValid() || found.count(b.gen_index()))
+                    continue;
+                double d = distanceToBucket(pos, b);
+                if (b != center && reach < d)
+                    continue;
+                found.insert(b.gen_index());
+                reached.push_back(std::make_pair(d, b));
+            }
+        }
+
+        std::stable_sort(reached.begin(), reached.end(),
+                         [](const std::pair<double, SGBucket>& a,
+                            const std::pair<double, SGBucket>& b)
+                         { return a.first < b.first; });
+        for (auto& r : reached)
+            list.push_back(r.second);
+    }
+}
+
 std::ostream& operator<< ( std::ostream& out, const SGBucket& b )
 {
     return out << b.lon << ":" << (int)b.x << ", " << b.lat << ":" << (int)b.y;
@@ -346,6 +346,20 @@ void sgBucketDiff( const SGBucket& b1, const SGBucket& b2, int *dx, int *dy );
  */
 void sgGetBuckets( const SGGeod& min, const SGGeod& max, std::vector<SGBucket>& list );
 
+/**
+ * \relates SGBucket
+ * Retrieve the buckets an aircraft will pass following a great circle
+ * track, in the order they are reached, e.g. to load scenery ahead.
+ * Buckets already in the list are skipped.
+ * @param start current position
+ * @param track initial true track in degrees
+ * @param distance length of the track in meters
+ * @param radius add the buckets within this many meters of the track
+ * @param list standard vector the buckets are appended to
+ */
+void sgGetBucketsAlongTrack( const SGGeod& start, double track, double distance,
+                             double radius, std::vector<SGBucket>& list );
+
 /**
  * Write the bucket lon, lat, x, and y to the output stream.
  * @param out output stream
@@ -22,6 +22,7 @@
 
 #include <simgear/compiler.h>
 
+#include <algorithm>
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
@@ -345,6 +346,60 @@ void testSiblings()
     siblings.clear();
 }
 
+void testAlongTrack()
+{
+    // Due east near Nashville, no corridor
+    SGGeod start = SGGeod::fromDeg(-86.6, 36.19);
+    std::vector<SGBucket> buckets;
+    sgGetBucketsAlongTrack(start, 90.0, 0.0, 0.0, buckets);
+    SG_CHECK_EQUAL(buckets.size(), static_cast<std::vector<SGBucket>::size_type>(1));
+    SG_CHECK_EQUAL(buckets.front(), SGBucket(start));
+
+    // 60 km east crosses about three 0.25 degree wide buckets, in order
+    buckets.clear();
+    sgGetBucketsAlongTrack(start, 90.0, 60000.0, 0.0, buckets);
+    SG_VERIFY(buckets.size() >= 3);
+    SG_CHECK_EQUAL(buckets.front(), SGBucket(start));
+    for (unsigned i = 1; i < buckets.size(); ++i) {
+        int dx = 0, dy = 0;
+        sgBucketDiff(buckets[i - 1], buckets[i], &dx, &dy);
+        SG_VERIFY(dx >= 0);
+    }
+    SGGeod end = SGGeodesy::direct(start, 90.0, 60000.0);
+    SG_VERIFY(std::find(buckets.begin(), buckets.end(), SGBucket(end)) != buckets.end());
+
+    // With a 20 km corridor every bucket within reach of the track is
+    // returned, but no bucket twice
+    buckets.clear();
+    sgGetBucketsAlongTrack(start, 45.0, 100000.0, 20000.0, buckets);
+    for (unsigned i = 0; i < buckets.size(); ++i)
+        for (unsigned j = i + 1; j < buckets.size(); ++j)
+            SG_VERIFY(buckets[i] != buckets[j]);
+    for (int k = 0; k <= 10; ++k) {
+        SGGeod p = SGGeodesy::direct(start, 45.0, k*10000.0);
+        SGGeod left = SGGeodesy::direct(p, 315.0, 19000.0);
+        SGGeod right = SGGeodesy::direct(p, 135.0, 19000.0);
+        SG_VERIFY(std::find(buckets.begin(), buckets.end(), SGBucket(left)) != buckets.end());
+        SG_VERIFY(std::find(buckets.begin(), buckets.end(), SGBucket(right)) != buckets.end());
+    }
+    SGGeod far = SGGeodesy::direct(start, 315.0, 60000.0);
+    SG_VERIFY(std::find(buckets.begin(), buckets.end(), SGBucket(far)) == buckets.end());
+
+    // Buckets already known are not returned again
+    std::vector<SGBucket>::size_type count = buckets.size();
+    sgGetBucketsAlongTrack(start, 45.0, 100000.0, 20000.0, buckets);
+    SG_CHECK_EQUAL(buckets.size(), count);
+
+    // Across the date line and over the pole
+    buckets.clear();
+    sgGetBucketsAlongTrack(SGGeod::fromDeg(179.9, -16.5), 90.0, 30000.0, 5000.0, buckets);
+    SG_VERIFY(buckets.back().get_center_lon() < 0);
+    buckets.clear();
+    sgGetBucketsAlongTrack(SGGeod::fromDeg(10.0, 89.8), 0.0, 50000.0, 10000.0, buckets);
+    for (auto b : buckets)
+        SG_VERIFY(b.isValid());
+}
+
 int main(int argc, char* argv[])
 {
     testBucketSpans();
@@ -356,6 +411,7 @@ int main(int argc, char* argv[])
     testOffsetWrap();
     testPolarOffset();
     testSiblings();
+    testAlongTrack();
 
     cout << "all tests passed OK" << endl;
     return 0; // passed
@@ -0,0 +1,408 @@
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#include <simgear_config.h>
+
+#include "BVHBatchLineSegmentVisitor.hxx"
+
+#include <algorithm>
+#include <cmath>
+
+#include "BVHGroup.hxx"
+#include "BVHPageNode.hxx"
+#include "BVHTransform.hxx"
+#include "BVHMotionTransform.hxx"
+#include "BVHLineGeometry.hxx"
+#include "BVHStaticGeometry.hxx"
+#include "BVHFlatGeometry.hxx"
+
+#include "BVHStaticData.hxx"
+
+#include "BVHStaticNode.hxx"
+#include "BVHStaticTriangle.hxx"
+#include "BVHStaticBinary.hxx"
+
+namespace simgear {
+
+BVHBatchLineSegmentVisitor::BVHBatchLineSegmentVisitor(const LineSegmentList& lineSegments,
+                                                       const double& t) :
+    _depth(0),
+    _time(t)
+{
+    _segments.resize(lineSegments.size());
+    for (size_t i = 0; i < lineSegments.size(); ++i) {
+        Segment& segment = _segments[i];
+        segment.lineSegment = lineSegments[i];
+        segment.material = 0;
+        segment.id = 0;
+        segment.haveHit = false;
+    }
+    _packets.resize((_segments.size() + 3)/4);
+    updatePackets();
+
+    // level zero has all segments active
+    reserveMaskLevels(8);
+    Mask* mask = getMask(0);
+    for (size_t i = 0; i < _segments.size(); ++i)
+        mask[i/4] |= Mask(1) << (i%4);
+}
+
+BVHBatchLineSegmentVisitor::~BVHBatchLineSegmentVisitor()
+{
+}
+
+bool
+BVHBatchLineSegmentVisitor::empty() const
+{
+    for (const Segment& segment : _segments)
+        if (segment.haveHit)
+            return false;
+    return true;
+}
+
+void
+BVHBatchLineSegmentVisitor::apply(BVHGroup& group)
+{
+    if (!pushMask(group.getBoundingSphere()))
+        return;
+    group.traverse(*this);
+    popMask();
+}
+
+void
+BVHBatchLineSegmentVisitor::apply(BVHPageNode& pageNode)
+{
+    if (!pushMask(pageNode.getBoundingSphere()))
+        return;
+    pageNode.traverse(*this);
+    popMask();
+}
+
+void
+BVHBatchLineSegmentVisitor::apply(BVHTransform& transform)
+{
+    if (!pushMask(transform.getBoundingSphere()))
+        return;
+
+    // Push the line segments
+    SegmentList saved(_segments);
+    const Mask* mask = getMask(_depth);
+    for (unsigned i = 0; i < _segments.size(); ++i) {
+        if (!(mask[i/4] & (1 << (i%4))))
+            continue;
+        Segment& segment = _segments[i];
+        segment.lineSegment = transform.lineSegmentToLocal(segment.lineSegment);
+        segment.haveHit = false;
+    }
+    updatePackets();
+
+    transform.traverse(*this);
+
+    mask = getMask(_depth);
+    for (unsigned i = 0; i < _segments.size(); ++i) {
+        if (!(mask[i/4] & (1 << (i%4))))
+            continue;
+        Segment& segment = _segments[i];
+        const Segment& old = saved[i];
+        if (segment.haveHit) {
+            segment.linearVelocity = transform.vecToWorld(segment.linearVelocity);
+            segment.angularVelocity = transform.vecToWorld(segment.angularVelocity);
+            SGVec3d point(transform.ptToWorld(segment.lineSegment.getEnd()));
+            segment.lineSegment.set(old.lineSegment.getStart(), point);
+            segment.normal = transform.vecToWorld(segment.normal);
+        } else {
+            segment.lineSegment = old.lineSegment;
+            segment.haveHit = old.haveHit;
+        }
+    }
+    updatePackets();
+    popMask();
+}
+
+void
+BVHBatchLineSegmentVisitor::apply(BVHMotionTransform& transform)
+{
+    if (!pushMask(transform.getBoundingSphere()))
+        return;
+
+    // Push the line segments
+    SegmentList saved(_segments);
+    SGMatrixd toLocal = transform.getToLocalTransform(_time);
+    const Mask* mask = getMask(_depth);
+    for (unsigned i = 0; i < _segments.size(); ++i) {
+        if (!(mask[i/4] & (1 << (i%4))))
+            continue;
+        Segment& segment = _segments[i];
+        segment.lineSegment = segment.lineSegment.transform(toLocal);
+        segment.haveHit = false;
+    }
+    updatePackets();
+
+    transform.traverse(*this);
+
+    SGMatrixd toWorld = transform.getToWorldTransform(_time);
+    mask = getMask(_depth);
+    for (unsigned i = 0; i < _segments.size(); ++i) {
+        if (!(mask[i/4] & (1 << (i%4))))
+            continue;
+        Segment& segment = _segments[i];
+        const Segment& old = saved[i];
+        if (segment.haveHit) {
+            SGVec3d localStart = segment.lineSegment.getStart();
+            segment.linearVelocity += transform.getLinearVelocityAt(localStart);
+            segment.angularVelocity += transform.getAngularVelocity();
+            segment.linearVelocity = toWorld.xformVec(segment.linearVelocity);
+            segment.angularVelocity = toWorld.xformVec(segment.angularVelocity);
+            SGVec3d localEnd = segment.lineSegment.getEnd();
+            segment.lineSegment.set(old.lineSegment.getStart(), toWorld.xformPt(localEnd));
+            segment.normal = toWorld.xformVec(segment.normal);
+            if (!segment.id)
+                segment.id = transform.getId();
+        } else {
+            segment.lineSegment = old.lineSegment;
+            segment.haveHit = old.haveHit;
+        }
+    }
+    updatePackets();
+    popMask();
+}
+
+void
+BVHBatchLineSegmentVisitor::apply(BVHLineGeometry&)
+{
+}
+
+void
+BVHBatchLineSegmentVisitor::apply(BVHStaticGeometry& node)
+{
+    if (!pushMask(node.getBoundingSphere()))
+        return;
+    node.traverse(*this);
+    popMask();
+}
+
+void
+BVHBatchLineSegmentVisitor::apply(BVHFlatGeometry& node)
+{
+    if (!pushMask(node.getBoundingSphere()))
+        return;
+
+    // Stack entries refer to the mask level of their parent. Entries are
+    // pushed with increasing levels, so computing the mask of a popped
+    // node never overwrites a level still referenced from the stack.
+    struct Entry {
+        unsigned index;
+        unsigned parentLevel;
+    };
+    const unsigned base = _depth;
+    reserveMaskLevels(base + BVHFlatGeometry::MaxDepth + 1);
+
+    const BVHFlatGeometry::Node* nodes = node.getNodes().data();
+    Entry stack[BVHFlatGeometry::MaxDepth];
+    unsigned stackSize = 0;
+    stack[stackSize++] = Entry{ 0, base };
+    while (stackSize) {
+        Entry entry = stack[--stackSize];
+        const BVHFlatGeometry::Node& flatNode = nodes[entry.index];
+        unsigned level = entry.parentLevel + 1;
+        if (!computeMask(entry.parentLevel, level, flatNode.min, flatNode.max))
+            continue;
+
+        if (flatNode.isLeaf()) {
+            const Mask* mask = getMask(level);
+            for (unsigned t = 0; t < flatNode.count; ++t) {
+                SGTrianglef tri = node.getTriangle(flatNode, t);
+                const BVHMaterial* material = node.getMaterial(flatNode, t);
+                for (unsigned i = 0; i < _segments.size(); ++i)
+                    if (mask[i/4] & (1 << (i%4)))
+                        intersectTriangle(i, tri, material);
+            }
+            continue;
+        }
+
+        // Enter the box containing the start point of one of the
+        // segments first, as the BVHLineSegmentVisitor does.
+        unsigned axis = flatNode.axis;
+        float center = 0.5f*(flatNode.min[axis] + flatNode.max[axis]);
+        if (getActiveStart(level)[axis] < center) {
+            stack[stackSize++] = Entry{ flatNode.offset, level };
+            stack[stackSize++] = Entry{ entry.index + 1, level };
+        } else {
+            stack[stackSize++] = Entry{ entry.index + 1, level };
+            stack[stackSize++] = Entry{ flatNode.offset, level };
+        }
+    }
+    popMask();
+}
+
+void
+BVHBatchLineSegmentVisitor::apply(const BVHStaticBinary& node,
+                                  const BVHStaticData& data)
+{
+    if (!pushMask(node.getBoundingBox()))
+        return;
+    node.traverse(*this, data, getActiveStart(_depth));
+    popMask();
+}
+
+void
+BVHBatchLineSegmentVisitor::apply(const BVHStaticTriangle& triangle,
+                                  const BVHStaticData& data)
+{
+    SGTrianglef tri = triangle.getTriangle(data);
+    const BVHMaterial* material = data.getMaterial(triangle.getMaterialIndex());
+    const Mask* mask = getMask(_depth);
+    for (unsigned i = 0; i < _segments.size(); ++i)
+        if (mask[i/4] & (1 << (i%4)))
+            intersectTriangle(i, tri, material);
+}
+
+void
+BVHBatchLineSegmentVisitor::updatePackets()
+{
+    for (unsigned i = 0; i < _segments.size(); ++i)
+        updatePacket(i);
+}
+
+void
+BVHBatchLineSegmentVisitor::updatePacket(unsigned i)
+{
+    Packet& packet = _packets[i/4];
+    unsigned lane = i%4;
+    const SGLineSegmentd& lineSegment = _segments[i].lineSegment;
+    for (unsigned j = 0; j < 3; ++j) {
+        float start = lineSegment.getStart()[j];
+        float direction = lineSegment.getDirection()[j];
+        packet.start[j][lane] = start;
+        // Avoid infinities, so that 0*inv does not produce a nan
+        // for segments parallel to a box side.
+        if (std::fabs(direction) < 1e-30f)
+            packet.invDirection[j][lane] = std::copysign(1e30f, direction);
+        else
+            packet.invDirection[j][lane] = 1/direction;
+    }
+}
+
+void
+BVHBatchLineSegmentVisitor::reserveMaskLevels(unsigned levels)
+{
+    size_t size = levels*_packets.size();
+    if (_masks.size() < size)
+        _masks.resize(size, 0);
+}
+
+bool
+BVHBatchLineSegmentVisitor::computeMask(unsigned parentLevel, unsigned level,
+                                        const float min[3], const float max[3])
+{
+    const Mask* parentMask = getMask(parentLevel);
+    Mask* mask = getMask(level);
+    bool any = false;
+    for (size_t p = 0; p < _packets.size(); ++p) {
+        mask[p] = 0;
+        if (!parentMask[p])
+            continue;
+
+        // Slab test for four segments at once, in the parameter space
+        // of the segments
+        const Packet& packet = _packets[p];
+        simd4_t<float,4> tNear(0.0f);
+        simd4_t<float,4> tFar(1.0f);
+        for (unsigned j = 0; j < 3; ++j) {
+            simd4_t<float,4> t1 = (simd4_t<float,4>(min[j]) - packet.start[j])*packet.invDirection[j];
+            simd4_t<float,4> t2 = (simd4_t<float,4>(max[j]) - packet.start[j])*packet.invDirection[j];
+            tNear = simd4::max(tNear, simd4::min(t1, t2));
+            tFar = simd4::min(tFar, simd4::max(t1, t2));
+        }
+
+        // be a bit generous, the triangle test is the exact one
+        for (unsigned lane = 0; lane < 4; ++lane)
+            if (tNear[lane] <= tFar[lane] + 1e-5f)
+                mask[p] |= Mask(1) << lane;
+        mask[p] &= parentMask[p];
+        any = any || mask[p];
+    }
+    return any;
+}
+
+bool
+BVHBatchLineSegmentVisitor::pushMask(const SGSphered& sphere)
+{
+    unsigned level = _depth + 1;
+    reserveMaskLevels(level + 1);
+    const Mask* parentMask = getMask(_depth);
+    Mask* mask = getMask(level);
+    bool any = false;
+    for (unsigned i = 0; i < _segments.size(); ++i) {
+        if (i%4 == 0)
+            mask[i/4] = 0;
+        Mask bit = Mask(1) << (i%4);
+        if (!(parentMask[i/4] & bit))
+            continue;
+        if (!intersects(_segments[i].lineSegment, sphere))
+            continue;
+        mask[i/4] |= bit;
+        any = true;
+    }
+    if (any)
+        _depth = level;
+    return any;
+}
+
+bool
+BVHBatchLineSegmentVisitor::pushMask(const SGBoxf& box)
+{
+    unsigned level = _depth + 1;
+    reserveMaskLevels(level + 1);
+    if (!computeMask(_depth, level, box.getMin().data(), box.getMax().data()))
+        return false;
+    _depth = level;
+    return true;
+}
+
+const SGVec3d&
+BVHBatchLineSegmentVisitor::getActiveStart(unsigned level) const
+{
+    const Mask* mask = getMask(level);
+    for (unsigned p = 0; p < _packets.size(); ++p) {
+        if (!mask[p])
+            continue;
+        for (unsigned lane = 0; lane < 4; ++lane)
+            if (mask[p] & (1 << lane))
+                return _segments[4*p + lane].lineSegment.getStart();
+    }
+    return _segments.front().lineSegment.getStart();
+}
+
+void
+BVHBatchLineSegmentVisitor::intersectTriangle(unsigned i, const SGTrianglef& tri,
+                                              const BVHMaterial* material)
+{
+    Segment& segment = _segments[i];
+    SGVec3f point;
+    if (!intersects(point, tri, SGLineSegmentf(segment.lineSegment), 1e-4f))
+        return;
+    segment.lineSegment.set(segment.lineSegment.getStart(), SGVec3d(point));
+    segment.normal = SGVec3d(tri.getNormal());
+    segment.linearVelocity = SGVec3d::zeros();
+    segment.angularVelocity = SGVec3d::zeros();
+    segment.material = material;
+    segment.id = 0;
+    segment.haveHit = true;
+    updatePacket(i);
+}
+
+}
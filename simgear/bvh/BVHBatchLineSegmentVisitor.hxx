@@ -0,0 +1,139 @@
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#ifndef BVHBatchLineSegmentVisitor_hxx
+#define BVHBatchLineSegmentVisitor_hxx
+
+#include <vector>
+
+#include <simgear/math/SGGeometry.hxx>
+#include <simgear/math/simd.hxx>
+
+#include "BVHVisitor.hxx"
+#include "BVHNode.hxx"
+
+namespace simgear {
+
+class BVHMaterial;
+
+/// Intersects a batch of line segments with the tree in a single
+/// traversal, for example all gear contact points of an aircraft or a fan
+/// of radar rays. Bounding boxes are tested against packets of four
+/// segments at once. For each segment the result is the same as for a
+/// BVHLineSegmentVisitor on that segment alone.
+class BVHBatchLineSegmentVisitor : public BVHVisitor {
+public:
+    typedef std::vector<SGLineSegmentd> LineSegmentList;
+
+    BVHBatchLineSegmentVisitor(const LineSegmentList& lineSegments,
+                               const double& t = 0);
+    virtual ~BVHBatchLineSegmentVisitor();
+
+    unsigned getNumLineSegments() const
+    { return static_cast<unsigned>(_segments.size()); }
+
+    /// True if no segment hit anything.
+    bool empty() const;
+    bool empty(unsigned i) const
+    { return !_segments[i].haveHit; }
+
+    const SGLineSegmentd& getLineSegment(unsigned i) const
+    { return _segments[i].lineSegment; }
+
+    SGVec3d getPoint(unsigned i) const
+    { return _segments[i].lineSegment.getEnd(); }
+    const SGVec3d& getNormal(unsigned i) const
+    { return _segments[i].normal; }
+    const SGVec3d& getLinearVelocity(unsigned i) const
+    { return _segments[i].linearVelocity; }
+    const SGVec3d& getAngularVelocity(unsigned i) const
+    { return _segments[i].angularVelocity; }
+    const BVHMaterial* getMaterial(unsigned i) const
+    { return _segments[i].material; }
+    BVHNode::Id getId(unsigned i) const
+    { return _segments[i].id; }
+
+    virtual void apply(BVHGroup& group);
+    virtual void apply(BVHPageNode& node);
+    virtual void apply(BVHTransform& transform);
+    virtual void apply(BVHMotionTransform& transform);
+    virtual void apply(BVHLineGeometry&);
+    virtual void apply(BVHStaticGeometry& node);
+    virtual void apply(BVHFlatGeometry& node);
+
+    virtual void apply(const BVHStaticBinary&, const BVHStaticData&);
+    virtual void apply(const BVHStaticTriangle&, const BVHStaticData&);
+
+private:
+    struct Segment {
+        SGLineSegmentd lineSegment;
+        SGVec3d normal;
+        SGVec3d linearVelocity;
+        SGVec3d angularVelocity;
+        const BVHMaterial* material;
+        BVHNode::Id id;
+        bool haveHit;
+    };
+    typedef std::vector<Segment> SegmentList;
+
+    /// Four segments in structure of arrays layout, for the slab test.
+    struct Packet {
+        simd4_t<float,4> start[3];
+        simd4_t<float,4> invDirection[3];
+    };
+
+    /// One bit per segment, four per packet.
+    typedef unsigned char Mask;
+
+    void updatePackets();
+    void updatePacket(unsigned i);
+
+    Mask* getMask(unsigned level)
+    { return _masks.data() + level*_packets.size(); }
+    const Mask* getMask(unsigned level) const
+    { return _masks.data() + level*_packets.size(); }
+    void reserveMaskLevels(unsigned levels);
+
+    /// Compute the segments active in level which are active in
+    /// parentLevel and intersect the box. Returns false if there are none.
+    bool computeMask(unsigned parentLevel, unsigned level,
+                     const float min[3], const float max[3]);
+
+    /// Push a new level of active segments, the ones active in the
+    /// current level which intersect the sphere or box. Returns false and
+    /// pushes nothing if there are none.
+    bool pushMask(const SGSphered& sphere);
+    bool pushMask(const SGBoxf& box);
+    void popMask()
+    { --_depth; }
+
+    /// Start point of one segment active in level, for the choice of the
+    /// first child to enter.
+    const SGVec3d& getActiveStart(unsigned level) const;
+
+    void intersectTriangle(unsigned i, const SGTrianglef& tri,
+                           const BVHMaterial* material);
+
+    SegmentList _segments;
+    std::vector<Packet> _packets;
+    std::vector<Mask> _masks;
+    unsigned _depth;
+    double _time;
+};
+
+}
+
+#endif
@@ -0,0 +1,205 @@
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#include <simgear_config.h>
+
+#include "BVHBatchSphereCollector.hxx"
+
+#include <cassert>
+
+#include "BVHGroup.hxx"
+#include "BVHPageNode.hxx"
+#include "BVHTransform.hxx"
+#include "BVHMotionTransform.hxx"
+#include "BVHLineGeometry.hxx"
+#include "BVHStaticGeometry.hxx"
+#include "BVHFlatGeometry.hxx"
+
+#include "BVHStaticData.hxx"
+
+#include "BVHStaticNode.hxx"
+#include "BVHStaticTriangle.hxx"
+#include "BVHStaticBinary.hxx"
+
+namespace simgear {
+
+BVHBatchSphereCollector::BVHBatchSphereCollector(const SphereList& spheres,
+                                                 const double& t) :
+    _spheres(spheres),
+    _toWorld(SGMatrixd::unit()),
+    _time(t),
+    _id(0),
+    _state(0)
+{
+    assert(spheres.size() <= MaxSpheres);
+    if (MaxSpheres < _spheres.size())
+        _spheres.resize(MaxSpheres);
+    _localSpheres = _spheres;
+    _results.resize(_spheres.size());
+    for (unsigned i = 0; i < _spheres.size(); ++i)
+        if (!_spheres[i].empty())
+            _state |= State(1) << i;
+}
+
+BVHBatchSphereCollector::~BVHBatchSphereCollector()
+{
+}
+
+void
+BVHBatchSphereCollector::apply(BVHGroup& group)
+{
+    Traversal::traverse(group, *this, *this, _state);
+}
+
+void
+BVHBatchSphereCollector::apply(BVHPageNode& node)
+{
+    Traversal::traverse(node, *this, *this, _state);
+}
+
+void
+BVHBatchSphereCollector::apply(BVHTransform& transform)
+{
+    SphereList spheres(_localSpheres);
+    for (unsigned i = 0; i < _localSpheres.size(); ++i)
+        if (_state & (State(1) << i))
+            _localSpheres[i] = transform.sphereToLocal(spheres[i]);
+    SGMatrixd toWorld = _toWorld;
+    _toWorld = toWorld*transform.getToWorldTransform();
+
+    Traversal::traverse(transform, *this, *this, _state);
+
+    _toWorld = toWorld;
+    _localSpheres.swap(spheres);
+}
+
+void
+BVHBatchSphereCollector::apply(BVHMotionTransform& transform)
+{
+    SphereList spheres(_localSpheres);
+    for (unsigned i = 0; i < _localSpheres.size(); ++i)
+        if (_state & (State(1) << i))
+            _localSpheres[i] = transform.sphereToLocal(spheres[i], _time);
+    SGMatrixd toWorld = _toWorld;
+    _toWorld = toWorld*transform.getToWorldTransform(_time);
+    BVHNode::Id id = _id;
+    _id = transform.getId();
+
+    Traversal::traverse(transform, *this, *this, _state);
+
+    _id = id;
+    _toWorld = toWorld;
+    _localSpheres.swap(spheres);
+}
+
+void
+BVHBatchSphereCollector::apply(BVHLineGeometry&)
+{
+}
+
+void
+BVHBatchSphereCollector::apply(BVHStaticGeometry& node)
+{
+    node.traverse(*this);
+}
+
+void
+BVHBatchSphereCollector::apply(BVHFlatGeometry& node)
+{
+    Traversal::traverse(node, *this, _state);
+}
+
+void
+BVHBatchSphereCollector::apply(const BVHStaticBinary& node,
+                               const BVHStaticData& data)
+{
+    State state;
+    double key;
+    if (!enter(node.getBoundingBox(), _state, state, key))
+        return;
+    State parentState = _state;
+    _state = state;
+    node.getLeftChild()->accept(*this, data);
+    node.getRightChild()->accept(*this, data);
+    _state = parentState;
+}
+
+void
+BVHBatchSphereCollector::apply(const BVHStaticTriangle& triangle,
+                               const BVHStaticData& data)
+{
+    addTriangle(triangle.getTriangle(data),
+                data.getMaterial(triangle.getMaterialIndex()), _state);
+}
+
+bool
+BVHBatchSphereCollector::enter(const SGSphered& sphere, const State& parent,
+                               State& state, double& key)
+{
+    state = 0;
+    for (unsigned i = 0; i < _localSpheres.size(); ++i)
+        if ((parent & (State(1) << i)) && intersects(_localSpheres[i], sphere))
+            state |= State(1) << i;
+    // All of them are collected, the order does not matter
+    key = 0;
+    return state != 0;
+}
+
+bool
+BVHBatchSphereCollector::enter(const SGBoxf& box, const State& parent,
+                               State& state, double& key)
+{
+    state = 0;
+    for (unsigned i = 0; i < _localSpheres.size(); ++i)
+        if ((parent & (State(1) << i)) && intersects(_localSpheres[i], box))
+            state |= State(1) << i;
+    key = 0;
+    return state != 0;
+}
+
+void
+BVHBatchSphereCollector::applyLeaf(const BVHFlatGeometry& node,
+                                   const BVHFlatGeometry::Node& leaf,
+                                   const State& state)
+{
+    for (unsigned i = 0; i < leaf.count; ++i)
+        addTriangle(node.getTriangle(leaf, i), node.getMaterial(leaf, i), state);
+}
+
+void
+BVHBatchSphereCollector::addTriangle(const SGTrianglef& triangle,
+                                     const BVHMaterial* material, State state)
+{
+    bool haveWorld = false;
+    Result result;
+    for (unsigned i = 0; i < _localSpheres.size(); ++i) {
+        if (!(state & (State(1) << i)))
+            continue;
+        if (!intersects(_localSpheres[i], triangle))
+            continue;
+        if (!haveWorld) {
+            result.triangle = SGTriangled(_toWorld.xformPt(SGVec3d(triangle.getVertex(0))),
+                                          _toWorld.xformPt(SGVec3d(triangle.getVertex(1))),
+                                          _toWorld.xformPt(SGVec3d(triangle.getVertex(2))));
+            result.material = material;
+            result.id = _id;
+            haveWorld = true;
+        }
+        _results[i].push_back(result);
+    }
+}
+
+}
@@ -0,0 +1,110 @@
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#ifndef BVHBatchSphereCollector_hxx
+#define BVHBatchSphereCollector_hxx
+
+#include <cstdint>
+#include <vector>
+
+#include <simgear/math/SGGeometry.hxx>
+
+#include "BVHVisitor.hxx"
+#include "BVHNode.hxx"
+#include "BVHFlatGeometry.hxx"
+#include "BVHOrderedTraversal.hxx"
+
+namespace simgear {
+
+class BVHMaterial;
+
+/// Collects the triangles touching each of a batch of spheres in a single
+/// traversal, for example the volumes of a wake vortex or the protection
+/// zones of several AI aircraft. Each bounding volume is tested only
+/// against the spheres which touch its parent.
+///
+/// At most MaxSpheres spheres are handled per batch, larger batches need
+/// to be split by the caller.
+class BVHBatchSphereCollector : public BVHVisitor {
+public:
+    enum { MaxSpheres = 64 };
+
+    typedef std::vector<SGSphered> SphereList;
+
+    struct Result {
+        /// The triangle in world coordinates
+        SGTriangled triangle;
+        const BVHMaterial* material;
+        BVHNode::Id id;
+    };
+    typedef std::vector<Result> ResultList;
+
+    BVHBatchSphereCollector(const SphereList& spheres, const double& t = 0);
+    virtual ~BVHBatchSphereCollector();
+
+    virtual void apply(BVHGroup& group);
+    virtual void apply(BVHPageNode& node);
+    virtual void apply(BVHTransform& transform);
+    virtual void apply(BVHMotionTransform& transform);
+    virtual void apply(BVHLineGeometry&);
+    virtual void apply(BVHStaticGeometry& node);
+    virtual void apply(BVHFlatGeometry& node);
+
+    virtual void apply(const BVHStaticBinary&, const BVHStaticData&);
+    virtual void apply(const BVHStaticTriangle&, const BVHStaticData&);
+
+    unsigned getNumSpheres() const
+    { return static_cast<unsigned>(_spheres.size()); }
+    const SGSphered& getSphere(unsigned i) const
+    { return _spheres[i]; }
+
+    /// The triangles touching sphere i.
+    const ResultList& getResults(unsigned i) const
+    { return _results[i]; }
+
+private:
+    typedef BVHOrderedTraversal<BVHBatchSphereCollector> Traversal;
+    friend class BVHOrderedTraversal<BVHBatchSphereCollector>;
+
+    /// One bit per sphere touching the volume
+    typedef uint64_t State;
+
+    bool enter(const SGSphered& sphere, const State& parent, State& state,
+               double& key);
+    bool enter(const SGBoxf& box, const State& parent, State& state,
+               double& key);
+    bool wanted(const State&, double) const
+    { return true; }
+    void applyLeaf(const BVHFlatGeometry& node,
+                   const BVHFlatGeometry::Node& leaf, const State& state);
+
+    void addTriangle(const SGTrianglef& triangle, const BVHMaterial* material,
+                     State state);
+
+    /// The spheres in world and in the current local coordinates
+    SphereList _spheres;
+    SphereList _localSpheres;
+    SGMatrixd _toWorld;
+    double _time;
+    BVHNode::Id _id;
+    State _state;
+
+    std::vector<ResultList> _results;
+};
+
+}
+
+#endif
@@ -34,6 +34,7 @@
 #include "BVHStaticTriangle.hxx"
 #include "BVHStaticBinary.hxx"
 #include "BVHStaticGeometry.hxx"
+#include "BVHFlatGeometry.hxx"
 
 namespace simgear {
 
@@ -56,6 +57,8 @@ public:
     { expandBy(node.getBoundingSphere()); }
     virtual void apply(BVHStaticGeometry& node)
     { expandBy(node.getBoundingSphere()); }
+    virtual void apply(BVHFlatGeometry& node)
+    { expandBy(node.getBoundingSphere()); }
     
     virtual void apply(const BVHStaticBinary& node, const BVHStaticData& data)
     { expandBy(node.getBoundingBox()); }
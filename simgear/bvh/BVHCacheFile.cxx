@@ -0,0 +1,630 @@
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#include <simgear_config.h>
+
+#include "BVHCacheFile.hxx"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include <simgear/debug/logstream.hxx>
+#include <simgear/io/iostreams/sgstream.hxx>
+#include <simgear/io/sg_mmap.hxx>
+
+#include "BVHGroup.hxx"
+#include "BVHTransform.hxx"
+#include "BVHStaticGeometry.hxx"
+#include "BVHStaticBinary.hxx"
+#include "BVHStaticTriangle.hxx"
+#include "BVHFlatGeometry.hxx"
+#include "BVHFlatGeometryBuilder.hxx"
+#include "BVHMaterial.hxx"
+
+// The file is a header followed by the material table and the nodes in
+// preorder. All values are in host byte order, files from a host of the
+// other order are rejected by the byte order mark:
+//
+//   char[8]   magic, includes the format version
+//   uint32    byte order mark
+//   string    source key
+//   uint32    number of source files, then for each
+//             string path, uint64 size, int64 modification time
+//   uint32    number of materials
+//   material  flags uint32, friction, rolling friction, bumpiness and
+//             load resistance as doubles, name string
+//   node      type uint32, then
+//             group:     uint32 number of children, children
+//             transform: 16 doubles to world matrix, as a group
+//             geometry:  uint32 count and global indices of its materials,
+//                        uint32 count and float[3] vertices,
+//                        uint32 count and BVHFlatGeometry::Node array,
+//                        uint32 count and BVHFlatGeometry::Triangle array
+//             compressed geometry:
+//                        uint32 count and global indices of its materials,
+//                        double[3] grid origin, double[3] grid step,
+//                        uint32 count and BVHFlatGeometry::Node array,
+//                        uint32 count and uint16 packed leaf records
+//   char[4]   end mark
+//
+// Strings are an uint32 length and the bytes.
+
+namespace simgear {
+
+namespace {
+
+const char Magic[8] = { 'S', 'G', 'B', 'V', 'H', 'C', '0', '2' };
+const char EndMark[4] = { 'E', 'N', 'D', '.' };
+const uint32_t ByteOrderMark = 0x01020304;
+const uint32_t NoMaterial = ~0u;
+
+enum NodeType {
+    GroupNode = 1,
+    TransformNode = 2,
+    GeometryNode = 3,
+    CompressedGeometryNode = 4
+};
+
+enum MaterialFlags {
+    SolidFlag = 1
+};
+
+/// A material restored from its stored properties.
+class CachedMaterial : public BVHMaterial {
+public:
+    CachedMaterial(bool solid, double frictionFactor, double rollingFriction,
+                   double bumpiness, double loadResistance)
+    {
+        _solid = solid;
+        _friction_factor = frictionFactor;
+        _rolling_friction = rollingFriction;
+        _bumpiness = bumpiness;
+        _load_resistance = loadResistance;
+    }
+};
+
+/// Collects the triangles of a pointer tree.
+class TriangleCollector : public BVHVisitor {
+public:
+    virtual void apply(BVHGroup&) {}
+    virtual void apply(BVHPageNode&) {}
+    virtual void apply(BVHTransform&) {}
+    virtual void apply(BVHMotionTransform&) {}
+    virtual void apply(BVHLineGeometry&) {}
+    virtual void apply(BVHStaticGeometry& node)
+    { node.traverse(*this); }
+    virtual void apply(const BVHStaticBinary& node, const BVHStaticData& data)
+    { node.traverse(*this, data); }
+    virtual void apply(const BVHStaticTriangle& triangle, const BVHStaticData&)
+    {
+        BVHFlatGeometry::Triangle t;
+        for (unsigned i = 0; i < 3; ++i)
+            t.indices[i] = triangle.getIndex(i);
+        t.material = triangle.getMaterialIndex();
+        _triangles.push_back(t);
+    }
+
+    BVHFlatGeometry::TriangleList _triangles;
+};
+
+class Writer : public BVHVisitor {
+public:
+    Writer(const BVHCacheFile::MaterialNameFunction& materialName) :
+        _materialName(materialName),
+        _ok(true)
+    { }
+
+    bool ok() const
+    { return _ok; }
+
+    /// The file content, with the materials in front of the nodes
+    std::string content(const std::string& sourceKey,
+                        const BVHCacheFile::PathList& sources) const
+    {
+        std::string header;
+        header.append(Magic, sizeof(Magic));
+        appendValue(header, ByteOrderMark);
+        appendString(header, sourceKey);
+        appendValue(header, uint32_t(sources.size()));
+        for (const SGPath& source : sources) {
+            SGPath uncached(source);
+            uncached.set_cached(false);
+            appendString(header, uncached.utf8Str());
+            appendValue(header, uint64_t(uncached.sizeInBytes()));
+            appendValue(header, int64_t(uncached.modTime()));
+        }
+        appendValue(header, uint32_t(_materials.size()));
+        for (const BVHMaterial* material : _materials) {
+            appendValue(header, uint32_t(material->get_solid() ? SolidFlag : 0));
+            appendValue(header, material->get_friction_factor());
+            appendValue(header, material->get_rolling_friction());
+            appendValue(header, material->get_bumpiness());
+            appendValue(header, material->get_load_resistance());
+            appendString(header, _materialName ? _materialName(material) : std::string());
+        }
+        return header + _nodes + std::string(EndMark, sizeof(EndMark));
+    }
+
+    virtual void apply(BVHGroup& group)
+    {
+        appendValue(_nodes, uint32_t(GroupNode));
+        appendChildren(group);
+    }
+    virtual void apply(BVHPageNode&)
+    { fail("page node"); }
+    virtual void apply(BVHTransform& transform)
+    {
+        appendValue(_nodes, uint32_t(TransformNode));
+        _nodes.append(reinterpret_cast<const char*>(transform.getToWorldTransform().data()),
+                      16*sizeof(double));
+        appendChildren(transform);
+    }
+    virtual void apply(BVHMotionTransform&)
+    { fail("motion transform"); }
+    virtual void apply(BVHLineGeometry&)
+    { fail("line geometry"); }
+    virtual void apply(BVHStaticGeometry& node)
+    {
+        TriangleCollector collector;
+        node.traverse(collector);
+        SGSharedPtr<BVHFlatGeometry> flat;
+        flat = BVHFlatGeometryBuilder::buildTree(node.getStaticData(), collector._triangles);
+        if (!flat) {
+            // keep the structure of the tree, an empty group does no harm
+            appendValue(_nodes, uint32_t(GroupNode));
+            appendValue(_nodes, uint32_t(0));
+            return;
+        }
+        apply(*flat);
+    }
+    virtual void apply(BVHFlatGeometry& node)
+    {
+        if (node.isCompressed())
+            appendValue(_nodes, uint32_t(CompressedGeometryNode));
+        else
+            appendValue(_nodes, uint32_t(GeometryNode));
+
+        const BVHStaticData* data = node.getStaticData();
+        appendValue(_nodes, uint32_t(data->getNumMaterials()));
+        for (unsigned i = 0; i < data->getNumMaterials(); ++i)
+            appendValue(_nodes, materialIndex(data->getMaterial(i)));
+
+        if (node.isCompressed()) {
+            _nodes.append(reinterpret_cast<const char*>(node.getGridOrigin().data()),
+                          3*sizeof(double));
+            _nodes.append(reinterpret_cast<const char*>(node.getGridStep().data()),
+                          3*sizeof(double));
+            appendArray(_nodes, node.getNodes());
+            appendArray(_nodes, node.getPacked());
+            return;
+        }
+
+        appendValue(_nodes, uint32_t(data->getNumVertices()));
+        for (unsigned i = 0; i < data->getNumVertices(); ++i)
+            _nodes.append(reinterpret_cast<const char*>(data->getVertex(i).data()),
+                          3*sizeof(float));
+
+        appendArray(_nodes, node.getNodes());
+        appendArray(_nodes, node.getTriangles());
+    }
+
+    virtual void apply(const BVHStaticBinary&, const BVHStaticData&)
+    { }
+    virtual void apply(const BVHStaticTriangle&, const BVHStaticData&)
+    { }
+
+private:
+    template<typename T>
+    static void appendValue(std::string& out, const T& value)
+    { out.append(reinterpret_cast<const char*>(&value), sizeof(T)); }
+    static void appendString(std::string& out, const std::string& value)
+    {
+        appendValue(out, uint32_t(value.size()));
+        out.append(value);
+    }
+    template<typename T>
+    static void appendArray(std::string& out, const std::vector<T>& values)
+    {
+        appendValue(out, uint32_t(values.size()));
+        out.append(reinterpret_cast<const char*>(values.data()), values.size()*sizeof(T));
+    }
+
+    void appendChildren(BVHGroup& group)
+    {
+        appendValue(_nodes, uint32_t(group.getNumChildren()));
+        for (unsigned i = 0; i < group.getNumChildren(); ++i)
+            group.getChild(i)->accept(*this);
+    }
+
+    uint32_t materialIndex(const BVHMaterial* material)
+    {
+        if (!material)
+            return NoMaterial;
+        std::map<const BVHMaterial*, uint32_t>::const_iterator i;
+        i = _materialIndices.find(material);
+        if (i != _materialIndices.end())
+            return i->second;
+        uint32_t index = uint32_t(_materials.size());
+        _materials.push_back(material);
+        _materialIndices[material] = index;
+        return index;
+    }
+
+    void fail(const char* what)
+    {
+        SG_LOG(SG_TERRAIN, SG_DEBUG, "BVHCacheFile: cannot store a " << what);
+        _ok = false;
+    }
+
+    const BVHCacheFile::MaterialNameFunction& _materialName;
+    std::vector<const BVHMaterial*> _materials;
+    std::map<const BVHMaterial*, uint32_t> _materialIndices;
+    std::string _nodes;
+    bool _ok;
+};
+
+class Reader {
+public:
+    Reader(const char* data, size_t size) :
+        _data(data),
+        _size(size),
+        _offset(0)
+    { }
+
+    bool readBytes(void* out, size_t size)
+    {
+        if (_size - _offset < size)
+            return false;
+        std::memcpy(out, _data + _offset, size);
+        _offset += size;
+        return true;
+    }
+    template<typename T>
+    bool readValue(T& value)
+    { return readBytes(&value, sizeof(T)); }
+    bool readString(std::string& value)
+    {
+        uint32_t size;
+        if (!readValue(size) || _size - _offset < size)
+            return false;
+        value.assign(_data + _offset, size);
+        _offset += size;
+        return true;
+    }
+    template<typename T>
+    bool readArray(std::vector<T>& values)
+    {
+        uint32_t size;
+        if (!readValue(size) || (_size - _offset)/sizeof(T) < size)
+            return false;
+        values.resize(size);
+        return readBytes(values.data(), size*sizeof(T));
+    }
+
+    /// False if a source file changed since the tree was written
+    bool readSources(bool& upToDate)
+    {
+        uint32_t count;
+        if (!readValue(count))
+            return false;
+        upToDate = true;
+        for (uint32_t i = 0; i < count; ++i) {
+            std::string path;
+            uint64_t size;
+            int64_t modTime;
+            if (!readString(path) || !readValue(size) || !readValue(modTime))
+                return false;
+            SGPath source = SGPath::fromUtf8(path);
+            source.set_cached(false);
+            if (!source.isFile() || source.sizeInBytes() != size ||
+                int64_t(source.modTime()) != modTime)
+                upToDate = false;
+        }
+        return true;
+    }
+
+    bool readMaterials(const BVHCacheFile::MaterialLookupFunction& materialLookup)
+    {
+        uint32_t count;
+        if (!readValue(count))
+            return false;
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t flags;
+            double friction, rollingFriction, bumpiness, loadResistance;
+            std::string name;
+            if (!readValue(flags) || !readValue(friction) ||
+                !readValue(rollingFriction) || !readValue(bumpiness) ||
+                !readValue(loadResistance) || !readString(name))
+                return false;
+            SGSharedPtr<const BVHMaterial> material;
+            if (!name.empty() && materialLookup)
+                material = materialLookup(name);
+            if (!material)
+                material = new CachedMaterial(flags & SolidFlag, friction,
+                                              rollingFriction, bumpiness,
+                                              loadResistance);
+            _materials.push_back(material);
+        }
+        return true;
+    }
+
+    BVHNode* readNode(unsigned depth)
+    {
+        uint32_t type;
+        // guard against damaged files recursing forever
+        if (64 < depth || !readValue(type))
+            return 0;
+        switch (type) {
+        case GroupNode: {
+            SGSharedPtr<BVHGroup> group = new BVHGroup;
+            if (!readChildren(*group, depth))
+                return 0;
+            return group.release();
+        }
+        case TransformNode: {
+            double matrix[16];
+            if (!readBytes(matrix, sizeof(matrix)))
+                return 0;
+            SGSharedPtr<BVHTransform> transform = new BVHTransform;
+            transform->setToWorldTransform(SGMatrixd(matrix));
+            if (!readChildren(*transform, depth))
+                return 0;
+            return transform.release();
+        }
+        case GeometryNode:
+            return readGeometry();
+        case CompressedGeometryNode:
+            return readCompressedGeometry();
+        default:
+            return 0;
+        }
+    }
+
+    bool atEnd()
+    {
+        char endMark[sizeof(EndMark)];
+        if (!readBytes(endMark, sizeof(endMark)))
+            return false;
+        return !std::memcmp(endMark, EndMark, sizeof(EndMark)) && _offset == _size;
+    }
+
+private:
+    bool readChildren(BVHGroup& group, unsigned depth)
+    {
+        uint32_t count;
+        if (!readValue(count))
+            return false;
+        for (uint32_t i = 0; i < count; ++i) {
+            SGSharedPtr<BVHNode> child = readNode(depth + 1);
+            if (!child)
+                return false;
+            group.addChild(child);
+        }
+        return true;
+    }
+
+    BVHStaticData* readMaterials()
+    {
+        std::vector<uint32_t> materials;
+        if (!readArray(materials))
+            return 0;
+        SGSharedPtr<BVHStaticData> data = new BVHStaticData;
+        for (uint32_t index : materials) {
+            if (index != NoMaterial && _materials.size() <= index)
+                return 0;
+            data->addMaterial(index == NoMaterial ? 0 : _materials[index].get());
+        }
+        return data.release();
+    }
+
+    // Everything the traversal dereferences needs to be in range,
+    // and the depth within what the traversal stacks hold
+    template<typename LeafCheck>
+    static bool checkNodes(const BVHFlatGeometry::NodeList& nodes,
+                           const LeafCheck& checkLeaf)
+    {
+        if (nodes.empty())
+            return false;
+        std::vector<std::pair<uint32_t, unsigned> > stack;
+        stack.push_back(std::make_pair(0u, 0u));
+        size_t visited = 0;
+        while (!stack.empty()) {
+            uint32_t index = stack.back().first;
+            unsigned depth = stack.back().second;
+            stack.pop_back();
+            if (nodes.size() <= index || BVHFlatGeometry::MaxDepth <= depth ||
+                nodes.size() < ++visited)
+                return false;
+            const BVHFlatGeometry::Node& node = nodes[index];
+            if (node.isLeaf()) {
+                if (!checkLeaf(node))
+                    return false;
+                continue;
+            }
+            if (node.offset <= index + 1 || 2 < node.axis)
+                return false;
+            stack.push_back(std::make_pair(index + 1, depth + 1));
+            stack.push_back(std::make_pair(node.offset, depth + 1));
+        }
+        return true;
+    }
+
+    BVHNode* readGeometry()
+    {
+        BVHFlatGeometry::NodeList nodes;
+        BVHFlatGeometry::TriangleList triangles;
+        uint32_t numVertices;
+        SGSharedPtr<BVHStaticData> data = readMaterials();
+        if (!data || !readValue(numVertices))
+            return 0;
+        if ((_size - _offset)/(3*sizeof(float)) < numVertices)
+            return 0;
+
+        for (uint32_t i = 0; i < numVertices; ++i) {
+            float v[3];
+            readBytes(v, sizeof(v));
+            data->addVertex(SGVec3f(v[0], v[1], v[2]));
+        }
+        if (!readArray(nodes) || !readArray(triangles))
+            return 0;
+
+        auto checkLeaf = [&triangles](const BVHFlatGeometry::Node& node) {
+            return size_t(node.offset) + node.count <= triangles.size();
+        };
+        if (!checkNodes(nodes, checkLeaf))
+            return 0;
+        for (const BVHFlatGeometry::Triangle& triangle : triangles) {
+            for (unsigned j = 0; j < 3; ++j)
+                if (numVertices <= triangle.indices[j])
+                    return 0;
+        }
+
+        return new BVHFlatGeometry(nodes, triangles, data);
+    }
+
+    BVHNode* readCompressedGeometry()
+    {
+        BVHFlatGeometry::NodeList nodes;
+        BVHFlatGeometry::PackedList packed;
+        double origin[3];
+        double step[3];
+        SGSharedPtr<BVHStaticData> data = readMaterials();
+        if (!data || !readBytes(origin, sizeof(origin)) ||
+            !readBytes(step, sizeof(step)))
+            return 0;
+        for (unsigned i = 0; i < 3; ++i)
+            if (!std::isfinite(origin[i]) || !std::isfinite(step[i]) || !(0 < step[i]))
+                return 0;
+        if (!readArray(nodes) || !readArray(packed))
+            return 0;
+
+        auto checkLeaf = [&packed](const BVHFlatGeometry::Node& node) {
+            size_t offset = node.offset;
+            if (packed.size() < offset + BVHFlatGeometry::PackedHeaderSize)
+                return false;
+            unsigned numVertices = packed[offset + 6];
+            size_t indices = offset + BVHFlatGeometry::PackedHeaderSize +
+                3*numVertices + node.count;
+            if (packed.size() < indices + (3*node.count + 1)/2)
+                return false;
+            for (unsigned k = 0; k < 3u*node.count; ++k) {
+                unsigned index = (packed[indices + k/2] >> (8*(k%2))) & 0xff;
+                if (numVertices <= index)
+                    return false;
+            }
+            return true;
+        };
+        if (!checkNodes(nodes, checkLeaf))
+            return 0;
+
+        return new BVHFlatGeometry(nodes, packed,
+                                   SGVec3d(origin[0], origin[1], origin[2]),
+                                   SGVec3d(step[0], step[1], step[2]), data);
+    }
+
+    const char* _data;
+    size_t _size;
+    size_t _offset;
+    std::vector<SGSharedPtr<const BVHMaterial> > _materials;
+};
+
+} // anonymous namespace
+
+bool
+BVHCacheFile::write(const SGPath& path, BVHNode& node,
+                    const std::string& sourceKey,
+                    const MaterialNameFunction& materialName,
+                    const PathList& sources)
+{
+    Writer writer(materialName);
+    node.accept(writer);
+    if (!writer.ok())
+        return false;
+    std::string content = writer.content(sourceKey, sources);
+
+    // write to a temporary name, then rename, so readers never see a
+    // partial file
+    std::size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+    SGPath tmp(path.utf8Str() + ".tmp" + std::to_string(thread));
+    {
+        sg_ofstream stream(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!stream.is_open())
+            return false;
+        stream.write(content.data(), content.size());
+        if (!stream.good()) {
+            stream.close();
+            tmp.remove();
+            return false;
+        }
+    }
+    if (!tmp.rename(path)) {
+        tmp.remove();
+        return false;
+    }
+    return true;
+}
+
+BVHNode*
+BVHCacheFile::read(const SGPath& path, const std::string& sourceKey,
+                   const MaterialLookupFunction& materialLookup)
+{
+    // the callers path may have cached an earlier state of the file
+    SGPath uncached(path);
+    uncached.set_cached(false);
+    if (!uncached.isFile() || uncached.sizeInBytes() < sizeof(Magic))
+        return 0;
+
+    SGMMapFile file(path);
+    if (!file.open(SG_IO_IN))
+        return 0;
+
+    Reader reader(file.get(), file.get_size());
+    char magic[sizeof(Magic)];
+    uint32_t byteOrderMark;
+    std::string key;
+    if (!reader.readBytes(magic, sizeof(magic)) ||
+        std::memcmp(magic, Magic, sizeof(Magic)) ||
+        !reader.readValue(byteOrderMark) || byteOrderMark != ByteOrderMark ||
+        !reader.readString(key)) {
+        SG_LOG(SG_TERRAIN, SG_DEBUG, "BVHCacheFile: ignoring " << path
+               << ", unknown format");
+        return 0;
+    }
+    if (key != sourceKey)
+        return 0;
+
+    bool upToDate = false;
+    if (reader.readSources(upToDate) && !upToDate) {
+        SG_LOG(SG_TERRAIN, SG_DEBUG, "BVHCacheFile: ignoring " << path
+               << ", a source file changed");
+        return 0;
+    }
+
+    SGSharedPtr<BVHNode> node;
+    if (upToDate && reader.readMaterials(materialLookup))
+        node = reader.readNode(0);
+    if (!node || !reader.atEnd()) {
+        SG_LOG(SG_TERRAIN, SG_WARN, "BVHCacheFile: " << path << " is damaged");
+        return 0;
+    }
+    return node.release();
+}
+
+}
@@ -0,0 +1,71 @@
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#ifndef BVHCacheFile_hxx
+#define BVHCacheFile_hxx
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <simgear/misc/sg_path.hxx>
+
+namespace simgear {
+
+class BVHMaterial;
+class BVHNode;
+
+/// Reads and writes bounding volume trees in a compact binary file, so
+/// the tree built from a scenery tile or model can be loaded directly in
+/// later sessions instead of being rebuilt from the geometry.
+///
+/// Supported are BVHGroup, BVHTransform, BVHStaticGeometry and
+/// BVHFlatGeometry nodes. Static geometry is stored, and read back, as
+/// flat geometry. Each file records a key naming the source it was built
+/// from, e.g. its file name, and is ignored by read() if that does not
+/// match. It also records the size and modification time of the source
+/// files passed to write(), and is ignored if any of them changed or is
+/// gone.
+class BVHCacheFile {
+public:
+    /// Name to store for a material, to find it again when reading.
+    typedef std::function<std::string(const BVHMaterial*)> MaterialNameFunction;
+    /// Returns the material for a stored name, or 0.
+    typedef std::function<const BVHMaterial*(const std::string&)> MaterialLookupFunction;
+    /// The files a tree was built from.
+    typedef std::vector<SGPath> PathList;
+
+    /// Write the tree below node, built from the source named by
+    /// sourceKey. Returns false, and leaves no file behind, if the tree
+    /// contains unsupported nodes or on io errors. The current state of
+    /// the sources is stored to check for changes.
+    static bool write(const SGPath& path, BVHNode& node,
+                      const std::string& sourceKey,
+                      const MaterialNameFunction& materialName = MaterialNameFunction(),
+                      const PathList& sources = PathList());
+
+    /// Read a tree written by write(). Returns 0 if the file is missing,
+    /// damaged, of a different version, written with a different
+    /// sourceKey or if one of its source files changed.
+    /// Materials that have no name or that materialLookup does not know
+    /// are recreated from their stored properties.
+    static BVHNode* read(const SGPath& path, const std::string& sourceKey,
+                         const MaterialLookupFunction& materialLookup = MaterialLookupFunction());
+};
+
+}
+
+#endif
@@ -0,0 +1,290 @@
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#include <simgear_config.h>
+
+#include "BVHDynamicTree.hxx"
+
+#include <algorithm>
+
+namespace simgear {
+
+static SGBoxd
+enlargedBox(const SGSphered& sphere, double margin)
+{
+    SGBoxd box;
+    if (sphere.empty())
+        return box;
+    double radius = sphere.getRadius() + margin;
+    SGVec3d extent(radius, radius, radius);
+    box.setMin(sphere.getCenter() - extent);
+    box.setMax(sphere.getCenter() + extent);
+    return box;
+}
+
+static bool
+inside(const SGSphered& sphere, const SGBoxd& box)
+{
+    if (sphere.empty() || box.empty())
+        return false;
+    for (unsigned i = 0; i < 3; ++i) {
+        if (sphere.getCenter()[i] - sphere.getRadius() < box.getMin()[i])
+            return false;
+        if (box.getMax()[i] < sphere.getCenter()[i] + sphere.getRadius())
+            return false;
+    }
+    return true;
+}
+
+static SGBoxd
+join(const SGBoxd& box0, const SGBoxd& box1)
+{
+    SGBoxd box(box0);
+    box.expandBy(box1);
+    return box;
+}
+
+static double
+area(const SGBoxd& box)
+{
+    if (box.empty())
+        return 0;
+    SGVec3d size = box.getSize();
+    return size[0]*size[1] + size[1]*size[2] + size[2]*size[0];
+}
+
+BVHDynamicTree::BVHDynamicTree() :
+    _root(new BVHGroup),
+    _rootEntry(-1),
+    _margin(10)
+{
+}
+
+BVHDynamicTree::~BVHDynamicTree()
+{
+}
+
+void
+BVHDynamicTree::addNode(BVHNode* node)
+{
+    if (!node || containsNode(node))
+        return;
+    int leaf = allocateEntry();
+    _entries[leaf].node = node;
+    _entries[leaf].box = enlargedBox(node->getBoundingSphere(), _margin);
+    _leafs[node] = leaf;
+    insertLeaf(leaf);
+}
+
+void
+BVHDynamicTree::removeNode(BVHNode* node)
+{
+    LeafMap::iterator i = _leafs.find(node);
+    if (i == _leafs.end())
+        return;
+    int leaf = i->second;
+    _leafs.erase(i);
+    removeLeaf(leaf);
+    freeEntry(leaf);
+}
+
+void
+BVHDynamicTree::clear()
+{
+    _root->clear();
+    _entries.clear();
+    _freeEntries.clear();
+    _leafs.clear();
+    _rootEntry = -1;
+}
+
+unsigned
+BVHDynamicTree::update()
+{
+    unsigned count = 0;
+    for (LeafMap::iterator i = _leafs.begin(); i != _leafs.end(); ++i) {
+        int leaf = i->second;
+        const SGSphered& sphere = i->first->getBoundingSphere();
+        const SGBoxd& placed = _entries[leaf].box;
+        if (sphere.empty() ? placed.empty() : inside(sphere, placed))
+            continue;
+
+        removeLeaf(leaf);
+        _entries[leaf].box = enlargedBox(sphere, _margin);
+        insertLeaf(leaf);
+        ++count;
+    }
+    return count;
+}
+
+unsigned
+BVHDynamicTree::getDepth() const
+{
+    if (_rootEntry < 0)
+        return 0;
+    return getDepth(_rootEntry);
+}
+
+int
+BVHDynamicTree::allocateEntry()
+{
+    int index;
+    if (_freeEntries.empty()) {
+        index = static_cast<int>(_entries.size());
+        _entries.push_back(Entry());
+    } else {
+        index = _freeEntries.back();
+        _freeEntries.pop_back();
+    }
+    Entry& entry = _entries[index];
+    entry.box.clear();
+    entry.parent = -1;
+    entry.children[0] = -1;
+    entry.children[1] = -1;
+    return index;
+}
+
+void
+BVHDynamicTree::freeEntry(int index)
+{
+    // Keep the group of inner entries for reuse, reinsertion
+    // frees and takes one again right away
+    if (_entries[index].isLeaf())
+        _entries[index].node = 0;
+    _freeEntries.push_back(index);
+}
+
+void
+BVHDynamicTree::insertLeaf(int leaf)
+{
+    if (_rootEntry < 0) {
+        _rootEntry = leaf;
+        _entries[leaf].parent = -1;
+        _root->addChild(_entries[leaf].node);
+        return;
+    }
+
+    // Walk down while that is cheaper than pairing the new leaf with the
+    // current entry, the surface area heuristic used for static trees
+    SGBoxd box = _entries[leaf].box;
+    int sibling = _rootEntry;
+    while (!_entries[sibling].isLeaf()) {
+        const Entry& entry = _entries[sibling];
+        double joinedArea = area(join(entry.box, box));
+        double cost = 2*joinedArea;
+        // moving down still grows this entry
+        double inheritedCost = 2*(joinedArea - area(entry.box));
+
+        double childCost[2];
+        for (unsigned i = 0; i < 2; ++i) {
+            const Entry& child = _entries[entry.children[i]];
+            childCost[i] = area(join(child.box, box)) + inheritedCost;
+            if (!child.isLeaf())
+                childCost[i] -= area(child.box);
+        }
+        if (cost < childCost[0] && cost < childCost[1])
+            break;
+        sibling = entry.children[childCost[1] < childCost[0]];
+    }
+
+    // Pair it with the new leaf below a new inner entry
+    int oldParent = _entries[sibling].parent;
+    int parent = allocateEntry();
+    if (!_entries[parent].node)
+        _entries[parent].node = new BVHGroup;
+    _entries[parent].parent = oldParent;
+    if (oldParent < 0) {
+        _root->removeChild(_entries[sibling].node);
+        _root->addChild(_entries[parent].node);
+        _rootEntry = parent;
+    } else {
+        replaceChild(oldParent, sibling, parent);
+    }
+
+    _entries[parent].children[0] = sibling;
+    _entries[parent].children[1] = leaf;
+    _entries[sibling].parent = parent;
+    _entries[leaf].parent = parent;
+    getGroup(parent)->addChild(_entries[sibling].node);
+    getGroup(parent)->addChild(_entries[leaf].node);
+
+    updateBoxes(parent);
+}
+
+void
+BVHDynamicTree::removeLeaf(int leaf)
+{
+    int parent = _entries[leaf].parent;
+    if (parent < 0) {
+        _root->removeChild(_entries[leaf].node);
+        _rootEntry = -1;
+        return;
+    }
+
+    // The sibling takes the place of the parent
+    const Entry& parentEntry = _entries[parent];
+    int sibling = parentEntry.children[0] == leaf ?
+        parentEntry.children[1] : parentEntry.children[0];
+    int grandParent = parentEntry.parent;
+
+    getGroup(parent)->clear();
+    _entries[sibling].parent = grandParent;
+    _entries[leaf].parent = -1;
+    if (grandParent < 0) {
+        _root->removeChild(_entries[parent].node);
+        _root->addChild(_entries[sibling].node);
+        _rootEntry = sibling;
+    } else {
+        replaceChild(grandParent, parent, sibling);
+        updateBoxes(grandParent);
+    }
+    freeEntry(parent);
+}
+
+void
+BVHDynamicTree::replaceChild(int parent, int oldChild, int newChild)
+{
+    Entry& entry = _entries[parent];
+    if (entry.children[0] == oldChild)
+        entry.children[0] = newChild;
+    else
+        entry.children[1] = newChild;
+    BVHGroup* group = getGroup(parent);
+    group->removeChild(_entries[oldChild].node);
+    group->addChild(_entries[newChild].node);
+}
+
+void
+BVHDynamicTree::updateBoxes(int index)
+{
+    for (; 0 <= index; index = _entries[index].parent) {
+        Entry& entry = _entries[index];
+        entry.box = join(_entries[entry.children[0]].box,
+                         _entries[entry.children[1]].box);
+    }
+}
+
+unsigned
+BVHDynamicTree::getDepth(int index) const
+{
+    const Entry& entry = _entries[index];
+    if (entry.isLeaf())
+        return 1;
+    return 1 + std::max(getDepth(entry.children[0]),
+                        getDepth(entry.children[1]));
+}
+
+}
@@ -0,0 +1,110 @@
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#ifndef BVHDynamicTree_hxx
+#define BVHDynamicTree_hxx
+
+#include <map>
+#include <vector>
+
+#include <simgear/math/SGGeometry.hxx>
+#include <simgear/structure/SGReferenced.hxx>
+#include <simgear/structure/SGSharedPtr.hxx>
+
+#include "BVHGroup.hxx"
+
+namespace simgear {
+
+/// A top level hierarchy over many independently moving subtrees, like
+/// the BVHMotionTransforms of carriers, AI traffic or animated objects.
+///
+/// The nodes are kept in a binary tree of BVHGroups below getNode(), so
+/// any visitor culls them through the group bounding spheres. Each node
+/// is placed by the box around its bounding sphere, enlarged by a margin.
+/// update() moves only those nodes which left their enlarged box to a
+/// better place, which keeps the cost per frame low when most nodes move
+/// little.
+class BVHDynamicTree : public SGReferenced {
+public:
+    BVHDynamicTree();
+    virtual ~BVHDynamicTree();
+
+    /// The root of the hierarchy, to be added to the scene's tree.
+    BVHGroup* getNode()
+    { return _root; }
+    const BVHGroup* getNode() const
+    { return _root; }
+
+    /// Distance a node may move before update() reinserts it.
+    void setMargin(double margin)
+    { _margin = margin; }
+    double getMargin() const
+    { return _margin; }
+
+    void addNode(BVHNode* node);
+    void removeNode(BVHNode* node);
+    bool containsNode(const BVHNode* node) const
+    { return _leafs.find(node) != _leafs.end(); }
+    void clear();
+
+    unsigned getNumNodes() const
+    { return static_cast<unsigned>(_leafs.size()); }
+
+    /// Reinsert the nodes which moved out of their enlarged box.
+    /// Returns the number of reinserted nodes.
+    unsigned update();
+
+    /// Depth of the binary tree, 0 if empty.
+    unsigned getDepth() const;
+
+private:
+    struct Entry {
+        /// The users node for leafs, a BVHGroup for inner entries
+        SGSharedPtr<BVHNode> node;
+        /// Box around the enlarged sphere of leafs,
+        /// union of the children otherwise
+        SGBoxd box;
+        int parent;
+        int children[2];
+
+        bool isLeaf() const
+        { return children[0] < 0; }
+    };
+    typedef std::vector<Entry> EntryList;
+    typedef std::map<const BVHNode*, int> LeafMap;
+
+    int allocateEntry();
+    void freeEntry(int index);
+    BVHGroup* getGroup(int index)
+    { return static_cast<BVHGroup*>(_entries[index].node.get()); }
+
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    void replaceChild(int parent, int oldChild, int newChild);
+    void updateBoxes(int index);
+    unsigned getDepth(int index) const;
+
+    SGSharedPtr<BVHGroup> _root;
+    EntryList _entries;
+    std::vector<int> _freeEntries;
+    LeafMap _leafs;
+    int _rootEntry;
+    double _margin;
+};
+
+}
+
+#endif
@@ -0,0 +1,418 @@
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#include <simgear_config.h>
+
+#include "BVHFlatGeometry.hxx"
+
+#include <algorithm>
+#include <cmath>
+
+#include "BVHStaticBinary.hxx"
+#include "BVHStaticGeometry.hxx"
+#include "BVHStaticTriangle.hxx"
+
+namespace simgear {
+
+static_assert(sizeof(BVHFlatGeometry::Node) == 32,
+              "BVHFlatGeometry::Node should stay half a cache line");
+
+namespace {
+
+// Converts the leafs to compressed records. Small subtrees are merged into
+// a single leaf on the way, the nodes take more memory than the packed
+// triangles otherwise.
+class LeafPacker {
+public:
+    enum { MaxMergedTriangles = 8 };
+
+    LeafPacker(const BVHFlatGeometry::NodeList& nodes,
+               const BVHFlatGeometry::TriangleList& triangles,
+               const BVHStaticData& staticData) :
+        _nodes(nodes),
+        _triangles(triangles),
+        _staticData(staticData)
+    {
+    }
+
+    bool pack(double precision, BVHFlatGeometry::NodeList& nodes,
+              BVHFlatGeometry::PackedList& packed, SGVec3d& origin, SGVec3d& step)
+    {
+        // Children are stored behind their parents
+        _counts.resize(_nodes.size());
+        for (unsigned i = static_cast<unsigned>(_nodes.size()); 0 < i--;) {
+            const BVHFlatGeometry::Node& node = _nodes[i];
+            if (node.isLeaf())
+                _counts[i] = node.count;
+            else
+                _counts[i] = _counts[i + 1] + _counts[node.offset];
+        }
+        _maxMergedExtent = 65000*precision;
+        emit(0, nodes);
+
+        // One grid for the whole geometry, so vertices shared between
+        // leafs decode to the same position and there are no cracks
+        // between them. Each leaf has to fit into 16 bit grid offsets and
+        // the whole geometry into 31 bit grid positions.
+        SGBoxd box(BVHFlatGeometry::getBoundingBox(_nodes.front()));
+        origin = box.getMin();
+        step = SGVec3d(precision, precision, precision);
+        for (unsigned i = 0; i < 3; ++i)
+            step[i] = std::max(step[i], box.getSize()[i]/double(1 << 30));
+        for (const BVHFlatGeometry::Node& node : nodes) {
+            if (!node.isLeaf())
+                continue;
+            for (unsigned i = 0; i < 3; ++i) {
+                double extent = double(node.max[i]) - double(node.min[i]);
+                step[i] = std::max(step[i], extent/65000);
+            }
+        }
+
+        for (BVHFlatGeometry::Node& node : nodes) {
+            if (!node.isLeaf())
+                continue;
+            unsigned offset = static_cast<unsigned>(packed.size());
+            if (!packLeaf(node, origin, step, packed))
+                return false;
+            node.offset = offset;
+        }
+        return true;
+    }
+
+private:
+    // Copy the subtree in depth first order, leafs point into
+    // _leafTriangles for now
+    unsigned emit(unsigned index, BVHFlatGeometry::NodeList& nodes)
+    {
+        const BVHFlatGeometry::Node& node = _nodes[index];
+        unsigned newIndex = static_cast<unsigned>(nodes.size());
+        nodes.push_back(node);
+        if (node.isLeaf() || mergeable(index)) {
+            BVHFlatGeometry::Node& leaf = nodes.back();
+            leaf.offset = static_cast<unsigned>(_leafTriangles.size());
+            leaf.count = static_cast<uint16_t>(_counts[index]);
+            collectTriangles(index);
+            return newIndex;
+        }
+        emit(index + 1, nodes);
+        unsigned right = emit(node.offset, nodes);
+        nodes[newIndex].offset = right;
+        return newIndex;
+    }
+
+    bool mergeable(unsigned index) const
+    {
+        if (MaxMergedTriangles < _counts[index])
+            return false;
+        const BVHFlatGeometry::Node& node = _nodes[index];
+        for (unsigned i = 0; i < 3; ++i)
+            if (_maxMergedExtent < double(node.max[i]) - double(node.min[i]))
+                return false;
+        return true;
+    }
+
+    void collectTriangles(unsigned index)
+    {
+        const BVHFlatGeometry::Node& node = _nodes[index];
+        if (node.isLeaf()) {
+            for (unsigned i = node.offset; i < node.offset + node.count; ++i)
+                _leafTriangles.push_back(i);
+            return;
+        }
+        collectTriangles(index + 1);
+        collectTriangles(node.offset);
+    }
+
+    bool packLeaf(const BVHFlatGeometry::Node& node, const SGVec3d& origin,
+                  const SGVec3d& step, BVHFlatGeometry::PackedList& packed)
+    {
+        const unsigned* triangles = _leafTriangles.data() + node.offset;
+
+        // the distinct vertices of the leaf
+        _vertices.clear();
+        for (unsigned i = 0; i < node.count; ++i) {
+            for (unsigned j = 0; j < 3; ++j) {
+                unsigned index = _triangles[triangles[i]].indices[j];
+                if (std::find(_vertices.begin(), _vertices.end(), index) == _vertices.end())
+                    _vertices.push_back(index);
+            }
+        }
+        if (0xff < _vertices.size())
+            return false;
+
+        int32_t leafPosition[3] = { INT32_MAX, INT32_MAX, INT32_MAX };
+        _positions.clear();
+        for (unsigned index : _vertices) {
+            SGVec3d v(_staticData.getVertex(index));
+            for (unsigned i = 0; i < 3; ++i) {
+                int32_t position = int32_t(std::lround((v[i] - origin[i])/step[i]));
+                leafPosition[i] = std::min(leafPosition[i], position);
+                _positions.push_back(position);
+            }
+        }
+
+        for (unsigned i = 0; i < 3; ++i) {
+            packed.push_back(uint16_t(uint32_t(leafPosition[i]) & 0xffff));
+            packed.push_back(uint16_t(uint32_t(leafPosition[i]) >> 16));
+        }
+        packed.push_back(uint16_t(_vertices.size()));
+        for (size_t i = 0; i < _positions.size(); ++i) {
+            int32_t delta = _positions[i] - leafPosition[i%3];
+            if (delta < 0 || 0xffff < delta)
+                return false;
+            packed.push_back(uint16_t(delta));
+        }
+        for (unsigned i = 0; i < node.count; ++i)
+            packed.push_back(uint16_t(_triangles[triangles[i]].material));
+        size_t indexStart = packed.size();
+        packed.resize(indexStart + (3*node.count + 1)/2, 0);
+        for (unsigned k = 0; k < 3u*node.count; ++k) {
+            unsigned vertex = _triangles[triangles[k/3]].indices[k%3];
+            std::vector<unsigned>::const_iterator i;
+            i = std::find(_vertices.begin(), _vertices.end(), vertex);
+            unsigned index = static_cast<unsigned>(i - _vertices.begin());
+            packed[indexStart + k/2] |= uint16_t(index << (8*(k%2)));
+        }
+        return true;
+    }
+
+    const BVHFlatGeometry::NodeList& _nodes;
+    const BVHFlatGeometry::TriangleList& _triangles;
+    const BVHStaticData& _staticData;
+    double _maxMergedExtent;
+
+    std::vector<unsigned> _counts;
+    std::vector<unsigned> _leafTriangles;
+    std::vector<unsigned> _vertices;
+    std::vector<int32_t> _positions;
+};
+
+}
+
+BVHFlatGeometry::BVHFlatGeometry(NodeList& nodes, TriangleList& triangles,
+                                 const BVHStaticData* staticData) :
+    _staticData(staticData),
+    _compressed(false),
+    _gridOrigin(0, 0, 0),
+    _gridStep(0, 0, 0)
+{
+    _nodes.swap(nodes);
+    _triangles.swap(triangles);
+    // builders grow them piecewise
+    _nodes.shrink_to_fit();
+    _triangles.shrink_to_fit();
+}
+
+BVHFlatGeometry::BVHFlatGeometry(NodeList& nodes, PackedList& packed,
+                                 const SGVec3d& gridOrigin, const SGVec3d& gridStep,
+                                 const BVHStaticData* staticData) :
+    _staticData(staticData),
+    _compressed(true),
+    _gridOrigin(gridOrigin),
+    _gridStep(gridStep)
+{
+    _nodes.swap(nodes);
+    _packed.swap(packed);
+    _nodes.shrink_to_fit();
+    _packed.shrink_to_fit();
+}
+
+BVHFlatGeometry::~BVHFlatGeometry()
+{
+}
+
+void
+BVHFlatGeometry::accept(BVHVisitor& visitor)
+{
+    visitor.apply(*this);
+}
+
+SGSphered
+BVHFlatGeometry::computeBoundingSphere() const
+{
+    SGSphered sphere;
+    if (!_nodes.empty())
+        sphere.expandBy(SGBoxd(getBoundingBox(_nodes.front())));
+    return sphere;
+}
+
+BVHStaticGeometry*
+BVHFlatGeometry::getStaticGeometry() const
+{
+    std::lock_guard<std::mutex> lock(_staticGeometryMutex);
+    if (_staticGeometry || _nodes.empty())
+        return _staticGeometry;
+    if (!_compressed) {
+        _staticGeometry = new BVHStaticGeometry(buildStaticNode(0, 0), _staticData);
+        return _staticGeometry;
+    }
+
+    // the static nodes need indexed vertices, decode them
+    SGSharedPtr<BVHStaticData> data = new BVHStaticData;
+    for (unsigned i = 0; i < _staticData->getNumMaterials(); ++i)
+        data->addMaterial(_staticData->getMaterial(i));
+    const BVHStaticNode* root = buildStaticNode(0, data);
+    data->trim();
+    _staticGeometry = new BVHStaticGeometry(root, data);
+    return _staticGeometry;
+}
+
+bool
+BVHFlatGeometry::compress(double precision)
+{
+    if (_compressed || _nodes.empty())
+        return _compressed;
+    // material index 0xffff is left for triangles without material
+    if (!(0 < precision) || 0xffff <= _staticData->getNumMaterials())
+        return false;
+
+    LeafPacker packer(_nodes, _triangles, *_staticData);
+    NodeList nodes;
+    PackedList packed;
+    SGVec3d origin, step;
+    if (!packer.pack(precision, nodes, packed, origin, step))
+        return false;
+
+    SGSharedPtr<BVHStaticData> staticData = new BVHStaticData;
+    for (unsigned i = 0; i < _staticData->getNumMaterials(); ++i)
+        staticData->addMaterial(_staticData->getMaterial(i));
+    _staticData = staticData;
+
+    _nodes.swap(nodes);
+    _nodes.shrink_to_fit();
+    _packed.swap(packed);
+    _packed.shrink_to_fit();
+    TriangleList().swap(_triangles);
+    _gridOrigin = origin;
+    _gridStep = step;
+    _compressed = true;
+
+    // the boxes have to hold the vertices as they are decoded
+    refitNodes();
+    {
+        std::lock_guard<std::mutex> lock(_staticGeometryMutex);
+        _staticGeometry = 0;
+    }
+    invalidateBound();
+    return true;
+}
+
+size_t
+BVHFlatGeometry::getMemoryUsage() const
+{
+    size_t size = sizeof(*this);
+    size += _nodes.capacity()*sizeof(Node);
+    size += _triangles.capacity()*sizeof(Triangle);
+    size += _packed.capacity()*sizeof(uint16_t);
+    if (_staticData) {
+        size += _staticData->getNumVertices()*sizeof(SGVec3f);
+        size += _staticData->getNumMaterials()*sizeof(SGSharedPtr<const BVHMaterial>);
+    }
+    return size;
+}
+
+bool
+BVHFlatGeometry::refit(const std::vector<SGVec3f>& vertices)
+{
+    if (_compressed || !_staticData ||
+        vertices.size() != _staticData->getNumVertices())
+        return false;
+
+    // Other geometry may share the static data, so do not touch it
+    SGSharedPtr<BVHStaticData> staticData = new BVHStaticData;
+    for (unsigned i = 0; i < _staticData->getNumMaterials(); ++i)
+        staticData->addMaterial(_staticData->getMaterial(i));
+    for (unsigned i = 0; i < vertices.size(); ++i)
+        staticData->addVertex(vertices[i]);
+    _staticData = staticData;
+
+    refitNodes();
+    {
+        std::lock_guard<std::mutex> lock(_staticGeometryMutex);
+        _staticGeometry = 0;
+    }
+    invalidateBound();
+    return true;
+}
+
+void
+BVHFlatGeometry::refitNodes()
+{
+    // Children are stored behind their parents,
+    // so walking backwards visits them first
+    for (unsigned i = static_cast<unsigned>(_nodes.size()); 0 < i--;) {
+        Node& node = _nodes[i];
+        if (node.isLeaf()) {
+            refitLeaf(node);
+            continue;
+        }
+        const Node& left = _nodes[i + 1];
+        const Node& right = _nodes[node.offset];
+        for (unsigned j = 0; j < 3; ++j) {
+            node.min[j] = std::min(left.min[j], right.min[j]);
+            node.max[j] = std::max(left.max[j], right.max[j]);
+        }
+    }
+}
+
+void
+BVHFlatGeometry::refitLeaf(Node& node) const
+{
+    SGBoxf box;
+    for (unsigned i = 0; i < node.count; ++i) {
+        SGTrianglef triangle = getTriangle(node, i);
+        for (unsigned j = 0; j < 3; ++j)
+            box.expandBy(triangle.getVertex(j));
+    }
+    for (unsigned j = 0; j < 3; ++j) {
+        node.min[j] = box.getMin()[j];
+        node.max[j] = box.getMax()[j];
+    }
+}
+
+const BVHStaticNode*
+BVHFlatGeometry::buildStaticNode(unsigned index, BVHStaticData* data) const
+{
+    const Node& node = _nodes[index];
+    if (!node.isLeaf()) {
+        const BVHStaticNode* left = buildStaticNode(index + 1, data);
+        const BVHStaticNode* right = buildStaticNode(node.offset, data);
+        return new BVHStaticBinary(node.axis, left, right, getBoundingBox(node));
+    }
+
+    // leafs with several triangles become a chain of binaries
+    const BVHStaticNode* result = 0;
+    for (unsigned i = node.count; 0 < i--;) {
+        const BVHStaticNode* triangle;
+        if (data) {
+            SGTrianglef decoded = getTriangle(node, i);
+            unsigned indices[3];
+            for (unsigned j = 0; j < 3; ++j)
+                indices[j] = data->addVertex(decoded.getVertex(j));
+            triangle = new BVHStaticTriangle(getMaterialIndex(node, i), indices);
+        } else {
+            const Triangle& t = _triangles[node.offset + i];
+            triangle = new BVHStaticTriangle(t.material, t.indices);
+        }
+        if (result)
+            result = new BVHStaticBinary(node.axis, triangle, result, getBoundingBox(node));
+        else
+            result = triangle;
+    }
+    return result;
+}
+
+}
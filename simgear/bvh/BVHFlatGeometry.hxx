@@ -0,0 +1,204 @@
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#ifndef BVHFlatGeometry_hxx
+#define BVHFlatGeometry_hxx
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <simgear/math/SGGeometry.hxx>
+#include <simgear/structure/SGSharedPtr.hxx>
+
+#include "BVHVisitor.hxx"
+#include "BVHNode.hxx"
+#include "BVHStaticData.hxx"
+
+namespace simgear {
+
+class BVHStaticGeometry;
+class BVHStaticNode;
+
+/// Static triangle geometry stored as a flat, depth-first array of
+/// bounding box nodes. The first child of an inner node directly follows
+/// it in the array, so traversal touches memory mostly front to back and
+/// needs neither virtual calls nor pointer chasing. Built by the
+/// BVHFlatGeometryBuilder.
+///
+/// The geometry can be compressed, see compress(). Leafs then hold their
+/// vertices as 16 bit offsets on a grid and their triangles as packed
+/// byte indices into those, decoded on the fly by getTriangle().
+class BVHFlatGeometry : public BVHNode {
+public:
+    /// Upper bound for the depth of the tree, and so for the size of the
+    /// traversal stack.
+    enum { MaxDepth = 96 };
+
+    struct Node {
+        bool isLeaf() const
+        { return count != 0; }
+
+        float min[3];
+        float max[3];
+        /// index of the second child for inner nodes,
+        /// index of the first triangle for leafs
+        uint32_t offset;
+        /// number of triangles in a leaf, zero for inner nodes
+        uint16_t count;
+        /// split axis of inner nodes
+        uint16_t axis;
+    };
+
+    /// Triangles refer to the vertices and materials of the BVHStaticData.
+    struct Triangle {
+        unsigned indices[3];
+        unsigned material;
+    };
+
+    typedef std::vector<Node> NodeList;
+    typedef std::vector<Triangle> TriangleList;
+    /// Leaf records of compressed geometry, the offset of a compressed
+    /// leaf points to its record in here. A record holds the grid position
+    /// of the leaf as three 32 bit values in two words each, the number of
+    /// vertices, the vertices as grid offsets from the leaf position, one
+    /// material index per triangle and finally the vertex indices of the
+    /// triangles, one byte each.
+    typedef std::vector<uint16_t> PackedList;
+
+    /// Takes over the content of nodes and triangles.
+    BVHFlatGeometry(NodeList& nodes, TriangleList& triangles,
+                    const BVHStaticData* staticData);
+    /// Compressed geometry, takes over the content of nodes and
+    /// packed. staticData only holds the materials.
+    BVHFlatGeometry(NodeList& nodes, PackedList& packed,
+                    const SGVec3d& gridOrigin, const SGVec3d& gridStep,
+                    const BVHStaticData* staticData);
+    virtual ~BVHFlatGeometry();
+
+    virtual void accept(BVHVisitor& visitor);
+
+    virtual SGSphered computeBoundingSphere() const;
+
+    const BVHStaticData* getStaticData() const
+    { return _staticData; }
+    const NodeList& getNodes() const
+    { return _nodes; }
+    /// Empty for compressed geometry.
+    const TriangleList& getTriangles() const
+    { return _triangles; }
+
+    static SGBoxf getBoundingBox(const Node& node)
+    {
+        return SGBoxf(SGVec3f(node.min[0], node.min[1], node.min[2]),
+                      SGVec3f(node.max[0], node.max[1], node.max[2]));
+    }
+
+    /// Triangle i, 0 <= i < leaf.count, of a leaf.
+    SGTrianglef getTriangle(const Node& leaf, unsigned i) const
+    {
+        if (_compressed)
+            return getPackedTriangle(&_packed[leaf.offset], leaf.count, i);
+        const Triangle& t = _triangles[leaf.offset + i];
+        return SGTrianglef(_staticData->getVertex(t.indices[0]),
+                           _staticData->getVertex(t.indices[1]),
+                           _staticData->getVertex(t.indices[2]));
+    }
+    const BVHMaterial* getMaterial(const Node& leaf, unsigned i) const
+    { return _staticData->getMaterial(getMaterialIndex(leaf, i)); }
+    unsigned getMaterialIndex(const Node& leaf, unsigned i) const
+    {
+        if (_compressed)
+            return _packed[leaf.offset + PackedHeaderSize + 3*_packed[leaf.offset + 6] + i];
+        return _triangles[leaf.offset + i].material;
+    }
+
+    /// Convert to the compressed storage. Vertices are placed on a grid
+    /// with about precision meters spacing, coarser if single leafs are
+    /// too large for that. Bounding boxes are recomputed for the moved
+    /// vertices. Returns false and leaves the geometry as it is, if it
+    /// cannot be compressed.
+    bool compress(double precision = 1.0/256);
+    bool isCompressed() const
+    { return _compressed; }
+    const PackedList& getPacked() const
+    { return _packed; }
+    const SGVec3d& getGridOrigin() const
+    { return _gridOrigin; }
+    /// Vertex spacing of compressed geometry, per axis.
+    const SGVec3d& getGridStep() const
+    { return _gridStep; }
+
+    /// Bytes used by the nodes, triangles and vertices.
+    size_t getMemoryUsage() const;
+
+    /// Move the vertices of deforming geometry, an animated ramp or a
+    /// flexing wing, to new positions and update the bounding boxes bottom
+    /// up in a single pass over the nodes. The tree topology is kept, so
+    /// this is much cheaper than a rebuild, but culling gets worse when
+    /// the triangles move far relative to each other. vertices replaces
+    /// the vertices of the static data, which is copied on the way, and
+    /// must have the same size. Returns false if it does not or for
+    /// compressed geometry.
+    bool refit(const std::vector<SGVec3f>& vertices);
+
+    /// The equivalent tree of BVHStaticBinary and BVHStaticTriangle nodes,
+    /// for visitors which do not know about the flat layout.
+    /// Built on first use.
+    BVHStaticGeometry* getStaticGeometry() const;
+
+    /// Words in front of the vertices of a leaf record.
+    enum { PackedHeaderSize = 7 };
+
+private:
+    SGTrianglef getPackedTriangle(const uint16_t* record, unsigned count,
+                                  unsigned i) const
+    {
+        const uint16_t* vertices = record + PackedHeaderSize;
+        const uint16_t* indices = vertices + 3*record[6] + count;
+        SGVec3f corners[3];
+        for (unsigned j = 0; j < 3; ++j) {
+            unsigned k = 3*i + j;
+            unsigned index = (indices[k/2] >> (8*(k%2))) & 0xff;
+            const uint16_t* v = vertices + 3*index;
+            for (unsigned l = 0; l < 3; ++l) {
+                int32_t position = record[2*l] | (uint32_t(record[2*l + 1]) << 16);
+                corners[j][l] = float(_gridOrigin[l] + (double(position) + v[l])*_gridStep[l]);
+            }
+        }
+        return SGTrianglef(corners[0], corners[1], corners[2]);
+    }
+
+    void refitNodes();
+    void refitLeaf(Node& node) const;
+    const BVHStaticNode* buildStaticNode(unsigned index, BVHStaticData* data) const;
+
+    NodeList _nodes;
+    TriangleList _triangles;
+    SGSharedPtr<const BVHStaticData> _staticData;
+
+    bool _compressed;
+    PackedList _packed;
+    SGVec3d _gridOrigin;
+    SGVec3d _gridStep;
+
+    mutable std::mutex _staticGeometryMutex;
+    mutable SGSharedPtr<BVHStaticGeometry> _staticGeometry;
+};
+
+}
+
+#endif
@@ -0,0 +1,388 @@
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#include <simgear_config.h>
+
+#include "BVHFlatGeometryBuilder.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <thread>
+
+namespace simgear {
+
+namespace {
+
+/// Axis aligned box on plain floats, cheaper to grow than SGBoxf.
+struct Bounds {
+    Bounds()
+    {
+        for (unsigned i = 0; i < 3; ++i) {
+            min[i] = std::numeric_limits<float>::max();
+            max[i] = -std::numeric_limits<float>::max();
+        }
+    }
+    void expandBy(const float p[3])
+    {
+        for (unsigned i = 0; i < 3; ++i) {
+            min[i] = std::min(min[i], p[i]);
+            max[i] = std::max(max[i], p[i]);
+        }
+    }
+    void expandBy(const Bounds& b)
+    {
+        for (unsigned i = 0; i < 3; ++i) {
+            min[i] = std::min(min[i], b.min[i]);
+            max[i] = std::max(max[i], b.max[i]);
+        }
+    }
+    bool empty() const
+    { return max[0] < min[0]; }
+    float halfArea() const
+    {
+        if (empty())
+            return 0;
+        float dx = max[0] - min[0];
+        float dy = max[1] - min[1];
+        float dz = max[2] - min[2];
+        return dx*dy + dy*dz + dz*dx;
+    }
+
+    float min[3];
+    float max[3];
+};
+
+/// Per triangle data used during the build.
+struct BuildRef {
+    Bounds bounds;
+    float center[3];
+    unsigned triangle;
+};
+
+class SAHBuilder {
+public:
+    SAHBuilder(const BVHStaticData& data, const BVHFlatGeometry::TriangleList& triangles,
+               unsigned maxLeafTriangles) :
+        _triangles(triangles),
+        _maxLeafTriangles(std::max(1u, std::min(maxLeafTriangles, 255u)))
+    {
+        _refs.resize(triangles.size());
+        for (size_t i = 0; i < triangles.size(); ++i) {
+            BuildRef& ref = _refs[i];
+            ref.triangle = static_cast<unsigned>(i);
+            for (unsigned j = 0; j < 3; ++j) {
+                const SGVec3f& v = data.getVertex(triangles[i].indices[j]);
+                const float p[3] = { v[0], v[1], v[2] };
+                ref.bounds.expandBy(p);
+            }
+            for (unsigned j = 0; j < 3; ++j)
+                ref.center[j] = 0.5f*(ref.bounds.min[j] + ref.bounds.max[j]);
+        }
+    }
+
+    void build(BVHFlatGeometry::NodeList& nodes, BVHFlatGeometry::TriangleList& triangles,
+               unsigned numThreads)
+    {
+        _nodes.reserve(2*_refs.size());
+        if (!_refs.empty())
+            buildRecursive(_nodes, 0, static_cast<unsigned>(_refs.size()), 0,
+                           std::max(1u, numThreads));
+
+        // leafs refer to contiguous ranges of the reordered triangles
+        triangles.clear();
+        triangles.reserve(_refs.size());
+        for (const BuildRef& ref : _refs)
+            triangles.push_back(_triangles[ref.triangle]);
+        nodes.swap(_nodes);
+    }
+
+private:
+    enum { NumBins = 16 };
+    /// Force median splits below this depth, which keeps the total
+    /// depth below BVHFlatGeometry::MaxDepth.
+    enum { MaxSAHDepth = BVHFlatGeometry::MaxDepth - 33 };
+
+    struct Bin {
+        Bin() : count(0) {}
+        Bounds bounds;
+        unsigned count;
+    };
+
+    static unsigned makeNode(BVHFlatGeometry::NodeList& nodes, const Bounds& bounds)
+    {
+        BVHFlatGeometry::Node node;
+        for (unsigned i = 0; i < 3; ++i) {
+            node.min[i] = bounds.min[i];
+            node.max[i] = bounds.max[i];
+        }
+        node.offset = 0;
+        node.count = 0;
+        node.axis = 0;
+        nodes.push_back(node);
+        return static_cast<unsigned>(nodes.size() - 1);
+    }
+
+    /// Subtrees are split across threads by building the second child
+    /// into a separate node list, appended once the first child is done.
+    /// The ranges of _refs the threads work on are disjoint.
+    void buildRecursive(BVHFlatGeometry::NodeList& nodes, unsigned begin,
+                        unsigned end, unsigned depth, unsigned numThreads)
+    {
+        assert(begin < end);
+        assert(depth < BVHFlatGeometry::MaxDepth);
+
+        Bounds bounds, centerBounds;
+        for (unsigned i = begin; i < end; ++i) {
+            bounds.expandBy(_refs[i].bounds);
+            centerBounds.expandBy(_refs[i].center);
+        }
+
+        unsigned index = makeNode(nodes, bounds);
+        unsigned count = end - begin;
+        if (count == 1) {
+            nodes[index].offset = begin;
+            nodes[index].count = 1;
+            return;
+        }
+
+        unsigned splitAxis = 0;
+        unsigned mid = findSAHSplit(begin, end, bounds, centerBounds, depth, splitAxis);
+        if (mid == begin) {
+            // the SAH prefers a leaf
+            nodes[index].offset = begin;
+            nodes[index].count = static_cast<uint16_t>(count);
+            return;
+        }
+        nodes[index].axis = static_cast<uint16_t>(splitAxis);
+
+        // Not worth a thread for small subtrees
+        if (numThreads < 2 || count < 4096) {
+            buildRecursive(nodes, begin, mid, depth + 1, 1);
+            nodes[index].offset = static_cast<uint32_t>(nodes.size());
+            buildRecursive(nodes, mid, end, depth + 1, 1);
+            return;
+        }
+
+        unsigned numThreads1 = numThreads/2;
+        BVHFlatGeometry::NodeList secondNodes;
+        std::thread thread([&]() {
+            buildRecursive(secondNodes, mid, end, depth + 1, numThreads1);
+        });
+        buildRecursive(nodes, begin, mid, depth + 1, numThreads - numThreads1);
+        thread.join();
+
+        uint32_t base = static_cast<uint32_t>(nodes.size());
+        nodes[index].offset = base;
+        for (BVHFlatGeometry::Node node : secondNodes) {
+            if (!node.isLeaf())
+                node.offset += base;
+            nodes.push_back(node);
+        }
+    }
+
+    /// Partition [begin, end) and return the start of the second half,
+    /// or begin if the range should become a leaf.
+    unsigned findSAHSplit(unsigned begin, unsigned end, const Bounds& bounds,
+                          const Bounds& centerBounds, unsigned depth,
+                          unsigned& splitAxis)
+    {
+        unsigned count = end - begin;
+
+        unsigned broadest = 0;
+        for (unsigned i = 1; i < 3; ++i) {
+            if (centerBounds.max[broadest] - centerBounds.min[broadest] <
+                centerBounds.max[i] - centerBounds.min[i])
+                broadest = i;
+        }
+
+        float bestCost = std::numeric_limits<float>::max();
+        unsigned bestAxis = 0;
+        unsigned bestBin = 0;
+        if (depth < MaxSAHDepth) {
+            for (unsigned axis = 0; axis < 3; ++axis) {
+                float extent = centerBounds.max[axis] - centerBounds.min[axis];
+                if (extent <= 0)
+                    continue;
+
+                Bin bins[NumBins];
+                float scale = NumBins/extent;
+                for (unsigned i = begin; i < end; ++i) {
+                    const BuildRef& ref = _refs[i];
+                    unsigned b = binIndex(ref.center[axis], centerBounds.min[axis], scale);
+                    ++bins[b].count;
+                    bins[b].bounds.expandBy(ref.bounds);
+                }
+
+                // sweep from the right to get the cost of the right halfs
+                float rightArea[NumBins];
+                unsigned rightCount[NumBins];
+                Bounds accum;
+                unsigned accumCount = 0;
+                for (unsigned b = NumBins - 1; 0 < b; --b) {
+                    accum.expandBy(bins[b].bounds);
+                    accumCount += bins[b].count;
+                    rightArea[b] = accum.halfArea();
+                    rightCount[b] = accumCount;
+                }
+
+                accum = Bounds();
+                accumCount = 0;
+                for (unsigned b = 1; b < NumBins; ++b) {
+                    accum.expandBy(bins[b - 1].bounds);
+                    accumCount += bins[b - 1].count;
+                    if (!accumCount || !rightCount[b])
+                        continue;
+                    float cost = accum.halfArea()*accumCount + rightArea[b]*rightCount[b];
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestBin = b;
+                    }
+                }
+            }
+        }
+
+        // relative to the area of the node, with the traversal cost of one
+        // triangle intersection
+        float area = bounds.halfArea();
+        if (0 < area && bestCost < std::numeric_limits<float>::max())
+            bestCost = 1 + bestCost/area;
+        if (count <= _maxLeafTriangles && float(count) <= bestCost)
+            return begin;
+
+        BuildRef* refs = _refs.data();
+        if (bestCost < std::numeric_limits<float>::max()) {
+            float minValue = centerBounds.min[bestAxis];
+            float scale = NumBins/(centerBounds.max[bestAxis] - minValue);
+            BuildRef* mid = std::partition(refs + begin, refs + end,
+                                           [&](const BuildRef& ref) {
+                return binIndex(ref.center[bestAxis], minValue, scale) < bestBin;
+            });
+            splitAxis = bestAxis;
+            return static_cast<unsigned>(mid - refs);
+        }
+
+        // all centers coincide, or the tree is getting too deep:
+        // split at the median
+        unsigned mid = begin + count/2;
+        std::nth_element(refs + begin, refs + mid, refs + end,
+                         [broadest](const BuildRef& a, const BuildRef& b) {
+            return a.center[broadest] < b.center[broadest];
+        });
+        splitAxis = broadest;
+        return mid;
+    }
+
+    static unsigned binIndex(float value, float minValue, float scale)
+    {
+        int b = static_cast<int>((value - minValue)*scale);
+        return static_cast<unsigned>(std::max(0, std::min(b, NumBins - 1)));
+    }
+
+    const BVHFlatGeometry::TriangleList& _triangles;
+    unsigned _maxLeafTriangles;
+    std::vector<BuildRef> _refs;
+    BVHFlatGeometry::NodeList _nodes;
+};
+
+} // anonymous namespace
+
+BVHFlatGeometryBuilder::BVHFlatGeometryBuilder() :
+    _staticData(new BVHStaticData),
+    _currentMaterial(0),
+    _currentMaterialIndex(~0u),
+    _maxLeafTriangles(4),
+    _numThreads(1),
+    _compressed(false)
+{
+}
+
+BVHFlatGeometryBuilder::~BVHFlatGeometryBuilder()
+{
+}
+
+unsigned
+BVHFlatGeometryBuilder::addMaterial(const BVHMaterial* material)
+{
+    MaterialMap::const_iterator i = _materialMap.find(material);
+    if (i != _materialMap.end())
+        return i->second;
+    unsigned index = _staticData->addMaterial(material);
+    _materialMap[material] = index;
+    return index;
+}
+
+void
+BVHFlatGeometryBuilder::addTriangle(const SGVec3f& v1, const SGVec3f& v2,
+                                    const SGVec3f& v3)
+{
+    unsigned indices[3] = { addVertex(v1), addVertex(v2), addVertex(v3) };
+    unsigned sorted[3] = { indices[0], indices[1], indices[2] };
+    std::sort(sorted, sorted + 3);
+    if (!_triangleSet.insert(SGVec3<unsigned>(sorted)).second)
+        return;
+
+    // like the BVHStaticGeometryBuilder, vertices are stored sorted
+    BVHFlatGeometry::Triangle triangle;
+    for (unsigned i = 0; i < 3; ++i)
+        triangle.indices[i] = sorted[i];
+    triangle.material = _currentMaterialIndex;
+    _triangles.push_back(triangle);
+}
+
+unsigned
+BVHFlatGeometryBuilder::addVertex(const SGVec3f& v)
+{
+    VertexMap::const_iterator i = _vertexMap.find(v);
+    if (i != _vertexMap.end())
+        return i->second;
+    unsigned index = _staticData->addVertex(v);
+    _vertexMap[v] = index;
+    return index;
+}
+
+BVHFlatGeometry*
+BVHFlatGeometryBuilder::buildTree()
+{
+    if (_triangles.empty())
+        return 0;
+    _staticData->trim();
+    BVHFlatGeometry* geometry;
+    geometry = buildTree(_staticData, _triangles, _maxLeafTriangles, _numThreads);
+    // stays uncompressed if that does not work out
+    if (_compressed)
+        geometry->compress();
+    return geometry;
+}
+
+BVHFlatGeometry*
+BVHFlatGeometryBuilder::buildTree(const BVHStaticData* staticData,
+                                  BVHFlatGeometry::TriangleList& triangles,
+                                  unsigned maxLeafTriangles,
+                                  unsigned numThreads)
+{
+    if (triangles.empty())
+        return 0;
+
+    BVHFlatGeometry::NodeList nodes;
+    BVHFlatGeometry::TriangleList ordered;
+    SAHBuilder builder(*staticData, triangles, maxLeafTriangles);
+    builder.build(nodes, ordered, numThreads);
+    return new BVHFlatGeometry(nodes, ordered, staticData);
+}
+
+}
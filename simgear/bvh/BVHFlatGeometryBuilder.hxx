@@ -0,0 +1,118 @@
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#ifndef BVHFlatGeometryBuilder_hxx
+#define BVHFlatGeometryBuilder_hxx
+
+#include <cstring>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <simgear/structure/SGReferenced.hxx>
+#include <simgear/structure/SGSharedPtr.hxx>
+
+#include "BVHStaticData.hxx"
+#include "BVHFlatGeometry.hxx"
+
+namespace simgear {
+
+/// Builds a BVHFlatGeometry from triangles, using binned surface area
+/// heuristic splits over contiguous arrays. Has the same interface for
+/// adding geometry as the BVHStaticGeometryBuilder.
+class BVHFlatGeometryBuilder : public SGReferenced {
+public:
+    BVHFlatGeometryBuilder();
+    virtual ~BVHFlatGeometryBuilder();
+
+    void setCurrentMaterial(const BVHMaterial* material)
+    {
+        _currentMaterial = material;
+        _currentMaterialIndex = addMaterial(material);
+    }
+    const BVHMaterial* getCurrentMaterial() const
+    {
+        return _currentMaterial;
+    }
+    unsigned addMaterial(const BVHMaterial* material);
+
+    void addTriangle(const SGVec3f& v1, const SGVec3f& v2, const SGVec3f& v3);
+    unsigned addVertex(const SGVec3f& v);
+
+    /// Leafs hold at most this many triangles, default 4.
+    void setMaxLeafTriangles(unsigned count)
+    { _maxLeafTriangles = count; }
+
+    /// Split the top levels of the build across this many threads,
+    /// default 1.
+    void setNumThreads(unsigned numThreads)
+    { _numThreads = numThreads; }
+
+    /// Build compressed geometry, default false.
+    /// See BVHFlatGeometry::compress().
+    void setCompressed(bool compressed)
+    { _compressed = compressed; }
+
+    BVHFlatGeometry* buildTree();
+
+    /// Build a tree for a subset of the triangles of an existing geometry,
+    /// sharing its vertices and materials.
+    static BVHFlatGeometry*
+    buildTree(const BVHStaticData* staticData,
+              BVHFlatGeometry::TriangleList& triangles,
+              unsigned maxLeafTriangles = 4,
+              unsigned numThreads = 1);
+
+private:
+    struct VertexHash {
+        size_t operator()(const SGVec3f& v) const
+        {
+            uint32_t bits[3];
+            for (unsigned i = 0; i < 3; ++i) {
+                // fold -0 onto 0, they compare equal
+                const float f = v[i] + 0.0f;
+                std::memcpy(bits + i, &f, sizeof(f));
+            }
+            return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+        }
+    };
+    struct TriangleKeyHash {
+        size_t operator()(const SGVec3<unsigned>& t) const
+        { return (t[0] * 73856093u) ^ (t[1] * 19349663u) ^ (t[2] * 83492791u); }
+    };
+
+    SGSharedPtr<BVHStaticData> _staticData;
+    BVHFlatGeometry::TriangleList _triangles;
+
+    typedef std::unordered_map<SGVec3f, unsigned, VertexHash> VertexMap;
+    VertexMap _vertexMap;
+
+    typedef std::unordered_set<SGVec3<unsigned>, TriangleKeyHash> TriangleSet;
+    TriangleSet _triangleSet;
+
+    typedef std::map<const BVHMaterial*, unsigned> MaterialMap;
+    MaterialMap _materialMap;
+    const BVHMaterial* _currentMaterial;
+    unsigned _currentMaterialIndex;
+
+    unsigned _maxLeafTriangles;
+    unsigned _numThreads;
+    bool _compressed;
+};
+
+}
+
+#endif
@@ -47,6 +47,9 @@ BVHGroup::accept(BVHVisitor& visitor)
 void
 BVHGroup::clear()
 {
+    ChildList::iterator i;
+    for (i = _children.begin(); i != _children.end(); ++i)
+        (*i)->removeParent(this);
     _children.clear();
     invalidateBound();
 }
@@ -32,6 +32,7 @@
 #include "BVHMotionTransform.hxx"
 #include "BVHLineGeometry.hxx"
 #include "BVHStaticGeometry.hxx"
+#include "BVHFlatGeometry.hxx"
 
 #include "BVHStaticData.hxx"
 
@@ -145,11 +146,56 @@ BVHLineSegmentVisitor::apply(const BVHStaticBinary& node,
     node.traverse(*this, data, _lineSegment.getStart());
 }
 
+void
+BVHLineSegmentVisitor::apply(BVHFlatGeometry& node)
+{
+    if (!intersects(_lineSegment, node.getBoundingSphere()))
+        return;
+
+    const BVHFlatGeometry::Node* nodes = node.getNodes().data();
+    unsigned stack[BVHFlatGeometry::MaxDepth];
+    unsigned stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize) {
+        unsigned index = stack[--stackSize];
+        const BVHFlatGeometry::Node& flatNode = nodes[index];
+        if (!intersects(SGLineSegmentf(_lineSegment),
+                        BVHFlatGeometry::getBoundingBox(flatNode)))
+            continue;
+
+        if (flatNode.isLeaf()) {
+            for (unsigned i = 0; i < flatNode.count; ++i)
+                intersectTriangle(node.getTriangle(flatNode, i),
+                                  node.getMaterial(flatNode, i));
+            continue;
+        }
+
+        // Same as for the BVHStaticBinary, enter the box containing the
+        // start point first.
+        unsigned axis = flatNode.axis;
+        float center = 0.5f*(flatNode.min[axis] + flatNode.max[axis]);
+        if (_lineSegment.getStart()[axis] < center) {
+            stack[stackSize++] = flatNode.offset;
+            stack[stackSize++] = index + 1;
+        } else {
+            stack[stackSize++] = index + 1;
+            stack[stackSize++] = flatNode.offset;
+        }
+    }
+}
+
 void
 BVHLineSegmentVisitor::apply(const BVHStaticTriangle& triangle,
                              const BVHStaticData& data)
 {
-    SGTrianglef tri = triangle.getTriangle(data);
+    intersectTriangle(triangle.getTriangle(data),
+                      data.getMaterial(triangle.getMaterialIndex()));
+}
+
+void
+BVHLineSegmentVisitor::intersectTriangle(const SGTrianglef& tri,
+                                         const BVHMaterial* material)
+{
     SGVec3f point;
     if (!intersects(point, tri, SGLineSegmentf(_lineSegment), 1e-4f))
         return;
@@ -157,10 +203,9 @@ BVHLineSegmentVisitor::apply(const BVHStaticTriangle& triangle,
     _normal = SGVec3d(tri.getNormal());
     _linearVelocity = SGVec3d::zeros();
     _angularVelocity = SGVec3d::zeros();
-    _material = data.getMaterial(triangle.getMaterialIndex());
+    _material = material;
     _id = 0;
     _haveHit = true;
 }
 
-
 }
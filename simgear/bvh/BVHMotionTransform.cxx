@@ -64,7 +64,7 @@ BVHMotionTransform::setTransform(const BVHMotionTransform& transform)
     _startTime = transform._startTime;
     _endTime = transform._endTime;
     _id = transform._id;
-    invalidateParentBound();
+    invalidateBound();
 }
 
 void
@@ -73,7 +73,7 @@ BVHMotionTransform::setToWorldTransform(const SGMatrixd& transform)
     _toWorldReference = transform;
     invert(_toLocalReference, transform);
     updateAmplificationFactors();
-    invalidateParentBound();
+    invalidateBound();
 }
 
 void
@@ -82,7 +82,7 @@ BVHMotionTransform::setToLocalTransform(const SGMatrixd& transform)
     _toLocalReference = transform;
     invert(_toWorldReference, transform);
     updateAmplificationFactors();
-    invalidateParentBound();
+    invalidateBound();
 }
 
 SGSphered
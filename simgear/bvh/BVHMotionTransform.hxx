@@ -36,27 +36,27 @@ public:
     void setToLocalTransform(const SGMatrixd& transform);
 
     void setLinearVelocity(const SGVec3d& linearVelocity)
-    { _linearVelocity = linearVelocity; }
+    { _linearVelocity = linearVelocity; invalidateBound(); }
     const SGVec3d& getLinearVelocity() const
     { return _linearVelocity; }
 
     void setAngularVelocity(const SGVec3d& angularVelocity)
-    { _angularVelocity = angularVelocity; }
+    { _angularVelocity = angularVelocity; invalidateBound(); }
     const SGVec3d& getAngularVelocity() const
     { return _angularVelocity; }
 
     void setReferenceTime(const double& referenceTime)
-    { _referenceTime = referenceTime; }
+    { _referenceTime = referenceTime; invalidateBound(); }
     const double& getReferenceTime() const
     { return _referenceTime; }
 
     void setStartTime(const double& startTime)
-    { _startTime = startTime; }
+    { _startTime = startTime; invalidateBound(); }
     const double& getStartTime() const
     { return _startTime; }
 
     void setEndTime(const double& endTime)
-    { _endTime = endTime; }
+    { _endTime = endTime; invalidateBound(); }
     const double& getEndTime() const
     { return _endTime; }
     
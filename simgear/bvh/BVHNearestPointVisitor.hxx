@@ -28,6 +28,7 @@
 #include "BVHTransform.hxx"
 #include "BVHLineGeometry.hxx"
 #include "BVHStaticGeometry.hxx"
+#include "BVHFlatGeometry.hxx"
 
 #include "BVHStaticData.hxx"
 
@@ -35,8 +36,13 @@
 #include "BVHStaticTriangle.hxx"
 #include "BVHStaticBinary.hxx"
 
+#include "BVHOrderedTraversal.hxx"
+
 namespace simgear {
 
+/// Finds the point of the tree closest to the center of the sphere and
+/// within the sphere. Children are visited front to back and the radius
+/// shrinks with each point found, so most of the tree is skipped early.
 class BVHNearestPointVisitor : public BVHVisitor {
 public:
     BVHNearestPointVisitor(const SGSphered& sphere, const double& t) :
@@ -48,28 +54,17 @@ public:
     { }
     
     virtual void apply(BVHGroup& leaf)
-    {
-        if (!intersects(_sphere, leaf.getBoundingSphere()))
-            return;
-        leaf.traverse(*this);
-    }
+    { Traversal::traverse(leaf, *this, *this, _state); }
     virtual void apply(BVHPageNode& leaf)
-    {
-        if (!intersects(_sphere, leaf.getBoundingSphere()))
-            return;
-        leaf.traverse(*this);
-    }
+    { Traversal::traverse(leaf, *this, *this, _state); }
     virtual void apply(BVHTransform& transform)
     {
-        if (!intersects(_sphere, transform.getBoundingSphere()))
-            return;
-        
         SGSphered sphere = _sphere;
         _sphere = transform.sphereToLocal(sphere);
         bool havePoint = _havePoint;
         _havePoint = false;
         
-        transform.traverse(*this);
+        Traversal::traverse(transform, *this, *this, _state);
         
         if (_havePoint) {
             _point = transform.ptToWorld(_point);
@@ -81,15 +76,12 @@ public:
     }
     virtual void apply(BVHMotionTransform& transform)
     {
-        if (!intersects(_sphere, transform.getBoundingSphere()))
-            return;
-        
         SGSphered sphere = _sphere;
         _sphere = transform.sphereToLocal(sphere, _time);
         bool havePoint = _havePoint;
         _havePoint = false;
         
-        transform.traverse(*this);
+        Traversal::traverse(transform, *this, *this, _state);
         
         if (_havePoint) {
             SGMatrixd toWorld = transform.getToWorldTransform(_time);
@@ -108,12 +100,11 @@ public:
     virtual void apply(BVHLineGeometry& node)
     { }
     virtual void apply(BVHStaticGeometry& node)
-    {
-        if (!intersects(_sphere, node.getBoundingSphere()))
-            return;
-        node.traverse(*this);
-    }
+    { node.traverse(*this); }
     
+    virtual void apply(BVHFlatGeometry& node)
+    { Traversal::traverse(node, *this, _state); }
+
     virtual void apply(const BVHStaticBinary& node, const BVHStaticData& data)
     {
         if (!intersects(_sphere, node.getBoundingBox()))
@@ -122,18 +113,8 @@ public:
     }
     virtual void apply(const BVHStaticTriangle& node, const BVHStaticData& data)
     {
-        SGVec3f center(_sphere.getCenter());
-        SGVec3d closest(closestPoint(node.getTriangle(data), center));
-        if (!intersects(_sphere, closest))
-            return;
-        _point = closest;
-        _linearVelocity = SGVec3d::zeros();
-        _angularVelocity = SGVec3d::zeros();
-        _material = data.getMaterial(node.getMaterialIndex());
-        // The trick is to decrease the radius of the search sphere.
-        _sphere.setRadius(length(closest - _sphere.getCenter()));
-        _havePoint = true;
-        _id = 0;
+        closestPointTo(node.getTriangle(data),
+                       data.getMaterial(node.getMaterialIndex()));
     }
     
     void setSphere(const SGSphered& sphere)
@@ -156,8 +137,57 @@ public:
     { return !_havePoint; }
     
 private:
+    typedef BVHOrderedTraversal<BVHNearestPointVisitor> Traversal;
+    friend class BVHOrderedTraversal<BVHNearestPointVisitor>;
+
+    // Nothing to carry down, the sphere holds all of the query
+    struct State { };
+
+    bool enter(const SGSphered& sphere, const State&, State&, double& key)
+    {
+        if (sphere.empty() || _sphere.empty())
+            return false;
+        double dist = length(sphere.getCenter() - _sphere.getCenter());
+        dist = std::max(0.0, dist - sphere.getRadius());
+        key = dist*dist;
+        return key <= _sphere.getRadius2();
+    }
+    bool enter(const SGBoxf& box, const State&, State&, double& key)
+    {
+        if (box.empty() || _sphere.empty())
+            return false;
+        SGVec3d closest(box.getClosestPoint(_sphere.getCenter()));
+        key = distSqr(closest, _sphere.getCenter());
+        return key <= _sphere.getRadius2();
+    }
+    bool wanted(const State&, double key) const
+    { return key <= _sphere.getRadius2(); }
+    void applyLeaf(const BVHFlatGeometry& node,
+                   const BVHFlatGeometry::Node& leaf, const State&)
+    {
+        for (unsigned i = 0; i < leaf.count; ++i)
+            closestPointTo(node.getTriangle(leaf, i), node.getMaterial(leaf, i));
+    }
+
+    void closestPointTo(const SGTrianglef& triangle, const BVHMaterial* material)
+    {
+        SGVec3f center(_sphere.getCenter());
+        SGVec3d closest(closestPoint(triangle, center));
+        if (!intersects(_sphere, closest))
+            return;
+        _point = closest;
+        _linearVelocity = SGVec3d::zeros();
+        _angularVelocity = SGVec3d::zeros();
+        _material = material;
+        // The trick is to decrease the radius of the search sphere.
+        _sphere.setRadius(length(closest - _sphere.getCenter()));
+        _havePoint = true;
+        _id = 0;
+    }
+
     SGSphered _sphere;
     double _time;
+    State _state;
 
     SGVec3d _point;
     SGVec3d _linearVelocity;
@@ -0,0 +1,223 @@
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#include <simgear_config.h>
+
+#include "BVHNearestTrianglesVisitor.hxx"
+
+#include <algorithm>
+#include <cmath>
+
+#include "BVHGroup.hxx"
+#include "BVHPageNode.hxx"
+#include "BVHTransform.hxx"
+#include "BVHMotionTransform.hxx"
+#include "BVHLineGeometry.hxx"
+#include "BVHStaticGeometry.hxx"
+#include "BVHFlatGeometry.hxx"
+
+#include "BVHStaticData.hxx"
+
+#include "BVHStaticNode.hxx"
+#include "BVHStaticTriangle.hxx"
+#include "BVHStaticBinary.hxx"
+
+namespace simgear {
+
+BVHNearestTrianglesVisitor::BVHNearestTrianglesVisitor(const SGSphered& sphere,
+                                                       unsigned k,
+                                                       const double& t) :
+    _sphere(sphere),
+    _k(k),
+    _time(t),
+    _scope(0),
+    _numScopes(0)
+{
+    _results.reserve(k);
+}
+
+BVHNearestTrianglesVisitor::~BVHNearestTrianglesVisitor()
+{
+}
+
+void
+BVHNearestTrianglesVisitor::apply(BVHGroup& group)
+{
+    Traversal::traverse(group, *this, *this, _state);
+}
+
+void
+BVHNearestTrianglesVisitor::apply(BVHPageNode& node)
+{
+    Traversal::traverse(node, *this, *this, _state);
+}
+
+void
+BVHNearestTrianglesVisitor::apply(BVHTransform& transform)
+{
+    SGSphered sphere = _sphere;
+    _sphere = transform.sphereToLocal(sphere);
+    unsigned scope = _scope;
+    _scope = ++_numScopes;
+
+    Traversal::traverse(transform, *this, *this, _state);
+
+    for (Result& result : _results) {
+        if (result.scope != _scope)
+            continue;
+        result.point = transform.ptToWorld(result.point);
+        result.normal = transform.vecToWorld(result.normal);
+        result.linearVelocity = transform.vecToWorld(result.linearVelocity);
+        result.angularVelocity = transform.vecToWorld(result.angularVelocity);
+        result.scope = scope;
+    }
+    _scope = scope;
+    _sphere = sphere;
+}
+
+void
+BVHNearestTrianglesVisitor::apply(BVHMotionTransform& transform)
+{
+    SGSphered sphere = _sphere;
+    _sphere = transform.sphereToLocal(sphere, _time);
+    unsigned scope = _scope;
+    _scope = ++_numScopes;
+
+    Traversal::traverse(transform, *this, *this, _state);
+
+    SGMatrixd toWorld;
+    bool haveToWorld = false;
+    for (Result& result : _results) {
+        if (result.scope != _scope)
+            continue;
+        if (!haveToWorld) {
+            toWorld = transform.getToWorldTransform(_time);
+            haveToWorld = true;
+        }
+        result.linearVelocity += transform.getLinearVelocityAt(result.point);
+        result.angularVelocity += transform.getAngularVelocity();
+        result.linearVelocity = toWorld.xformVec(result.linearVelocity);
+        result.angularVelocity = toWorld.xformVec(result.angularVelocity);
+        result.point = toWorld.xformPt(result.point);
+        result.normal = toWorld.xformVec(result.normal);
+        if (!result.id)
+            result.id = transform.getId();
+        result.scope = scope;
+    }
+    _scope = scope;
+    _sphere = sphere;
+}
+
+void
+BVHNearestTrianglesVisitor::apply(BVHLineGeometry&)
+{
+}
+
+void
+BVHNearestTrianglesVisitor::apply(BVHStaticGeometry& node)
+{
+    node.traverse(*this);
+}
+
+void
+BVHNearestTrianglesVisitor::apply(BVHFlatGeometry& node)
+{
+    Traversal::traverse(node, *this, _state);
+}
+
+void
+BVHNearestTrianglesVisitor::apply(const BVHStaticBinary& node,
+                                  const BVHStaticData& data)
+{
+    State state;
+    double key;
+    if (!enter(node.getBoundingBox(), _state, state, key))
+        return;
+    node.traverse(*this, data, _sphere.getCenter());
+}
+
+void
+BVHNearestTrianglesVisitor::apply(const BVHStaticTriangle& triangle,
+                                  const BVHStaticData& data)
+{
+    addTriangle(triangle.getTriangle(data),
+                data.getMaterial(triangle.getMaterialIndex()));
+}
+
+bool
+BVHNearestTrianglesVisitor::enter(const SGSphered& sphere, const State&,
+                                  State&, double& key)
+{
+    if (!_k || sphere.empty() || _sphere.empty())
+        return false;
+    double dist = length(sphere.getCenter() - _sphere.getCenter());
+    dist = std::max(0.0, dist - sphere.getRadius());
+    key = dist*dist;
+    return key <= getBound2();
+}
+
+bool
+BVHNearestTrianglesVisitor::enter(const SGBoxf& box, const State&,
+                                  State&, double& key)
+{
+    if (!_k || box.empty() || _sphere.empty())
+        return false;
+    SGVec3d closest(box.getClosestPoint(_sphere.getCenter()));
+    key = distSqr(closest, _sphere.getCenter());
+    return key <= getBound2();
+}
+
+void
+BVHNearestTrianglesVisitor::applyLeaf(const BVHFlatGeometry& node,
+                                      const BVHFlatGeometry::Node& leaf,
+                                      const State&)
+{
+    for (unsigned i = 0; i < leaf.count; ++i)
+        addTriangle(node.getTriangle(leaf, i), node.getMaterial(leaf, i));
+}
+
+void
+BVHNearestTrianglesVisitor::addTriangle(const SGTrianglef& triangle,
+                                        const BVHMaterial* material)
+{
+    if (!_k)
+        return;
+    SGVec3f center(_sphere.getCenter());
+    SGVec3d closest(closestPoint(triangle, center));
+    double dist2 = distSqr(closest, _sphere.getCenter());
+    if (getBound2() < dist2)
+        return;
+
+    Result result;
+    result.point = closest;
+    result.distance = std::sqrt(dist2);
+    result.normal = SGVec3d(triangle.getNormal());
+    result.linearVelocity = SGVec3d::zeros();
+    result.angularVelocity = SGVec3d::zeros();
+    result.material = material;
+    result.id = 0;
+    result.scope = _scope;
+
+    // Keep the list sorted, k is small
+    if (_results.size() == _k)
+        _results.pop_back();
+    ResultList::iterator i = _results.begin();
+    while (i != _results.end() && i->distance <= result.distance)
+        ++i;
+    _results.insert(i, result);
+}
+
+}
@@ -0,0 +1,115 @@
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#ifndef BVHNearestTrianglesVisitor_hxx
+#define BVHNearestTrianglesVisitor_hxx
+
+#include <vector>
+
+#include <simgear/math/SGGeometry.hxx>
+
+#include "BVHVisitor.hxx"
+#include "BVHNode.hxx"
+#include "BVHFlatGeometry.hxx"
+#include "BVHOrderedTraversal.hxx"
+
+namespace simgear {
+
+class BVHMaterial;
+
+/// Finds the k triangles closest to the center of the sphere and within
+/// the sphere, for example the obstacles around an AI aircraft. Like
+/// BVHNearestPointVisitor, but once k triangles are found the search is
+/// bounded by the distance of the farthest of them.
+class BVHNearestTrianglesVisitor : public BVHVisitor {
+public:
+    struct Result {
+        /// Closest point of the triangle
+        SGVec3d point;
+        double distance;
+        SGVec3d normal;
+        SGVec3d linearVelocity;
+        SGVec3d angularVelocity;
+        const BVHMaterial* material;
+        BVHNode::Id id;
+        /// Transform the point is still relative to, internal
+        unsigned scope;
+    };
+    typedef std::vector<Result> ResultList;
+
+    BVHNearestTrianglesVisitor(const SGSphered& sphere, unsigned k,
+                               const double& t = 0);
+    virtual ~BVHNearestTrianglesVisitor();
+
+    virtual void apply(BVHGroup& group);
+    virtual void apply(BVHPageNode& node);
+    virtual void apply(BVHTransform& transform);
+    virtual void apply(BVHMotionTransform& transform);
+    virtual void apply(BVHLineGeometry&);
+    virtual void apply(BVHStaticGeometry& node);
+    virtual void apply(BVHFlatGeometry& node);
+
+    virtual void apply(const BVHStaticBinary&, const BVHStaticData&);
+    virtual void apply(const BVHStaticTriangle&, const BVHStaticData&);
+
+    const SGSphered& getSphere() const
+    { return _sphere; }
+    unsigned getMaxResults() const
+    { return _k; }
+
+    /// The triangles found, nearest first.
+    const ResultList& getResults() const
+    { return _results; }
+
+    bool empty() const
+    { return _results.empty(); }
+
+private:
+    typedef BVHOrderedTraversal<BVHNearestTrianglesVisitor> Traversal;
+    friend class BVHOrderedTraversal<BVHNearestTrianglesVisitor>;
+
+    struct State { };
+
+    bool enter(const SGSphered& sphere, const State&, State&, double& key);
+    bool enter(const SGBoxf& box, const State&, State&, double& key);
+    bool wanted(const State&, double key) const
+    { return key <= getBound2(); }
+    void applyLeaf(const BVHFlatGeometry& node,
+                   const BVHFlatGeometry::Node& leaf, const State&);
+
+    /// Squared distance a triangle needs to be within to be of interest
+    double getBound2() const
+    {
+        if (_results.size() < _k)
+            return _sphere.getRadius2();
+        return _results.back().distance*_results.back().distance;
+    }
+
+    void addTriangle(const SGTrianglef& triangle, const BVHMaterial* material);
+
+    SGSphered _sphere;
+    unsigned _k;
+    double _time;
+    State _state;
+
+    ResultList _results;
+    unsigned _scope;
+    unsigned _numScopes;
+};
+
+}
+
+#endif
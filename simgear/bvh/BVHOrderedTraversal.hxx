@@ -0,0 +1,161 @@
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#ifndef BVHOrderedTraversal_hxx
+#define BVHOrderedTraversal_hxx
+
+#include <algorithm>
+#include <vector>
+
+#include <simgear/math/SGGeometry.hxx>
+
+#include "BVHVisitor.hxx"
+#include "BVHGroup.hxx"
+#include "BVHFlatGeometry.hxx"
+
+namespace simgear {
+
+/// Front to back traversal for the distance bounded queries, like
+/// BVHNearestPointVisitor. The Query decides for each bounding volume if
+/// it needs to be entered, the key to order it among its siblings and the
+/// state of the query below it:
+///
+///   typedef ... State;
+///   bool enter(const SGSphered&, const State& parent, State& state, double& key);
+///   bool enter(const SGBoxf&, const State& parent, State& state, double& key);
+///   bool wanted(const State& state, double key);
+///   void applyLeaf(const BVHFlatGeometry&, const BVHFlatGeometry::Node& leaf,
+///                  const State& state);
+///
+/// Siblings are entered by increasing key. Before each one, wanted() is
+/// asked again with the results found so far, and once it refuses the
+/// remaining siblings are skipped. So the bound of a query must only
+/// shrink while it runs.
+template<typename Query>
+class BVHOrderedTraversal {
+public:
+    typedef typename Query::State State;
+
+    /// Visit the children of group, including transforms and page nodes.
+    /// state is the state of the query for the children of the group, it
+    /// is set to the state of each child while that is visited.
+    static void traverse(BVHGroup& group, BVHVisitor& visitor, Query& query,
+                         State& state)
+    {
+        unsigned numChildren = group.getNumChildren();
+        Child localChildren[LocalChildren];
+        std::vector<Child> children;
+        Child* sorted = localChildren;
+        if (LocalChildren < numChildren) {
+            children.resize(numChildren);
+            sorted = children.data();
+        }
+
+        unsigned count = 0;
+        for (unsigned i = 0; i < numChildren; ++i) {
+            Child& child = sorted[count];
+            child.node = group.getChild(i);
+            child.index = i;
+            if (query.enter(child.node->getBoundingSphere(), state,
+                            child.state, child.key))
+                ++count;
+        }
+        std::sort(sorted, sorted + count);
+
+        State parentState = state;
+        for (unsigned i = 0; i < count; ++i) {
+            if (!query.wanted(sorted[i].state, sorted[i].key))
+                break;
+            state = sorted[i].state;
+            sorted[i].node->accept(visitor);
+        }
+        state = parentState;
+    }
+
+    /// Visit the leafs of the flat geometry.
+    static void traverse(const BVHFlatGeometry& geometry, Query& query,
+                         const State& state)
+    {
+        const BVHFlatGeometry::NodeList& nodes = geometry.getNodes();
+        if (nodes.empty())
+            return;
+
+        // At most one entry per level plus the last sibling pushed
+        Entry stack[BVHFlatGeometry::MaxDepth + 1];
+        unsigned stackSize = 0;
+        if (!enter(nodes, 0, query, state, stack[stackSize]))
+            return;
+        ++stackSize;
+        while (stackSize) {
+            Entry entry = stack[--stackSize];
+            if (!query.wanted(entry.state, entry.key))
+                continue;
+
+            const BVHFlatGeometry::Node& flatNode = nodes[entry.index];
+            if (flatNode.isLeaf()) {
+                query.applyLeaf(geometry, flatNode, entry.state);
+                continue;
+            }
+
+            // push the farther child first, so the nearer is entered first
+            Entry children[2];
+            unsigned count = 0;
+            count += enter(nodes, entry.index + 1, query, entry.state,
+                           children[count]);
+            count += enter(nodes, flatNode.offset, query, entry.state,
+                           children[count]);
+            if (count == 2 && children[0].key < children[1].key)
+                std::swap(children[0], children[1]);
+            for (unsigned i = 0; i < count; ++i)
+                stack[stackSize++] = children[i];
+        }
+    }
+
+private:
+    enum { LocalChildren = 16 };
+
+    struct Child {
+        bool operator<(const Child& other) const
+        {
+            if (key != other.key)
+                return key < other.key;
+            return index < other.index;
+        }
+
+        BVHNode* node;
+        unsigned index;
+        double key;
+        State state;
+    };
+
+    struct Entry {
+        unsigned index;
+        double key;
+        State state;
+    };
+
+    static bool enter(const BVHFlatGeometry::NodeList& nodes, unsigned index,
+                      Query& query, const State& parent, Entry& entry)
+    {
+        entry.index = index;
+        SGBoxf box = BVHFlatGeometry::getBoundingBox(nodes[index]);
+        return query.enter(box, parent, entry.state, entry.key);
+    }
+};
+
+}
+
+#endif
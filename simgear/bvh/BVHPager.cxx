@@ -19,21 +19,39 @@
 
 #include "BVHPager.hxx"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <list>
+#include <memory>
 #include <mutex>
+#include <vector>
 
 #include <simgear/threads/SGThread.hxx>
+#include <simgear/timing/timestamp.hxx>
 
 #include "BVHPageNode.hxx"
 #include "BVHPageRequest.hxx"
 
 namespace simgear {
 
-struct BVHPager::_PrivateData : protected SGThread {
+namespace {
+// Set by the pager workers around BVHPageRequest::load()
+thread_local unsigned _buildThreads = 1;
+}
+
+struct BVHPager::_PrivateData {
     typedef SGSharedPtr<BVHPageRequest> _Request;
     typedef std::list<_Request> _RequestList;
     typedef std::list<SGSharedPtr<BVHPageNode> > _PageNodeList;
-    
+
+    struct _Entry {
+        _Request _request;
+        SGSphered _sphere;
+        SGTimeStamp _requestTime;
+    };
+    typedef std::list<_Entry> _EntryList;
+
     struct _LockedQueue {
         void _push(const _Request& request)
         {
@@ -50,59 +68,142 @@ struct BVHPager::_PrivateData : protected SGThread {
             _requestList.pop_front();
             return request;
         }
+        unsigned _size()
+        {
+            std::lock_guard<std::mutex> scopeLock(_mutex);
+            return static_cast<unsigned>(_requestList.size());
+        }
     private:
         std::mutex _mutex;
         _RequestList _requestList;
     };
-    
+
     struct _WorkQueue {
+        _WorkQueue() :
+            _stopping(false),
+            _haveQuerySphere(false)
+        {
+        }
         void _stop()
         {
-            _push(_Request());
+            std::lock_guard<std::mutex> scopeLock(_mutex);
+            _stopping = true;
+            _waitCondition.notify_all();
         }
-        void _push(const _Request& request)
+        void _restart()
         {
             std::lock_guard<std::mutex> scopeLock(_mutex);
-            bool needSignal = _requestList.empty();
-            _requestList.push_back(request);
-            if (needSignal)
-                _waitCondition.signal();
+            _stopping = false;
         }
-        _Request _pop()
+        void _push(const _Entry& entry)
         {
             std::lock_guard<std::mutex> scopeLock(_mutex);
-            while (_requestList.empty())
-                _waitCondition.wait(_mutex);
-            _Request request;
-            request.swap(_requestList.front());
-            _requestList.pop_front();
-            return request;
+            _entryList.push_back(entry);
+            _waitCondition.notify_one();
+        }
+        /// Returns an empty entry once stopped and drained
+        _Entry _pop()
+        {
+            std::unique_lock<std::mutex> scopeLock(_mutex);
+            while (_entryList.empty()) {
+                if (_stopping)
+                    return _Entry();
+                _waitCondition.wait(scopeLock);
+            }
+            _EntryList::iterator best = _entryList.begin();
+            if (_haveQuerySphere) {
+                double bestDistance = _distance(*best);
+                for (_EntryList::iterator i = std::next(best);
+                     i != _entryList.end(); ++i) {
+                    double distance = _distance(*i);
+                    if (distance < bestDistance) {
+                        bestDistance = distance;
+                        best = i;
+                    }
+                }
+            }
+            _Entry entry = *best;
+            _entryList.erase(best);
+            return entry;
+        }
+        void _setQuerySphere(const SGSphered& sphere)
+        {
+            std::lock_guard<std::mutex> scopeLock(_mutex);
+            _querySphere = sphere;
+            _haveQuerySphere = !sphere.empty();
+        }
+        unsigned _size()
+        {
+            std::lock_guard<std::mutex> scopeLock(_mutex);
+            return static_cast<unsigned>(_entryList.size());
         }
     private:
+        double _distance(const _Entry& entry) const
+        {
+            if (entry._sphere.empty())
+                return 0;
+            double distance = dist(_querySphere.getCenter(), entry._sphere.getCenter());
+            return std::max(0.0, distance - _querySphere.getRadius()
+                            - entry._sphere.getRadius());
+        }
+
         std::mutex _mutex;
-        SGWaitCondition _waitCondition;
-        _RequestList _requestList;
+        std::condition_variable _waitCondition;
+        _EntryList _entryList;
+        bool _stopping;
+        SGSphered _querySphere;
+        bool _haveQuerySphere;
+    };
+
+    struct _Worker : public SGThread {
+        _Worker(_PrivateData& privateData) :
+            _privateData(privateData)
+        {
+        }
+        virtual void run()
+        {
+            _privateData._run();
+        }
+    private:
+        _PrivateData& _privateData;
     };
 
     _PrivateData() :
         _started(false),
-        _useStamp(0)
+        _useStamp(0),
+        _numThreads(1),
+        _loading(0),
+        _loaded(0),
+        _totalLatencyMSec(0),
+        _maxLatencyMSec(0),
+        _totalLoadMSec(0),
+        _maxLoadMSec(0)
     {
     }
-    virtual ~_PrivateData()
+    ~_PrivateData()
     {
         _stop();
     }
 
-    virtual void run()
+    void _run()
     {
         for (;;) {
-            _Request request = _pendingRequests._pop();
+            _Entry entry = _pendingRequests._pop();
             // This means stop working
-            if (!request.valid())
+            if (!entry._request.valid())
                 return;
-            request->load();
-            _processedRequests._push(request);
+
+            // Hand idle workers to the tree builder of this request
+            unsigned loading = ++_loading;
+            _buildThreads = 1 + (_numThreads - std::min(_numThreads, loading));
+            SGTimeStamp loadStart = SGTimeStamp::now();
+            entry._request->load();
+            _buildThreads = 1;
+            --_loading;
+
+            _addStatistics(entry._requestTime.elapsedMSec(),
+                           loadStart.elapsedMSec());
+            _processedRequests._push(entry._request);
         }
     }
 
@@ -110,20 +211,29 @@ struct BVHPager::_PrivateData : protected SGThread {
     {
         if (_started)
             return true;
-        if (!start())
-            return false;
-        _started = true;
-        return true;
+        _pendingRequests._restart();
+        for (unsigned i = 0; i < _numThreads; ++i) {
+            std::unique_ptr<_Worker> worker(new _Worker(*this));
+            if (!worker->start()) {
+                _stop();
+                return false;
+            }
+            _workers.push_back(std::move(worker));
+            _started = true;
+        }
+        return _started;
     }
-    
+
     void _stop()
     {
         if (!_started)
             return;
-        // send a stop request ...
+        // tell the workers to stop once the queue is empty ...
         _pendingRequests._stop();
-        // ... and wait for the thread to finish
-        join();
+        // ... and wait for them to finish
+        for (auto& worker : _workers)
+            worker->join();
+        _workers.clear();
         _started = false;
     }
 
@@ -143,7 +253,11 @@ struct BVHPager::_PrivateData : protected SGThread {
             pageNode._requested = true;
 
             if (_started) {
-                _pendingRequests._push(request);
+                _Entry entry;
+                entry._request = request;
+                entry._sphere = pageNode.getBoundingSphere();
+                entry._requestTime = SGTimeStamp::now();
+                _pendingRequests._push(entry);
             } else {
                 request->load();
                 request->insert();
@@ -180,12 +294,48 @@ struct BVHPager::_PrivateData : protected SGThread {
         }
     }
 
+    void _addStatistics(double latencyMSec, double loadMSec)
+    {
+        std::lock_guard<std::mutex> scopeLock(_statisticsMutex);
+        ++_loaded;
+        _totalLatencyMSec += latencyMSec;
+        _maxLatencyMSec = std::max(_maxLatencyMSec, latencyMSec);
+        _totalLoadMSec += loadMSec;
+        _maxLoadMSec = std::max(_maxLoadMSec, loadMSec);
+    }
+
+    Statistics _getStatistics()
+    {
+        Statistics statistics;
+        statistics.pending = _pendingRequests._size();
+        statistics.processed = _processedRequests._size();
+        statistics.loading = _loading;
+
+        std::lock_guard<std::mutex> scopeLock(_statisticsMutex);
+        statistics.loaded = _loaded;
+        statistics.meanLatencyMSec = _loaded ? _totalLatencyMSec/_loaded : 0;
+        statistics.maxLatencyMSec = _maxLatencyMSec;
+        statistics.meanLoadMSec = _loaded ? _totalLoadMSec/_loaded : 0;
+        statistics.maxLoadMSec = _maxLoadMSec;
+        return statistics;
+    }
+
     bool _started;
     unsigned _useStamp;
+    unsigned _numThreads;
+    std::vector<std::unique_ptr<_Worker> > _workers;
     _WorkQueue _pendingRequests;
     _LockedQueue _processedRequests;
     // Store the rcu list of loaded nodes so that they can expire
     _PageNodeList _pageNodeList;
+
+    std::atomic<unsigned> _loading;
+    std::mutex _statisticsMutex;
+    unsigned _loaded;
+    double _totalLatencyMSec;
+    double _maxLatencyMSec;
+    double _totalLoadMSec;
+    double _maxLoadMSec;
 };
 
 BVHPager::BVHPager() :
@@ -211,6 +361,36 @@ BVHPager::stop()
     _privateData->_stop();
 }
 
+void
+BVHPager::setNumThreads(unsigned numThreads)
+{
+    _privateData->_numThreads = std::max(1u, numThreads);
+}
+
+unsigned
+BVHPager::getNumThreads() const
+{
+    return _privateData->_numThreads;
+}
+
+void
+BVHPager::setQuerySphere(const SGSphered& sphere)
+{
+    _privateData->_pendingRequests._setQuerySphere(sphere);
+}
+
+unsigned
+BVHPager::getBuildThreads()
+{
+    return _buildThreads;
+}
+
+BVHPager::Statistics
+BVHPager::getStatistics() const
+{
+    return _privateData->_getStatistics();
+}
+
 void
 BVHPager::use(BVHPageNode& pageNode)
 {
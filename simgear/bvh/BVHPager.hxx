@@ -18,6 +18,7 @@
 #ifndef BVHPager_hxx
 #define BVHPager_hxx
 
+#include <simgear/math/SGGeometry.hxx>
 #include <simgear/structure/SGSharedPtr.hxx>
 
 namespace simgear {
@@ -30,12 +31,45 @@ public:
     BVHPager();
     ~BVHPager();
 
-    /// Starts the pager thread
+    /// Starts the pager threads
     bool start();
 
-    /// Stops the pager thread
+    /// Stops the pager threads, once the pending requests are loaded
     void stop();
 
+    /// The number of worker threads loading page requests, default 1.
+    /// Takes effect on the next start.
+    void setNumThreads(unsigned numThreads);
+    unsigned getNumThreads() const;
+
+    /// Pending requests are loaded in the order of the distance of their
+    /// page nodes to this sphere, usually the current collision query.
+    /// Without a sphere they are loaded in the order they were requested.
+    void setQuerySphere(const SGSphered& sphere);
+
+    /// The number of threads a BVHPageRequest::load() may use to build
+    /// its tree, which is one plus the number of idle workers when called
+    /// from within a pager worker and one otherwise.
+    static unsigned getBuildThreads();
+
+    struct Statistics {
+        /// requests waiting for a worker
+        unsigned pending;
+        /// requests loaded, but not yet inserted by update()
+        unsigned processed;
+        /// requests currently loading
+        unsigned loading;
+        /// requests loaded since the pager was created
+        unsigned loaded;
+        /// time from the request to the end of its load
+        double meanLatencyMSec;
+        double maxLatencyMSec;
+        /// time spent in BVHPageRequest::load()
+        double meanLoadMSec;
+        double maxLoadMSec;
+    };
+    Statistics getStatistics() const;
+
     /// Use this page node, if loaded make it as used, if not loaded schedule
     void use(BVHPageNode& pageNode);
 
@@ -34,12 +34,16 @@ public:
     { _vertices.push_back(vertex); return static_cast<unsigned>(_vertices.size() - 1); }
     const SGVec3f& getVertex(unsigned i) const
     { return _vertices[i]; }
+    unsigned getNumVertices() const
+    { return static_cast<unsigned>(_vertices.size()); }
     
     
     unsigned addMaterial(const BVHMaterial* material)
     { _materials.push_back(material); return static_cast<unsigned>(_materials.size() - 1); }
     const BVHMaterial* getMaterial(unsigned i) const
     { if (_materials.size() <= i) return 0; return _materials[i]; }
+    unsigned getNumMaterials() const
+    { return static_cast<unsigned>(_materials.size()); }
 
     void trim()
     {
@@ -19,8 +19,10 @@
 #define BVHStaticGeometryBuilder_hxx
 
 #include <algorithm>
+#include <list>
 #include <map>
 #include <set>
+#include <thread>
 
 #include <simgear/structure/SGReferenced.hxx>
 #include <simgear/structure/SGSharedPtr.hxx>
@@ -127,9 +129,11 @@ public:
         return index;
     }
 
-    BVHStaticGeometry* buildTree()
+    /// With numThreads > 1 the top levels of the tree are split across
+    /// that many threads.
+    BVHStaticGeometry* buildTree(unsigned numThreads = 1)
     {
-        const BVHStaticNode* tree = buildTreeRecursive(_leafRefList);
+        const BVHStaticNode* tree = buildTreeRecursive(_leafRefList, numThreads);
         if (!tree)
             return 0;
         _staticData->trim();
@@ -166,7 +170,8 @@ private:
         }
     }
     
-    static const BVHStaticNode* buildTreeRecursive(LeafRefList& leafs)
+    static const BVHStaticNode* buildTreeRecursive(LeafRefList& leafs,
+                                                   unsigned numThreads = 1)
     {
         // recursion termination
         if (leafs.empty())
@@ -215,8 +220,20 @@ private:
             equalSplitLeafs(splitAxis, leafs, splitLeafs);
         }
         
-        const BVHStaticNode* child0 = buildTreeRecursive(splitLeafs[0]);
-        const BVHStaticNode* child1 = buildTreeRecursive(splitLeafs[1]);
+        const BVHStaticNode* child0;
+        const BVHStaticNode* child1;
+        // Not worth a thread for small subtrees
+        if (1 < numThreads && 4096 < splitLeafs[0].size() + splitLeafs[1].size()) {
+            unsigned numThreads0 = numThreads/2;
+            std::thread thread([&]() {
+                child0 = buildTreeRecursive(splitLeafs[0], numThreads0);
+            });
+            child1 = buildTreeRecursive(splitLeafs[1], numThreads - numThreads0);
+            thread.join();
+        } else {
+            child0 = buildTreeRecursive(splitLeafs[0]);
+            child1 = buildTreeRecursive(splitLeafs[1]);
+        }
         if (!child0)
             return child1;
         if (!child1)
@@ -43,6 +43,8 @@ public:
 
   unsigned getMaterialIndex() const
   { return _material; }
+  unsigned getIndex(unsigned i) const
+  { return _indices[i]; }
 
 private:
   unsigned _indices[3];
@@ -30,6 +30,8 @@
 #include "BVHStaticTriangle.hxx"
 #include "BVHStaticBinary.hxx"
 #include "BVHStaticGeometry.hxx"
+#include "BVHFlatGeometry.hxx"
+#include "BVHFlatGeometryBuilder.hxx"
 #include "BVHBoundingBoxVisitor.hxx"
 
 namespace simgear {
@@ -151,6 +153,61 @@ BVHSubTreeCollector::apply(BVHStaticGeometry& node)
     _staticNode = 0;
 }
 
+void
+BVHSubTreeCollector::apply(BVHFlatGeometry& node)
+{
+    if (!intersects(_sphere, node.getBoundingSphere()))
+        return;
+
+    // If the geometry is totally contained in the sphere, just take it all
+    const BVHFlatGeometry::NodeList& nodes = node.getNodes();
+    SGBoxf rootBox = BVHFlatGeometry::getBoundingBox(nodes.front());
+    if (intersects(_sphere, SGVec3d(rootBox.getFarestCorner(_sphere.getCenter())))) {
+        addNode(&node);
+        return;
+    }
+
+    // Otherwise collect the triangles of the leafs touching the sphere and
+    // build a smaller tree of those, sharing the vertex data. Compressed
+    // geometry has no vertices to share, the small trees built here are
+    // left uncompressed for speed.
+    BVHFlatGeometry::TriangleList triangles;
+    SGSharedPtr<BVHFlatGeometryBuilder> builder;
+    if (node.isCompressed())
+        builder = new BVHFlatGeometryBuilder;
+    unsigned stack[BVHFlatGeometry::MaxDepth];
+    unsigned stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize) {
+        unsigned index = stack[--stackSize];
+        const BVHFlatGeometry::Node& flatNode = nodes[index];
+        if (!intersects(_sphere, BVHFlatGeometry::getBoundingBox(flatNode)))
+            continue;
+        if (!flatNode.isLeaf()) {
+            stack[stackSize++] = flatNode.offset;
+            stack[stackSize++] = index + 1;
+            continue;
+        }
+        for (unsigned i = 0; i < flatNode.count; ++i) {
+            SGTrianglef triangle = node.getTriangle(flatNode, i);
+            if (!intersects(_sphere, triangle))
+                continue;
+            if (builder) {
+                builder->setCurrentMaterial(node.getMaterial(flatNode, i));
+                builder->addTriangle(triangle.getVertex(0), triangle.getVertex(1),
+                                     triangle.getVertex(2));
+            } else {
+                triangles.push_back(node.getTriangles()[flatNode.offset + i]);
+            }
+        }
+    }
+
+    if (builder)
+        addNode(builder->buildTree());
+    else
+        addNode(BVHFlatGeometryBuilder::buildTree(node.getStaticData(), triangles));
+}
+
 void
 BVHSubTreeCollector::apply(const BVHStaticBinary& node,
                            const BVHStaticData& data)
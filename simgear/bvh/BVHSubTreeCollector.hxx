@@ -48,6 +48,7 @@ public:
     virtual void apply(BVHMotionTransform&);
     virtual void apply(BVHLineGeometry&);
     virtual void apply(BVHStaticGeometry&);
+    virtual void apply(BVHFlatGeometry&);
     
     virtual void apply(const BVHStaticBinary&, const BVHStaticData&);
     virtual void apply(const BVHStaticTriangle&, const BVHStaticData&);
@@ -52,7 +52,7 @@ BVHTransform::setTransform(const BVHTransform& transform)
     _toLocal = transform._toLocal;
     _toWorldAmplification = transform._toWorldAmplification;
     _toLocalAmplification = transform._toLocalAmplification;
-    invalidateParentBound();
+    invalidateBound();
 }
 
 void
@@ -61,7 +61,7 @@ BVHTransform::setToWorldTransform(const SGMatrixd& transform)
     _toWorld = transform;
     invert(_toLocal, transform);
     updateAmplificationFactors();
-    invalidateParentBound();
+    invalidateBound();
 }
 
 void
@@ -70,7 +70,7 @@ BVHTransform::setToLocalTransform(const SGMatrixd& transform)
     _toLocal = transform;
     invert(_toWorld, transform);
     updateAmplificationFactors();
-    invalidateParentBound();
+    invalidateBound();
 }
 
 SGSphered
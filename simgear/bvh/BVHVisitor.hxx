@@ -27,6 +27,7 @@ class BVHPageNode;
 class BVHTransform;
 class BVHMotionTransform;
 class BVHStaticGeometry;
+class BVHFlatGeometry;
 class BVHLineGeometry;
 
 class BVHStaticBinary;
@@ -47,6 +48,10 @@ public:
     virtual void apply(BVHMotionTransform&) = 0;
     virtual void apply(BVHLineGeometry&) = 0;
     virtual void apply(BVHStaticGeometry&) = 0;
+
+    // Not pure, visitors which do not implement this see the flat
+    // geometry as the equivalent BVHStaticGeometry.
+    virtual void apply(BVHFlatGeometry&);
     
     // Static tree nodes to handle
     virtual void apply(const BVHStaticBinary&, const BVHStaticData&) = 0;
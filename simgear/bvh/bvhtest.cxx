@@ -16,12 +16,26 @@
 //
 
 #include <simgear_config.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <simgear/io/sg_binobj.hxx>
+#include <simgear/io/iostreams/sgstream.hxx>
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/misc/sg_path.hxx>
 #include <simgear/structure/SGSharedPtr.hxx>
+#include <simgear/timing/timestamp.hxx>
 
 #include "BVHNode.hxx"
 #include "BVHGroup.hxx"
 #include "BVHTransform.hxx"
+#include "BVHPageNode.hxx"
+#include "BVHPageRequest.hxx"
+#include "BVHPager.hxx"
 
 #include "BVHStaticData.hxx"
 
@@ -30,11 +44,20 @@
 #include "BVHStaticTriangle.hxx"
 #include "BVHStaticBinary.hxx"
 #include "BVHStaticGeometry.hxx"
+#include "BVHStaticGeometryBuilder.hxx"
+#include "BVHFlatGeometry.hxx"
+#include "BVHFlatGeometryBuilder.hxx"
 
+#include "BVHBatchLineSegmentVisitor.hxx"
+#include "BVHBatchSphereCollector.hxx"
+#include "BVHCacheFile.hxx"
+#include "BVHDynamicTree.hxx"
+#include "BVHMaterial.hxx"
 #include "BVHBoundingBoxVisitor.hxx"
 #include "BVHSubTreeCollector.hxx"
 #include "BVHLineSegmentVisitor.hxx"
 #include "BVHNearestPointVisitor.hxx"
+#include "BVHNearestTrianglesVisitor.hxx"
 
 using namespace simgear;
 
@@ -132,6 +155,1178 @@ testNearestPoint()
     return true;
 }
 
+typedef std::vector<SGVec3f> TriangleSoup;
+
+// A terrain like height field of about the extent of a scenery tile
+TriangleSoup
+buildTerrain(unsigned n)
+{
+    TriangleSoup soup;
+    const float size = 20000;
+    const float step = size/n;
+    auto height = [](float x, float y) {
+        return 300*std::sin(x*1e-3f)*std::cos(y*7e-4f) + 40*std::sin(x*7e-3f + y*5e-3f);
+    };
+    for (unsigned i = 0; i < n; ++i) {
+        for (unsigned j = 0; j < n; ++j) {
+            float x0 = i*step - 0.5f*size, x1 = x0 + step;
+            float y0 = j*step - 0.5f*size, y1 = y0 + step;
+            SGVec3f v00(x0, y0, height(x0, y0));
+            SGVec3f v10(x1, y0, height(x1, y0));
+            SGVec3f v01(x0, y1, height(x0, y1));
+            SGVec3f v11(x1, y1, height(x1, y1));
+            soup.push_back(v00); soup.push_back(v10); soup.push_back(v11);
+            soup.push_back(v00); soup.push_back(v11); soup.push_back(v01);
+        }
+    }
+    return soup;
+}
+
+// Triangles of a real scenery tile, relative to the tile center
+TriangleSoup
+loadTile(const SGPath& path)
+{
+    TriangleSoup soup;
+    SGBinObject tile;
+    if (!tile.read_bin(path))
+        return soup;
+    const std::vector<SGVec3d>& nodes = tile.get_wgs84_nodes();
+    for (const int_list& tris : tile.get_tris_v()) {
+        for (size_t i = 0; i + 2 < tris.size(); i += 3)
+            for (unsigned j = 0; j < 3; ++j)
+                soup.push_back(SGVec3f(nodes[tris[i + j]]));
+    }
+    return soup;
+}
+
+template<typename Builder>
+SGSharedPtr<BVHNode>
+buildFromSoup(const TriangleSoup& soup)
+{
+    SGSharedPtr<Builder> builder = new Builder;
+    for (size_t i = 0; i + 2 < soup.size(); i += 3)
+        builder->addTriangle(soup[i], soup[i + 1], soup[i + 2]);
+    return builder->buildTree();
+}
+
+bool
+testFlatGeometry()
+{
+    TriangleSoup soup = buildTerrain(32);
+    SGSharedPtr<BVHNode> staticTree = buildFromSoup<BVHStaticGeometryBuilder>(soup);
+    SGSharedPtr<BVHNode> flatTree = buildFromSoup<BVHFlatGeometryBuilder>(soup);
+    if (!flatTree)
+        return false;
+
+    // same answers as the pointer tree
+    for (int i = -9; i < 10; ++i) {
+        SGLineSegmentd lineSegment(SGVec3d(i*1000 + 17, i*600 + 3, 1000),
+                                   SGVec3d(i*1000 + 17, i*600 + 3, -1000));
+        BVHLineSegmentVisitor staticVisitor(lineSegment);
+        staticTree->accept(staticVisitor);
+        BVHLineSegmentVisitor flatVisitor(lineSegment);
+        flatTree->accept(flatVisitor);
+        if (staticVisitor.empty() || flatVisitor.empty())
+            return false;
+        if (!equivalent(staticVisitor.getPoint(), flatVisitor.getPoint(), 1e-3))
+            return false;
+
+        SGSphered sphere(SGVec3d(i*1000 + 17, i*600 + 3, 500), 1000);
+        BVHNearestPointVisitor staticNearest(sphere, 0);
+        staticTree->accept(staticNearest);
+        BVHNearestPointVisitor flatNearest(sphere, 0);
+        flatTree->accept(flatNearest);
+        if (staticNearest.empty() != flatNearest.empty())
+            return false;
+        if (!flatNearest.empty() &&
+            !equivalent(staticNearest.getPoint(), flatNearest.getPoint(), 1e-2))
+            return false;
+    }
+
+    // visitors without explicit support see the pointer tree
+    BVHFlatGeometry* flat = static_cast<BVHFlatGeometry*>(flatTree.get());
+    if (!flat->getStaticGeometry())
+        return false;
+
+    // sub trees
+    SGSphered sphere(SGVec3d(100, 100, 0), 1500);
+    BVHSubTreeCollector collector(sphere);
+    flatTree->accept(collector);
+    SGSharedPtr<BVHNode> subTree = collector.getNode();
+    if (!subTree)
+        return false;
+    SGLineSegmentd inside(SGVec3d(150, 120, 1000), SGVec3d(150, 120, -1000));
+    BVHLineSegmentVisitor subVisitor(inside);
+    subTree->accept(subVisitor);
+    BVHLineSegmentVisitor fullVisitor(inside);
+    flatTree->accept(fullVisitor);
+    if (subVisitor.empty() || !equivalent(subVisitor.getPoint(), fullVisitor.getPoint()))
+        return false;
+
+    return true;
+}
+
+bool
+testBatchLineSegments()
+{
+    TriangleSoup soup = buildTerrain(32);
+    SGSharedPtr<BVHNode> staticTree = buildFromSoup<BVHStaticGeometryBuilder>(soup);
+    SGSharedPtr<BVHNode> flatTree = buildFromSoup<BVHFlatGeometryBuilder>(soup);
+
+    // the flat tree shifted, plus one moving copy of the static tree
+    SGSharedPtr<BVHGroup> group = new BVHGroup;
+    group->addChild(staticTree);
+    SGSharedPtr<BVHTransform> transform = new BVHTransform;
+    transform->setToWorldTransform(SGMatrixd(SGVec3d(3000, 0, 700)));
+    transform->addChild(flatTree);
+    group->addChild(transform);
+    SGSharedPtr<BVHMotionTransform> motion = new BVHMotionTransform;
+    motion->setToWorldTransform(SGMatrixd(SGVec3d(0, 5000, -900)));
+    motion->setLinearVelocity(SGVec3d(0, 0, 1));
+    motion->setAngularVelocity(SGVec3d(0, 0, 0.1));
+    motion->setId(7);
+    motion->addChild(staticTree);
+    group->addChild(motion);
+
+    BVHBatchLineSegmentVisitor::LineSegmentList lineSegments;
+    for (int i = -6; i < 7; ++i) {
+        SGVec3d p(i*800 + 11, i*i*150 - 2000, 0);
+        lineSegments.push_back(SGLineSegmentd(p + SGVec3d(0, 0, 3000),
+                                              p - SGVec3d(0, 0, 3000)));
+    }
+    // misses everything, and a segment ending above ground
+    lineSegments.push_back(SGLineSegmentd(SGVec3d(50000, 0, 10), SGVec3d(50000, 0, -10)));
+    lineSegments.push_back(SGLineSegmentd(SGVec3d(10, 10, 3000), SGVec3d(10, 10, 2000)));
+
+    const BVHNode* trees[] = { staticTree, flatTree, group };
+    for (const BVHNode* tree : trees) {
+        BVHBatchLineSegmentVisitor batch(lineSegments);
+        const_cast<BVHNode*>(tree)->accept(batch);
+        if (batch.getNumLineSegments() != lineSegments.size())
+            return false;
+        for (unsigned i = 0; i < lineSegments.size(); ++i) {
+            BVHLineSegmentVisitor single(lineSegments[i]);
+            const_cast<BVHNode*>(tree)->accept(single);
+            if (single.empty() != batch.empty(i))
+                return false;
+            if (single.empty())
+                continue;
+            if (!equivalent(single.getPoint(), batch.getPoint(i), 1e-3))
+                return false;
+            if (!equivalent(single.getNormal(), batch.getNormal(i), 1e-6, 1e-6))
+                return false;
+            if (!equivalent(single.getLinearVelocity(), batch.getLinearVelocity(i), 1e-6, 1e-6))
+                return false;
+            if (single.getId() != batch.getId(i))
+                return false;
+            if (single.getMaterial() != batch.getMaterial(i))
+                return false;
+        }
+        if (!batch.empty(lineSegments.size() - 1) || !batch.empty(lineSegments.size() - 2))
+            return false;
+    }
+
+    // some segments hit the moving copy
+    BVHBatchLineSegmentVisitor batch(lineSegments);
+    group->accept(batch);
+    unsigned movingHits = 0;
+    for (unsigned i = 0; i < lineSegments.size(); ++i)
+        movingHits += !batch.empty(i) && batch.getId(i) == 7;
+    if (!movingHits)
+        return false;
+
+    BVHBatchLineSegmentVisitor none(BVHBatchLineSegmentVisitor::LineSegmentList{});
+    group->accept(none);
+    if (!none.empty())
+        return false;
+
+    return true;
+}
+
+class TestPageNode : public BVHPageNode {
+public:
+    TestPageNode(const SGSphered& sphere, std::vector<const TestPageNode*>& loadOrder,
+                 std::mutex& mutex, std::atomic<bool>* gate = 0) :
+        _sphere(sphere),
+        _loadOrder(loadOrder),
+        _mutex(mutex),
+        _gate(gate)
+    { }
+
+    virtual SGSphered computeBoundingSphere() const
+    { return _sphere; }
+
+    virtual BVHPageRequest* newRequest()
+    { return new Request(this); }
+
+protected:
+    virtual void invalidateBound()
+    { }
+
+private:
+    class Request : public BVHPageRequest {
+    public:
+        Request(TestPageNode* pageNode) :
+            _pageNode(pageNode)
+        { }
+        virtual void load()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_pageNode->_mutex);
+                _pageNode->_loadOrder.push_back(_pageNode);
+            }
+            while (_pageNode->_gate && !*_pageNode->_gate)
+                SGTimeStamp::sleepForMSec(1);
+            SGVec3f c(_pageNode->_sphere.getCenter());
+            _node = buildSingleTriangle(c, c + SGVec3f(1, 0, 0), c + SGVec3f(0, 1, 0));
+        }
+        virtual void insert()
+        { _pageNode->addChild(_node); }
+        virtual BVHPageNode* getPageNode()
+        { return _pageNode; }
+    private:
+        SGSharedPtr<TestPageNode> _pageNode;
+        SGSharedPtr<BVHNode> _node;
+    };
+
+    SGSphered _sphere;
+    std::vector<const TestPageNode*>& _loadOrder;
+    std::mutex& _mutex;
+    std::atomic<bool>* _gate;
+};
+
+bool
+waitForLoaded(BVHPager& pager, unsigned loaded)
+{
+    SGTimeStamp start = SGTimeStamp::now();
+    while (pager.getStatistics().loaded < loaded) {
+        if (10000 < start.elapsedMSec())
+            return false;
+        SGTimeStamp::sleepForMSec(1);
+    }
+    return true;
+}
+
+bool
+testPager()
+{
+    std::vector<const TestPageNode*> loadOrder;
+    std::mutex mutex;
+
+    // closest to the query sphere first
+    {
+        BVHPager pager;
+        if (!pager.start())
+            return false;
+        pager.setQuerySphere(SGSphered(SGVec3d(0, 0, 0), 1));
+
+        std::atomic<bool> gate(false);
+        SGSharedPtr<TestPageNode> blocking;
+        blocking = new TestPageNode(SGSphered(SGVec3d(0, 0, 9000), 1), loadOrder, mutex, &gate);
+        pager.use(*blocking);
+        SGTimeStamp start = SGTimeStamp::now();
+        while (pager.getStatistics().loading != 1 && start.elapsedMSec() < 10000)
+            SGTimeStamp::sleepForMSec(1);
+
+        std::vector<SGSharedPtr<TestPageNode> > pageNodes;
+        const double distances[] = { 500, 100, 300, 200 };
+        for (double distance : distances) {
+            SGSphered sphere(SGVec3d(distance, 0, 0), 10);
+            pageNodes.push_back(new TestPageNode(sphere, loadOrder, mutex));
+            pager.use(*pageNodes.back());
+        }
+        if (pager.getStatistics().pending != 4)
+            return false;
+        gate = true;
+        if (!waitForLoaded(pager, 5))
+            return false;
+        pager.update(100);
+
+        if (loadOrder.size() != 5 || loadOrder[0] != blocking)
+            return false;
+        const unsigned expected[] = { 1, 3, 2, 0 };
+        for (unsigned i = 0; i < 4; ++i)
+            if (loadOrder[i + 1] != pageNodes[expected[i]])
+                return false;
+        for (const auto& pageNode : pageNodes)
+            if (pageNode->getNumChildren() != 1)
+                return false;
+
+        BVHPager::Statistics statistics = pager.getStatistics();
+        if (statistics.pending || statistics.processed || statistics.loading)
+            return false;
+        if (statistics.maxLatencyMSec < statistics.meanLatencyMSec)
+            return false;
+        pager.stop();
+    }
+
+    // several workers
+    {
+        loadOrder.clear();
+        BVHPager pager;
+        pager.setNumThreads(4);
+        if (pager.getNumThreads() != 4 || !pager.start())
+            return false;
+        std::vector<SGSharedPtr<TestPageNode> > pageNodes;
+        for (unsigned i = 0; i < 64; ++i) {
+            SGSphered sphere(SGVec3d(i*100, 0, 0), 10);
+            pageNodes.push_back(new TestPageNode(sphere, loadOrder, mutex));
+            pager.use(*pageNodes.back());
+        }
+        // stopping finishes the pending requests
+        pager.stop();
+        if (pager.getStatistics().loaded != 64)
+            return false;
+        pager.update(100);
+        for (const auto& pageNode : pageNodes)
+            if (pageNode->getNumChildren() != 1)
+                return false;
+    }
+
+    return true;
+}
+
+bool
+testParallelBuild()
+{
+    TriangleSoup soup = buildTerrain(100);
+
+    SGSharedPtr<BVHFlatGeometryBuilder> builder = new BVHFlatGeometryBuilder;
+    for (size_t i = 0; i + 2 < soup.size(); i += 3)
+        builder->addTriangle(soup[i], soup[i + 1], soup[i + 2]);
+    SGSharedPtr<BVHFlatGeometry> reference = builder->buildTree();
+    BVHFlatGeometry::TriangleList triangles[2];
+    triangles[0] = triangles[1] = reference->getTriangles();
+    SGSharedPtr<BVHFlatGeometry> serial, parallel;
+    serial = BVHFlatGeometryBuilder::buildTree(reference->getStaticData(), triangles[0], 4, 1);
+    parallel = BVHFlatGeometryBuilder::buildTree(reference->getStaticData(), triangles[1], 4, 4);
+    const BVHFlatGeometry::NodeList& serialNodes = serial->getNodes();
+    const BVHFlatGeometry::NodeList& parallelNodes = parallel->getNodes();
+    if (serialNodes.size() != parallelNodes.size())
+        return false;
+    if (std::memcmp(serialNodes.data(), parallelNodes.data(),
+                    serialNodes.size()*sizeof(BVHFlatGeometry::Node)))
+        return false;
+
+    SGSharedPtr<BVHStaticGeometryBuilder> staticBuilder = new BVHStaticGeometryBuilder;
+    for (size_t i = 0; i + 2 < soup.size(); i += 3)
+        staticBuilder->addTriangle(soup[i], soup[i + 1], soup[i + 2]);
+    SGSharedPtr<BVHNode> staticTree = staticBuilder->buildTree(4);
+    for (int i = -9; i < 10; ++i) {
+        SGLineSegmentd lineSegment(SGVec3d(i*1000 + 17, i*600 + 3, 1000),
+                                   SGVec3d(i*1000 + 17, i*600 + 3, -1000));
+        BVHLineSegmentVisitor staticVisitor(lineSegment);
+        staticTree->accept(staticVisitor);
+        BVHLineSegmentVisitor flatVisitor(lineSegment);
+        parallel->accept(flatVisitor);
+        if (staticVisitor.empty() || flatVisitor.empty())
+            return false;
+        if (!equivalent(staticVisitor.getPoint(), flatVisitor.getPoint(), 1e-3))
+            return false;
+    }
+
+    return true;
+}
+
+class TestMaterial : public BVHMaterial {
+public:
+    TestMaterial(double friction)
+    {
+        _solid = true;
+        _friction_factor = friction;
+    }
+};
+
+bool
+sameGroundAnswers(BVHNode& node1, BVHNode& node2)
+{
+    for (int i = -20; i < 20; ++i) {
+        SGLineSegmentd lineSegment(SGVec3d(i*500 + 17, i*300 + 3, 2000),
+                                   SGVec3d(i*500 + 17, i*300 + 3, -2000));
+        BVHLineSegmentVisitor visitor1(lineSegment);
+        node1.accept(visitor1);
+        BVHLineSegmentVisitor visitor2(lineSegment);
+        node2.accept(visitor2);
+        if (visitor1.empty() != visitor2.empty())
+            return false;
+        if (visitor1.empty())
+            continue;
+        if (!equivalent(visitor1.getPoint(), visitor2.getPoint(), 1e-6, 1e-6))
+            return false;
+        if (!visitor1.getMaterial() != !visitor2.getMaterial())
+            return false;
+        if (visitor1.getMaterial() &&
+            visitor1.getMaterial()->get_friction_factor() !=
+            visitor2.getMaterial()->get_friction_factor())
+            return false;
+    }
+    return true;
+}
+
+bool
+testCacheFile()
+{
+    Dir tempDir = Dir::tempDir("bvhtest");
+    tempDir.setRemoveOnDestroy();
+    SGPath path = tempDir.file("tile.bvh");
+
+    SGSharedPtr<TestMaterial> grass = new TestMaterial(0.8);
+    SGSharedPtr<TestMaterial> asphalt = new TestMaterial(1.0);
+    TriangleSoup soup = buildTerrain(32);
+    SGSharedPtr<BVHStaticGeometryBuilder> staticBuilder = new BVHStaticGeometryBuilder;
+    SGSharedPtr<BVHFlatGeometryBuilder> flatBuilder = new BVHFlatGeometryBuilder;
+    for (size_t i = 0; i + 2 < soup.size(); i += 3) {
+        const BVHMaterial* material = (i/3) % 7 ? grass : asphalt;
+        staticBuilder->setCurrentMaterial(material);
+        staticBuilder->addTriangle(soup[i], soup[i + 1], soup[i + 2]);
+        flatBuilder->setCurrentMaterial(material);
+        flatBuilder->addTriangle(soup[i] + SGVec3f(0, 0, 50),
+                                 soup[i + 1] + SGVec3f(0, 0, 50),
+                                 soup[i + 2] + SGVec3f(0, 0, 50));
+    }
+    SGSharedPtr<BVHGroup> group = new BVHGroup;
+    group->addChild(staticBuilder->buildTree());
+    SGSharedPtr<BVHTransform> transform = new BVHTransform;
+    transform->setToWorldTransform(SGMatrixd(SGVec3d(6000, 0, 0)));
+    transform->addChild(flatBuilder->buildTree());
+    group->addChild(transform);
+
+    auto materialName = [&](const BVHMaterial* material) -> std::string {
+        return material == grass ? "grass" : "";
+    };
+    if (!BVHCacheFile::write(path, *group, "tile1.btg", materialName))
+        return false;
+
+    // wrong source
+    if (BVHCacheFile::read(path, "tile2.btg"))
+        return false;
+
+    // named materials are looked up, the others recreated
+    auto materialLookup = [&](const std::string& name) -> const BVHMaterial* {
+        return name == "grass" ? grass.get() : 0;
+    };
+    SGSharedPtr<BVHNode> cached = BVHCacheFile::read(path, "tile1.btg", materialLookup);
+    if (!cached || !sameGroundAnswers(*group, *cached))
+        return false;
+    bool haveGrass = false;
+    for (int i = -20; i < 20; ++i) {
+        BVHLineSegmentVisitor visitor(SGLineSegmentd(SGVec3d(i*100, 7, 2000),
+                                                     SGVec3d(i*100, 7, -2000)));
+        cached->accept(visitor);
+        if (visitor.getMaterial() == grass)
+            haveGrass = true;
+        else if (visitor.getMaterial() == asphalt)
+            return false;
+    }
+    if (!haveGrass)
+        return false;
+
+    // trees are out of date once one of their source files changes
+    SGPath source = tempDir.file("source");
+    {
+        sg_ofstream stream(source);
+        stream << "some tile";
+    }
+    SGPath sourcesPath = tempDir.file("sources.bvh");
+    BVHCacheFile::PathList sources(1, source);
+    if (!BVHCacheFile::write(sourcesPath, *group, "tile1.btg", materialName, sources))
+        return false;
+    SGSharedPtr<BVHNode> upToDate = BVHCacheFile::read(sourcesPath, "tile1.btg");
+    if (!upToDate)
+        return false;
+    {
+        sg_ofstream stream(source);
+        stream << "yet another tile";
+    }
+    if (BVHCacheFile::read(sourcesPath, "tile1.btg"))
+        return false;
+    if (!BVHCacheFile::write(sourcesPath, *group, "tile1.btg", materialName, sources))
+        return false;
+    source.remove();
+    if (BVHCacheFile::read(sourcesPath, "tile1.btg"))
+        return false;
+
+    // damaged files are rejected
+    size_t size = path.sizeInBytes();
+    std::string content;
+    {
+        sg_ifstream stream(path, std::ios::in | std::ios::binary);
+        content = stream.read_all();
+    }
+    for (size_t length : { size_t(0), size_t(10), size/2, size - 1 }) {
+        {
+            sg_ofstream stream(path, std::ios::out | std::ios::binary | std::ios::trunc);
+            stream.write(content.data(), length);
+        }
+        if (BVHCacheFile::read(path, "tile1.btg"))
+            return false;
+    }
+
+    // nothing written for trees with moving parts
+    SGSharedPtr<BVHMotionTransform> motion = new BVHMotionTransform;
+    motion->addChild(group);
+    SGPath motionPath = tempDir.file("motion.bvh");
+    if (BVHCacheFile::write(motionPath, *motion, "tile1.btg") || motionPath.exists())
+        return false;
+
+    return true;
+}
+
+bool
+testRefit()
+{
+    TriangleSoup soup = buildTerrain(32);
+    SGSharedPtr<BVHNode> tree = buildFromSoup<BVHFlatGeometryBuilder>(soup);
+    BVHFlatGeometry* flat = dynamic_cast<BVHFlatGeometry*>(tree.get());
+    if (!flat)
+        return false;
+    SGSharedPtr<BVHGroup> group = new BVHGroup;
+    group->addChild(flat);
+    // compute the bounds before they change
+    group->getBoundingSphere();
+    SGSharedPtr<const BVHStaticData> oldData = flat->getStaticData();
+
+    auto deform = [](const SGVec3f& v) {
+        return v + SGVec3f(0, 0, 60 + 0.005f*v[0]);
+    };
+    std::vector<SGVec3f> vertices;
+    for (unsigned i = 0; i < oldData->getNumVertices(); ++i)
+        vertices.push_back(deform(oldData->getVertex(i)));
+    for (SGVec3f& v : soup)
+        v = deform(v);
+
+    if (flat->refit(std::vector<SGVec3f>(3)))
+        return false;
+    if (!flat->refit(vertices))
+        return false;
+    // shared data is left alone
+    if (flat->getStaticData() == oldData ||
+        oldData->getVertex(0) == vertices[0])
+        return false;
+
+    SGSharedPtr<BVHNode> rebuilt = buildFromSoup<BVHFlatGeometryBuilder>(soup);
+    if (!sameGroundAnswers(*group, *rebuilt))
+        return false;
+    if (!sameGroundAnswers(*flat->getStaticGeometry(), *rebuilt))
+        return false;
+    return true;
+}
+
+bool
+sameObjectAnswers(BVHNode& node1, BVHNode& node2, double range)
+{
+    for (int i = -20; i < 20; ++i) {
+        for (int j = -20; j < 20; ++j) {
+            SGVec3d position(i*range/20 + 3, j*range/20 + 7, 0);
+            SGLineSegmentd lineSegment(position + SGVec3d(0, 0, 1000),
+                                       position - SGVec3d(0, 0, 1000));
+            BVHLineSegmentVisitor visitor1(lineSegment);
+            node1.accept(visitor1);
+            BVHLineSegmentVisitor visitor2(lineSegment);
+            node2.accept(visitor2);
+            if (visitor1.empty() != visitor2.empty())
+                return false;
+            if (visitor1.empty())
+                continue;
+            if (visitor1.getId() != visitor2.getId())
+                return false;
+            if (!equivalent(visitor1.getPoint(), visitor2.getPoint(), 1e-9, 1e-9))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool
+testDynamicTree()
+{
+    SGSharedPtr<BVHNode> triangle;
+    triangle = buildSingleTriangle(SGVec3f(-40, -40, 0), SGVec3f(40, -40, 0),
+                                   SGVec3f(-40, 40, 0));
+
+    unsigned seed = 1;
+    auto random = [&seed]() {
+        seed = seed*1664525u + 1013904223u;
+        return (seed >> 8)*(1.0/16777216.0) - 0.5;
+    };
+
+    const double range = 5000;
+    const unsigned numObjects = 300;
+    SGSharedPtr<BVHDynamicTree> tree = new BVHDynamicTree;
+    SGSharedPtr<BVHGroup> plain = new BVHGroup;
+    std::vector<SGSharedPtr<BVHMotionTransform> > objects;
+    for (unsigned i = 0; i < numObjects; ++i) {
+        SGSharedPtr<BVHMotionTransform> object = new BVHMotionTransform;
+        SGVec3d position(range*random(), range*random(), 100*random());
+        object->setToWorldTransform(SGMatrixd(position));
+        object->setId(BVHNode::getNewId());
+        object->addChild(triangle);
+        objects.push_back(object);
+        tree->addNode(object);
+        plain->addChild(object);
+    }
+    tree->addNode(objects.front());
+    if (tree->getNumNodes() != numObjects || !tree->containsNode(objects[7]))
+        return false;
+    if (numObjects/4 < tree->getDepth())
+        return false;
+    if (!sameObjectAnswers(*tree->getNode(), *plain, range))
+        return false;
+
+    // most move a little, some far
+    for (unsigned i = 0; i < numObjects; ++i) {
+        double distance = i % 10 ? 2 : 2000;
+        SGVec3d offset(distance*random(), distance*random(), 0);
+        SGMatrixd matrix = objects[i]->getToWorldReferenceTransform();
+        matrix.postMultTranslate(offset);
+        objects[i]->setToWorldTransform(matrix);
+    }
+    // the queries are right even before update
+    if (!sameObjectAnswers(*tree->getNode(), *plain, range))
+        return false;
+    unsigned reinserted = tree->update();
+    if (reinserted == 0 || numObjects/5 < reinserted)
+        return false;
+    if (tree->update() != 0)
+        return false;
+    if (!sameObjectAnswers(*tree->getNode(), *plain, range))
+        return false;
+
+    // moving ones are reinserted where their swept sphere is
+    objects[3]->setLinearVelocity(SGVec3d(100, 0, 0));
+    objects[3]->setEndTime(5);
+    if (tree->update() != 1)
+        return false;
+    if (!sameObjectAnswers(*tree->getNode(), *plain, range))
+        return false;
+
+    for (unsigned i = 0; i < numObjects; i += 2) {
+        tree->removeNode(objects[i]);
+        plain->removeChild(objects[i]);
+    }
+    if (tree->getNumNodes() != numObjects/2 || tree->containsNode(objects[0]))
+        return false;
+    if (!sameObjectAnswers(*tree->getNode(), *plain, range))
+        return false;
+
+    tree->clear();
+    if (tree->getNumNodes() || tree->getNode()->getNumChildren() ||
+        !tree->getNode()->getBoundingSphere().empty())
+        return false;
+    return true;
+}
+
+bool
+closeGroundAnswers(BVHNode& node1, BVHNode& node2, double tolerance)
+{
+    for (int i = -50; i < 50; ++i) {
+        SGLineSegmentd lineSegment(SGVec3d(i*200 + 17, i*130 + 3, 2000),
+                                   SGVec3d(i*200 + 17, i*130 + 3, -2000));
+        BVHLineSegmentVisitor visitor1(lineSegment);
+        node1.accept(visitor1);
+        BVHLineSegmentVisitor visitor2(lineSegment);
+        node2.accept(visitor2);
+        if (visitor1.empty() != visitor2.empty())
+            return false;
+        if (visitor1.empty())
+            continue;
+        if (tolerance < dist(visitor1.getPoint(), visitor2.getPoint()))
+            return false;
+        if (visitor1.getMaterial() != visitor2.getMaterial())
+            return false;
+    }
+    return true;
+}
+
+bool
+testCompressedGeometry()
+{
+    SGSharedPtr<TestMaterial> grass = new TestMaterial(0.8);
+    SGSharedPtr<TestMaterial> asphalt = new TestMaterial(1.0);
+    TriangleSoup soup = buildTerrain(64);
+    SGSharedPtr<BVHFlatGeometryBuilder> builder = new BVHFlatGeometryBuilder;
+    SGSharedPtr<BVHFlatGeometryBuilder> compressedBuilder = new BVHFlatGeometryBuilder;
+    compressedBuilder->setCompressed(true);
+    for (size_t i = 0; i + 2 < soup.size(); i += 3) {
+        const BVHMaterial* material = (i/3) % 5 ? grass : asphalt;
+        builder->setCurrentMaterial(material);
+        builder->addTriangle(soup[i], soup[i + 1], soup[i + 2]);
+        compressedBuilder->setCurrentMaterial(material);
+        compressedBuilder->addTriangle(soup[i], soup[i + 1], soup[i + 2]);
+    }
+    SGSharedPtr<BVHFlatGeometry> flat = builder->buildTree();
+    SGSharedPtr<BVHFlatGeometry> compressed = compressedBuilder->buildTree();
+    if (flat->isCompressed() || !compressed->isCompressed())
+        return false;
+    if (flat->getMemoryUsage() <= compressed->getMemoryUsage())
+        return false;
+
+    // vertices move by at most half a grid step
+    const SGVec3d& step = compressed->getGridStep();
+    if (0.01 < norm(step))
+        return false;
+    if (!closeGroundAnswers(*flat, *compressed, norm(step)))
+        return false;
+
+    // vertices shared by leafs stay shared, there are no cracks to
+    // fall through right at the edges
+    for (size_t i = 0; i < soup.size(); i += 7) {
+        SGVec3d v(soup[i]);
+        BVHLineSegmentVisitor visitor(SGLineSegmentd(v + SGVec3d(0, 0, 1000),
+                                                     v - SGVec3d(0, 0, 1000)));
+        compressed->accept(visitor);
+        if (visitor.empty())
+            return false;
+    }
+
+    // the pointer tree for other visitors, sub trees and cache files
+    if (!closeGroundAnswers(*compressed->getStaticGeometry(), *compressed, 1e-6))
+        return false;
+    BVHSubTreeCollector collector(SGSphered(SGVec3d(100, 100, 0), 1500));
+    compressed->accept(collector);
+    SGSharedPtr<BVHNode> subTree = collector.getNode();
+    SGLineSegmentd inside(SGVec3d(150, 120, 1000), SGVec3d(150, 120, -1000));
+    BVHLineSegmentVisitor subVisitor(inside);
+    subTree->accept(subVisitor);
+    BVHLineSegmentVisitor fullVisitor(inside);
+    compressed->accept(fullVisitor);
+    if (subVisitor.empty() || !equivalent(subVisitor.getPoint(), fullVisitor.getPoint()) ||
+        subVisitor.getMaterial() != fullVisitor.getMaterial())
+        return false;
+
+    Dir tempDir = Dir::tempDir("bvhtest");
+    tempDir.setRemoveOnDestroy();
+    SGPath path = tempDir.file("compressed.bvh");
+    auto materialName = [&](const BVHMaterial* material) -> std::string {
+        return material == grass ? "grass" : "asphalt";
+    };
+    auto materialLookup = [&](const std::string& name) -> const BVHMaterial* {
+        return name == "grass" ? grass.get() : asphalt.get();
+    };
+    if (!BVHCacheFile::write(path, *compressed, "tile.btg", materialName))
+        return false;
+    SGSharedPtr<BVHNode> cached = BVHCacheFile::read(path, "tile.btg", materialLookup);
+    BVHFlatGeometry* cachedFlat = dynamic_cast<BVHFlatGeometry*>(cached.get());
+    if (!cachedFlat || !cachedFlat->isCompressed() ||
+        !closeGroundAnswers(*compressed, *cachedFlat, 1e-6))
+        return false;
+
+    // no refit of quantized vertices
+    if (compressed->refit(std::vector<SGVec3f>()))
+        return false;
+    return true;
+}
+
+// The terrain, a shifted copy and a moving copy, with the triangles and
+// offsets to check the queries by brute force
+struct SphereQueryScene {
+    SphereQueryScene() :
+        soup(buildTerrain(32)),
+        group(new BVHGroup)
+    {
+        SGSharedPtr<BVHNode> staticTree = buildFromSoup<BVHStaticGeometryBuilder>(soup);
+        SGSharedPtr<BVHNode> flatTree = buildFromSoup<BVHFlatGeometryBuilder>(soup);
+        group->addChild(flatTree);
+        offsets.push_back(SGVec3d(0, 0, 0));
+
+        SGSharedPtr<BVHTransform> transform = new BVHTransform;
+        transform->setToWorldTransform(SGMatrixd(SGVec3d(3000, 0, 700)));
+        transform->addChild(staticTree);
+        group->addChild(transform);
+        offsets.push_back(transform->ptToWorld(SGVec3d::zeros()));
+
+        motion = new BVHMotionTransform;
+        motion->setToWorldTransform(SGMatrixd(SGVec3d(0, 5000, -900)));
+        motion->setLinearVelocity(SGVec3d(0, 0, 1));
+        motion->setAngularVelocity(SGVec3d(0, 0, 0.1));
+        motion->setId(7);
+        motion->addChild(flatTree);
+        group->addChild(motion);
+        offsets.push_back(motion->getToWorldTransform(0).xformPt(SGVec3d::zeros()));
+    }
+
+    // Distances of the triangles within the sphere, nearest first
+    std::vector<double> distances(const SGSphered& sphere) const
+    {
+        std::vector<double> result;
+        for (const SGVec3d& offset : offsets) {
+            SGVec3d center = sphere.getCenter() - offset;
+            for (size_t i = 0; i + 2 < soup.size(); i += 3) {
+                SGTrianglef triangle(soup[i], soup[i + 1], soup[i + 2]);
+                SGVec3d closest(closestPoint(triangle, SGVec3f(center)));
+                double distance = length(closest - center);
+                if (distance <= sphere.getRadius())
+                    result.push_back(distance);
+            }
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    // Number of triangles touching the sphere, per copy
+    unsigned count(const SGSphered& sphere, unsigned copy) const
+    {
+        unsigned result = 0;
+        SGSphered local(sphere.getCenter() - offsets[copy], sphere.getRadius());
+        for (size_t i = 0; i + 2 < soup.size(); i += 3)
+            result += intersects(local, SGTrianglef(soup[i], soup[i + 1], soup[i + 2]));
+        return result;
+    }
+
+    TriangleSoup soup;
+    std::vector<SGVec3d> offsets;
+    SGSharedPtr<BVHGroup> group;
+    SGSharedPtr<BVHMotionTransform> motion;
+};
+
+bool
+testNearestTriangles()
+{
+    SphereQueryScene scene;
+    const unsigned k = 5;
+    unsigned movingResults = 0;
+    for (int i = -8; i < 9; ++i) {
+        SGSphered sphere(SGVec3d(i*900 + 13, i*i*90 + 7, (i%3)*250), 1200);
+        std::vector<double> expected = scene.distances(sphere);
+        if (k < expected.size())
+            expected.resize(k);
+
+        BVHNearestTrianglesVisitor visitor(sphere, k);
+        scene.group->accept(visitor);
+        const BVHNearestTrianglesVisitor::ResultList& results = visitor.getResults();
+        if (results.size() != expected.size())
+            return false;
+        for (unsigned j = 0; j < results.size(); ++j) {
+            const BVHNearestTrianglesVisitor::Result& result = results[j];
+            if (std::fabs(result.distance - expected[j]) > 1e-3)
+                return false;
+            // in world coordinates
+            if (std::fabs(length(result.point - sphere.getCenter()) - result.distance) > 1e-3)
+                return false;
+            if (result.id != 7)
+                continue;
+            ++movingResults;
+            SGVec3d local = result.point - scene.offsets[2];
+            SGVec3d velocity = scene.motion->getLinearVelocityAt(local);
+            if (!equivalent(result.linearVelocity, velocity, 1e-6, 1e-6))
+                return false;
+        }
+
+        // the nearest point is the nearest of the triangles
+        BVHNearestPointVisitor nearest(sphere, 0);
+        scene.group->accept(nearest);
+        if (nearest.empty() != expected.empty())
+            return false;
+        if (!nearest.empty() &&
+            std::fabs(length(nearest.getPoint() - sphere.getCenter()) - expected[0]) > 1e-3)
+            return false;
+    }
+    if (!movingResults)
+        return false;
+
+    // nothing around, or nothing asked for
+    BVHNearestTrianglesVisitor far(SGSphered(SGVec3d(0, 0, 50000), 100), k);
+    scene.group->accept(far);
+    BVHNearestTrianglesVisitor none(SGSphered(SGVec3d(0, 0, 0), 100), 0);
+    scene.group->accept(none);
+    if (!far.empty() || !none.empty())
+        return false;
+
+    return true;
+}
+
+bool
+testBatchSpheres()
+{
+    SphereQueryScene scene;
+    BVHBatchSphereCollector::SphereList spheres;
+    for (int i = -10; i < 11; ++i)
+        spheres.push_back(SGSphered(SGVec3d(i*700 + 13, i*i*40 - 1000, (i%4)*300), 150 + 40*(i + 10)));
+    // far away and empty
+    spheres.push_back(SGSphered(SGVec3d(0, 0, 50000), 100));
+    spheres.push_back(SGSphered());
+
+    BVHBatchSphereCollector collector(spheres);
+    scene.group->accept(collector);
+    if (collector.getNumSpheres() != spheres.size())
+        return false;
+    unsigned movingResults = 0;
+    for (unsigned i = 0; i < spheres.size(); ++i) {
+        unsigned counts[3] = { 0, 0, 0 };
+        for (const BVHBatchSphereCollector::Result& result : collector.getResults(i)) {
+            // in world coordinates
+            SGSphered sphere(spheres[i].getCenter(), spheres[i].getRadius() + 1e-3);
+            if (!intersects(sphere, result.triangle))
+                return false;
+            if (result.id == 7)
+                ++counts[2];
+            // the terrain stays within 350 m, the copies are 700 m apart
+            else if (std::fabs(result.triangle.getCenter()[2] - scene.offsets[0][2]) < 350)
+                ++counts[0];
+            else
+                ++counts[1];
+        }
+        movingResults += counts[2];
+        if (spheres[i].empty()) {
+            if (counts[0] + counts[1] + counts[2])
+                return false;
+            continue;
+        }
+        for (unsigned copy = 0; copy < 3; ++copy)
+            if (counts[copy] != scene.count(spheres[i], copy))
+                return false;
+    }
+    if (!movingResults)
+        return false;
+
+    // the same as one sphere at a time
+    for (unsigned i = 0; i < spheres.size(); ++i) {
+        BVHBatchSphereCollector single(BVHBatchSphereCollector::SphereList(1, spheres[i]));
+        scene.group->accept(single);
+        if (single.getResults(0).size() != collector.getResults(i).size())
+            return false;
+    }
+
+    return true;
+}
+
+// Build time and ground queries per second, pointer tree vs flat array
+// vs compressed flat array, and the memory of the flat arrays.
+// Pass a .btg(.gz) file to measure on real scenery, else a synthetic
+// terrain is used.
+void
+benchmarkLayouts(const TriangleSoup& soup)
+{
+    SGBoxf box;
+    for (const SGVec3f& v : soup)
+        box.expandBy(v);
+    SGVec3d center(box.getCenter());
+    SGVec3d up = normalize(center);
+    if (!(dot(up, up) > 0.5))
+        up = SGVec3d(0, 0, 1);
+    double extent = 0.4*length(SGVec3d(box.getSize()));
+
+    const unsigned numQueries = 20000;
+    std::vector<SGLineSegmentd> queries;
+    queries.reserve(numQueries);
+    unsigned seed = 1;
+    auto random = [&seed]() {
+        seed = seed*1664525u + 1013904223u;
+        return (seed >> 8)*(1.0/16777216.0) - 0.5;
+    };
+    SGVec3d side1 = normalize(cross(up, std::fabs(up[0]) < 0.9 ? SGVec3d(1, 0, 0) : SGVec3d(0, 1, 0)));
+    SGVec3d side2 = cross(up, side1);
+    for (unsigned i = 0; i < numQueries; ++i) {
+        SGVec3d p = center + extent*(random()*side1 + random()*side2);
+        queries.push_back(SGLineSegmentd(p + 10000*up, p - 10000*up));
+    }
+
+    SGSharedPtr<BVHNode> trees[3];
+    const char* names[3] = { "pointer tree", "flat array", "compressed flat array" };
+    for (unsigned layout = 0; layout < 3; ++layout) {
+        SGTimeStamp stamp = SGTimeStamp::now();
+        if (layout == 0)
+            trees[layout] = buildFromSoup<BVHStaticGeometryBuilder>(soup);
+        else
+            trees[layout] = buildFromSoup<BVHFlatGeometryBuilder>(soup);
+        if (layout == 2)
+            static_cast<BVHFlatGeometry*>(trees[layout].get())->compress();
+        double buildMSec = 1e-3*stamp.elapsedUSec();
+
+        stamp.stamp();
+        unsigned hits = 0;
+        for (const SGLineSegmentd& query : queries) {
+            BVHLineSegmentVisitor visitor(query);
+            trees[layout]->accept(visitor);
+            hits += !visitor.empty();
+        }
+        double querySec = std::max(1e-6, 1e-6*stamp.elapsedUSec());
+
+        std::cout << names[layout] << ": " << soup.size()/3 << " triangles, build "
+                  << buildMSec << " ms, " << unsigned(numQueries/querySec)
+                  << " line queries/s, " << hits << " hits";
+        if (layout != 0) {
+            const BVHFlatGeometry* flat = static_cast<BVHFlatGeometry*>(trees[layout].get());
+            std::cout << ", " << flat->getMemoryUsage()/1024 << " kB";
+        }
+        std::cout << std::endl;
+
+        // the same queries in batches of eight close by segments, like
+        // the gear contact points of an aircraft
+        stamp.stamp();
+        hits = 0;
+        BVHBatchLineSegmentVisitor::LineSegmentList batch(8);
+        for (unsigned i = 0; i < numQueries; i += 8) {
+            const SGLineSegmentd& query = queries[i];
+            for (unsigned j = 0; j < 8; ++j) {
+                SGVec3d offset = (j*1.5)*side1 + ((j%3)*2.0)*side2;
+                batch[j] = SGLineSegmentd(query.getStart() + offset, query.getEnd() + offset);
+            }
+            BVHBatchLineSegmentVisitor visitor(batch);
+            trees[layout]->accept(visitor);
+            for (unsigned j = 0; j < 8; ++j)
+                hits += !visitor.empty(j);
+        }
+        querySec = std::max(1e-6, 1e-6*stamp.elapsedUSec());
+        std::cout << names[layout] << ": " << unsigned(numQueries/querySec)
+                  << " batched line queries/s, " << hits << " hits" << std::endl;
+    }
+}
+
+// Per frame cost of many moving objects, in a flat group vs below a
+// BVHDynamicTree.
+void
+benchmarkDynamicTree()
+{
+    SGSharedPtr<BVHNode> triangle;
+    triangle = buildSingleTriangle(SGVec3f(-40, -40, 0), SGVec3f(40, -40, 0),
+                                   SGVec3f(-40, 40, 0));
+    unsigned seed = 1;
+    auto random = [&seed]() {
+        seed = seed*1664525u + 1013904223u;
+        return (seed >> 8)*(1.0/16777216.0) - 0.5;
+    };
+
+    const double range = 50000;
+    const unsigned numObjects = 2000;
+    const unsigned numFrames = 20;
+    const unsigned numQueries = 200;
+    std::vector<SGSharedPtr<BVHMotionTransform> > objects;
+    std::vector<SGVec3d> positions;
+    std::vector<SGVec3d> velocities;
+    for (unsigned i = 0; i < numObjects; ++i) {
+        SGSharedPtr<BVHMotionTransform> object = new BVHMotionTransform;
+        object->addChild(triangle);
+        objects.push_back(object);
+        positions.push_back(SGVec3d(range*random(), range*random(), 0));
+        // up to 250 kt at 60 frames per second
+        velocities.push_back(SGVec3d(4*random(), 4*random(), 0));
+    }
+
+    const char* names[2] = { "flat group", "dynamic tree" };
+    for (unsigned layout = 0; layout < 2; ++layout) {
+        seed = 1;
+        for (unsigned i = 0; i < numObjects; ++i)
+            objects[i]->setToWorldTransform(SGMatrixd(positions[i]));
+        SGSharedPtr<BVHGroup> group = new BVHGroup;
+        SGSharedPtr<BVHDynamicTree> tree = new BVHDynamicTree;
+        for (const auto& object : objects) {
+            if (layout == 0)
+                group->addChild(object);
+            else
+                tree->addNode(object);
+        }
+        BVHNode* root = layout == 0 ? group.get() : tree->getNode();
+
+        double updateMSec = 0;
+        double queryMSec = 0;
+        unsigned hits = 0;
+        for (unsigned frame = 0; frame < numFrames; ++frame) {
+            for (unsigned i = 0; i < numObjects; ++i) {
+                SGMatrixd matrix = objects[i]->getToWorldReferenceTransform();
+                matrix.postMultTranslate(velocities[i]);
+                objects[i]->setToWorldTransform(matrix);
+            }
+            SGTimeStamp stamp = SGTimeStamp::now();
+            root->getBoundingSphere();
+            tree->update();
+            updateMSec += 1e-3*stamp.elapsedUSec();
+            stamp.stamp();
+            for (unsigned i = 0; i < numQueries; ++i) {
+                SGVec3d position(range*random(), range*random(), 0);
+                BVHLineSegmentVisitor visitor(SGLineSegmentd(position + SGVec3d(0, 0, 100),
+                                                             position - SGVec3d(0, 0, 100)));
+                root->accept(visitor);
+                hits += !visitor.empty();
+            }
+            queryMSec += 1e-3*stamp.elapsedUSec();
+        }
+        std::cout << names[layout] << ": " << numObjects << " moving objects, "
+                  << updateMSec/numFrames << " ms bounds update and "
+                  << queryMSec/numFrames << " ms for " << numQueries
+                  << " line queries per frame, " << hits << " hits" << std::endl;
+    }
+}
+
+// Sphere queries per second against the flat array: nearest point, the
+// eight nearest triangles, and 64 sphere collections one by one vs in
+// one batch.
+void
+benchmarkSphereQueries(const TriangleSoup& soup)
+{
+    SGBoxf box;
+    for (const SGVec3f& v : soup)
+        box.expandBy(v);
+    SGSharedPtr<BVHNode> tree = buildFromSoup<BVHFlatGeometryBuilder>(soup);
+
+    unsigned seed = 1;
+    auto random = [&seed]() {
+        seed = seed*1664525u + 1013904223u;
+        return (seed >> 8)*(1.0/16777216.0);
+    };
+    const unsigned numQueries = 20000;
+    BVHBatchSphereCollector::SphereList spheres;
+    spheres.reserve(numQueries);
+    for (unsigned i = 0; i < numQueries; ++i) {
+        SGVec3d center;
+        for (unsigned j = 0; j < 3; ++j)
+            center[j] = box.getMin()[j] + random()*box.getSize()[j];
+        spheres.push_back(SGSphered(center, 200));
+    }
+
+    SGTimeStamp stamp = SGTimeStamp::now();
+    unsigned found = 0;
+    for (const SGSphered& sphere : spheres) {
+        BVHNearestPointVisitor visitor(sphere, 0);
+        tree->accept(visitor);
+        found += !visitor.empty();
+    }
+    double querySec = std::max(1e-6, 1e-6*stamp.elapsedUSec());
+    std::cout << "flat array: " << unsigned(numQueries/querySec)
+              << " nearest point queries/s, " << found << " found" << std::endl;
+
+    stamp.stamp();
+    found = 0;
+    for (const SGSphered& sphere : spheres) {
+        BVHNearestTrianglesVisitor visitor(sphere, 8);
+        tree->accept(visitor);
+        found += visitor.getResults().size();
+    }
+    querySec = std::max(1e-6, 1e-6*stamp.elapsedUSec());
+    std::cout << "flat array: " << unsigned(numQueries/querySec)
+              << " 8 nearest triangles queries/s, " << found << " found" << std::endl;
+
+    // clusters of 64 close by spheres, like the volumes along a wake
+    const unsigned numBatches = 100;
+    const unsigned batchSize = BVHBatchSphereCollector::MaxSpheres;
+    BVHBatchSphereCollector::SphereList batch(batchSize);
+    double singleMSec = 0, batchMSec = 0;
+    unsigned singleFound = 0, batchFound = 0;
+    for (unsigned i = 0; i < numBatches; ++i) {
+        for (unsigned j = 0; j < batchSize; ++j) {
+            SGVec3d offset(j*20.0, 0, 0);
+            batch[j] = SGSphered(spheres[i].getCenter() + offset, 50);
+        }
+        stamp.stamp();
+        for (unsigned j = 0; j < batchSize; ++j) {
+            BVHBatchSphereCollector single(BVHBatchSphereCollector::SphereList(1, batch[j]));
+            tree->accept(single);
+            singleFound += single.getResults(0).size();
+        }
+        singleMSec += 1e-3*stamp.elapsedUSec();
+        stamp.stamp();
+        BVHBatchSphereCollector collector(batch);
+        tree->accept(collector);
+        for (unsigned j = 0; j < batchSize; ++j)
+            batchFound += collector.getResults(j).size();
+        batchMSec += 1e-3*stamp.elapsedUSec();
+    }
+    std::cout << "flat array: " << unsigned(numBatches*batchSize/std::max(1e-6, 1e-3*singleMSec))
+              << " single vs " << unsigned(numBatches*batchSize/std::max(1e-6, 1e-3*batchMSec))
+              << " batched sphere collections/s, " << singleFound << "/" << batchFound
+              << " triangles" << std::endl;
+}
+
 int
 main(int argc, char** argv)
 {
@@ -139,5 +1334,39 @@ main(int argc, char** argv)
         return EXIT_FAILURE;
     if (!testNearestPoint())
         return EXIT_FAILURE;
+    if (!testFlatGeometry())
+        return EXIT_FAILURE;
+    if (!testBatchLineSegments())
+        return EXIT_FAILURE;
+    if (!testPager())
+        return EXIT_FAILURE;
+    if (!testParallelBuild())
+        return EXIT_FAILURE;
+    if (!testCacheFile())
+        return EXIT_FAILURE;
+    if (!testRefit())
+        return EXIT_FAILURE;
+    if (!testDynamicTree())
+        return EXIT_FAILURE;
+    if (!testCompressedGeometry())
+        return EXIT_FAILURE;
+    if (!testNearestTriangles())
+        return EXIT_FAILURE;
+    if (!testBatchSpheres())
+        return EXIT_FAILURE;
+
+    // Time the trees when asked for, on the BTG file given after
+    // --benchmark or else on generated terrain
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        TriangleSoup soup;
+        if (2 < argc)
+            soup = loadTile(SGPath::fromUtf8(argv[2]));
+        if (soup.empty())
+            soup = buildTerrain(200);
+        benchmarkLayouts(soup);
+        benchmarkDynamicTree();
+        benchmarkSphereQueries(soup);
+    }
+
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,267 @@
+// ContentStore.cxx - content-addressed local file store
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <simgear_config.h>
+
+#include "ContentStore.hxx"
+
+#include <atomic>
+#include <cctype>
+#include <vector>
+
+#if defined(SG_WINDOWS)
+#include <windows.h>
+#include <process.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <simgear/debug/logstream.hxx>
+#include <simgear/io/sg_file.hxx>
+#include <simgear/misc/sg_dir.hxx>
+
+namespace simgear
+{
+
+namespace
+{
+
+const char* tempSuffix = ".tmp";
+
+bool hardLink(const SGPath& existing, const SGPath& newPath)
+{
+#if defined(SG_WINDOWS)
+    const auto ws = existing.wstr();
+    const auto wn = newPath.wstr();
+    return CreateHardLinkW(wn.c_str(), ws.c_str(), nullptr) != 0;
+#else
+    return ::link(existing.utf8Str().c_str(), newPath.utf8Str().c_str()) == 0;
+#endif
+}
+
+/// number of directory entries referring to the file, or 0 on error
+unsigned int linkCount(const SGPath& p)
+{
+#if defined(SG_WINDOWS)
+    const auto ws = p.wstr();
+    HANDLE h = CreateFileW(ws.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+
+    BY_HANDLE_FILE_INFORMATION info;
+    const bool ok = GetFileInformationByHandle(h, &info) != 0;
+    CloseHandle(h);
+    return ok ? static_cast<unsigned int>(info.nNumberOfLinks) : 0;
+#else
+    struct stat buf;
+    if (::stat(p.utf8Str().c_str(), &buf) < 0) {
+        return 0;
+    }
+
+    return static_cast<unsigned int>(buf.st_nlink);
+#endif
+}
+
+bool copyFile(const SGPath& src, const SGPath& dest)
+{
+    SGBinaryFile in(src);
+    SGBinaryFile out(dest);
+    if (!in.open(SG_IO_IN) || !out.open(SG_IO_OUT)) {
+        return false;
+    }
+
+    out.preallocate(src.sizeInBytes());
+
+    std::vector<char> buf(256 * 1024);
+    for (;;) {
+        const int r = in.read(buf.data(), static_cast<int>(buf.size()));
+        if (r < 0) {
+            return false;
+        }
+
+        if (r == 0) {
+            break;
+        }
+
+        if (out.write(buf.data(), r) != r) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/// unique name beside the final blob, so concurrent inserts from several
+/// threads or processes never write to the same file
+SGPath tempPathFor(const SGPath& blob)
+{
+    static std::atomic<unsigned int> counter{0};
+#if defined(SG_WINDOWS)
+    const int pid = _getpid();
+#else
+    const int pid = static_cast<int>(::getpid());
+#endif
+    return SGPath(blob.utf8Str() + "." + std::to_string(pid) + "-" +
+                  std::to_string(counter++) + tempSuffix);
+}
+
+} // of anonymous namespace
+
+ContentStore::ContentStore(const SGPath& root) : _root(root)
+{
+}
+
+bool ContentStore::isValidHash(const std::string& hashHex) const
+{
+    if (hashHex.size() < 8) {
+        return false;
+    }
+
+    for (char c : hashHex) {
+        if (!std::isxdigit(static_cast<unsigned char>(c))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+SGPath ContentStore::pathForHash(const std::string& hashHex) const
+{
+    SGPath p = _root;
+    p.append(hashHex.substr(0, 2));
+    p.append(hashHex);
+    return p;
+}
+
+bool ContentStore::contains(const std::string& hashHex) const
+{
+    if (!isValidHash(hashHex)) {
+        return false;
+    }
+
+    return pathForHash(hashHex).isFile();
+}
+
+bool ContentStore::insert(const SGPath& file, const std::string& hashHex)
+{
+    if (!isValidHash(hashHex) || !file.isFile()) {
+        return false;
+    }
+
+    const SGPath blob = pathForHash(hashHex);
+    if (blob.isFile()) {
+        return true;
+    }
+
+    Dir bucket(blob.dirPath());
+    if (!bucket.exists() && !bucket.create(0755)) {
+        SG_LOG(SG_IO, SG_WARN, "ContentStore: failed to create " << bucket.path());
+        return false;
+    }
+
+    // link or copy to a temporary name, then rename, so a blob which exists
+    // is always complete
+    SGPath tmp = tempPathFor(blob);
+    if (!hardLink(file, tmp) && !copyFile(file, tmp)) {
+        SG_LOG(SG_IO, SG_WARN, "ContentStore: failed to add " << file << " as " << hashHex);
+        tmp.remove();
+        return false;
+    }
+
+    if (!tmp.rename(blob)) {
+        // lost a race with another inserter, which is fine
+        tmp.remove();
+        SGPath check = blob;
+        return check.isFile();
+    }
+
+    ++_stats.inserted;
+    return true;
+}
+
+bool ContentStore::materialize(const std::string& hashHex, const SGPath& dest,
+                               size_t expectedSize)
+{
+    if (!isValidHash(hashHex)) {
+        return false;
+    }
+
+    SGPath blob = pathForHash(hashHex);
+    if (!blob.isFile()) {
+        return false;
+    }
+
+    const size_t sz = blob.sizeInBytes();
+    if ((expectedSize > 0) && (sz != expectedSize)) {
+        SG_LOG(SG_IO, SG_WARN, "ContentStore: removing blob with bad size " << blob);
+        blob.remove();
+        return false;
+    }
+
+    SGPath target = dest;
+    if (target.exists()) {
+        target.remove();
+    }
+
+    if (hardLink(blob, target)) {
+        ++_stats.linked;
+    } else if (copyFile(blob, target)) {
+        ++_stats.copied;
+    } else {
+        SG_LOG(SG_IO, SG_WARN, "ContentStore: failed to create " << dest << " from " << hashHex);
+        target.remove();
+        return false;
+    }
+
+    _stats.bytesReused += sz;
+    return true;
+}
+
+size_t ContentStore::collectGarbage()
+{
+    size_t released = 0;
+    const Dir rootDir(_root);
+    if (!rootDir.exists()) {
+        return 0;
+    }
+
+    for (const auto& bucketPath : rootDir.children(Dir::TYPE_DIR | Dir::NO_DOT_OR_DOTDOT)) {
+        for (auto blob : Dir(bucketPath).children(Dir::TYPE_FILE | Dir::INCLUDE_HIDDEN)) {
+            // in-progress inserts, possibly from another process
+            if (blob.extension() == (tempSuffix + 1)) {
+                continue;
+            }
+
+            if (linkCount(blob) != 1) {
+                continue;
+            }
+
+            const size_t sz = blob.sizeInBytes();
+            if (blob.remove()) {
+                released += sz;
+            }
+        }
+    }
+
+    SG_LOG(SG_IO, SG_INFO, "ContentStore: garbage collection released " << released << " bytes");
+    return released;
+}
+
+} // of namespace simgear
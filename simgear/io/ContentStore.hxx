@@ -0,0 +1,102 @@
+// ContentStore.hxx - content-addressed local file store
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#pragma once
+
+#include <string>
+
+#include <simgear/misc/sg_path.hxx>
+
+namespace simgear
+{
+
+/**
+ * A directory of files ('blobs') named by the hex digest of their
+ * contents, shared between repositories and processes. Files are placed
+ * into repository trees as hard links where the file-system allows it,
+ * falling back to a copy, so identical content is downloaded and (ideally)
+ * stored only once.
+ *
+ * Because linked files share storage with the blob, anything writing into
+ * a repository tree using a store must replace files (remove, then create)
+ * rather than overwrite them in place.
+ *
+ * The store keeps no index: concurrent users only need to agree on the
+ * root path, and all updates are atomic renames.
+ */
+class ContentStore
+{
+public:
+    explicit ContentStore(const SGPath& root);
+
+    SGPath rootPath() const
+    {
+        return _root;
+    }
+
+    /**
+     * @return the location of the blob for a hash; it may not exist
+     */
+    SGPath pathForHash(const std::string& hashHex) const;
+
+    bool contains(const std::string& hashHex) const;
+
+    /**
+     * add a file, whose contents have already been verified to match
+     * hashHex, to the store. Does nothing if the hash is already present.
+     */
+    bool insert(const SGPath& file, const std::string& hashHex);
+
+    /**
+     * create dest with the content of the blob for hashHex, replacing any
+     * existing file. When expectedSize is non-zero, blobs of a different
+     * size are treated as missing (and removed).
+     *
+     * @return false if the store has no such blob, or dest could not be
+     * written
+     */
+    bool materialize(const std::string& hashHex, const SGPath& dest,
+                     size_t expectedSize = 0);
+
+    /**
+     * remove blobs which are no longer linked from any repository tree,
+     * ie whose link count has dropped to one. Blobs which were copied
+     * (rather than linked) out of the store are always candidates.
+     *
+     * @return the number of bytes released
+     */
+    size_t collectGarbage();
+
+    struct Statistics {
+        size_t inserted = 0;      ///< blobs added
+        size_t linked = 0;        ///< files materialized as hard links
+        size_t copied = 0;        ///< files materialized by copying
+        size_t bytesReused = 0;   ///< total size of materialized files
+    };
+
+    const Statistics& statistics() const
+    {
+        return _stats;
+    }
+
+private:
+    bool isValidHash(const std::string& hashHex) const;
+
+    SGPath _root;
+    Statistics _stats;
+};
+
+} // of namespace simgear
@@ -30,6 +30,8 @@
 #include <ctime>
 
 #include <simgear/debug/logstream.hxx>
+#include <simgear/io/iostreams/sgstream.hxx>
+#include <simgear/misc/strutils.hxx>
 
 namespace simgear {
 
@@ -123,19 +125,26 @@ static void dnscbSRV(struct dns_ctx *ctx, struct dns_rr_srv *result, void *data)
 {
     SRVRequest * r = static_cast<SRVRequest*>(data);
     if (result) {
+        SRVRequest::SRV_list entries;
+        for (int i = 0; i < result->dnssrv_nrr; i++) {
+            SRVRequest::SRV_ptr srv(new SRVRequest::SRV);
+            entries.push_back(srv);
+            srv->priority = result->dnssrv_srv[i].priority;
+            srv->weight = result->dnssrv_srv[i].weight;
+            srv->port = result->dnssrv_srv[i].port;
+            srv->target = result->dnssrv_srv[i].name;
+        }
+        std::sort(entries.begin(), entries.end(), sortSRV);
+
+        if (!entries.empty()) {
+            Cache::instance()->insert(Cache::keyFor(r), result->dnssrv_ttl, {}, entries);
+        }
+
         if (!r->isCancelled()) {
             r->cname = result->dnssrv_cname;
             r->qname = result->dnssrv_qname;
             r->ttl = result->dnssrv_ttl;
-            for (int i = 0; i < result->dnssrv_nrr; i++) {
-                SRVRequest::SRV_ptr srv(new SRVRequest::SRV);
-                r->entries.push_back(srv);
-                srv->priority = result->dnssrv_srv[i].priority;
-                srv->weight = result->dnssrv_srv[i].weight;
-                srv->port = result->dnssrv_srv[i].port;
-                srv->target = result->dnssrv_srv[i].name;
-            }
-            std::sort(r->entries.begin(), r->entries.end(), sortSRV);
+            r->entries = entries;
         }
         free(result);
     }
@@ -211,32 +220,48 @@ static bool sortNAPTR( const NAPTRRequest::NAPTR_ptr a, const NAPTRRequest::NAPT
     return a->preference < b->preference;
 }
 
+/// copy the records matching the request's qservice and qflags into it
+static void setMatchingNAPTR(NAPTRRequest* r, const NAPTRRequest::NAPTR_list& all)
+{
+    r->entries.clear();
+    for (const auto& n : all) {
+        if (!r->qservice.empty() && r->qservice != n->service)
+            continue;
+
+        //TODO: case ignore and result flags may have more than one flag
+        if (!r->qflags.empty() && r->qflags != n->flags)
+            continue;
+
+        r->entries.push_back(new NAPTRRequest::NAPTR(*n));
+    }
+    std::sort(r->entries.begin(), r->entries.end(), sortNAPTR);
+}
+
 static void dnscbNAPTR(struct dns_ctx *ctx, struct dns_rr_naptr *result, void *data)
 {
     NAPTRRequest * r = static_cast<NAPTRRequest*>(data);
     if (result) {
+        NAPTRRequest::NAPTR_list all;
+        for (int i = 0; i < result->dnsnaptr_nrr; i++) {
+            NAPTRRequest::NAPTR_ptr naptr(new NAPTRRequest::NAPTR);
+            all.push_back(naptr);
+            naptr->order = result->dnsnaptr_naptr[i].order;
+            naptr->preference = result->dnsnaptr_naptr[i].preference;
+            naptr->flags = result->dnsnaptr_naptr[i].flags;
+            naptr->service = result->dnsnaptr_naptr[i].service;
+            naptr->regexp = result->dnsnaptr_naptr[i].regexp;
+            naptr->replacement = result->dnsnaptr_naptr[i].replacement;
+        }
+
+        if (!all.empty()) {
+            Cache::instance()->insert(Cache::keyFor(r), result->dnsnaptr_ttl, all, {});
+        }
+
         if (!r->isCancelled()) {
             r->cname = result->dnsnaptr_cname;
             r->qname = result->dnsnaptr_qname;
             r->ttl = result->dnsnaptr_ttl;
-            for (int i = 0; i < result->dnsnaptr_nrr; i++) {
-                if (!r->qservice.empty() && r->qservice != result->dnsnaptr_naptr[i].service)
-                    continue;
-
-                //TODO: case ignore and result flags may have more than one flag
-                if (!r->qflags.empty() && r->qflags != result->dnsnaptr_naptr[i].flags)
-                    continue;
-
-                NAPTRRequest::NAPTR_ptr naptr(new NAPTRRequest::NAPTR);
-                r->entries.push_back(naptr);
-                naptr->order = result->dnsnaptr_naptr[i].order;
-                naptr->preference = result->dnsnaptr_naptr[i].preference;
-                naptr->flags = result->dnsnaptr_naptr[i].flags;
-                naptr->service = result->dnsnaptr_naptr[i].service;
-                naptr->regexp = result->dnsnaptr_naptr[i].regexp;
-                naptr->replacement = result->dnsnaptr_naptr[i].replacement;
-            }
-            std::sort(r->entries.begin(), r->entries.end(), sortNAPTR);
+            setMatchingNAPTR(r, all);
         }
         free(result);
     }
@@ -266,10 +291,54 @@ Client::Client() :
 
 void Client::makeRequest(const Request_ptr& r)
 {
+    const auto cached = Cache::instance()->lookup(r.get());
+    if (cached != Cache::Lookup::Miss) {
+        r->_start = time(NULL);
+        r->setComplete();
+
+        if (cached == Cache::Lookup::HitNeedsRefresh) {
+            // unfiltered, so the refreshed entry serves every request
+            // for this name
+            Request_ptr refresh;
+            if (r->getType() == DNS_T_NAPTR) {
+                refresh = new NAPTRRequest(r->getDn());
+            } else {
+                auto srv = static_cast<SRVRequest*>(r.get());
+                refresh = new SRVRequest(r->getDn(), srv->getService(), srv->getProtocol());
+            }
+
+            SG_LOG(SG_IO, SG_DEBUG, "DNS: refreshing cached answer for " << r->getDn());
+            d->_activeRequests.push_back(refresh);
+            refresh->submit(this);
+        }
+        return;
+    }
+
     d->_activeRequests.push_back(r);
     r->submit(this);
 }
 
+bool Client::setNameServer(const std::string& address, int port)
+{
+    // closing the context drops any queries in flight
+    d->_activeRequests.clear();
+    dns_close(d->ctx);
+
+    dns_add_serv(d->ctx, NULL);
+    if (dns_add_serv(d->ctx, address.c_str()) < 0) {
+        SG_LOG(SG_IO, SG_ALERT, "Invalid DNS server address " << address);
+        return false;
+    }
+
+    dns_set_opt(d->ctx, DNS_OPT_PORT, port);
+    if (dns_open(d->ctx) < 0) {
+        SG_LOG(SG_IO, SG_ALERT, "Can't open udns context" );
+        return false;
+    }
+
+    return true;
+}
+
 void Client::update(int waitTimeout)
 {
     time_t now = time(NULL);
@@ -292,6 +361,248 @@ void Client::update(int waitTimeout)
     d->_activeRequests.erase(it, d->_activeRequests.end());
 }
 
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+/// don't start another refresh for an entry within this time, so a
+/// failing server is not hammered
+const time_t refreshRetrySecs = 30;
+
+const char* cacheFileHeader = "# SimGear DNS cache v1";
+
+} // of anonymous namespace
+
+Cache* Cache::instance()
+{
+    static Cache theCache;
+    return &theCache;
+}
+
+std::string Cache::keyFor(const Request* r)
+{
+    const auto dn = strutils::lowercase(r->getDn());
+    if (r->getType() == DNS_T_NAPTR) {
+        return "NAPTR:" + dn;
+    }
+
+    if (r->getType() == DNS_T_SRV) {
+        auto srv = static_cast<const SRVRequest*>(r);
+        return "SRV:" + srv->getService() + ":" + srv->getProtocol() + ":" + dn;
+    }
+
+    return {};
+}
+
+void Cache::setPersistentPath(const SGPath& path)
+{
+    std::lock_guard<std::mutex> g(_lock);
+    _path = path;
+    if (!_path.isNull()) {
+        load();
+    }
+}
+
+void Cache::setPrefetchFraction(double fraction)
+{
+    std::lock_guard<std::mutex> g(_lock);
+    _prefetchFraction = fraction;
+}
+
+void Cache::setMaxStaleSeconds(time_t secs)
+{
+    std::lock_guard<std::mutex> g(_lock);
+    _maxStaleSecs = secs;
+}
+
+void Cache::clear()
+{
+    std::lock_guard<std::mutex> g(_lock);
+    _entries.clear();
+    _stats = Statistics();
+}
+
+Cache::Statistics Cache::statistics() const
+{
+    std::lock_guard<std::mutex> g(_lock);
+    return _stats;
+}
+
+Cache::Lookup Cache::lookup(Request* r)
+{
+    const auto key = keyFor(r);
+    if (key.empty()) {
+        return Lookup::Miss;
+    }
+
+    std::lock_guard<std::mutex> g(_lock);
+    auto it = _entries.find(key);
+    if (it == _entries.end()) {
+        ++_stats.misses;
+        return Lookup::Miss;
+    }
+
+    const time_t now = time(NULL);
+    Entry& e = it->second;
+    const bool expired = (now >= e.expires);
+    if (expired && ((now - e.expires) > _maxStaleSecs)) {
+        _entries.erase(it);
+        ++_stats.misses;
+        return Lookup::Miss;
+    }
+
+    if (expired) {
+        ++_stats.staleHits;
+    } else {
+        ++_stats.hits;
+    }
+
+    if (r->getType() == DNS_T_NAPTR) {
+        NAPTRRequest::NAPTR_list all;
+        for (const auto& n : e.naptr) {
+            all.push_back(new NAPTRRequest::NAPTR(n));
+        }
+        setMatchingNAPTR(static_cast<NAPTRRequest*>(r), all);
+    } else {
+        auto srvRequest = static_cast<SRVRequest*>(r);
+        srvRequest->entries.clear();
+        for (const auto& srv : e.srv) {
+            srvRequest->entries.push_back(new SRVRequest::SRV(srv));
+        }
+    }
+
+    r->qname = r->getDn();
+    r->ttl = expired ? 0 : static_cast<unsigned>(e.expires - now);
+
+    const bool wantRefresh = expired || (r->ttl <= e.ttl * _prefetchFraction);
+    if (wantRefresh && ((now - e.refreshStarted) > refreshRetrySecs)) {
+        e.refreshStarted = now;
+        ++_stats.refreshes;
+        return Lookup::HitNeedsRefresh;
+    }
+
+    return Lookup::Hit;
+}
+
+void Cache::insert(const std::string& key, unsigned ttl,
+                   const NAPTRRequest::NAPTR_list& naptr,
+                   const SRVRequest::SRV_list& srv)
+{
+    // a zero TTL means the answer must not be cached
+    if (key.empty() || (ttl == 0)) {
+        return;
+    }
+
+    Entry e;
+    e.expires = time(NULL) + ttl;
+    e.ttl = ttl;
+    for (const auto& n : naptr) {
+        e.naptr.push_back(*n);
+    }
+    for (const auto& s : srv) {
+        e.srv.push_back(*s);
+    }
+
+    std::lock_guard<std::mutex> g(_lock);
+    _entries[key] = std::move(e);
+    save();
+}
+
+void Cache::load()
+{
+    sg_ifstream f(_path, std::ios::in);
+    if (!f.is_open()) {
+        return;
+    }
+
+    std::string line;
+    std::getline(f, line);
+    if (line != cacheFileHeader) {
+        SG_LOG(SG_IO, SG_WARN, "DNS: ignoring cache file with unknown format:" << _path);
+        return;
+    }
+
+    const time_t now = time(NULL);
+    Entry* current = nullptr;
+    try {
+        while (std::getline(f, line)) {
+            const auto tokens = strutils::split(line, "\t");
+            if ((tokens[0] == "E") && (tokens.size() == 4)) {
+                Entry e;
+                e.expires = static_cast<time_t>(std::stoll(tokens[2]));
+                e.ttl = static_cast<unsigned>(std::stoul(tokens[3]));
+                if ((now - e.expires) > _maxStaleSecs) {
+                    current = nullptr; // too old, skip its records
+                    continue;
+                }
+
+                _entries[tokens[1]] = e;
+                current = &_entries[tokens[1]];
+            } else if (!current) {
+                continue;
+            } else if ((tokens[0] == "N") && (tokens.size() == 7)) {
+                NAPTRRequest::NAPTR n;
+                n.order = std::stoi(tokens[1]);
+                n.preference = std::stoi(tokens[2]);
+                n.flags = tokens[3];
+                n.service = tokens[4];
+                n.regexp = tokens[5];
+                n.replacement = tokens[6];
+                current->naptr.push_back(n);
+            } else if ((tokens[0] == "S") && (tokens.size() == 5)) {
+                SRVRequest::SRV srv;
+                srv.priority = std::stoi(tokens[1]);
+                srv.weight = std::stoi(tokens[2]);
+                srv.port = std::stoi(tokens[3]);
+                srv.target = tokens[4];
+                current->srv.push_back(srv);
+            }
+        }
+    } catch (std::exception& e) {
+        // std::stoi and friends throw on malformed numbers
+        SG_LOG(SG_IO, SG_WARN, "DNS: corrupt cache file " << _path << ":" << e.what());
+    }
+
+    SG_LOG(SG_IO, SG_DEBUG, "DNS: loaded " << _entries.size() << " cached answers from " << _path);
+}
+
+void Cache::save() const
+{
+    if (_path.isNull()) {
+        return;
+    }
+
+    // write then rename, so a crash never leaves a truncated cache
+    SGPath tmp = SGPath(_path.utf8Str() + ".new");
+    {
+        sg_ofstream f(tmp, std::ios::out | std::ios::trunc);
+        if (!f.is_open()) {
+            SG_LOG(SG_IO, SG_WARN, "DNS: unable to write cache file:" << tmp);
+            return;
+        }
+
+        f << cacheFileHeader << "\n";
+        for (const auto& it : _entries) {
+            const Entry& e = it.second;
+            f << "E\t" << it.first << "\t" << static_cast<long long>(e.expires) << "\t" << e.ttl << "\n";
+            for (const auto& n : e.naptr) {
+                f << "N\t" << n.order << "\t" << n.preference << "\t" << n.flags << "\t"
+                  << n.service << "\t" << n.regexp << "\t" << n.replacement << "\n";
+            }
+            for (const auto& srv : e.srv) {
+                f << "S\t" << srv.priority << "\t" << srv.weight << "\t" << srv.port
+                  << "\t" << srv.target << "\n";
+            }
+        }
+    }
+
+    SGPath dest = _path;
+    if (dest.exists()) {
+        dest.remove();
+    }
+    tmp.rename(dest);
+}
+
 } // of namespace DNS
 
 } // of namespace simgear
@@ -24,11 +24,15 @@
 #ifndef SG_DNS_CLIENT_HXX
 #define SG_DNS_CLIENT_HXX
 
+#include <map>
 #include <memory> // for std::unique_ptr
+#include <mutex>
 #include <string>
 #include <vector>
 #include <ctime> // for time_t
 
+#include <simgear/misc/sg_path.hxx>
+
 #include <simgear/structure/SGReferenced.hxx>
 #include <simgear/structure/SGSharedPtr.hxx>
 #include <simgear/structure/event_mgr.hxx>
@@ -113,6 +117,9 @@ public:
     typedef SGSharedPtr<SRV> SRV_ptr;
     typedef std::vector<SRV_ptr> SRV_list;
     SRV_list entries;
+
+    const std::string& getService() const { return _service; }
+    const std::string& getProtocol() const { return _protocol; }
 private:
     std::string _service;
     std::string _protocol;
@@ -138,14 +145,112 @@ public:
 
     void update(int waitTimeout = 0);
 
+    /**
+     * submit a request. NAPTR and SRV requests are answered from the
+     * shared Cache when possible, in which case they are complete on
+     * return; a background refresh is started if the cached answer is
+     * close to (or past) its expiry, so keep calling update().
+     */
     void makeRequest(const Request_ptr& r);
 
+    /**
+     * send queries to a specific name server instead of the system
+     * configuration; mostly useful for testing. Must be called before
+     * any requests are made.
+     */
+    bool setNameServer(const std::string& address, int port = 53);
+
 //    void cancelRequest(const Request_ptr& r, std::string reason = std::string());
 
     class ClientPrivate;
     std::unique_ptr<ClientPrivate> d;
 };
 
+/**
+ * Process-wide cache of NAPTR and SRV answers, shared by all clients.
+ *
+ * Answers are kept for their TTL and refreshed in the background once
+ * less than a fraction of the TTL remains. Expired answers are still
+ * returned (and refreshed) for a limited time, so that with a persistent
+ * cache file, a restart does not have to wait on the network.
+ */
+class Cache
+{
+public:
+    static Cache* instance();
+
+    /**
+     * load answers from, and save them to, the given file. Pass a null
+     * path to stop persisting.
+     */
+    void setPersistentPath(const SGPath& path);
+
+    /**
+     * refresh answers once less than this fraction of their TTL remains
+     * (default 0.1)
+     */
+    void setPrefetchFraction(double fraction);
+
+    /**
+     * how long after expiry an answer may still be used while it is
+     * refreshed (default one day). Zero disables use of stale answers.
+     */
+    void setMaxStaleSeconds(time_t secs);
+
+    void clear();
+
+    struct Statistics {
+        size_t hits = 0;       ///< answered from a fresh entry
+        size_t staleHits = 0;  ///< answered from an expired entry
+        size_t misses = 0;     ///< had to wait for the network
+        size_t refreshes = 0;  ///< background queries started
+    };
+
+    Statistics statistics() const;
+
+    /**
+     * record an answer; the client does this for each successful NAPTR
+     * or SRV response. NAPTR records are stored before any qservice /
+     * qflags filtering, so one entry serves all requests for a name.
+     */
+    void insert(const std::string& key, unsigned ttl,
+                const NAPTRRequest::NAPTR_list& naptr,
+                const SRVRequest::SRV_list& srv);
+
+    static std::string keyFor(const Request* r);
+
+private:
+    friend class Client;
+
+    Cache() = default;
+
+    enum class Lookup {
+        Miss,
+        Hit,
+        HitNeedsRefresh
+    };
+
+    Lookup lookup(Request* r);
+
+    void load();
+    void save() const;
+
+    struct Entry {
+        time_t expires = 0;
+        unsigned ttl = 0;
+        time_t refreshStarted = 0;
+        std::vector<NAPTRRequest::NAPTR> naptr;
+        std::vector<SRVRequest::SRV> srv;
+    };
+
+    mutable std::mutex _lock;
+    std::map<std::string, Entry> _entries;
+    SGPath _path;
+    double _prefetchFraction = 0.1;
+    time_t _maxStaleSecs = 24 * 60 * 60;
+    Statistics _stats;
+};
+
 } // of namespace DNS
 
 } // of namespace simgear
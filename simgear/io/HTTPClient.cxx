@@ -31,6 +31,8 @@
 #include <cstdlib> // rand()
 #include <list>
 #include <errno.h>
+#include <algorithm>
+#include <cmath>
 #include <map>
 #include <stdexcept>
 #include <mutex>
@@ -66,11 +68,49 @@ namespace HTTP
 extern const int DEFAULT_HTTP_PORT = 80;
 const char* CONTENT_TYPE_URL_ENCODED = "application/x-www-form-urlencoded";
 
+namespace {
+
+// DNS and TLS session data shared between all clients. Clients may live
+// on different threads (eg TerraSync), so access is guarded per data type.
+std::mutex curlShareMutexes[CURL_LOCK_DATA_LAST];
+CURLSH* curlShare = nullptr;
+
+void curlShareLock(CURL*, curl_lock_data data, curl_lock_access, void*)
+{
+    curlShareMutexes[data].lock();
+}
+
+void curlShareUnlock(CURL*, curl_lock_data data, void*)
+{
+    curlShareMutexes[data].unlock();
+}
+
+void createCurlShare()
+{
+    curlShare = curl_share_init();
+    curl_share_setopt(curlShare, CURLSHOPT_LOCKFUNC, curlShareLock);
+    curl_share_setopt(curlShare, CURLSHOPT_UNLOCKFUNC, curlShareUnlock);
+    curl_share_setopt(curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+}
+
+} // of anonymous namespace
+
 void Client::ClientPrivate::createCurlMulti() {
   curlMulti = curl_multi_init();
   // see https://curl.haxx.se/libcurl/c/CURLMOPT_PIPELINING.html
-  // we request HTTP 1.1 pipelining
-  curl_multi_setopt(curlMulti, CURLMOPT_PIPELINING, 1 /* aka CURLPIPE_HTTP1 */);
+  // we request HTTP 1.1 pipelining, and HTTP/2 multiplexing if enabled
+  long pipelining = 1 /* aka CURLPIPE_HTTP1 */;
+#if (LIBCURL_VERSION_NUM >= 0x072b00)
+  if (http2Enabled) {
+    pipelining |= CURLPIPE_MULTIPLEX;
+  }
+#endif
+  curl_multi_setopt(curlMulti, CURLMOPT_PIPELINING, pipelining);
+#if (LIBCURL_VERSION_NUM >= 0x074300)
+  curl_multi_setopt(curlMulti, CURLMOPT_MAX_CONCURRENT_STREAMS,
+                    (long)maxConcurrentStreams);
+#endif
 #if (LIBCURL_VERSION_MINOR >= 30)
   curl_multi_setopt(curlMulti, CURLMOPT_MAX_TOTAL_CONNECTIONS,
                     (long)maxConnections);
@@ -89,6 +129,7 @@ Client::Client()
     std::lock_guard<std::mutex> g(initMutex);
     if (!didInitCurlGlobal) {
       curl_global_init(CURL_GLOBAL_ALL);
+      createCurlShare();
       didInitCurlGlobal = true;
     }
 
@@ -124,6 +165,50 @@ void Client::setMaxPipelineDepth(unsigned int depth)
 #endif
 }
 
+void Client::setHTTP2Enabled(bool enabled)
+{
+    if (d->http2Enabled == enabled) {
+        return;
+    }
+
+    d->http2Enabled = enabled;
+#if (LIBCURL_VERSION_NUM >= 0x072b00)
+    long pipelining = 1 /* aka CURLPIPE_HTTP1 */;
+    if (enabled) {
+        pipelining |= CURLPIPE_MULTIPLEX;
+    }
+    curl_multi_setopt(d->curlMulti, CURLMOPT_PIPELINING, pipelining);
+#endif
+}
+
+bool Client::isHTTP2Enabled() const
+{
+    return d->http2Enabled;
+}
+
+void Client::setMaxConcurrentStreams(unsigned int streams)
+{
+    d->maxConcurrentStreams = std::max(1u, streams);
+#if (LIBCURL_VERSION_NUM >= 0x074300)
+    curl_multi_setopt(d->curlMulti, CURLMOPT_MAX_CONCURRENT_STREAMS,
+                      (long)d->maxConcurrentStreams);
+#endif
+}
+
+void Client::setUseSharedCaches(bool shared)
+{
+    d->useSharedCaches = shared;
+}
+
+unsigned int Client::ClientPrivate::maxActiveRequests() const
+{
+    // beyond this, requests are held back in our own queue, so that later
+    // high-priority requests can overtake them; Curl's queue is FIFO.
+    const unsigned int perConnection = http2Enabled
+        ? maxConcurrentStreams : std::max(1u, maxPipelineDepth);
+    return std::max(1u, maxConnections) * perConnection;
+}
+
 void Client::reset()
 {
     if (d.get()) {
@@ -148,6 +233,8 @@ void Client::reset()
 
 void Client::update(int waitTimeout)
 {
+    dispatchPendingRequests();
+
     if (d->requests.empty()) {
         // curl_multi_wait returns immediately if there's no requests active,
         // but that can cause high CPU usage for us.
@@ -194,6 +281,22 @@ void Client::update(int waitTimeout)
         long responseCode;
         curl_easy_getinfo(e, CURLINFO_RESPONSE_CODE, &responseCode);
 
+        if (msg->data.result == CURLE_OK) {
+#if (LIBCURL_VERSION_NUM >= 0x073d00)
+          curl_off_t firstByteUSec = 0, totalUSec = 0;
+          curl_easy_getinfo(e, CURLINFO_STARTTRANSFER_TIME_T, &firstByteUSec);
+          curl_easy_getinfo(e, CURLINFO_TOTAL_TIME_T, &totalUSec);
+          d->latency.firstByte.addSample(firstByteUSec / 1000.0);
+          d->latency.total.addSample(totalUSec / 1000.0);
+#else
+          double firstByteSec = 0.0, totalSec = 0.0;
+          curl_easy_getinfo(e, CURLINFO_STARTTRANSFER_TIME, &firstByteSec);
+          curl_easy_getinfo(e, CURLINFO_TOTAL_TIME, &totalSec);
+          d->latency.firstByte.addSample(firstByteSec * 1000.0);
+          d->latency.total.addSample(totalSec * 1000.0);
+#endif
+        }
+
           // remove from the requests map now,
           // in case the callbacks perform a cancel. We'll use
           // the absence from the request dict in cancel to avoid
@@ -239,6 +342,9 @@ void Client::update(int waitTimeout)
           SG_LOG(SG_IO, SG_ALERT, "unknown CurlMSG:" << msg->msg);
       }
     } // of curl message processing loop
+
+    // fill any slots freed by completed requests
+    dispatchPendingRequests();
 }
 
 void Client::makeRequest(const Request_ptr& r)
@@ -260,6 +366,34 @@ void Client::makeRequest(const Request_ptr& r)
 
     assert(d->requests.find(r) == d->requests.end());
 
+    // insert after any queued requests of equal or higher priority
+    auto pos = std::find_if(d->pendingRequests.begin(), d->pendingRequests.end(),
+                            [&r](const PendingRequest& pr) {
+                                return pr.request->priority() < r->priority();
+                            });
+    d->pendingRequests.insert(pos, PendingRequest{r, SGTimeStamp::now()});
+
+    dispatchPendingRequests();
+}
+
+void Client::dispatchPendingRequests()
+{
+    // don't add handles from inside a Curl callback
+    if (d->curlPerformActive) {
+        return;
+    }
+
+    const unsigned int maxActive = d->maxActiveRequests();
+    while (!d->pendingRequests.empty() && (d->requests.size() < maxActive)) {
+        PendingRequest pr = d->pendingRequests.front();
+        d->pendingRequests.pop_front();
+        d->latency.queued.addSample(pr.queuedAt.elapsedUSec() / 1000.0);
+        startRequest(pr.request);
+    }
+}
+
+void Client::startRequest(const Request_ptr& r)
+{
     CURL* curlRequest = curl_easy_init();
     curl_easy_setopt(curlRequest, CURLOPT_URL, r->url().c_str());
 
@@ -284,7 +418,22 @@ void Client::makeRequest(const Request_ptr& r)
 
     curl_easy_setopt(curlRequest, CURLOPT_BUFFERSIZE, CURL_MAX_READ_SIZE);
     curl_easy_setopt(curlRequest, CURLOPT_USERAGENT, d->userAgent.c_str());
+#if (LIBCURL_VERSION_NUM >= 0x072f00)
+    if (d->http2Enabled) {
+        curl_easy_setopt(curlRequest, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+        // prefer waiting for a connection we can multiplex over, to opening
+        // a new one
+        curl_easy_setopt(curlRequest, CURLOPT_PIPEWAIT, 1L);
+    } else {
+        curl_easy_setopt(curlRequest, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+    }
+#else
     curl_easy_setopt(curlRequest, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+#endif
+
+    if (d->useSharedCaches && curlShare) {
+        curl_easy_setopt(curlRequest, CURLOPT_SHARE, curlShare);
+    }
 
     if (sglog().would_log(SG_TERRASYNC, SG_DEBUG, __FILE__, __LINE__, __FUNCTION__)) {
         curl_easy_setopt(curlRequest, CURLOPT_VERBOSE, 1);
@@ -370,6 +519,17 @@ void Client::makeRequest(const Request_ptr& r)
 
 void Client::cancelRequest(const Request_ptr &r, std::string reason)
 {
+    auto pendingIt = std::find_if(d->pendingRequests.begin(), d->pendingRequests.end(),
+                                  [&r](const PendingRequest& pr) {
+                                      return pr.request == r;
+                                  });
+    if (pendingIt != d->pendingRequests.end()) {
+        // never handed to Curl, so nothing to clean up
+        d->pendingRequests.erase(pendingIt);
+        r->setFailure(-1, reason);
+        return;
+    }
+
     ClientPrivate::RequestCurlMap::iterator it = d->requests.find(r);
     if(it == d->requests.end()) {
         // already being removed, presumably inside ::update()
@@ -451,7 +611,7 @@ void Client::setProxy( const std::string& proxy,
 
 bool Client::hasActiveRequests() const
 {
-    return !d->requests.empty();
+    return !d->requests.empty() || !d->pendingRequests.empty();
 }
 
 void Client::receivedBytes(unsigned int count)
@@ -491,6 +651,53 @@ uint64_t Client::totalBytesDownloaded() const
     return d->totalBytesDownloaded;
 }
 
+const Client::LatencyStatistics& Client::latencyStatistics() const
+{
+    return d->latency;
+}
+
+void Client::resetLatencyStatistics()
+{
+    d->latency = LatencyStatistics();
+}
+
+void Client::LatencyHistogram::addSample(double msec)
+{
+    unsigned int bucket = 0;
+    if (msec >= 1.0) {
+        bucket = static_cast<unsigned int>(std::floor(std::log2(msec))) + 1;
+        bucket = std::min(bucket, BucketCount - 1);
+    }
+
+    ++buckets[bucket];
+    ++count;
+    totalMSec += msec;
+    maxMSec = std::max(maxMSec, msec);
+}
+
+double Client::LatencyHistogram::meanMSec() const
+{
+    return (count > 0) ? (totalMSec / count) : 0.0;
+}
+
+double Client::LatencyHistogram::percentileMSec(double pct) const
+{
+    if (count == 0) {
+        return 0.0;
+    }
+
+    const double target = (pct / 100.0) * count;
+    uint64_t cumulative = 0;
+    for (unsigned int i = 0; i < BucketCount - 1; ++i) {
+        cumulative += buckets[i];
+        if ((cumulative > 0) && (cumulative >= target)) {
+            return std::min(maxMSec, static_cast<double>(1u << i));
+        }
+    }
+
+    return maxMSec;
+}
+
 size_t Client::requestWriteCallback(char *ptr, size_t size, size_t nmemb, void *userdata)
 {
   size_t byteSize = size * nmemb;
@@ -574,6 +781,9 @@ void Client::debugDumpRequests()
     for (; it != d->requests.end(); ++it) {
         SG_LOG(SG_IO, SG_INFO, "\t" << it->first->url());
     }
+    for (const auto& pr : d->pendingRequests) {
+        SG_LOG(SG_IO, SG_INFO, "\t(queued) " << pr.request->url());
+    }
     SG_LOG(SG_IO, SG_INFO, "==");
 }
 
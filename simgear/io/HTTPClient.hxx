@@ -87,6 +87,65 @@ public:
      */
     void setMaxPipelineDepth(unsigned int depth);
 
+    /**
+     * Negotiate HTTP/2 for https:// URLs, and multiplex concurrent requests
+     * to the same host over a single connection. Plain http:// requests and
+     * servers without HTTP/2 support continue to use HTTP/1.1.
+     * (default is disabled)
+     */
+    void setHTTP2Enabled(bool enabled);
+
+    bool isHTTP2Enabled() const;
+
+    /**
+     * maximum number of requests multiplexed over one HTTP/2 connection
+     * (default value is 100)
+     */
+    void setMaxConcurrentStreams(unsigned int streams);
+
+    /**
+     * Share the DNS and TLS session caches with all other clients which
+     * have this enabled, so a new client does not repeat lookups and
+     * handshakes already done by another one. (default is enabled)
+     */
+    void setUseSharedCaches(bool shared);
+
+    /**
+     * histogram of request latencies, in power-of-two millisecond buckets:
+     * bucket 0 counts samples below 1msec, bucket i samples in
+     * [2^(i-1), 2^i) msec, and the last bucket is open-ended.
+     */
+    struct LatencyHistogram
+    {
+        static const unsigned int BucketCount = 16;
+
+        uint64_t buckets[BucketCount] = {};
+        uint64_t count = 0;
+        double totalMSec = 0.0;
+        double maxMSec = 0.0;
+
+        void addSample(double msec);
+
+        double meanMSec() const;
+
+        /**
+         * approximate percentile (0 - 100), rounded up to the
+         * upper bound of the containing bucket
+         */
+        double percentileMSec(double pct) const;
+    };
+
+    struct LatencyStatistics
+    {
+        LatencyHistogram queued;    ///< time spent waiting to be sent
+        LatencyHistogram firstByte; ///< time from sending to the first response byte
+        LatencyHistogram total;     ///< time from sending to completion
+    };
+
+    const LatencyStatistics& latencyStatistics() const;
+
+    void resetLatencyStatistics();
+
     const std::string& userAgent() const;
 
     const std::string& proxyHost() const;
@@ -122,6 +181,9 @@ private:
 
     void requestFinished(Connection* con);
 
+    void dispatchPendingRequests();
+    void startRequest(const Request_ptr& r);
+
     void receivedBytes(unsigned int count);
 
     friend class Connection;
@@ -29,6 +29,13 @@ namespace HTTP {
 
 typedef std::list<Request_ptr> RequestList;
 
+struct PendingRequest {
+  Request_ptr request;
+  SGTimeStamp queuedAt;
+};
+
+typedef std::list<PendingRequest> PendingRequestList;
+
 using ResponseDoneCallback =
     std::function<bool(int curlResult, Request_ptr req)>;
 
@@ -48,8 +55,14 @@ public:
   unsigned int maxConnections;
   unsigned int maxHostConnections;
   unsigned int maxPipelineDepth;
+  bool http2Enabled = false;
+  unsigned int maxConcurrentStreams = 100;
+  bool useSharedCaches = true;
 
-  RequestList pendingRequests;
+  // requests not yet handed to Curl, sorted by descending priority
+  PendingRequestList pendingRequests;
+
+  unsigned int maxActiveRequests() const;
 
   bool curlPerformActive = false;
   RequestList pendingCancelRequests;
@@ -61,6 +74,8 @@ public:
 
   SGPath tlsCertificatePath;
 
+  Client::LatencyStatistics latency;
+
   // only used by unit-tests / test-api, but
   // only costs us a pointe here to declare it.
   ResponseDoneCallback testsuiteResponseDoneCallback;
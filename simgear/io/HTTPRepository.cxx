@@ -21,16 +21,21 @@
 #include "HTTPRepository.hxx"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdlib>
+#include <exception>
 #include <fstream>
 #include <iostream>
 #include <limits>
 #include <map>
+#include <mutex>
 #include <set>
 #include <sstream>
+#include <thread>
 
 #include <fcntl.h>
+#include <sys/stat.h>
 
 #include "simgear/debug/logstream.hxx"
 #include "simgear/misc/strutils.hxx"
@@ -41,6 +46,7 @@
 #include <simgear/io/HTTPClient.hxx>
 #include <simgear/io/iostreams/sgstream.hxx>
 #include <simgear/io/sg_file.hxx>
+#include <simgear/io/sg_mmap.hxx>
 #include <simgear/io/untar.hxx>
 #include <simgear/misc/sg_dir.hxx>
 #include <simgear/structure/exception.hxx>
@@ -88,11 +94,31 @@ struct HashCacheEntry {
     std::string filePath;
     time_t modTime;
     size_t lengthBytes;
+    uint64_t inode = 0; ///< zero if unknown, or not supported by the platform
     std::string hashHex;
 };
 
 using HashCache = std::unordered_map<std::string, HashCacheEntry>;
 
+// files at least this big are hashed from a read-only mapping instead of
+// being copied through a buffer
+const size_t mmapHashThreshold = 256 * 1024;
+
+uint64_t inodeForPath(const SGPath& p)
+{
+#if defined(SG_WINDOWS)
+    // st_ino is always zero on Windows
+    return 0;
+#else
+    struct stat buf;
+    if (::stat(p.utf8Str().c_str(), &buf) < 0) {
+        return 0;
+    }
+
+    return static_cast<uint64_t>(buf.st_ino);
+#endif
+}
+
 std::string computeHashForPath(const SGPath& p)
 {
     if (!p.exists())
@@ -101,6 +127,17 @@ std::string computeHashForPath(const SGPath& p)
     sha1nfo info;
     sha1_init(&info);
 
+    if (p.sizeInBytes() >= mmapHashThreshold) {
+        SGMMapFile mf(p);
+        if (mf.open(SG_IO_IN)) {
+            sha1_write(&info, mf.get(), mf.get_size());
+            mf.close();
+            return strutils::encodeHex(sha1_result(&info), HASH_LENGTH);
+        }
+
+        // mapping failed, fall back to reading the file
+    }
+
     const int bufSize = 1024 * 1024;
     char* buf = static_cast<char*>(malloc(bufSize));
     if (!buf) {
@@ -123,6 +160,55 @@ std::string computeHashForPath(const SGPath& p)
     return strutils::encodeHex(hashBytes);
 }
 
+/**
+ * compute the hashes of several files, spreading the work over up to
+ * threadCount threads (including the calling one). Results are returned in
+ * the same order as the input; the first exception thrown by any worker is
+ * re-thrown on the calling thread once all workers are done.
+ */
+string_list computeHashesForPaths(const PathList& paths, unsigned int threadCount)
+{
+    string_list result(paths.size());
+    std::atomic<size_t> nextIndex{0};
+    std::exception_ptr firstError;
+    std::mutex errorMutex;
+
+    auto worker = [&]() {
+        for (;;) {
+            const size_t i = nextIndex++;
+            if (i >= paths.size()) {
+                return;
+            }
+
+            try {
+                result[i] = computeHashForPath(paths[i]);
+            } catch (...) {
+                std::lock_guard<std::mutex> g(errorMutex);
+                if (!firstError) {
+                    firstError = std::current_exception();
+                }
+            }
+        }
+    };
+
+    const size_t numThreads = std::min<size_t>(threadCount, paths.size());
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < numThreads; ++t) {
+        threads.emplace_back(worker);
+    }
+
+    worker();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    if (firstError) {
+        std::rethrow_exception(firstError);
+    }
+
+    return result;
+}
+
 } // namespace
 
 class HTTPDirectory
@@ -223,6 +309,7 @@ public:
         }
 
         std::string buf;
+        PathList copied;
 
         for (auto& child : children) {
             if (child.type != HTTPRepository::FileType)
@@ -252,7 +339,7 @@ public:
                     simgear::reportFailure(simgear::LoadFailure::OutOfMemory, simgear::ErrorCode::TerraSync,
                                            "copyInstalledChildren: couldn't allocation copy buffer of size:" + std::to_string(sizeToCopy),
                                            child.path);
-                    return;
+                    break;
                 }
             }
 
@@ -261,7 +348,7 @@ public:
                 simgear::reportFailure(simgear::LoadFailure::IOError, simgear::ErrorCode::TerraSync,
                                        "copyInstalledChildren: read underflow, got:" + std::to_string(r),
                                        cp);
-                return;
+                break;
             }
 
             const size_t written = dst.write(buf.data(), sizeToCopy);
@@ -269,7 +356,7 @@ public:
                 simgear::reportFailure(simgear::LoadFailure::IOError, simgear::ErrorCode::TerraSync,
                                        "copyInstalledChildren: write underflow, wrote:" + std::to_string(r),
                                        child.path);
-                return;
+                break;
             }
 
             src.close();
@@ -278,10 +365,12 @@ public:
             // reset caching
             child.path.set_cached(false);
             child.path.set_cached(true);
-
-            std::string hash = computeHashForPath(child.path);
-            updatedFileContents(child.path, hash);
+            copied.push_back(child.path);
         }
+
+        // hash all the copied files in one go, so the work can be shared
+        // between threads
+        computeAndCacheHashes(copied);
     }
 
     /// helper to check and erase 'fooBar' from paths, if passed fooBar.zip, fooBar.tgz, etc.
@@ -305,6 +394,8 @@ public:
 
       ChildInfoList toBeUpdated;
 
+      const string_list childHashes = hashesForChildren();
+
       simgear::Dir d(absolutePath());
       PathList fsChildren = d.children(0);
       PathList orphans = fsChildren;
@@ -317,13 +408,14 @@ public:
                                    }),
                     orphans.end());
 
-      for (const auto &c : children) {
+      for (size_t i = 0; i < children.size(); ++i) {
+        const auto &c = children[i];
         // Check if the file exists
         auto p = std::find_if(fsChildren.begin(), fsChildren.end(),
                               LocalFileMatcher(c));
 
         const bool isNew = (p == fsChildren.end());
-        const bool upToDate = hashForChild(c) == c.hash;
+        const bool upToDate = childHashes[i] == c.hash;
 
         if (!isNew) {
           orphans.erase(std::remove(orphans.begin(), orphans.end(), *p),
@@ -436,6 +528,9 @@ public:
         ChildInfoList::const_iterator it;
         for (it = names.begin(); it != names.end(); ++it) {
           if (it->type == HTTPRepository::FileType) {
+            if (materializeFromStore(*it)) {
+              continue;
+            }
             _repository->updateFile(this, it->name, it->sizeInBytes);
           } else if (it->type == HTTPRepository::DirectoryType) {
             HTTPDirectory *childDir = childDirectory(it->name);
@@ -450,6 +545,22 @@ public:
         }
     }
 
+    /// create a child file from the content store, if it holds a blob
+    /// with the expected hash
+    bool materializeFromStore(const ChildInfo& child)
+    {
+        auto store = _repository->contentStore.get();
+        if (!store || !store->materialize(child.hash, child.path, child.sizeInBytes)) {
+            return false;
+        }
+
+        // the store only holds verified content, so there's no need to
+        // re-hash here
+        updatedFileContents(child.path, child.hash);
+        _repository->updatedChildSuccessfully(_relativePath + "/" + child.name);
+        return true;
+    }
+
     SGPath absolutePath() const
     {
         SGPath r(_repository->basePath);
@@ -555,6 +666,10 @@ public:
                 _repository->updatedChildSuccessfully(_relativePath + "/" +
                                                       file);
 
+                if (_repository->contentStore && (it->type == HTTPRepository::FileType)) {
+                    _repository->contentStore->insert(it->path, hash);
+                }
+
                 _repository->totalDownloaded += sz;
                 SGPath p = SGPath(absolutePath(), file);
 
@@ -608,23 +723,42 @@ public:
 
     std::string hashForPath(const SGPath& p) const
     {
-        const auto ps = p.utf8Str();
-        auto it = hashes.find(ps);
-        if (it != hashes.end()) {
-            const auto& entry = it->second;
-            // ensure data on disk hasn't changed.
-            // we could also use the file type here if we were paranoid
-            if ((p.sizeInBytes() == entry.lengthBytes) && (p.modTime() == entry.modTime)) {
-                return entry.hashHex;
+        std::string hash;
+        if (lookupCachedHash(p, hash)) {
+            ++_repository->hashStats.cacheHits;
+            return hash;
+        }
+
+        return computeAndCacheHashes({p}).front();
+    }
+
+    /**
+     * return the on-disk hash of each entry in children (in the same order),
+     * using the hash cache where possible and computing all the missing
+     * hashes in parallel.
+     */
+    string_list hashesForChildren() const
+    {
+        string_list result(children.size());
+        PathList toCompute;
+        std::vector<size_t> toComputeIndex;
+
+        for (size_t i = 0; i < children.size(); ++i) {
+            const SGPath p = hashPathForChild(children[i]);
+            if (lookupCachedHash(p, result[i])) {
+                ++_repository->hashStats.cacheHits;
+            } else if (p.exists()) {
+                toCompute.push_back(p);
+                toComputeIndex.push_back(i);
             }
+        }
 
-            // entry in the cache, but it's stale so remove and fall through
-            hashes.erase(it);
+        const string_list computed = computeAndCacheHashes(toCompute);
+        for (size_t i = 0; i < computed.size(); ++i) {
+            result[toComputeIndex[i]] = computed[i];
         }
 
-        std::string hash = computeHashForPath(p);
-        updatedFileContents(p, hash);
-        return hash;
+        return result;
     }
 
     bool isHashCacheDirty() const
@@ -644,7 +778,8 @@ public:
         for (const auto& e : hashes) {
             const auto& entry = e.second;
             stream << entry.filePath << "*" << entry.modTime << "*"
-                   << entry.lengthBytes << "*" << entry.hashHex << "\n";
+                   << entry.lengthBytes << "*" << entry.hashHex << "*"
+                   << entry.inode << "\n";
         }
         stream.close();
     }
@@ -782,13 +917,62 @@ private:
         }
     }
 
-    std::string hashForChild(const ChildInfo& child) const
+    SGPath hashPathForChild(const ChildInfo& child) const
     {
       SGPath p(child.path);
       if (child.type == HTTPRepository::DirectoryType) {
           p.append(".dirindex");
       }
-      return hashForPath(p);
+      return p;
+    }
+
+    bool lookupCachedHash(const SGPath& p, std::string& hash) const
+    {
+        auto it = hashes.find(p.utf8Str());
+        if (it == hashes.end()) {
+            return false;
+        }
+
+        const auto& entry = it->second;
+        // ensure data on disk hasn't changed. The inode check catches files
+        // replaced by a rename within the same second, with the same size.
+        if ((p.sizeInBytes() == entry.lengthBytes) && (p.modTime() == entry.modTime)) {
+            const uint64_t inode = entry.inode ? inodeForPath(p) : 0;
+            if (inode == entry.inode) {
+                hash = entry.hashHex;
+                return true;
+            }
+        }
+
+        // entry in the cache, but it's stale so remove it
+        hashes.erase(it);
+        hashCacheDirty = true;
+        return false;
+    }
+
+    string_list computeAndCacheHashes(const PathList& paths) const
+    {
+        if (paths.empty()) {
+            return {};
+        }
+
+        SGTimeStamp st;
+        st.stamp();
+
+        const string_list result = computeHashesForPaths(paths,
+            _repository->effectiveHashThreadCount());
+
+        auto& stats = _repository->hashStats;
+        for (size_t i = 0; i < paths.size(); ++i) {
+            updatedFileContents(paths[i], result[i]);
+            if (!result[i].empty()) {
+                ++stats.filesHashed;
+                stats.bytesHashed += paths[i].sizeInBytes();
+            }
+        }
+
+        stats.hashTimeMSec += st.elapsedMSec();
+        return result;
     }
 
     void parseHashCache()
@@ -828,6 +1012,10 @@ private:
             entry.hashHex = hashData;
             entry.modTime = strtol(timeData.c_str(), NULL, 10);
             entry.lengthBytes = strtol(sizeData.c_str(), NULL, 10);
+            // the inode field was added later, so older caches omit it
+            if (tokens.size() > 4) {
+                entry.inode = strtoull(tokens[4].c_str(), NULL, 10);
+            }
             hashes.insert(std::make_pair(entry.filePath, entry));
         }
     }
@@ -856,6 +1044,7 @@ private:
         entry.hashHex = newHash;
         entry.modTime = p2.modTime();
         entry.lengthBytes = p2.sizeInBytes();
+        entry.inode = inodeForPath(p2);
         hashes.insert(std::make_pair(ps, entry));
 
         hashCacheDirty = true;
@@ -994,6 +1183,25 @@ void HTTPRepository::setInstalledCopyPath(const SGPath& copyPath)
     _d->installedCopyPath = copyPath;
 }
 
+void HTTPRepository::setContentStorePath(const SGPath& storePath)
+{
+    if (storePath.isNull()) {
+        _d->contentStore.reset();
+    } else {
+        _d->contentStore.reset(new ContentStore(storePath));
+    }
+}
+
+void HTTPRepository::setHashThreadCount(unsigned int count)
+{
+    _d->hashThreadCount = count;
+}
+
+HTTPRepository::HashStatistics HTTPRepository::hashStatistics() const
+{
+    return _d->hashStats;
+}
+
 std::string HTTPRepository::resultCodeAsString(ResultCode code)
 {
     return innerResultCodeAsString(code);
@@ -1056,6 +1264,12 @@ HTTPRepository::failure() const
 
         bool createOutputFile()
         {
+            // replace rather than truncate: the existing file may be a
+            // hard link into the content store
+            if (pathInRepo.exists()) {
+                pathInRepo.remove();
+            }
+
             file.reset(new SGBinaryFile(pathInRepo));
             if (!file->open(SG_IO_OUT)) {
                 SG_LOG(SG_TERRASYNC, SG_WARN,
@@ -1168,6 +1382,9 @@ HTTPRepository::failure() const
             _targetHash(targetHash)
         {
             sha1_init(&hashContext);
+            // index files are small and each one unlocks further requests,
+            // so fetch them ahead of any queued file downloads
+            setPriority(1);
         }
 
         void setIsRootDir()
@@ -1399,8 +1616,13 @@ HTTPRepository::failure() const
       }
 
       if (!queuedRequests.empty()) {
-        RepoRequestPtr rr = queuedRequests.front();
-        queuedRequests.erase(queuedRequests.begin());
+        // first request with the highest priority
+        auto next = std::max_element(queuedRequests.begin(), queuedRequests.end(),
+                                     [](const RepoRequestPtr& a, const RepoRequestPtr& b) {
+                                         return a->priority() < b->priority();
+                                     });
+        RepoRequestPtr rr = *next;
+        queuedRequests.erase(next);
         activeRequests.push_back(rr);
         http->makeRequest(rr);
       }
@@ -1490,6 +1712,17 @@ HTTPRepository::failure() const
       pendingTasks.push_back(task);
     }
 
+    unsigned int HTTPRepoPrivate::effectiveHashThreadCount() const
+    {
+        if (hashThreadCount > 0) {
+            return hashThreadCount;
+        }
+
+        // hashing is mostly I/O bound, more threads than this rarely helps
+        const unsigned int hw = std::thread::hardware_concurrency();
+        return std::max(1u, std::min(hw, 8u));
+    }
+
     int HTTPRepoPrivate::countDirtyHashCaches() const
     {
         int result = rootDir->isHashCacheDirty() ? 1 : 0;
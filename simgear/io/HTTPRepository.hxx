@@ -81,6 +81,33 @@ public:
    */
   void setInstalledCopyPath(const SGPath &copyPath);
 
+  /**
+   * optionally provide the root of a content-addressed store, which may be
+   * shared with other repositories and processes. Files whose hash is
+   * already in the store are linked (or copied) from it instead of being
+   * downloaded, and verified downloads are added to it.
+   */
+  void setContentStorePath(const SGPath &storePath);
+
+  /**
+   * set the number of worker threads used to verify local files against
+   * the repository index. Zero (the default) picks a value based on the
+   * hardware concurrency, one hashes everything on the calling thread.
+   */
+  void setHashThreadCount(unsigned int count);
+
+  struct HashStatistics {
+    size_t filesHashed = 0;    ///< files whose SHA1 was computed from disk
+    size_t bytesHashed = 0;    ///< total size of those files
+    size_t cacheHits = 0;      ///< hashes served from the .dirhash cache
+    double hashTimeMSec = 0.0; ///< wall-clock time spent computing hashes
+  };
+
+  /**
+   * @brief statistics about local file verification since construction
+   */
+  HashStatistics hashStatistics() const;
+
   static std::string resultCodeAsString(ResultCode code);
 
   enum class SyncAction { Add, Update, Delete, UpToDate };
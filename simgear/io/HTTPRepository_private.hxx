@@ -25,6 +25,7 @@
 #include <string>
 #include <unordered_map>
 
+#include <simgear/io/ContentStore.hxx>
 #include <simgear/io/HTTPClient.hxx>
 #include <simgear/misc/sg_path.hxx>
 
@@ -111,6 +112,12 @@ public:
   void scheduleUpdateOfChildren(HTTPDirectory *dir);
 
   SGPath installedCopyPath;
+  std::unique_ptr<ContentStore> contentStore;
+
+  unsigned int hashThreadCount = 0;
+  HTTPRepository::HashStatistics hashStats;
+
+  unsigned int effectiveHashThreadCount() const;
 
   int countDirtyHashCaches() const;
   void flushHashCaches();
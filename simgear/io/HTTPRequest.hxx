@@ -166,6 +166,17 @@ public:
     unsigned long getMaxBytesPerSec() const
         { return _maxBytesPerSec; }
 
+    /**
+     * Requests waiting to be sent by the client are dispatched in order of
+     * descending priority, and in submission order for equal priorities.
+     * Only affects requests which have not been sent yet; the default is 0.
+     */
+    void setPriority(int priority)
+        { _priority = priority; }
+
+    int priority() const
+        { return _priority; }
+
     Client* http() const
     { return _client; }
 
@@ -301,6 +312,7 @@ public:
     bool          _willClose;
     bool          _connectionCloseHeader;
     unsigned long _maxBytesPerSec = 0;
+    int           _priority = 0;
 };
 
 typedef SGSharedPtr<Request> Request_ptr;
@@ -39,6 +39,7 @@
 # include <unistd.h>
 #endif
 
+#include <simgear/sg_inlines.h>
 #include <simgear/misc/stdint.hxx>
 #include <simgear/debug/logstream.hxx>
 
@@ -217,6 +218,20 @@ int SGFile::writestring( const char *str ) {
 }
 
 
+bool SGFile::preallocate(size_t length) {
+#if defined(HAVE_POSIX_FALLOCATE)
+    if (length == 0) {
+        return true;
+    }
+
+    return ::posix_fallocate( fp, 0, (off_t) length ) == 0;
+#else
+    SG_UNUSED(length);
+    return false;
+#endif
+}
+
+
 // close the port
 bool SGFile::close() {
     if ( ::close( fp ) == -1 ) {
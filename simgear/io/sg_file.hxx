@@ -82,6 +82,13 @@ public:
     // close file
     bool close();
 
+    /**
+     * reserve disk space for a file about to be written with exactly
+     * length bytes. Returns false if unsupported or the request failed,
+     * in which case the file is still usable.
+     */
+    bool preallocate(size_t length);
+
     /** @return the name of the file being manipulated. */
     std::string get_file_name() const { return file_name.utf8Str(); }
 
@@ -1,13 +1,189 @@
 #ifndef SIMGEAR_IO_TEST_DNS_HXX
 #define SIMGEAR_IO_TEST_DNS_HXX
 
+#include <cstdint>
+#include <map>
 #include <sstream>
+#include <string>
+#include <vector>
 
+#include <simgear/io/raw_socket.hxx>
 #include <simgear/io/sg_netChat.hxx>
 #include <simgear/misc/strutils.hxx>
 
 namespace simgear
 {
+
+/**
+ * Minimal UDP name server answering NAPTR and SRV queries from a fixed
+ * table, so the DNS client can be tested without network access. Call
+ * poll() regularly, as with the HTTP TestServer.
+ */
+class FakeDNSServer
+{
+public:
+    enum {
+        TypeSRV = 33,
+        TypeNAPTR = 35
+    };
+
+    FakeDNSServer(int port = 15353) : _port(port)
+    {
+        _socket.open(false);
+        _socket.setBlocking(false);
+        _socket.bind("127.0.0.1", _port);
+    }
+
+    ~FakeDNSServer()
+    {
+        _socket.close();
+    }
+
+    int port() const { return _port; }
+
+    void addNAPTR(const std::string& name, unsigned ttl, int order, int preference,
+                  const std::string& flags, const std::string& service,
+                  const std::string& regexp)
+    {
+        std::string rdata;
+        put16(rdata, order);
+        put16(rdata, preference);
+        putString(rdata, flags);
+        putString(rdata, service);
+        putString(rdata, regexp);
+        rdata.push_back(0); // root replacement
+        _records[key(name, TypeNAPTR)].push_back({ttl, rdata});
+    }
+
+    void addSRV(const std::string& name, unsigned ttl, int priority, int weight,
+                int port, const std::string& target)
+    {
+        std::string rdata;
+        put16(rdata, priority);
+        put16(rdata, weight);
+        put16(rdata, port);
+        putName(rdata, target);
+        _records[key(name, TypeSRV)].push_back({ttl, rdata});
+    }
+
+    void clearRecords()
+    {
+        _records.clear();
+    }
+
+    int queryCount(const std::string& name, int type) const
+    {
+        auto it = _queryCounts.find(key(name, type));
+        return (it == _queryCounts.end()) ? 0 : it->second;
+    }
+
+    void poll()
+    {
+        char buf[512];
+        IPAddress from;
+        for (;;) {
+            const int len = _socket.recvfrom(buf, sizeof(buf), 0, &from);
+            if (len < 12) {
+                return;
+            }
+
+            respond(std::string(buf, len), from);
+        }
+    }
+
+private:
+    struct Record {
+        unsigned ttl;
+        std::string rdata;
+    };
+
+    static std::string key(const std::string& name, int type)
+    {
+        return strutils::lowercase(name) + "/" + std::to_string(type);
+    }
+
+    static void put16(std::string& s, unsigned v)
+    {
+        s.push_back(static_cast<char>((v >> 8) & 0xff));
+        s.push_back(static_cast<char>(v & 0xff));
+    }
+
+    static void put32(std::string& s, unsigned v)
+    {
+        put16(s, v >> 16);
+        put16(s, v & 0xffff);
+    }
+
+    static void putString(std::string& s, const std::string& v)
+    {
+        s.push_back(static_cast<char>(v.size()));
+        s += v;
+    }
+
+    static void putName(std::string& s, const std::string& name)
+    {
+        for (const auto& label : strutils::split(name, ".")) {
+            if (!label.empty()) {
+                putString(s, label);
+            }
+        }
+        s.push_back(0);
+    }
+
+    void respond(const std::string& query, const IPAddress& to)
+    {
+        // decode the (single) question
+        std::string name;
+        size_t pos = 12;
+        while ((pos < query.size()) && (query[pos] != 0)) {
+            const size_t labelLen = static_cast<uint8_t>(query[pos]);
+            if (!name.empty()) {
+                name += ".";
+            }
+            name += query.substr(pos + 1, labelLen);
+            pos += labelLen + 1;
+        }
+
+        pos += 1; // terminating zero
+        if (pos + 4 > query.size()) {
+            return;
+        }
+
+        const int type = (static_cast<uint8_t>(query[pos]) << 8) | static_cast<uint8_t>(query[pos + 1]);
+        const std::string question = query.substr(12, pos + 4 - 12);
+        const auto k = key(name, type);
+        _queryCounts[k]++;
+
+        auto it = _records.find(k);
+        const size_t answerCount = (it == _records.end()) ? 0 : it->second.size();
+
+        std::string reply = query.substr(0, 2); // ID
+        put16(reply, answerCount ? 0x8180 : 0x8183); // response, RD, RA, NXDOMAIN if empty
+        put16(reply, 1);
+        put16(reply, answerCount);
+        put16(reply, 0);
+        put16(reply, 0);
+        reply += question;
+
+        for (size_t i = 0; i < answerCount; ++i) {
+            const Record& r = it->second.at(i);
+            put16(reply, 0xc00c); // pointer to the question name
+            put16(reply, type);
+            put16(reply, 1); // IN
+            put32(reply, r.ttl);
+            put16(reply, r.rdata.size());
+            reply += r.rdata;
+        }
+
+        _socket.sendto(reply.data(), reply.size(), 0, &to);
+    }
+
+    int _port;
+    Socket _socket;
+    std::map<std::string, std::vector<Record>> _records;
+    std::map<std::string, int> _queryCounts;
+};
+
 } // of namespace simgear
 
 #endif // of SIMGEAR_IO_TEST_DNS_HXX
@@ -0,0 +1,213 @@
+#include <simgear_config.h>
+
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+
+#include "DNSClient.hxx"
+#include "test_DNS.hxx"
+
+#include <simgear/debug/logstream.hxx>
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/misc/test_macros.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+using namespace simgear;
+
+namespace {
+
+const char* NAPTR_NAME = "terrasync.test";
+
+void pollUntil(DNS::Client& cl, FakeDNSServer& server, std::function<bool()> done)
+{
+    SGTimeStamp start(SGTimeStamp::now());
+    while (!done()) {
+        if (start.elapsedMSec() > 5000) {
+            cerr << "Failure: timeout." << endl;
+            exit(EXIT_FAILURE);
+        }
+
+        server.poll();
+        cl.update(0);
+        SGTimeStamp::sleepForMSec(5);
+    }
+}
+
+SGSharedPtr<DNS::NAPTRRequest> makeNAPTR(const std::string& service)
+{
+    SGSharedPtr<DNS::NAPTRRequest> r(new DNS::NAPTRRequest(NAPTR_NAME));
+    r->qservice = service;
+    r->qflags = "U";
+    return r;
+}
+
+} // namespace
+
+void testResolveAndCache(DNS::Client& cl, FakeDNSServer& server)
+{
+    auto r = makeNAPTR("https+ws20");
+    cl.makeRequest(r);
+    pollUntil(cl, server, [r]() { return r->isComplete(); });
+
+    SG_CHECK_EQUAL(r->entries.size(), 1);
+    SG_CHECK_EQUAL(r->entries[0]->regexp, "!^.*$!https://a.example.org/!");
+    SG_CHECK_EQUAL(server.queryCount(NAPTR_NAME, FakeDNSServer::TypeNAPTR), 1);
+    SG_CHECK_EQUAL(DNS::Cache::instance()->statistics().misses, 1);
+
+    // different service, same name: answered without a query, and the
+    // filters are applied to the cached records
+    auto r2 = makeNAPTR("ws20");
+    cl.makeRequest(r2);
+    SG_VERIFY(r2->isComplete());
+    SG_CHECK_EQUAL(r2->entries.size(), 2);
+    SG_CHECK_EQUAL(r2->entries[0]->regexp, "!^.*$!http://b.example.org/!");
+    SG_CHECK_EQUAL(r2->entries[1]->regexp, "!^.*$!http://c.example.org/!");
+    SG_VERIFY(r2->ttl > 0);
+    SG_CHECK_EQUAL(server.queryCount(NAPTR_NAME, FakeDNSServer::TypeNAPTR), 1);
+    SG_CHECK_EQUAL(DNS::Cache::instance()->statistics().hits, 1);
+
+    // SRV
+    SGSharedPtr<DNS::SRVRequest> srv(new DNS::SRVRequest("mirror.test", "http", "tcp"));
+    cl.makeRequest(srv);
+    pollUntil(cl, server, [srv]() { return srv->isComplete(); });
+    SG_CHECK_EQUAL(srv->entries.size(), 1);
+    SG_CHECK_EQUAL(srv->entries[0]->port, 8080);
+
+    SGSharedPtr<DNS::SRVRequest> srv2(new DNS::SRVRequest("mirror.test", "http", "tcp"));
+    cl.makeRequest(srv2);
+    SG_VERIFY(srv2->isComplete());
+    SG_CHECK_EQUAL(srv2->entries.size(), 1);
+    SG_CHECK_EQUAL(srv2->entries[0]->target, "mirror1.example.org");
+    SG_CHECK_EQUAL(server.queryCount("_http._tcp.mirror.test", FakeDNSServer::TypeSRV), 1);
+}
+
+void testPrefetch(DNS::Client& cl, FakeDNSServer& server)
+{
+    auto cache = DNS::Cache::instance();
+    const int queriesBefore = server.queryCount(NAPTR_NAME, FakeDNSServer::TypeNAPTR);
+
+    // everything is due for a refresh
+    cache->setPrefetchFraction(1.0);
+    auto r = makeNAPTR("https+ws20");
+    cl.makeRequest(r);
+    SG_VERIFY(r->isComplete());
+    SG_CHECK_EQUAL(r->entries.size(), 1);
+    SG_CHECK_EQUAL(cache->statistics().refreshes, 1);
+
+    pollUntil(cl, server, [&]() {
+        return server.queryCount(NAPTR_NAME, FakeDNSServer::TypeNAPTR) > queriesBefore;
+    });
+
+    cache->setPrefetchFraction(0.1);
+}
+
+void testStaleEntries(DNS::Client& cl, FakeDNSServer& server)
+{
+    auto cache = DNS::Cache::instance();
+    cache->clear();
+
+    DNS::NAPTRRequest::NAPTR_list records;
+    DNS::NAPTRRequest::NAPTR_ptr n(new DNS::NAPTRRequest::NAPTR);
+    n->order = 1;
+    n->preference = 1;
+    n->flags = "U";
+    n->service = "https+ws20";
+    n->regexp = "!^.*$!https://stale.example.org/!";
+    records.push_back(n);
+
+    auto probe = makeNAPTR("");
+    cache->insert(DNS::Cache::keyFor(probe.get()), 1, records, {});
+    SGTimeStamp::sleepForMSec(1100);
+
+    const int queriesBefore = server.queryCount(NAPTR_NAME, FakeDNSServer::TypeNAPTR);
+
+    // expired, but still usable while it is refreshed
+    auto r = makeNAPTR("https+ws20");
+    cl.makeRequest(r);
+    SG_VERIFY(r->isComplete());
+    SG_CHECK_EQUAL(r->entries.size(), 1);
+    SG_CHECK_EQUAL(r->entries[0]->regexp, "!^.*$!https://stale.example.org/!");
+    SG_CHECK_EQUAL(r->ttl, 0);
+    SG_CHECK_EQUAL(cache->statistics().staleHits, 1);
+
+    pollUntil(cl, server, [&]() {
+        return server.queryCount(NAPTR_NAME, FakeDNSServer::TypeNAPTR) > queriesBefore;
+    });
+    for (int i = 0; i < 10; ++i) {
+        server.poll();
+        cl.update(0);
+        SGTimeStamp::sleepForMSec(5);
+    }
+
+    // refreshed from the server
+    auto r2 = makeNAPTR("https+ws20");
+    cl.makeRequest(r2);
+    SG_VERIFY(r2->isComplete());
+    SG_CHECK_EQUAL(r2->entries[0]->regexp, "!^.*$!https://a.example.org/!");
+
+    // stale answers disabled
+    cache->insert(DNS::Cache::keyFor(probe.get()), 1, records, {});
+    cache->setMaxStaleSeconds(0);
+    SGTimeStamp::sleepForMSec(2100);
+    auto r3 = makeNAPTR("https+ws20");
+    cl.makeRequest(r3);
+    SG_VERIFY(!r3->isComplete());
+    pollUntil(cl, server, [r3]() { return r3->isComplete(); });
+    cache->setMaxStaleSeconds(24 * 60 * 60);
+}
+
+void testPersistentCache(DNS::Client& cl, FakeDNSServer& server)
+{
+    auto cache = DNS::Cache::instance();
+    cache->clear();
+
+    Dir tmp = Dir::tempDir("sg_dns_cache");
+    tmp.setRemoveOnDestroy();
+    const SGPath cachePath = tmp.path() / "dns-cache";
+    cache->setPersistentPath(cachePath);
+
+    auto r = makeNAPTR("https+ws20");
+    cl.makeRequest(r);
+    pollUntil(cl, server, [r]() { return r->isComplete(); });
+    SG_VERIFY(cachePath.exists());
+
+    // simulate a restart
+    cache->clear();
+    cache->setPersistentPath(cachePath);
+
+    const int queriesBefore = server.queryCount(NAPTR_NAME, FakeDNSServer::TypeNAPTR);
+    auto r2 = makeNAPTR("ws20");
+    cl.makeRequest(r2);
+    SG_VERIFY(r2->isComplete());
+    SG_CHECK_EQUAL(r2->entries.size(), 2);
+    SG_CHECK_EQUAL(server.queryCount(NAPTR_NAME, FakeDNSServer::TypeNAPTR), queriesBefore);
+
+    cache->setPersistentPath(SGPath());
+}
+
+int main(int argc, char* argv[])
+{
+    simgear::Socket::initSockets();
+
+    FakeDNSServer server;
+    server.addNAPTR(NAPTR_NAME, 3600, 100, 10, "U", "https+ws20", "!^.*$!https://a.example.org/!");
+    server.addNAPTR(NAPTR_NAME, 3600, 100, 20, "U", "ws20", "!^.*$!http://c.example.org/!");
+    server.addNAPTR(NAPTR_NAME, 3600, 100, 10, "U", "ws20", "!^.*$!http://b.example.org/!");
+    server.addSRV("_http._tcp.mirror.test", 3600, 10, 5, 8080, "mirror1.example.org");
+
+    DNS::Client cl;
+    SG_VERIFY(cl.setNameServer("127.0.0.1", server.port()));
+    DNS::Cache::instance()->clear();
+
+    testResolveAndCache(cl, server);
+    testPrefetch(cl, server);
+    testStaleEntries(cl, server);
+    testPersistentCache(cl, server);
+
+    cout << "all tests passed" << endl;
+    return EXIT_SUCCESS;
+}
@@ -4,6 +4,7 @@
 #include <map>
 #include <memory>
 #include <sstream>
+#include <vector>
 #include <cerrno>
 
 #include <simgear/simgear_config.h>
@@ -41,6 +42,9 @@ const char* BODY3 = "Cras ut neque nulla. Duis ut velit neque, sit amet "
 const unsigned int body2Size = 8 * 1024;
 char body2[body2Size];
 
+// paths in the order the test server received them
+std::vector<string> serverRequestPaths;
+
 
 class TestRequest : public HTTP::Request
 {
@@ -89,6 +93,7 @@ public:
 
     virtual void processRequestHeaders()
     {
+        serverRequestPaths.push_back(path);
         if (path == "/test1") {
             string contentStr(BODY1);
             stringstream d;
@@ -845,6 +850,88 @@ cout << "testing proxy close" << endl;
         SG_CHECK_EQUAL(tr->bodyData, string(BODY1));
     }
 
+    {
+        cout << "request priority test" << endl;
+        cl.resetLatencyStatistics();
+        // only one request in flight, so the remainder queue in the client
+        cl.setMaxConnections(1);
+        cl.setMaxPipelineDepth(0);
+        serverRequestPaths.clear();
+
+        std::vector<string> completionOrder;
+        auto track = [&completionOrder](HTTP::Request* r) {
+            completionOrder.push_back(r->path());
+        };
+
+        TestRequest* tr = new TestRequest("http://localhost:2000/test1");
+        HTTP::Request_ptr own(tr);
+        tr->done(track);
+        cl.makeRequest(tr);
+
+        TestRequest* tr2 = new TestRequest("http://localhost:2000/testLorem");
+        HTTP::Request_ptr own2(tr2);
+        tr2->done(track);
+        cl.makeRequest(tr2);
+
+        TestRequest* tr3 = new TestRequest("http://localhost:2000/test_args?foo=abc&bar=1234&username=johndoe");
+        HTTP::Request_ptr own3(tr3);
+        tr3->setPriority(10);
+        tr3->done(track);
+        cl.makeRequest(tr3);
+
+        SG_VERIFY(waitFor(&cl, [tr, tr2, tr3]() {
+            return tr->isComplete() && tr2->isComplete() && tr3->isComplete();
+        }));
+
+        SG_CHECK_EQUAL(completionOrder.size(), 3);
+        SG_CHECK_EQUAL(completionOrder[0], "/test1");
+        SG_CHECK_EQUAL(completionOrder[1], "/test_args");
+        SG_CHECK_EQUAL(completionOrder[2], "/testLorem");
+
+        // the server saw the requests in priority order, not queue order
+        SG_CHECK_EQUAL(serverRequestPaths.size(), 3);
+        SG_CHECK_EQUAL(serverRequestPaths[0], "/test1");
+        SG_CHECK_EQUAL(serverRequestPaths[1], "/test_args");
+        SG_CHECK_EQUAL(serverRequestPaths[2], "/testLorem");
+
+        const auto& latency = cl.latencyStatistics();
+        SG_CHECK_EQUAL(latency.queued.count, 3);
+        SG_CHECK_EQUAL(latency.total.count, 3);
+        SG_CHECK_EQUAL(latency.firstByte.count, 3);
+        SG_VERIFY(latency.total.percentileMSec(100) >= latency.total.meanMSec());
+
+        cl.setMaxPipelineDepth(5);
+    }
+
+    {
+        cout << "HTTP/2 enabled client, HTTP/1.1 server" << endl;
+        HTTP::Client cl2;
+        cl2.setHTTP2Enabled(true);
+        SG_VERIFY(cl2.isHTTP2Enabled());
+
+        TestRequest* tr = new TestRequest("http://localhost:2000/test1");
+        HTTP::Request_ptr own(tr);
+        cl2.makeRequest(tr);
+
+        waitForComplete(&cl2, tr);
+        SG_CHECK_EQUAL(tr->responseCode(), 200);
+        SG_CHECK_EQUAL(tr->bodyData, string(BODY1));
+    }
+
+    {
+        HTTP::Client::LatencyHistogram h;
+        h.addSample(0.5);
+        h.addSample(3.0);
+        h.addSample(3.5);
+        h.addSample(100000.0);
+        SG_CHECK_EQUAL(h.count, 4);
+        SG_CHECK_EQUAL(h.buckets[0], 1);
+        SG_CHECK_EQUAL(h.buckets[2], 2);
+        SG_CHECK_EQUAL(h.buckets[HTTP::Client::LatencyHistogram::BucketCount - 1], 1);
+        SG_CHECK_EQUAL(h.percentileMSec(50), 4.0);
+        SG_CHECK_EQUAL(h.percentileMSec(100), 100000.0);
+    }
+
     cout << "all tests passed ok" << endl;
     return EXIT_SUCCESS;
 }
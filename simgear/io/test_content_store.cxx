@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////
+// Test harness.
+////////////////////////////////////////////////////////////////////////
+
+#include <simgear_config.h>
+#include <simgear/compiler.h>
+
+#include <iostream>
+
+#include "ContentStore.hxx"
+
+#include <simgear/io/iostreams/sgstream.hxx>
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/misc/sg_path.hxx>
+#include <simgear/misc/test_macros.hxx>
+
+using std::cout;
+using std::endl;
+
+using namespace simgear;
+
+namespace {
+
+const std::string hashA = "0a4d55a8d778e5022fab701977c5d840bbc486d0";
+const std::string hashB = "b7c48cbfa44c8d1a3a2e8aa9c0d5a3d6c4c2d7e1";
+
+void writeFile(const SGPath& p, const std::string& content)
+{
+    sg_ofstream f(p, std::ios::out | std::ios::trunc | std::ios::binary);
+    f << content;
+}
+
+std::string readFile(const SGPath& p)
+{
+    sg_ifstream f(p, std::ios::in | std::ios::binary);
+    return f.read_all();
+}
+
+} // namespace
+
+void testInsertAndMaterialize(const SGPath& base)
+{
+    SGPath storeRoot = base / "store";
+    ContentStore store(storeRoot);
+
+    SG_VERIFY(!store.contains(hashA));
+    SG_VERIFY(!store.contains("not-a-hash"));
+
+    const SGPath src = base / "source.txt";
+    writeFile(src, "hello world");
+
+    SG_VERIFY(store.insert(src, hashA));
+    SG_VERIFY(store.contains(hashA));
+    SG_CHECK_EQUAL(store.pathForHash(hashA).dirPath().file(), hashA.substr(0, 2));
+    SG_CHECK_EQUAL(store.statistics().inserted, 1);
+
+    // inserting again is a no-op
+    SG_VERIFY(store.insert(src, hashA));
+    SG_CHECK_EQUAL(store.statistics().inserted, 1);
+
+    // missing content
+    SG_VERIFY(!store.materialize(hashB, base / "missing.txt"));
+
+    // materialize over an existing file
+    const SGPath dest = base / "dest.txt";
+    writeFile(dest, "old contents");
+    SG_VERIFY(store.materialize(hashA, dest, 11));
+    SG_CHECK_EQUAL(readFile(dest), "hello world");
+    SG_CHECK_EQUAL(store.statistics().linked + store.statistics().copied, 1);
+    SG_CHECK_EQUAL(store.statistics().bytesReused, 11);
+
+    // size mismatch discards the blob
+    SG_VERIFY(!store.materialize(hashA, base / "dest2.txt", 99));
+    SG_VERIFY(!store.contains(hashA));
+}
+
+void testGarbageCollection(const SGPath& base)
+{
+    ContentStore store(base / "gc_store");
+
+    const SGPath a = base / "a.txt";
+    const SGPath b = base / "b.txt";
+    writeFile(a, "content A");
+    writeFile(b, "content B");
+    SG_VERIFY(store.insert(a, hashA));
+    SG_VERIFY(store.insert(b, hashB));
+
+    // the blob for A is only referenced by the store once the source has
+    // gone, whereas B is still linked from b.txt
+    SGPath pa = a;
+    pa.remove();
+
+    store.collectGarbage();
+    SG_VERIFY(!store.contains(hashA));
+    SG_VERIFY(store.contains(hashB));
+
+    SGPath pb = b;
+    pb.remove();
+    store.collectGarbage();
+    SG_VERIFY(!store.contains(hashB));
+}
+
+int main(int argc, char* argv[])
+{
+    Dir tmp = Dir::tempDir("sg_content_store");
+    tmp.setRemoveOnDestroy();
+    const SGPath base = tmp.path();
+
+    testInsertAndMaterialize(base);
+    testGarbageCollection(base);
+
+    cout << "all tests passed" << endl;
+    return 0;
+}
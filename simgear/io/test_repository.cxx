@@ -493,6 +493,14 @@ void testUpdateNoChanges(HTTP::Client* cl)
 	verifyRequestCount("dirC", 0);
 	verifyRequestCount("dirC/fileCA", 0);
 
+	// files were hashed during the clone, so the persisted hash cache
+	// should answer most lookups (sub-directory indexes are cached by
+	// the sub-directory itself, so those still get hashed)
+	const auto stats = repo->hashStatistics();
+	if ((stats.cacheHits == 0) || (stats.filesHashed >= stats.cacheHits)) {
+		throw sg_exception("Hash cache was not used");
+	}
+
 	std::cout << "Passed test:no changes update" << std::endl;
 
 }
@@ -546,6 +554,7 @@ void testMergeExistingFileWithoutDownload(HTTP::Client* cl)
 
     repo.reset(new HTTPRepository(p, cl));
     repo->setBaseUrl("http://localhost:2000/repo");
+    repo->setHashThreadCount(4);
 
     createFile(p, "dirC/fileCB", 4); // should match
     createFile(p, "dirC/fileCC", 3); // mismatch
@@ -573,6 +582,10 @@ void testMergeExistingFileWithoutDownload(HTTP::Client* cl)
     verifyRequestCount("dirD/subdirDA/fileDAA", 0);
     verifyRequestCount("dirD/subdirDB/fileDBA", 0);
 
+    if (repo->hashStatistics().filesHashed == 0) {
+        throw sg_exception("Existing files were not hashed");
+    }
+
     std::cout << "Passed test: merge existing files with matching hash" << std::endl;
 }
 
@@ -804,6 +817,78 @@ void testCopyInstalledChildren(HTTP::Client* cl)
     std::cout << "passed Copy installed children" << std::endl;
 }
 
+void testContentStoreShared(HTTP::Client* cl)
+{
+    SGPath storePath(simgear::Dir::current().path());
+    storePath.append("http_repo_content_store");
+    simgear::Dir sd(storePath);
+    if (sd.exists()) {
+        sd.remove(true);
+    }
+
+    SGPath p(simgear::Dir::current().path());
+    p.append("http_repo_store_a");
+    simgear::Dir pd(p);
+    if (pd.exists()) {
+        pd.remove(true);
+    }
+
+    SGPath p2(simgear::Dir::current().path());
+    p2.append("http_repo_store_b");
+    simgear::Dir pd2(p2);
+    if (pd2.exists()) {
+        pd2.remove(true);
+    }
+
+    global_repo->defineFile("dirK/fileKA", 2);
+    global_repo->defineFile("dirK/fileKB", 3);
+    global_repo->clearRequestCounts();
+    global_repo->clearFailFlags();
+
+    std::unique_ptr<HTTPRepository> repo(new HTTPRepository(p, cl));
+    repo->setBaseUrl("http://localhost:2000/repo");
+    repo->setContentStorePath(storePath);
+    repo->update();
+    waitForUpdateComplete(cl, repo.get());
+
+    verifyFileState(p, "dirK/fileKA");
+    verifyRequestCount("dirK/fileKA", 1);
+    verifyRequestCount("fileA", 1);
+
+    // second clone sharing the store only needs the directory indexes
+    global_repo->clearRequestCounts();
+    repo.reset(new HTTPRepository(p2, cl));
+    repo->setBaseUrl("http://localhost:2000/repo");
+    repo->setContentStorePath(storePath);
+    repo->update();
+    waitForUpdateComplete(cl, repo.get());
+
+    verifyFileState(p2, "fileA");
+    verifyFileState(p2, "dirK/fileKA");
+    verifyFileState(p2, "dirK/fileKB");
+    verifyRequestCount("dirK", 1);
+    verifyRequestCount("dirK/fileKA", 0);
+    verifyRequestCount("dirK/fileKB", 0);
+    verifyRequestCount("fileA", 0);
+    if (repo->failure() != HTTPRepository::REPO_NO_ERROR) {
+        throw sg_exception("Clone from content store failed");
+    }
+
+    // a changed file must not modify the copy in the other tree
+    global_repo->findEntry("dirK/fileKA")->revision++;
+    repo->update();
+    waitForUpdateComplete(cl, repo.get());
+    verifyFileState(p2, "dirK/fileKA");
+    verifyRequestCount("dirK/fileKA", 1);
+
+    SGPath oldCopy = p / "dirK" / "fileKA";
+    if (test_computeHashForPath(oldCopy) == global_repo->findEntry("dirK/fileKA")->hash()) {
+        throw sg_exception("Shared content was modified in place");
+    }
+
+    std::cout << "passed content store" << std::endl;
+}
+
 void testRetryAfterSocketFailure(HTTP::Client *cl) {
   global_repo->clearRequestCounts();
   global_repo->clearFailFlags();
@@ -948,6 +1033,7 @@ int main(int argc, char* argv[])
     cl.clearAllConnections();
 
     testCopyInstalledChildren(&cl);
+    testContentStoreShared(&cl);
     testRetryAfterSocketFailure(&cl);
     testPersistentSocketFailure(&cl);
 
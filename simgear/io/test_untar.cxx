@@ -81,6 +81,54 @@ void testExtractStreamed()
 	SG_VERIFY((extractDir / "testDir/foo.txt").exists());
 }
 
+void testExtractThreading()
+{
+    // single-threaded and multi-threaded extraction must produce the
+    // same files, for both tar (write-behind) and zip (parallel inflate)
+    for (const std::string archive : {"test.tar.gz", "zippy.zip"}) {
+        std::string contents[2];
+        for (unsigned int threads : {1u, 4u}) {
+            SGPath p = SGPath(SRC_DIR);
+            p.append(archive);
+
+            SGBinaryFile f(p);
+            f.open(SG_IO_IN);
+
+            SGPath extractDir = simgear::Dir::current().path() / "test_extract_threads";
+            simgear::Dir pd(extractDir);
+            pd.removeChildren();
+
+            ArchiveExtractor ex(extractDir);
+            ex.setThreadCount(threads);
+            SG_CHECK_EQUAL(ex.effectiveThreadCount(), threads);
+
+            uint8_t* buf = (uint8_t*)alloca(128);
+            while (!f.eof()) {
+                size_t bufSize = f.read((char*)buf, 128);
+                ex.extractBytes(buf, bufSize);
+            }
+
+            ex.flush();
+            SG_VERIFY(ex.isAtEndOfArchive());
+            SG_VERIFY(ex.hasError() == false);
+
+            const SGPath checkFile = (archive == "zippy.zip")
+                ? extractDir / "zippy/dirA/hello.c"
+                : extractDir / "testDir/hello.c";
+            SG_VERIFY(checkFile.exists());
+
+            SGBinaryFile cf(checkFile);
+            cf.open(SG_IO_IN);
+            char cbuf[4096];
+            const int len = cf.read(cbuf, sizeof(cbuf));
+            SG_VERIFY(len > 0);
+            contents[threads == 1 ? 0 : 1] = std::string(cbuf, len);
+        }
+
+        SG_CHECK_EQUAL(contents[0], contents[1]);
+    }
+}
+
 void testExtractLocalFile()
 {
 
@@ -210,6 +258,7 @@ int main(int ac, char ** av)
 	testExtractStreamed();
 	testExtractZip();
     testExtractXZ();
+    testExtractThreading();
 
     // disabled to avoiding checking in large PAX archive
     // testPAXAttributes();
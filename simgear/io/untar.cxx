@@ -25,6 +25,13 @@
 #include <cstring>
 #include <cstddef>
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include <zlib.h>
 
@@ -94,6 +101,164 @@ typedef struct
 
     /* tar Header Block, from POSIX 1003.1-1990.  */
 
+    // maximum number of decompressed bytes waiting to be written, before
+    // the extracting thread blocks
+    const size_t WRITE_BEHIND_MAX_QUEUED_BYTES = 8 * 1024 * 1024;
+
+    /**
+     * Performs the file-system side of extraction (creating directories,
+     * writing files) on a background thread, so the thread feeding the
+     * extractor (often the HTTP thread) only has to decompress.
+     */
+    class ArchiveWriteBehind
+    {
+    public:
+        ArchiveWriteBehind()
+        {
+            _thread = std::thread(&ArchiveWriteBehind::run, this);
+        }
+
+        ~ArchiveWriteBehind()
+        {
+            {
+                std::lock_guard<std::mutex> g(_lock);
+                _quit = true;
+            }
+            _workAvailable.notify_one();
+            _thread.join();
+        }
+
+        void createDirectory(const SGPath& p)
+        {
+            push(Operation{Operation::CreateDir, p, 0, {}});
+        }
+
+        void openFile(const SGPath& p, size_t sizeBytes)
+        {
+            push(Operation{Operation::OpenFile, p, sizeBytes, {}});
+        }
+
+        void write(const char* bytes, size_t count)
+        {
+            push(Operation{Operation::Write, SGPath(), 0, std::string(bytes, count)});
+        }
+
+        void closeFile()
+        {
+            push(Operation{Operation::CloseFile, SGPath(), 0, {}});
+        }
+
+        /// block until all queued operations are complete
+        void drain()
+        {
+            std::unique_lock<std::mutex> g(_lock);
+            _spaceAvailable.wait(g, [this] { return _queue.empty() && !_busy; });
+        }
+
+        bool hasError() const
+        {
+            return _error;
+        }
+
+    private:
+        struct Operation {
+            enum Kind {
+                CreateDir,
+                OpenFile,
+                Write,
+                CloseFile
+            };
+
+            Kind kind;
+            SGPath path;
+            size_t sizeBytes;
+            std::string data;
+        };
+
+        void push(Operation&& op)
+        {
+            std::unique_lock<std::mutex> g(_lock);
+            _spaceAvailable.wait(g, [this] {
+                return _queuedBytes < WRITE_BEHIND_MAX_QUEUED_BYTES;
+            });
+
+            _queuedBytes += op.data.size();
+            _queue.push_back(std::move(op));
+            g.unlock();
+            _workAvailable.notify_one();
+        }
+
+        void run()
+        {
+            for (;;) {
+                Operation op;
+                {
+                    std::unique_lock<std::mutex> g(_lock);
+                    _busy = false;
+                    _spaceAvailable.notify_all();
+                    _workAvailable.wait(g, [this] { return _quit || !_queue.empty(); });
+                    if (_queue.empty()) {
+                        return; // quit requested, and all work is done
+                    }
+
+                    op = std::move(_queue.front());
+                    _queue.pop_front();
+                    _queuedBytes -= op.data.size();
+                    _busy = true;
+                }
+
+                perform(op);
+            }
+        }
+
+        void perform(Operation& op)
+        {
+            switch (op.kind) {
+            case Operation::CreateDir: {
+                Dir dir(op.path);
+                dir.create(0755);
+                break;
+            }
+
+            case Operation::OpenFile:
+                _file.reset(new SGBinaryFile(op.path));
+                if (!_file->open(SG_IO_OUT)) {
+                    SG_LOG(SG_IO, SG_WARN, "Untar: unable to create " << op.path);
+                    _file.reset();
+                    _error = true;
+                } else {
+                    // failure is harmless, we just lose the optimisation
+                    _file->preallocate(op.sizeBytes);
+                }
+                break;
+
+            case Operation::Write:
+                if (_file && (_file->write(op.data.data(), op.data.size()) != (int) op.data.size())) {
+                    _error = true;
+                }
+                break;
+
+            case Operation::CloseFile:
+                if (_file) {
+                    _file->close();
+                    _file.reset();
+                }
+                break;
+            }
+        }
+
+        std::thread _thread;
+        std::mutex _lock;
+        std::condition_variable _workAvailable, _spaceAvailable;
+        std::deque<Operation> _queue;
+        size_t _queuedBytes = 0;
+        bool _busy = false;
+        bool _quit = false;
+        std::atomic<bool> _error{false};
+
+        // only touched by the writer thread
+        std::unique_ptr<SGFile> _file;
+    };
 
     class TarExtractorPrivate : public ArchiveExtractorPrivate
     {
@@ -112,9 +277,15 @@ typedef struct
         std::string paxAttributes;
         std::string paxPathName;
 
+        // null if we write on the extracting thread
+        std::unique_ptr<ArchiveWriteBehind> writer;
+
         TarExtractorPrivate(ArchiveExtractor* o) : ArchiveExtractorPrivate(o)
         {
             setState(TarExtractorPrivate::READING_HEADER);
+            if (o->threadCount() != 1) {
+                writer.reset(new ArchiveWriteBehind);
+            }
         }
 
         ~TarExtractorPrivate() = default;
@@ -140,6 +311,8 @@ typedef struct
                 if (currentFile) {
                     currentFile->close();
                     currentFile.reset();
+                } else if (writer && !skipCurrentEntry) {
+                    writer->closeFile();
                 }
                 readPaddingIfRequired();
             } else if (state == READING_HEADER) {
@@ -179,7 +352,14 @@ typedef struct
 
         void flush() override
         {
-            // no-op for tar files, we process everything greedily
+            // we process everything greedily, but the writer thread may
+            // still be busy
+            if (writer) {
+                writer->drain();
+                if (writer->hasError() && (state < ERROR_STATE)) {
+                    state = BAD_DATA;
+                }
+            }
         }
 
         void processHeader()
@@ -222,16 +402,25 @@ typedef struct
             SGPath p = extractRootPath() / tarPath;
             if (header.typeflag == DIRTYPE) {
                 if (!skipCurrentEntry) {
-                    Dir dir(p);
-                    dir.create(0755);
+                    if (writer) {
+                        writer->createDirectory(p);
+                    } else {
+                        Dir dir(p);
+                        dir.create(0755);
+                    }
                 }
                 setState(READING_HEADER);
             } else if ((header.typeflag == REGTYPE) || (header.typeflag == AREGTYPE)) {
                 currentFileSize = ::strtol(header.size, NULL, 8);
                 bytesRemaining = currentFileSize;
                 if (!skipCurrentEntry) {
-                    currentFile.reset(new SGBinaryFile(p));
-                    currentFile->open(SG_IO_OUT);
+                    if (writer) {
+                        writer->openFile(p, currentFileSize);
+                    } else {
+                        currentFile.reset(new SGBinaryFile(p));
+                        currentFile->open(SG_IO_OUT);
+                        currentFile->preallocate(currentFileSize);
+                    }
                 }
                 setState(READING_FILE);
             } else if (header.typeflag == PAX_GLOBAL_HEADER) {
@@ -264,6 +453,8 @@ typedef struct
             if (state == READING_FILE) {
                 if (currentFile) {
                     currentFile->write(bytes, curBytes);
+                } else if (writer && !skipCurrentEntry && (curBytes > 0)) {
+                    writer->write(bytes, curBytes);
                 }
                 bytesRemaining -= curBytes;
             } else if ((state == READING_HEADER) || (state == PRE_END_OF_ARCHVE) || (state == END_OF_ARCHIVE)) {
@@ -478,6 +669,8 @@ public:
         if (ret != LZMA_STREAM_END) {
             setState(BAD_ARCHIVE);
         }
+
+        TarExtractorPrivate::flush();
     }
 
 private:
@@ -517,7 +710,13 @@ public:
 		m_buffer.append((const char*) bytes, count);
 	}
 
-	void flush() override
+	struct ZipEntry {
+		std::string name;
+		size_t sizeBytes;
+		unz_file_pos position;
+	};
+
+	unzFile openZip()
 	{
 		zlib_filefunc_def memoryAccessFuncs;
 		fill_memory_filefunc(&memoryAccessFuncs);
@@ -528,11 +727,19 @@ public:
 #else
 		::snprintf(bufferName, 128, "%p+%lx", m_buffer.data(), m_buffer.size());
 #endif
-		unzFile zip = unzOpen2(bufferName, &memoryAccessFuncs);
+		return unzOpen2(bufferName, &memoryAccessFuncs);
+	}
+
+	void flush() override
+	{
+		unzFile zip = openZip();
 
 		const size_t BUFFER_SIZE = 1024 * 1024;
 		void* buf = malloc(BUFFER_SIZE);
 
+        // walk the central directory first, applying the filter, so the
+        // remaining entries are independent and can be inflated in parallel
+        std::vector<ZipEntry> entries;
         int result = unzGoToFirstFile(zip);
         if (result != UNZ_OK) {
             SG_LOG(SG_IO, SG_ALERT, outer->rootPath() << "failed to go to first file in archive:" << result);
@@ -543,7 +750,7 @@ public:
         }
 
         while (true) {
-            extractCurrentFile(zip, (char*)buf, BUFFER_SIZE);
+            collectCurrentFile(zip, (char*)buf, BUFFER_SIZE, entries);
             if (state == FILTER_STOPPED) {
                 state = END_OF_ARCHIVE;
                 break;
@@ -560,12 +767,18 @@ public:
             }
         }
 
-
         free(buf);
         unzClose(zip);
+
+        if (state == BAD_ARCHIVE) {
+            return;
+        }
+
+        extractEntries(entries);
     }
-    
-    void extractCurrentFile(unzFile zip, char* buffer, size_t bufferSize)
+
+    void collectCurrentFile(unzFile zip, char* buffer, size_t bufferSize,
+                            std::vector<ZipEntry>& entries)
     {
         unz_file_info fileInfo;
         int result = unzGetCurrentFileInfo(zip, &fileInfo,
@@ -575,7 +788,7 @@ public:
         if (result != Z_OK) {
             throw sg_io_exception("Failed to get zip current file info");
         }
-        
+
 		std::string name(buffer);
 		if (!isSafePath(name)) {
             SG_LOG(SG_IO, SG_WARN, "unsafe zip path, skipping::" << name);
@@ -598,39 +811,100 @@ public:
 			return;
 		}
 
-		result = unzOpenCurrentFile(zip);
+        ZipEntry entry;
+        entry.name = name;
+        entry.sizeBytes = fileInfo.uncompressed_size;
+        unzGetFilePos(zip, &entry.position);
+        entries.push_back(entry);
+    }
+
+    void extractEntries(std::vector<ZipEntry>& entries)
+    {
+        const size_t numThreads = std::min<size_t>(outer->effectiveThreadCount(),
+                                                   entries.size());
+        std::atomic<size_t> nextEntry{0};
+        std::exception_ptr firstError;
+        std::mutex errorMutex;
+
+        // each worker uses its own unzFile handle onto the shared buffer
+        auto worker = [&]() {
+            unzFile zip = openZip();
+            const size_t BUFFER_SIZE = 1024 * 1024;
+            std::unique_ptr<char[]> buffer(new char[BUFFER_SIZE]);
+
+            for (;;) {
+                const size_t i = nextEntry++;
+                if (i >= entries.size()) {
+                    break;
+                }
+
+                try {
+                    unzGoToFilePos(zip, &entries[i].position);
+                    extractCurrentFile(zip, entries[i], buffer.get(), BUFFER_SIZE);
+                } catch (...) {
+                    std::lock_guard<std::mutex> g(errorMutex);
+                    if (!firstError) {
+                        firstError = std::current_exception();
+                    }
+                    nextEntry = entries.size(); // stop the other workers too
+                }
+            }
+
+            unzClose(zip);
+        };
+
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < numThreads; ++t) {
+            threads.emplace_back(worker);
+        }
+
+        worker();
+        for (auto& t : threads) {
+            t.join();
+        }
+
+        if (firstError) {
+            std::rethrow_exception(firstError);
+        }
+    }
+
+    void extractCurrentFile(unzFile zip, const ZipEntry& entry, char* buffer, size_t bufferSize)
+    {
+		int result = unzOpenCurrentFile(zip);
 		if (result != UNZ_OK) {
-			throw sg_io_exception("opening current zip file failed", sg_location(name));
+			throw sg_io_exception("opening current zip file failed", sg_location(entry.name));
 		}
 
-		sg_ofstream outFile;
 		bool eof = false;
-		SGPath path = extractRootPath() / name;
+		SGPath path = extractRootPath() / entry.name;
 
-		// create enclosing directory heirarchy as required
+		// create enclosing directory heirarchy as required. Another worker
+		// may be creating the same directory, so re-check on failure.
 		Dir parentDir(path.dir());
 		if (!parentDir.exists()) {
 			bool ok = parentDir.create(0755);
-			if (!ok) {
+			if (!ok && !SGPath(path.dir()).isDir()) {
 				throw sg_io_exception("failed to create directory heirarchy for extraction", path);
 			}
 		}
 
-		outFile.open(path, std::ios::binary | std::ios::trunc | std::ios::out);
-		if (outFile.fail()) {
+		SGBinaryFile outFile(path);
+		if (!outFile.open(SG_IO_OUT)) {
 			throw sg_io_exception("failed to open output file for writing:" + strutils::error_string(errno), path);
 		}
 
+		outFile.preallocate(entry.sizeBytes);
+
 		while (!eof) {
 			int bytes = unzReadCurrentFile(zip, buffer, bufferSize);
 			if (bytes < 0) {
-				throw sg_io_exception("unzip failure reading curent archive", sg_location(name));
+				throw sg_io_exception("unzip failure reading curent archive", sg_location(entry.name));
 			}
 			else if (bytes == 0) {
 				eof = true;
 			}
-			else {
-				outFile.write(buffer, bytes);
+			else if (outFile.write(buffer, bytes) != bytes) {
+				throw sg_io_exception("failed writing extracted file", path);
 			}
 		}
 
@@ -648,6 +922,21 @@ ArchiveExtractor::ArchiveExtractor(const SGPath& rootPath) :
 
 ArchiveExtractor::~ArchiveExtractor() = default;
 
+void ArchiveExtractor::setThreadCount(unsigned int count)
+{
+    _threadCount = count;
+}
+
+unsigned int ArchiveExtractor::effectiveThreadCount() const
+{
+    if (_threadCount > 0) {
+        return _threadCount;
+    }
+
+    const unsigned int hw = std::thread::hardware_concurrency();
+    return std::max(1u, std::min(hw, 4u));
+}
+
 void ArchiveExtractor::extractBytes(const uint8_t* bytes, size_t count)
 {
 	if (!d) {
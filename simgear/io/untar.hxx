@@ -58,6 +58,11 @@ public:
 	 */
     void extractBytes(const uint8_t* bytes, size_t count);
 
+	/**
+	 * @brief complete extraction. Must be called once all bytes have been
+	 * passed to extractBytes(); files are only guaranteed to be on disk
+	 * after this returns.
+	 */
 	void flush();
 
     bool isAtEndOfArchive() const;
@@ -76,6 +81,22 @@ public:
         return _rootPath;
     }
 
+    /**
+     * @brief configure threading, before the first call to extractBytes().
+     * With the default of zero, tar archives are written to disk by a
+     * background thread and zip entries are inflated by several threads in
+     * parallel. One keeps all work on the calling thread. Note filterPath()
+     * is always called on the calling thread.
+     */
+    void setThreadCount(unsigned int count);
+
+    unsigned int threadCount() const
+    {
+        return _threadCount;
+    }
+
+    unsigned int effectiveThreadCount() const;
+
 protected:
 
 
@@ -89,6 +110,7 @@ private:
 	SGPath _rootPath;
 	std::string _prebuffer; // store bytes before type is determined
 	bool _invalidDataType = false;
+	unsigned int _threadCount = 0;
 };
 
 } // of namespace simgear
@@ -36,6 +36,7 @@
 #ifndef SG_MAGVAR_HXX
 #define SG_MAGVAR_HXX
 
+#include <cstddef>
 
 /* Convert date to Julian day    1950-2049 */
 unsigned long int yymmdd_to_julian_days( int yy, int mm, int dd );
@@ -46,5 +47,12 @@ N and E lat and long are positive, S and W negative
 */
 double calc_magvar( double lat, double lon, double h, long dat, double* field );
 
+/* compute the variations (in radians) of count points sharing one (Julian)
+date in one go, the arguments are as for the single point version above.
+field may be NULL, otherwise it receives the 6 field values of each point
+*/
+void calc_magvar( size_t count, const double* lat, const double* lon,
+                  const double* h, long dat, double* var, double* field );
+
 
 #endif // SG_MAGVAR_HXX
@@ -26,8 +26,10 @@
 #endif
 
 
+#include <algorithm>
 #include <cmath>
 
+#include <simgear/constants.h>
 #include <simgear/magvar/magvar.hxx>
 #include <simgear/math/SGMath.hxx>
 
@@ -74,3 +76,177 @@ double sgGetMagVar( const SGGeod& pos, double jd )
     pos.getElevationM(), jd);
 }
 
+void sgGetMagVar( size_t count, const SGGeod* pos, double jd, double* magvar )
+{
+    std::vector<double> lat(count), lon(count), h(count);
+    for ( size_t i = 0; i < count; ++i ) {
+        lat[i] = pos[i].getLatitudeRad();
+        lon[i] = pos[i].getLongitudeRad();
+        h[i] = pos[i].getElevationM() / 1000.0;
+    }
+    calc_magvar( count, lat.data(), lon.data(), h.data(), (long)jd,
+                 magvar, 0 );
+}
+
+
+// differences of two variations into [-pi, pi]
+static inline double wrap_angle( double a ) {
+    if ( a > SGD_PI )
+        return a - SGD_2PI;
+    if ( a < -SGD_PI )
+        return a + SGD_2PI;
+    return a;
+}
+
+SGMagVarGrid::SGMagVarGrid( double jd_, double maxError, double stepDeg,
+                            double minAltM, double maxAltM, double altStepM )
+  : jd(jd_),
+    maxSampleError(0.0),
+    numExactCells(0)
+{
+    int lonCells = std::max(1, int(floor(360.0 / stepDeg + 0.5)));
+    int latCells = std::max(1, int(floor(180.0 / stepDeg + 0.5)));
+    int altCells = std::max(1, int(ceil((maxAltM - minAltM) / altStepM - 1e-6)));
+    nLon = lonCells + 1;
+    nLat = latCells + 1;
+    nAlt = altCells + 1;
+    lonStep = 360.0 / lonCells;
+    latStep = 180.0 / latCells;
+    minAlt = minAltM;
+    altStep = std::max(1.0, maxAltM - minAltM) / altCells;
+
+    // the grid points
+    size_t num = size_t(nLon) * nLat * nAlt;
+    std::vector<double> lat(num), lon(num), h(num), var(num);
+    for ( int k = 0; k < nAlt; ++k ) {
+        for ( int j = 0; j < nLat; ++j ) {
+            for ( int i = 0; i < nLon; ++i ) {
+                size_t n = index(i, j, k);
+                lon[n] = SGD_DEGREES_TO_RADIANS * (-180.0 + i * lonStep);
+                lat[n] = SGD_DEGREES_TO_RADIANS * (-90.0 + j * latStep);
+                h[n] = (minAlt + k * altStep) / 1000.0;
+            }
+        }
+    }
+    calc_magvar( num, lat.data(), lon.data(), h.data(), (long)jd,
+                 var.data(), 0 );
+    values.assign(var.begin(), var.end());
+
+    // check the interpolation at the center and at the middle of the
+    // four edges of the middle altitude of each cell
+    static const double samples[5][3] = {
+        { 0.5, 0.5, 0.5 }, { 0.5, 0.0, 0.5 }, { 0.5, 1.0, 0.5 },
+        { 0.0, 0.5, 0.5 }, { 1.0, 0.5, 0.5 }
+    };
+    std::vector<size_t> cells;
+    lat.clear();
+    lon.clear();
+    h.clear();
+    for ( int k = 0; k < altCells; ++k ) {
+        for ( int j = 0; j < latCells; ++j ) {
+            for ( int i = 0; i < lonCells; ++i ) {
+                cells.push_back(index(i, j, k));
+                for ( unsigned m = 0; m < 5; ++m ) {
+                    lon.push_back(SGD_DEGREES_TO_RADIANS *
+                                  (-180.0 + (i + samples[m][0]) * lonStep));
+                    lat.push_back(SGD_DEGREES_TO_RADIANS *
+                                  (-90.0 + (j + samples[m][1]) * latStep));
+                    h.push_back((minAlt + (k + samples[m][2]) * altStep) / 1000.0);
+                }
+            }
+        }
+    }
+    var.resize(lat.size());
+    calc_magvar( lat.size(), lat.data(), lon.data(), h.data(), (long)jd,
+                 var.data(), 0 );
+
+    exact.assign(num, 0);
+    for ( size_t n = 0; n < cells.size(); ++n ) {
+        double err = 0.0;
+        for ( unsigned m = 0; m < 5; ++m ) {
+            double v = interpolate(cells[n], samples[m]);
+            err = std::max(err, fabs(wrap_angle(v - var[5*n + m])));
+        }
+        if ( err > maxError ) {
+            exact[cells[n]] = 1;
+            ++numExactCells;
+        } else {
+            maxSampleError = std::max(maxSampleError, err);
+        }
+    }
+}
+
+bool SGMagVarGrid::find( const SGGeod& pos, size_t& cell, double w[3] ) const
+{
+    double z = (pos.getElevationM() - minAlt) / altStep;
+    if ( !(0.0 <= z && z <= nAlt - 1) )
+        return false;
+    double lon = SGMiscd::normalizePeriodic(-180.0, 180.0,
+                                            pos.getLongitudeDeg());
+    double x = (lon + 180.0) / lonStep;
+    double y = (SGMiscd::clip(pos.getLatitudeDeg(), -90.0, 90.0) + 90.0) / latStep;
+    int i = std::min(int(x), nLon - 2);
+    int j = std::min(int(y), nLat - 2);
+    int k = std::min(int(z), nAlt - 2);
+    w[0] = x - i;
+    w[1] = y - j;
+    w[2] = z - k;
+    cell = index(i, j, k);
+    return !exact[cell];
+}
+
+double SGMagVarGrid::interpolate( size_t cell, const double w[3] ) const
+{
+    // relative to the first corner, the variation may wrap around
+    // between the corners close to the poles
+    size_t offset[3] = { 1, size_t(nLon), size_t(nLon) * nLat };
+    double v0 = values[cell];
+    double sum = 0.0;
+    for ( unsigned c = 1; c < 8; ++c ) {
+        size_t n = cell;
+        double weight = 1.0;
+        for ( unsigned d = 0; d < 3; ++d ) {
+            if ( c & (1 << d) ) {
+                n += offset[d];
+                weight *= w[d];
+            } else {
+                weight *= 1.0 - w[d];
+            }
+        }
+        sum += weight * wrap_angle(values[n] - v0);
+    }
+    return wrap_angle(v0 + sum);
+}
+
+double SGMagVarGrid::get( const SGGeod& pos ) const
+{
+    size_t cell;
+    double w[3];
+    if ( find(pos, cell, w) )
+        return interpolate(cell, w);
+    return sgGetMagVar(pos, jd);
+}
+
+void SGMagVarGrid::get( size_t count, const SGGeod* pos, double* magvar ) const
+{
+    // interpolate what we can, collect the rest for one batch evaluation
+    std::vector<size_t> model;
+    for ( size_t i = 0; i < count; ++i ) {
+        size_t cell;
+        double w[3];
+        if ( find(pos[i], cell, w) )
+            magvar[i] = interpolate(cell, w);
+        else
+            model.push_back(i);
+    }
+    if ( model.empty() )
+        return;
+
+    std::vector<SGGeod> modelPos(model.size());
+    std::vector<double> modelVar(model.size());
+    for ( size_t i = 0; i < model.size(); ++i )
+        modelPos[i] = pos[model[i]];
+    sgGetMagVar( model.size(), modelPos.data(), jd, modelVar.data() );
+    for ( size_t i = 0; i < model.size(); ++i )
+        magvar[model[i]] = modelVar[i];
+}
@@ -33,6 +33,9 @@
 #endif
 
 
+#include <cstddef>
+#include <vector>
+
 // forward decls
 class SGGeod;
 
@@ -108,4 +111,81 @@ double sgGetMagVar( double lon, double lat, double alt_m, double jd );
  */
 double sgGetMagVar( const SGGeod& pos, double jd );
 
+/**
+ * \relates SGMagVar
+ * Lookup the magvar for many locations at the same date, considerably
+ * cheaper than calling sgGetMagVar() for each of them.
+ * @param count number of positions
+ * @param pos the positions
+ * @param jd julian date
+ * @param magvar receives count variations in radians
+ */
+void sgGetMagVar( size_t count, const SGGeod* pos, double jd, double* magvar );
+
+
+/**
+ * Magnetic variation precomputed on a longitude, latitude and altitude
+ * grid for one date, for bulk lookups like all the navaids or airports
+ * of a scenery load.
+ *
+ * Lookups interpolate between the grid points. When building the grid
+ * the interpolated variation is compared with the model at the center
+ * and at the edge midpoints of each cell. Cells where it is off by more
+ * than the requested error,
+ * which happens close to the magnetic and the geographic poles, as well
+ * as positions outside of the altitude range are computed from the
+ * model instead.
+ */
+class SGMagVarGrid {
+
+public:
+
+    /**
+     * Build the grid.
+     * @param jd julian date
+     * @param maxError largest acceptable interpolation error in radians
+     * @param stepDeg longitude and latitude spacing of the grid points
+     * @param minAltM lowest altitude of the grid in meters
+     * @param maxAltM highest altitude of the grid in meters
+     * @param altStepM altitude spacing of the grid points in meters
+     */
+    SGMagVarGrid( double jd, double maxError = 0.005, double stepDeg = 1,
+                  double minAltM = -1000, double maxAltM = 20000,
+                  double altStepM = 7000 );
+
+    /** @return the magnetic variation at pos in radians. */
+    double get( const SGGeod& pos ) const;
+
+    /** Lookup the magnetic variation in radians of count positions. */
+    void get( size_t count, const SGGeod* pos, double* magvar ) const;
+
+    /** @return the julian date the grid is computed for. */
+    double get_jd() const { return jd; }
+
+    /** @return the largest interpolation error in radians found at the
+        sample points of the interpolated cells. */
+    double get_max_error() const { return maxSampleError; }
+
+    /** @return the number of cells computed from the model. */
+    size_t get_num_exact_cells() const { return numExactCells; }
+
+private:
+
+    bool find( const SGGeod& pos, size_t& cell, double w[3] ) const;
+    double interpolate( size_t cell, const double w[3] ) const;
+    size_t index( int lon, int lat, int alt ) const
+    { return (size_t(alt)*nLat + lat)*nLon + lon; }
+
+    double jd;
+    int nLon, nLat, nAlt;
+    double lonStep, latStep, minAlt, altStep;
+    double maxSampleError;
+    size_t numExactCells;
+
+    /// the variations at the grid points
+    std::vector<float> values;
+    /// non zero for the cells computed from the model
+    std::vector<unsigned char> exact;
+};
+
 #endif // _MAGVAR_HXX
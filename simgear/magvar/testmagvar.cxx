@@ -3,10 +3,139 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <cmath>
+#include <vector>
 
 #include <simgear/constants.h>
+#include <simgear/math/SGMath.hxx>
+#include <simgear/math/sg_random.hxx>
+#include <simgear/timing/timestamp.hxx>
 
 #include "coremag.hxx"
+#include "magvar.hxx"
+
+/* random positions all over the globe, including both poles */
+static std::vector<SGGeod> random_positions(size_t n)
+{
+  std::vector<SGGeod> pos;
+  pos.push_back(SGGeod::fromDegM(0, 90, 0));
+  pos.push_back(SGGeod::fromDegM(0, -90, 0));
+  while (pos.size() < n)
+    pos.push_back(SGGeod::fromDegM(360*sg_random() - 180, 180*sg_random() - 90,
+                                   20000*sg_random()));
+  return pos;
+}
+
+/* the batch version against the single point one */
+static int test_batch(long jd)
+{
+  std::vector<SGGeod> pos = random_positions(1001);
+  size_t n = pos.size();
+  std::vector<double> lat(n), lon(n), h(n), var(n), field(6*n);
+  for (size_t i = 0; i < n; ++i) {
+    lat[i] = pos[i].getLatitudeRad();
+    lon[i] = pos[i].getLongitudeRad();
+    h[i] = pos[i].getElevationM()/1000;
+  }
+  calc_magvar(n, lat.data(), lon.data(), h.data(), jd, var.data(), field.data());
+
+  for (size_t i = 0; i < n; ++i) {
+    double f[6];
+    double v = calc_magvar(lat[i], lon[i], h[i], jd, f);
+    if (fabs(v - var[i]) > 1e-9) {
+      fprintf(stderr, "batch variation %g differs from %g at point %u\n",
+              var[i], v, unsigned(i));
+      return 1;
+    }
+    for (int j = 0; j < 6; ++j) {
+      if (fabs(f[j] - field[6*i + j]) > 1e-6) {
+        fprintf(stderr, "batch field %d %g differs from %g at point %u\n",
+                j, field[6*i + j], f[j], unsigned(i));
+        return 1;
+      }
+    }
+  }
+
+  /* the SGGeod version and a count which is not a multiple of the block */
+  std::vector<double> geodVar(n);
+  sgGetMagVar(n - 3, pos.data(), jd, geodVar.data());
+  for (size_t i = 0; i < n - 3; ++i) {
+    if (fabs(geodVar[i] - sgGetMagVar(pos[i], jd)) > 1e-9) {
+      fprintf(stderr, "sgGetMagVar batch differs at point %u\n", unsigned(i));
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* the grid lookups against the model */
+static int test_grid(long jd)
+{
+  double maxError = 0.005;
+  SGMagVarGrid grid(jd, maxError, 5);
+  if (grid.get_max_error() > maxError) {
+    fprintf(stderr, "grid sample error %g above the bound\n",
+            grid.get_max_error());
+    return 1;
+  }
+
+  std::vector<SGGeod> pos = random_positions(20000);
+  /* below and above the grid altitudes */
+  pos.push_back(SGGeod::fromDegM(10, 50, -2000));
+  pos.push_back(SGGeod::fromDegM(10, 50, 30000));
+  size_t n = pos.size();
+  std::vector<double> var(n);
+  grid.get(n, pos.data(), var.data());
+  double err = 0;
+  for (size_t i = 0; i < n; ++i) {
+    double exact = sgGetMagVar(pos[i], jd);
+    double e = fabs(SGMiscd::normalizeAngle(var[i] - exact));
+    if (e > err)
+      err = e;
+    if (fabs(grid.get(pos[i]) - var[i]) > 1e-9) {
+      fprintf(stderr, "grid single and batch lookup differ at point %u\n",
+              unsigned(i));
+      return 1;
+    }
+  }
+  /* the bound is only checked at sample points, allow some slack */
+  if (err > 2*maxError) {
+    fprintf(stderr, "grid error %g above the bound\n", err);
+    return 1;
+  }
+  fprintf(stdout, "grid: %u of %u cells from the model, max error %g deg\n",
+          unsigned(grid.get_num_exact_cells()),
+          unsigned(72*36*3), SGD_RADIANS_TO_DEGREES * err);
+  return 0;
+}
+
+/* points per second of the different ways */
+static void test_throughput(long jd)
+{
+  std::vector<SGGeod> pos = random_positions(20000);
+  size_t n = pos.size();
+  std::vector<double> var(n);
+  double sum = 0;
+
+  SGTimeStamp stamp = SGTimeStamp::now();
+  for (size_t i = 0; i < n; ++i)
+    sum += sgGetMagVar(pos[i], jd);
+  double single = std::max(1e-6, 1e-6*stamp.elapsedUSec());
+
+  stamp.stamp();
+  sgGetMagVar(n, pos.data(), jd, var.data());
+  double batch = std::max(1e-6, 1e-6*stamp.elapsedUSec());
+
+  stamp.stamp();
+  SGMagVarGrid grid(jd, 0.005, 5);
+  double build = 1e-6*stamp.elapsedUSec();
+
+  stamp.stamp();
+  grid.get(n, pos.data(), var.data());
+  double lookup = std::max(1e-6, 1e-6*stamp.elapsedUSec());
+
+  fprintf(stdout, "points/s: %.0f single, %.0f batch, %.0f grid (%.3fs to build)%s\n",
+          n/single, n/batch, n/lookup, build, sum == 12345 ? " " : "");
+}
 
 
 int main(int argc, char *argv[])
@@ -19,6 +148,17 @@ double lat_deg,lon_deg,h,var;
 int /* model,*/yy,mm,dd;
 double field[6];
 
+if (argc == 1) {
+  /* no arguments, run the self tests */
+  long jd = yymmdd_to_julian_days(18,6,1);
+  sg_srandom(17);
+  if (test_batch(jd) || test_grid(jd))
+    return EXIT_FAILURE;
+  test_throughput(jd);
+  fprintf(stdout, "Successfully passed all tests!\n");
+  return EXIT_SUCCESS;
+}
+
 if ((argc != 8) && (argc !=7)) {
 fprintf(stdout,"Usage: mag lat_deg lon_deg h mm dd yy [model]\n");
 fprintf(stdout,"N latitudes, E longitudes positive degrees, h in km, mm dd yy is date\n");
@@ -19,6 +19,14 @@
 
 #include <cmath>
 
+#if defined(__AVX2__)
+# include <immintrin.h>
+#elif defined(__SSE2__)
+# include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+# include <arm_neon.h>
+#endif
+
 #include <simgear/debug/logstream.hxx>
 #include <simgear/misc/strutils.hxx>
 #include <simgear/sg_inlines.h>
@@ -180,6 +188,183 @@ SGGeodesy::SGGeocToCart(const SGGeoc& geoc, SGVec3<double>& cart)
   cart = geoc.getRadiusM()*SGVec3<double>(clat*clon, clat*slon, slat);
 }
 
+// Batch conversions. The algebraic parts are done on packs of doubles
+// in the widest registers available, with the same operations in the
+// same order as the single point versions above, so the results do not
+// differ. The transcendental functions have no vector versions and are
+// done lane by lane.
+
+namespace {
+
+#if defined(__AVX2__)
+struct Pack {
+  enum { Size = 4 };
+  Pack(__m256d v) : _v(v) {}
+  Pack(double d) : _v(_mm256_set1_pd(d)) {}
+  static Pack load(const double* p) { return _mm256_loadu_pd(p); }
+  void store(double* p) const { _mm256_storeu_pd(p, _v); }
+  friend Pack operator+(Pack a, Pack b) { return _mm256_add_pd(a._v, b._v); }
+  friend Pack operator-(Pack a, Pack b) { return _mm256_sub_pd(a._v, b._v); }
+  friend Pack operator*(Pack a, Pack b) { return _mm256_mul_pd(a._v, b._v); }
+  friend Pack operator/(Pack a, Pack b) { return _mm256_div_pd(a._v, b._v); }
+  friend Pack sqrt(Pack a) { return _mm256_sqrt_pd(a._v); }
+  /// a, but zero where lo <= a <= hi
+  friend Pack zeroInRange(Pack a, double lo, double hi)
+  {
+    __m256d in = _mm256_and_pd(_mm256_cmp_pd(_mm256_set1_pd(lo), a._v, _CMP_LE_OQ),
+                               _mm256_cmp_pd(a._v, _mm256_set1_pd(hi), _CMP_LE_OQ));
+    return _mm256_andnot_pd(in, a._v);
+  }
+  __m256d _v;
+};
+#elif defined(__SSE2__)
+struct Pack {
+  enum { Size = 2 };
+  Pack(__m128d v) : _v(v) {}
+  Pack(double d) : _v(_mm_set1_pd(d)) {}
+  static Pack load(const double* p) { return _mm_loadu_pd(p); }
+  void store(double* p) const { _mm_storeu_pd(p, _v); }
+  friend Pack operator+(Pack a, Pack b) { return _mm_add_pd(a._v, b._v); }
+  friend Pack operator-(Pack a, Pack b) { return _mm_sub_pd(a._v, b._v); }
+  friend Pack operator*(Pack a, Pack b) { return _mm_mul_pd(a._v, b._v); }
+  friend Pack operator/(Pack a, Pack b) { return _mm_div_pd(a._v, b._v); }
+  friend Pack sqrt(Pack a) { return _mm_sqrt_pd(a._v); }
+  friend Pack zeroInRange(Pack a, double lo, double hi)
+  {
+    __m128d in = _mm_and_pd(_mm_cmple_pd(_mm_set1_pd(lo), a._v),
+                            _mm_cmple_pd(a._v, _mm_set1_pd(hi)));
+    return _mm_andnot_pd(in, a._v);
+  }
+  __m128d _v;
+};
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+struct Pack {
+  enum { Size = 2 };
+  Pack(float64x2_t v) : _v(v) {}
+  Pack(double d) : _v(vdupq_n_f64(d)) {}
+  static Pack load(const double* p) { return vld1q_f64(p); }
+  void store(double* p) const { vst1q_f64(p, _v); }
+  friend Pack operator+(Pack a, Pack b) { return vaddq_f64(a._v, b._v); }
+  friend Pack operator-(Pack a, Pack b) { return vsubq_f64(a._v, b._v); }
+  friend Pack operator*(Pack a, Pack b) { return vmulq_f64(a._v, b._v); }
+  friend Pack operator/(Pack a, Pack b) { return vdivq_f64(a._v, b._v); }
+  friend Pack sqrt(Pack a) { return vsqrtq_f64(a._v); }
+  friend Pack zeroInRange(Pack a, double lo, double hi)
+  {
+    uint64x2_t in = vandq_u64(vcleq_f64(vdupq_n_f64(lo), a._v),
+                              vcleq_f64(a._v, vdupq_n_f64(hi)));
+    return vreinterpretq_f64_u64(vbicq_u64(vreinterpretq_u64_f64(a._v), in));
+  }
+  float64x2_t _v;
+};
+#else
+struct Pack {
+  enum { Size = 1 };
+  Pack(double d) : _v(d) {}
+  static Pack load(const double* p) { return *p; }
+  void store(double* p) const { *p = _v; }
+  friend Pack operator+(Pack a, Pack b) { return a._v + b._v; }
+  friend Pack operator-(Pack a, Pack b) { return a._v - b._v; }
+  friend Pack operator*(Pack a, Pack b) { return a._v * b._v; }
+  friend Pack operator/(Pack a, Pack b) { return a._v / b._v; }
+  friend Pack sqrt(Pack a) { return std::sqrt(a._v); }
+  friend Pack zeroInRange(Pack a, double lo, double hi)
+  { return (lo <= a._v && a._v <= hi) ? 0.0 : a._v; }
+  double _v;
+};
+#endif
+
+} // anonymous namespace
+
+void
+SGGeodesy::SGCartToGeod(size_t n, const double* x, const double* y,
+                        const double* z, double* lonRad, double* latRad,
+                        double* elevM)
+{
+  // See the single point version for the algorithm
+  const size_t N = Pack::Size;
+  size_t i = 0;
+  for (; i + N <= n; i += N) {
+    Pack X = Pack::load(x + i);
+    Pack Y = Pack::load(y + i);
+    Pack Z = Pack::load(z + i);
+    Pack XXpYY = X*X+Y*Y;
+    Pack sqrtXXpYY = sqrt(XXpYY);
+    Pack p = XXpYY*ra2;
+    Pack q = Z*Z*(1-e2)*ra2;
+    Pack r = 1/6.0*(p+q-e4);
+    Pack s = e4*p*q/(4*r*r*r);
+    s = zeroInRange(s, -2.0, 0.0);
+
+    double base[N];
+    (1+s+sqrt(s*(2+s))).store(base);
+    for (size_t j = 0; j < N; ++j)
+      base[j] = pow(base[j], 1/3.0);
+    Pack t = Pack::load(base);
+
+    Pack u = r*(1+t+1/t);
+    Pack v = sqrt(u*u+e4*q);
+    Pack w = e2*(u+v-q)/(2*v);
+    Pack k = sqrt(u+v+w*w)-w;
+    Pack D = k*sqrtXXpYY/(k+e2);
+    Pack sqrtDDpZZ = sqrt(D*D+Z*Z);
+    ((k+e2-1)*sqrtDDpZZ/k).store(elevM + i);
+
+    double lonDenom[N], latDenom[N];
+    (X+sqrtXXpYY).store(lonDenom);
+    (D+sqrtDDpZZ).store(latDenom);
+    for (size_t j = 0; j < N; ++j) {
+      size_t l = i + j;
+      if (x[l]*x[l]+y[l]*y[l] + z[l]*z[l] < 25) {
+        lonRad[l] = 0.0;
+        latRad[l] = 0.0;
+        elevM[l] = -EQURAD;
+        continue;
+      }
+      lonRad[l] = 2*atan2(y[l], lonDenom[j]);
+      latRad[l] = 2*atan2(z[l], latDenom[j]);
+    }
+  }
+  for (; i < n; ++i) {
+    SGGeod geod;
+    SGCartToGeod(SGVec3<double>(x[i], y[i], z[i]), geod);
+    lonRad[i] = geod.getLongitudeRad();
+    latRad[i] = geod.getLatitudeRad();
+    elevM[i] = geod.getElevationM();
+  }
+}
+
+void
+SGGeodesy::SGGeodToCart(size_t n, const double* lonRad, const double* latRad,
+                        const double* elevM, double* x, double* y, double* z)
+{
+  const size_t N = Pack::Size;
+  size_t i = 0;
+  for (; i + N <= n; i += N) {
+    double sphi[N], cphi[N], slambda[N], clambda[N];
+    for (size_t j = 0; j < N; ++j) {
+      sphi[j] = sin(latRad[i + j]);
+      cphi[j] = cos(latRad[i + j]);
+      slambda[j] = sin(lonRad[i + j]);
+      clambda[j] = cos(lonRad[i + j]);
+    }
+    Pack h = Pack::load(elevM + i);
+    Pack sp = Pack::load(sphi);
+    Pack cp = Pack::load(cphi);
+    Pack nphi = a/sqrt(1-e2*sp*sp);
+    ((h+nphi)*cp*Pack::load(clambda)).store(x + i);
+    ((h+nphi)*cp*Pack::load(slambda)).store(y + i);
+    ((h+nphi-e2*nphi)*sp).store(z + i);
+  }
+  for (; i < n; ++i) {
+    SGVec3<double> cart;
+    SGGeodToCart(SGGeod::fromRadM(lonRad[i], latRad[i], elevM[i]), cart);
+    x[i] = cart(0);
+    y[i] = cart(1);
+    z[i] = cart(2);
+  }
+}
+
 // Notes:
 //
 // The XYZ/cartesian coordinate system in use puts the X axis through
@@ -467,6 +652,33 @@ SGGeodesy::inverse(const SGGeod& p1, const SGGeod& p2, double& course1,
   return ret == 0;
 }
 
+// The iterations of direct and inverse take a different number of steps
+// for each point, so these are done point by point. The batch versions
+// save the conversions to and from SGGeod.
+bool
+SGGeodesy::direct(size_t n, const double* lonDeg1, const double* latDeg1,
+                  const double* course1, const double* distance,
+                  double* lonDeg2, double* latDeg2, double* course2)
+{
+  bool ok = true;
+  for (size_t i = 0; i < n; ++i)
+    ok &= _geo_direct_wgs_84(latDeg1[i], lonDeg1[i], course1[i], distance[i],
+                             latDeg2 + i, lonDeg2 + i, course2 + i) == 0;
+  return ok;
+}
+
+bool
+SGGeodesy::inverse(size_t n, const double* lonDeg1, const double* latDeg1,
+                   const double* lonDeg2, const double* latDeg2,
+                   double* course1, double* course2, double* distance)
+{
+  bool ok = true;
+  for (size_t i = 0; i < n; ++i)
+    ok &= _geo_inverse_wgs_84(latDeg1[i], lonDeg1[i], latDeg2[i], lonDeg2[i],
+                              course1 + i, course2 + i, distance + i) == 0;
+  return ok;
+}
+
 double
 SGGeodesy::courseDeg(const SGGeod& p1, const SGGeod& p2)
 {
@@ -18,6 +18,8 @@
 #ifndef SGGeodesy_H
 #define SGGeodesy_H
 
+#include <cstddef>
+
 class SGGeodesy {
 public:
   // Hard numbers from the WGS84 standard.
@@ -46,6 +48,19 @@ public:
   /// coordinates.
   static void SGGeocToCart(const SGGeoc& geoc, SGVec3<double>& cart);
 
+  /// Batch versions of the above and of direct() and inverse() for n
+  /// points at once. The arrays hold one coordinate of all points each,
+  /// outputs must not overlap the inputs. The results are the same as
+  /// from the single point versions. Angles are in radians for the
+  /// conversions and in degrees for direct() and inverse(), as in the
+  /// single point versions.
+  static void SGCartToGeod(size_t n, const double* x, const double* y,
+                           const double* z, double* lonRad, double* latRad,
+                           double* elevM);
+  static void SGGeodToCart(size_t n, const double* lonRad,
+                           const double* latRad, const double* elevM,
+                           double* x, double* y, double* z);
+
   // Geodetic course/distance computation
   static bool direct(const SGGeod& p1, double course1,
                      double distance, SGGeod& p2, double& course2);
@@ -58,6 +73,15 @@ public:
   static bool inverse(const SGGeod& p1, const SGGeod& p2, double& course1,
                       double& course2, double& distance);
 
+  /// Batch versions, see the batch SGCartToGeod. Return false if any of
+  /// the points fails.
+  static bool direct(size_t n, const double* lonDeg1, const double* latDeg1,
+                     const double* course1, const double* distance,
+                     double* lonDeg2, double* latDeg2, double* course2);
+  static bool inverse(size_t n, const double* lonDeg1, const double* latDeg1,
+                      const double* lonDeg2, const double* latDeg2,
+                      double* course1, double* course2, double* distance);
+
   static double courseDeg(const SGGeod& from, const SGGeod& to);
   static double distanceM(const SGGeod& from, const SGGeod& to);
   static double distanceNm(const SGGeod& from, const SGGeod& to);
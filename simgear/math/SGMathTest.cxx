@@ -23,11 +23,14 @@
 
 #include <cstdlib>
 #include <iostream>
+#include <vector>
 
 #include "SGMath.hxx"
 #include "SGRect.hxx"
 #include "sg_random.hxx"
 
+#include <simgear/timing/timestamp.hxx>
+
 int lineno = 0;
 
 
@@ -271,6 +274,35 @@ MatrixTest(void)
   if (!equivalent(m3*m0, SGMatrix<T>::unit()))
     { lineno = __LINE__; return false; }
 
+  // The product post multiplies, m4*m5 applies m5 first. The same in
+  // builds with and without the SIMD code.
+  SGMatrix<T> m4 = SGMatrix<T>::unit();
+  m4.postMultRotate(q0);
+  SGMatrix<T> m5 = SGMatrix<T>::unit();
+  m5.postMultTranslate(v0);
+  SGMatrix<T> m6 = m4;
+  m6.postMultTranslate(v0);
+  if (!equivalent(m4*m5, m6))
+    { lineno = __LINE__; return false; }
+  m6 = m4;
+  m6.preMultTranslate(v0);
+  if (!equivalent(m5*m4, m6))
+    { lineno = __LINE__; return false; }
+  SGVec3<T> p0(3, -5, 11);
+  if (!equivalent((m4*m5).xformPt(p0), m4.xformPt(m5.xformPt(p0))))
+    { lineno = __LINE__; return false; }
+  SGMatrix<T> m7(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16);
+  SGMatrix<T> m8;
+  for (unsigned i = 0; i < 4; ++i) {
+    for (unsigned j = 0; j < 4; ++j) {
+      m8(i, j) = 0;
+      for (unsigned k = 0; k < 4; ++k)
+        m8(i, j) += m7(i, k)*m0(k, j);
+    }
+  }
+  if (!equivalent(m7*m0, m8))
+    { lineno = __LINE__; return false; }
+
   return true;
 }
 
@@ -357,6 +389,259 @@ GeodesyTest(void)
   return true;
 }
 
+bool
+GeodesyBatchTest(void)
+{
+  // The batch versions do the same operations in the same order
+  double epsDeg = 10*360*SGLimits<double>::epsilon();
+  double epsM = 10*6e6*SGLimits<double>::epsilon();
+
+  // points all over the globe, the poles, the geocenter and an odd count
+  // to get through the remainder after the full packs
+  std::vector<SGGeod> geods;
+  for (unsigned i = 0; i < 997; ++i)
+    geods.push_back(SGGeod::fromDegM(360*sg_random() - 180, 180*sg_random() - 90,
+                                     40000*sg_random() - 500));
+  geods.push_back(SGGeod::fromDegM(17, 90, 1000));
+  geods.push_back(SGGeod::fromDegM(-30, -90, 0));
+  size_t n = geods.size() + 1;
+
+  std::vector<double> x(n), y(n), z(n), lon(n), lat(n), elev(n);
+  for (size_t i = 0; i < geods.size(); ++i) {
+    SGVec3<double> cart = SGVec3<double>::fromGeod(geods[i]);
+    x[i] = cart(0);
+    y[i] = cart(1);
+    z[i] = cart(2);
+  }
+  x[n - 1] = y[n - 1] = z[n - 1] = 1;
+
+  SGGeodesy::SGCartToGeod(n, x.data(), y.data(), z.data(),
+                          lon.data(), lat.data(), elev.data());
+  for (size_t i = 0; i < n; ++i) {
+    SGGeod geod;
+    SGGeodesy::SGCartToGeod(SGVec3<double>(x[i], y[i], z[i]), geod);
+    if (epsDeg < fabs(geod.getLongitudeRad() - lon[i]) ||
+        epsDeg < fabs(geod.getLatitudeRad() - lat[i]) ||
+        epsM < fabs(geod.getElevationM() - elev[i]))
+      { lineno = __LINE__; return false; }
+  }
+
+  std::vector<double> x1(n), y1(n), z1(n);
+  SGGeodesy::SGGeodToCart(n, lon.data(), lat.data(), elev.data(),
+                          x1.data(), y1.data(), z1.data());
+  for (size_t i = 0; i < n; ++i) {
+    SGVec3<double> cart;
+    SGGeodesy::SGGeodToCart(SGGeod::fromRadM(lon[i], lat[i], elev[i]), cart);
+    if (!equivalent(cart, SGVec3<double>(x1[i], y1[i], z1[i]), 0.0, epsM))
+      { lineno = __LINE__; return false; }
+  }
+
+  // course and distance from each point to the next, the single point
+  // versions do not handle the poles and the geocenter well. The single
+  // point versions get the angles through SGGeod, in radians, so allow
+  // for the rounding.
+  size_t m = n - 3;
+  std::vector<double> lonDeg(m), latDeg(m), course1(m), course2(m), dist(m);
+  for (size_t i = 0; i < m; ++i) {
+    lonDeg[i] = SGMiscd::rad2deg(lon[i]);
+    latDeg[i] = SGMiscd::rad2deg(lat[i]);
+  }
+  if (!SGGeodesy::inverse(m - 1, lonDeg.data(), latDeg.data(),
+                          lonDeg.data() + 1, latDeg.data() + 1,
+                          course1.data(), course2.data(), dist.data()))
+    { lineno = __LINE__; return false; }
+  for (size_t i = 0; i + 1 < m; ++i) {
+    double c1, c2, d;
+    SGGeodesy::inverse(SGGeod::fromDeg(lonDeg[i], latDeg[i]),
+                       SGGeod::fromDeg(lonDeg[i + 1], latDeg[i + 1]), c1, c2, d);
+    if (1e-6 < fabs(c1 - course1[i]) || 1e-6 < fabs(c2 - course2[i]) ||
+        1e-3 < fabs(d - dist[i]))
+      { lineno = __LINE__; return false; }
+  }
+
+  std::vector<double> lonDeg2(m), latDeg2(m), course3(m);
+  SGGeodesy::direct(m - 1, lonDeg.data(), latDeg.data(), course1.data(),
+                    dist.data(), lonDeg2.data(), latDeg2.data(), course3.data());
+  for (size_t i = 0; i + 1 < m; ++i) {
+    SGGeod p2;
+    double c2;
+    SGGeodesy::direct(SGGeod::fromDeg(lonDeg[i], latDeg[i]), course1[i],
+                      dist[i], p2, c2);
+    if (1e-6 < fabs(p2.getLongitudeDeg() - lonDeg2[i]) ||
+        1e-6 < fabs(p2.getLatitudeDeg() - latDeg2[i]) ||
+        1e-6 < fabs(c2 - course3[i]))
+      { lineno = __LINE__; return false; }
+  }
+
+  // nothing to do
+  SGGeodesy::SGCartToGeod(0, 0, 0, 0, 0, 0, 0);
+
+  // throughput, single point vs batch
+  const size_t numPoints = 200000;
+  x.resize(numPoints);
+  y.resize(numPoints);
+  z.resize(numPoints);
+  lon.resize(numPoints);
+  lat.resize(numPoints);
+  elev.resize(numPoints);
+  for (size_t i = 0; i < numPoints; ++i) {
+    const SGGeod& geod = geods[i % geods.size()];
+    SGVec3<double> cart = SGVec3<double>::fromGeod(geod);
+    x[i] = cart(0);
+    y[i] = cart(1);
+    z[i] = cart(2);
+  }
+  SGTimeStamp stamp = SGTimeStamp::now();
+  for (size_t i = 0; i < numPoints; ++i) {
+    SGGeod geod;
+    SGGeodesy::SGCartToGeod(SGVec3<double>(x[i], y[i], z[i]), geod);
+  }
+  double singleSec = std::max(1e-6, 1e-3*stamp.elapsedMSec());
+  stamp.stamp();
+  SGGeodesy::SGCartToGeod(numPoints, x.data(), y.data(), z.data(),
+                          lon.data(), lat.data(), elev.data());
+  double batchSec = std::max(1e-6, 1e-3*stamp.elapsedMSec());
+  std::cout << "cartesian to geodetic: " << unsigned(numPoints/singleSec)
+            << " single vs " << unsigned(numPoints/batchSec)
+            << " batched points/s" << std::endl;
+
+  stamp.stamp();
+  for (size_t i = 0; i < numPoints; ++i) {
+    SGVec3<double> cart;
+    SGGeodesy::SGGeodToCart(SGGeod::fromRadM(lon[i], lat[i], elev[i]), cart);
+  }
+  singleSec = std::max(1e-6, 1e-3*stamp.elapsedMSec());
+  stamp.stamp();
+  SGGeodesy::SGGeodToCart(numPoints, lon.data(), lat.data(), elev.data(),
+                          x.data(), y.data(), z.data());
+  batchSec = std::max(1e-6, 1e-3*stamp.elapsedMSec());
+  std::cout << "geodetic to cartesian: " << unsigned(numPoints/singleSec)
+            << " single vs " << unsigned(numPoints/batchSec)
+            << " batched points/s" << std::endl;
+
+  return true;
+}
+
+template<typename T>
+bool
+SIMDBenchmark(void)
+{
+  // Check the vector and matrix operations against the plain component
+  // wise formulas, then time them with whatever backend simd4_t and
+  // simd4x4_t are compiled with.
+  const unsigned n = 1024;
+  const unsigned repeat = 100;
+  T eps = 100*SGLimits<T>::epsilon();
+
+  std::vector<SGVec3<T> > a(n), b(n);
+  std::vector<SGMatrix<T> > m(n);
+  for (unsigned i = 0; i < n; ++i) {
+    a[i] = SGVec3<T>(2*sg_random() - 1, 2*sg_random() - 1, 2*sg_random() - 1);
+    b[i] = SGVec3<T>(2*sg_random() - 1, 2*sg_random() - 1, 2*sg_random() - 1);
+    SGQuat<T> q = SGQuat<T>::fromAngleAxis(T(3*sg_random()), normalize(a[i]));
+    m[i] = SGMatrix<T>::unit();
+    m[i].postMultTranslate(b[i]);
+    m[i].postMultRotate(q);
+  }
+
+  for (unsigned i = 0; i < n; ++i) {
+    const SGVec3<T>& u = a[i];
+    const SGVec3<T>& v = b[i];
+    SGVec3<T> s = u + v;
+    for (unsigned k = 0; k < 3; ++k)
+      if (eps < fabs(s(k) - (u(k) + v(k))))
+        { lineno = __LINE__; return false; }
+    T d = u(0)*v(0) + u(1)*v(1) + u(2)*v(2);
+    if (eps < fabs(dot(u, v) - d))
+      { lineno = __LINE__; return false; }
+    SGVec3<T> c = cross(u, v);
+    if (eps < fabs(c(0) - (u(1)*v(2) - u(2)*v(1))) ||
+        eps < fabs(c(1) - (u(2)*v(0) - u(0)*v(2))) ||
+        eps < fabs(c(2) - (u(0)*v(1) - u(1)*v(0))))
+      { lineno = __LINE__; return false; }
+    // Division leaves the unused fourth lane undefined, the length and
+    // the dot product must not see it
+    simd4_t<T,3> q = u.simd3()/v.simd3();
+    T q2 = 0;
+    for (unsigned k = 0; k < 3; ++k)
+      q2 += (u(k)/v(k))*(u(k)/v(k));
+    if (eps*q2 < fabs(simd4::magnitude2(q) - q2))
+      { lineno = __LINE__; return false; }
+    if (eps*q2 < fabs(simd4::dot(q, q) - q2))
+      { lineno = __LINE__; return false; }
+
+    const SGMatrix<T>& m1 = m[i];
+    SGVec3<T> x = m1.xformPt(u);
+    for (unsigned r = 0; r < 3; ++r)
+      if (eps < fabs(x(r) - (m1(r, 0)*u(0) + m1(r, 1)*u(1) + m1(r, 2)*u(2)
+                             + m1(r, 3))))
+        { lineno = __LINE__; return false; }
+    simd4x4_t<T,4> t = simd4x4::transpose(m1.simd4x4());
+    for (unsigned r = 0; r < 4; ++r)
+      for (unsigned k = 0; k < 4; ++k)
+        if (t.ptr()[k][r] != m1(k, r))
+          { lineno = __LINE__; return false; }
+  }
+
+  // Some timings of the common operations, the sums keep the optimizer
+  // from dropping the loops
+  T sink = 0;
+  SGVec3<T> vsink = SGVec3<T>::zeros();
+  double ops = double(n)*repeat;
+  // The ISA selection only applies to the double backend
+  std::cout << "simd4 " << sizeof(T)*8 << " bit";
+  if (sizeof(T) == sizeof(double))
+    std::cout << " (" << simd4::double_isa() << ")";
+  std::cout << ":";
+
+  SGTimeStamp stamp = SGTimeStamp::now();
+  for (unsigned j = 0; j < repeat; ++j)
+    for (unsigned i = 0; i < n; ++i)
+      vsink += a[i] + T(0.5)*b[i];
+  std::cout << " add " << 1e3*stamp.elapsedUSec()/ops << "ns";
+
+  stamp.stamp();
+  for (unsigned j = 0; j < repeat; ++j)
+    for (unsigned i = 0; i < n; ++i)
+      sink += dot(a[i], b[i]);
+  std::cout << ", dot " << 1e3*stamp.elapsedUSec()/ops << "ns";
+
+  stamp.stamp();
+  for (unsigned j = 0; j < repeat; ++j)
+    for (unsigned i = 0; i < n; ++i)
+      vsink += cross(a[i], b[i]);
+  std::cout << ", cross " << 1e3*stamp.elapsedUSec()/ops << "ns";
+
+  stamp.stamp();
+  for (unsigned j = 0; j < repeat; ++j)
+    for (unsigned i = 0; i < n; ++i)
+      vsink += normalize(a[i]);
+  std::cout << ", normalize " << 1e3*stamp.elapsedUSec()/ops << "ns";
+
+  stamp.stamp();
+  SGMatrix<T> msink = SGMatrix<T>::unit();
+  for (unsigned j = 0; j < repeat; ++j)
+    for (unsigned i = 0; i < n; ++i)
+      msink += m[i]*m[(i + j) % n];
+  for (unsigned r = 0; r < 4; ++r)
+    for (unsigned k = 0; k < 4; ++k)
+      sink += msink(r, k);
+  std::cout << ", matrix mult " << 1e3*stamp.elapsedUSec()/ops << "ns";
+
+  stamp.stamp();
+  for (unsigned j = 0; j < repeat; ++j)
+    for (unsigned i = 0; i < n; ++i)
+      vsink += m[i].xformPt(b[i]);
+  std::cout << ", transform " << 1e3*stamp.elapsedUSec()/ops << "ns";
+  std::cout << std::endl;
+
+  // Never true, but the compiler does not know
+  if (sink + vsink(0) == T(-12345))
+    std::cout << sink << vsink << std::endl;
+
+  return true;
+}
+
 int
 main(void)
 {
@@ -384,6 +669,12 @@ main(void)
   if (!MatrixTest<double>())
     { fprintf(stderr, "Error at line: %i called from line: %i\n", lineno, __LINE__); return EXIT_FAILURE; }
 
+  // Check and time the vectorized operations
+  if (!SIMDBenchmark<float>())
+    { fprintf(stderr, "Error at line: %i called from line: %i\n", lineno, __LINE__); return EXIT_FAILURE; }
+  if (!SIMDBenchmark<double>())
+    { fprintf(stderr, "Error at line: %i called from line: %i\n", lineno, __LINE__); return EXIT_FAILURE; }
+
   // Do rect tests
   doRectTest<int>();
   doRectTest<double>();
@@ -391,6 +682,8 @@ main(void)
   // Check geodetic/geocentric/cartesian conversions
   if (!GeodesyTest())
     { fprintf(stderr, "Error at line: %i called from line: %i\n", lineno, __LINE__); return EXIT_FAILURE; }
+  if (!GeodesyBatchTest())
+    { fprintf(stderr, "Error at line: %i called from line: %i\n", lineno, __LINE__); return EXIT_FAILURE; }
 
   std::cout << "Successfully passed all tests!" << std::endl;
   return EXIT_SUCCESS;
@@ -568,7 +568,7 @@ inline simd4_t<float,N>abs(simd4_t<float,N> v) {
 # endif
 
 
-# ifdef __AVX_unsupported__
+# ifdef __AVX__
 template<int N>
 class alignas(32) simd4_t<double,N>
 {
@@ -594,10 +594,10 @@ public:
     simd4_t(const simd4_t<double,2>& v) { simd4 = v.v4(); }
     simd4_t(const __m256d& v) { simd4 = v; }
 
-    inline const __m256d (&v4(void) const) {
+    inline const __m256d &v4(void) const {
         return simd4;
     }
-    inline __m256d (&v4(void)) {
+    inline __m256d &v4(void) {
         return simd4;
     }
 
@@ -722,13 +722,14 @@ template<>
 inline simd4_t<double,4>::simd4_t(const __vec4d_t v) {
     simd4 = _mm256_loadu_pd(v);
 }
+// Only load the valid elements, v may point to a shorter array
 template<>
 inline simd4_t<double,3>::simd4_t(const __vec4d_t v) {
-    simd4 = _mm256_and_pd(_mm256_loadu_pd(v), dmask3);
+    simd4 = _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_loadu_pd(v)), _mm_load_sd(v+2), 1);
 }
 template<>
 inline simd4_t<double,2>::simd4_t(const __vec4d_t v) {
-    simd4 = _mm256_and_pd(_mm256_loadu_pd(v), dmask2);
+    simd4 = _mm256_insertf128_pd(_mm256_setzero_pd(), _mm_loadu_pd(v), 0);
 }
 template<>
 inline simd4_t<double,4>::simd4_t(double d) {
@@ -749,7 +750,6 @@ namespace simd4
 inline static double hsum_pd_avx(__m256d v) {
     const __m128d valupper = _mm256_extractf128_pd(v, 1);
     const __m128d vallower = _mm256_castpd256_pd128(v);
-    _mm256_zeroupper();
     const __m128d valval = _mm_add_pd(valupper, vallower);
     const __m128d sums =   _mm_add_pd(_mm_permute_pd(valval,1), valval);
     return                 _mm_cvtsd_f64(sums);
@@ -765,6 +765,18 @@ inline double dot(const simd4_t<double,4>& v1, const simd4_t<double,4>& v2) {
     return hsum_pd_avx(_mm256_mul_pd(v1.v4(),v2.v4()));
 }
 
+// the fourth lane of a simd4_t<double,3> is not guaranteed to be zero
+// after a division, mask it out before the horizontal sum
+template<>
+inline double magnitude2(const simd4_t<double,3>& v) {
+    return hsum_pd_avx(_mm256_and_pd(_mm256_mul_pd(v.v4(),v.v4()), dmask3));
+}
+
+template<>
+inline double dot(const simd4_t<double,3>& v1, const simd4_t<double,3>& v2) {
+    return hsum_pd_avx(_mm256_and_pd(_mm256_mul_pd(v1.v4(),v2.v4()), dmask3));
+}
+
 #  ifdef __AVX2__
 template<>
 inline simd4_t<double,3> cross(const simd4_t<double,3>& v1, const simd4_t<double,3>& v2)
@@ -779,6 +791,24 @@ inline simd4_t<double,3> cross(const simd4_t<double,3>& v1, const simd4_t<double
                      _mm256_permute4x64_pd(v41,_MM_SHUFFLE(3, 1, 0, 2)),
                      _mm256_permute4x64_pd(v42,_MM_SHUFFLE(3, 0, 2, 1))));
 }
+#  else
+// AVX has no lane crossing permute for doubles, build (y,z,x,w) from
+// the in-lane permutes of the vector and of its swapped halves
+inline static __m256d yzxw_pd_avx(__m256d v) {
+    __m256d s = _mm256_permute2f128_pd(v, v, 0x01);
+    return _mm256_blend_pd(_mm256_permute_pd(v, 0x9),
+                           _mm256_permute_pd(s, 0x0), 0x6);
+}
+
+template<>
+inline simd4_t<double,3> cross(const simd4_t<double,3>& v1, const simd4_t<double,3>& v2)
+{
+    // http://threadlocalmutex.com/?p=8
+    __m256d v41 = v1.v4(), v42 = v2.v4();
+    __m256d c = _mm256_sub_pd(_mm256_mul_pd(v41, yzxw_pd_avx(v42)),
+                              _mm256_mul_pd(yzxw_pd_avx(v41), v42));
+    return yzxw_pd_avx(c);
+}
 #  endif
 
 template<int N>
@@ -893,6 +923,7 @@ public:
         __m128d d4 = _mm_set1_pd(d);
         simd4[0] = _mm_sub_pd(simd4[0], d4);
         simd4[1] = _mm_sub_pd(simd4[1], d4);
+        return *this;
     }
     inline simd4_t<double,N>& operator-=(const simd4_t<double,N>& v) {
         simd4[0] = _mm_sub_pd(simd4[0], v.v4()[0]);
@@ -916,6 +947,7 @@ public:
         __m128d d4 = _mm_set1_pd(d);
         simd4[0] = _mm_div_pd(simd4[0], d4);
         simd4[1] = _mm_div_pd(simd4[1], d4);
+        return *this;
     }
     inline simd4_t<double,N>& operator/=(const simd4_t<double,N>& v) {
         simd4[0] = _mm_div_pd(simd4[0], v.v4()[0]);
@@ -1047,6 +1079,24 @@ inline double dot(const simd4_t<double,4>& v1, const simd4_t<double,4>& v2) {
     return hsum_pd_sse(mv);
 }
 
+// the fourth lane of a simd4_t<double,3> is not guaranteed to be zero
+// after a division, mask it out before the horizontal sum
+template<>
+inline double magnitude2(const simd4_t<double,3>& v) {
+    __m128d v2[2];
+    v2[0] = _mm_mul_pd(v.v4()[0],v.v4()[0]);
+    v2[1] = _mm_and_pd(_mm_mul_pd(v.v4()[1],v.v4()[1]), dmask3);
+    return hsum_pd_sse(v2);
+}
+
+template<>
+inline double dot(const simd4_t<double,3>& v1, const simd4_t<double,3>& v2) {
+    __m128d mv[2];
+    mv[0] = _mm_mul_pd(v1.v4()[0],v2.v4()[0]);
+    mv[1] = _mm_and_pd(_mm_mul_pd(v1.v4()[1],v2.v4()[1]), dmask3);
+    return hsum_pd_sse(mv);
+}
+
 template<>
 inline simd4_t<double,3> cross(const simd4_t<double,3>& v1, const simd4_t<double,3>& v2)
 {
@@ -1307,5 +1357,23 @@ inline simd4_t<int,N> max(simd4_t<int,N> v1, const simd4_t<int,N>& v2) {
 
 #endif /* ENABLE_SIMD_CODE */
 
+namespace simd4
+{
+// The instruction set simd4_t<double,N> and simd4x4_t<double,4> are
+// compiled for. The selection is done at compile time by the -mavx/-mavx2
+// (or /arch:AVX2) flags, see the ENABLE_SIMD_AVX build option.
+inline const char* double_isa(void) {
+#if defined(ENABLE_SIMD_CODE) && defined(__AVX2__)
+    return "avx2";
+#elif defined(ENABLE_SIMD_CODE) && defined(__AVX__)
+    return "avx";
+#elif defined(ENABLE_SIMD_CODE) && defined(__SSE2__)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+} /* namespace simd4 */
+
 #endif /* __SIMD_H__ */
 
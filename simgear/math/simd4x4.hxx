@@ -234,25 +234,17 @@ public:
         }
         return *this;
     }
-    simd4x4_t<T,N>& operator*=(const simd4x4_t<T,N>& m1) {
-        simd4x4_t<T,N> m2 = *this;
-        simd4_t<T,N> row;
-        for (int j=0; j<N; ++j) {
-            for (int r=0; r<N; r++) {
-                row[r] = m2.ptr()[r][0];
+    // post multiply, the same as the vectorized specializations
+    simd4x4_t<T,N>& operator*=(const simd4x4_t<T,N>& m2) {
+        simd4x4_t<T,N> m1 = *this;
+        for (int i=0; i<N; ++i) {
+            simd4_t<T,N> col(m1.ptr()[0]);
+            col *= m2.ptr()[i][0];
+            for (int j=1; j<N; ++j) {
+                col += simd4_t<T,N>(m1.ptr()[j]) * m2.ptr()[i][j];
             }
-            row *= m1.ptr()[0][j];
-            for (int r=0; r<N; r++) {
-                mtx[r][j] = row[r];
-            }
-            for (int i=1; i<N; ++i) {
-                for (int r=0; r<N; r++) {
-                    row[r] = m2.ptr()[r][i];
-                }
-                row *= m1.ptr()[i][j];
-                for (int r=0; r<N; r++) {
-                   mtx[r][j] += row[r];
-                }
+            for (int r=0; r<N; ++r) {
+                mtx[i][r] = col[r];
             }
         }
         return *this;
@@ -500,7 +492,7 @@ inline simd4_t<float,3> transform<float>(const simd4x4_t<float,4>& m, const simd
 # endif
 
 
-# ifdef __AVX_unsupported__
+# ifdef __AVX__
 template<>
 class alignas(32) simd4x4_t<double,4>
 {
@@ -751,11 +743,7 @@ public:
         simd4x4[3][1] = _mm_set_pd(m33,m23);
     }
     simd4x4_t(const double m[4*4]) {
-        const double *p = m;
         for (int i=0; i<4; ++i) {
-            simd4_t<double,4> vec4(p);
-            simd4x4[i][0] = vec4.v4()[0]; p += 4;
-            simd4x4[i][1] = vec4.v4()[1];
             simd4x4[i][0] = _mm_loadu_pd((const double*)&m[4*i]);
             simd4x4[i][1] = _mm_loadu_pd((const double*)&m[4*i+2]);
         }
@@ -763,10 +751,8 @@ public:
 
     simd4x4_t(const __mtx4d_t m) {
         for (int i=0; i<4; ++i) {
-            simd4x4[i][0] = simd4_t<double,4>(m[i]).v4()[0];
-            simd4x4[i][1] = simd4_t<double,4>(m[i]).v4()[1];
             simd4x4[i][0] = _mm_loadu_pd(m[i]);
-            simd4x4[i][1] = _mm_loadu_pd(m[i+2]);
+            simd4x4[i][1] = _mm_loadu_pd(m[i]+2);
         }
     }
     simd4x4_t(const simd4x4_t<double,4>& m) {
@@ -0,0 +1,149 @@
+// ListFileReader.cxx -- fast reader for the scenery list files
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <simgear_config.h>
+
+#include "ListFileReader.hxx"
+
+#include <cctype>
+#include <charconv>
+#include <locale>
+#include <sstream>
+
+#include <simgear/io/iostreams/sgstream.hxx>
+#include <simgear/misc/sg_path.hxx>
+
+namespace simgear
+{
+
+ListFileReader::ListFileReader(const SGPath& path) :
+    _pos(0),
+    _open(false)
+{
+    sg_gzifstream stream(path);
+    if (!stream.is_open())
+        return;
+
+    char buffer[65536];
+    while (stream) {
+        stream.read(buffer, sizeof(buffer));
+        _contents.append(buffer, stream.gcount());
+    }
+    _open = true;
+}
+
+bool ListFileReader::nextLine(std::string_view& line)
+{
+    if (_pos >= _contents.size())
+        return false;
+
+    std::string::size_type eol = _contents.find('\n', _pos);
+    if (eol == std::string::npos)
+        eol = _contents.size();
+
+    line = std::string_view(_contents.data() + _pos, eol - _pos);
+    _pos = eol + 1;
+
+    std::string_view::size_type hash_pos = line.find('#');
+    if (hash_pos != std::string_view::npos)
+        line = line.substr(0, hash_pos);
+    return true;
+}
+
+bool NumberScanner::skip()
+{
+    while (_pos != _end && (*_pos == ' ' || *_pos == '\t' || *_pos == '\r' ||
+                            *_pos == '\n' || *_pos == '\v' || *_pos == '\f'))
+        ++_pos;
+    // std::from_chars does not accept the sign an istream does
+    if (_pos != _end && *_pos == '+' && _pos + 1 != _end && *(_pos + 1) != '-')
+        ++_pos;
+    return _pos != _end;
+}
+
+bool NumberScanner::atEnd()
+{
+    return !skip();
+}
+
+namespace
+{
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+template <typename T>
+bool scanNumber(const char*& pos, const char* end, T& v)
+{
+    T value;
+    std::from_chars_result result = std::from_chars(pos, end, value);
+    if (result.ec != std::errc())
+        return false;
+    v = value;
+    pos = result.ptr;
+    return true;
+}
+#else
+// Without floating point std::from_chars fall back to a stream for the token
+template <typename T>
+bool scanNumber(const char*& pos, const char* end, T& v)
+{
+    const char* tokenEnd = pos;
+    while (tokenEnd != end && !std::isspace(static_cast<unsigned char>(*tokenEnd)))
+        ++tokenEnd;
+
+    std::istringstream in(std::string(pos, tokenEnd));
+    in.imbue(std::locale::classic());
+    T value;
+    in >> value;
+    if (in.fail())
+        return false;
+    v = value;
+    pos = in.eof() ? tokenEnd : pos + static_cast<std::ptrdiff_t>(in.tellg());
+    return true;
+}
+
+bool scanNumber(const char*& pos, const char* end, int& v)
+{
+    int value;
+    std::from_chars_result result = std::from_chars(pos, end, value);
+    if (result.ec != std::errc())
+        return false;
+    v = value;
+    pos = result.ptr;
+    return true;
+}
+#endif
+
+}
+
+bool NumberScanner::read(float& v)
+{
+    _fail = _fail || !skip() || !scanNumber(_pos, _end, v);
+    return !_fail;
+}
+
+bool NumberScanner::read(double& v)
+{
+    _fail = _fail || !skip() || !scanNumber(_pos, _end, v);
+    return !_fail;
+}
+
+bool NumberScanner::read(int& v)
+{
+    _fail = _fail || !skip() || !scanNumber(_pos, _end, v);
+    return !_fail;
+}
+
+} // namespace simgear
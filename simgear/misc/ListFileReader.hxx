@@ -0,0 +1,92 @@
+// ListFileReader.hxx -- fast reader for the scenery list files
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef SG_LIST_FILE_READER_HXX
+#define SG_LIST_FILE_READER_HXX
+
+#include <simgear/compiler.h>
+
+#include <string>
+#include <string_view>
+
+class SGPath;
+
+namespace simgear
+{
+
+/**
+ * Reads the text lists of trees, buildings, lights and features that come
+ * with the scenery, optionally gzipped.  The whole file is read at once and
+ * handed out line by line with any # comment stripped, so no string is
+ * allocated per line.
+ */
+class ListFileReader
+{
+public:
+    ListFileReader(const SGPath& path);
+
+    bool is_open() const
+    { return _open; }
+
+    /// The next line without its comment, false at the end of the file.
+    bool nextLine(std::string_view& line);
+
+private:
+    std::string _contents;
+    std::string::size_type _pos;
+    bool _open;
+};
+
+/**
+ * Reads whitespace separated numbers with std::from_chars, in the C locale.
+ * Behaves like reading them from a std::istringstream: a failed read leaves
+ * the value untouched and makes all the following reads fail too.
+ */
+class NumberScanner
+{
+public:
+    NumberScanner(std::string_view text) :
+        _pos(text.data()),
+        _end(text.data() + text.size()),
+        _fail(false)
+    { }
+
+    bool read(float& v);
+    bool read(double& v);
+    bool read(int& v);
+
+    template <typename T, typename... More>
+    bool read(T& v, More&... more)
+    { return read(v) && read(more...); }
+
+    bool fail() const
+    { return _fail; }
+
+    /// True if nothing but whitespace is left.
+    bool atEnd();
+
+private:
+    /// Skips whitespace and a leading '+', false if nothing is left.
+    bool skip();
+
+    const char* _pos;
+    const char* _end;
+    bool _fail;
+};
+
+} // namespace simgear
+
+#endif
@@ -0,0 +1,202 @@
+// -*- coding: utf-8 -*-
+//
+// Unit tests and benchmark for the scenery list file reader
+
+#include <simgear_config.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <simgear/misc/test_macros.hxx>
+#include <simgear/misc/ListFileReader.hxx>
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/misc/sg_path.hxx>
+#include <simgear/io/iostreams/sgstream.hxx>
+
+using simgear::ListFileReader;
+using simgear::NumberScanner;
+
+void test_numbers()
+{
+    float f = 0;
+    double d = 0;
+    int i = 0;
+
+    NumberScanner in(" 1.5\t-2.25e3  +7 12 0.1 ");
+    SG_VERIFY(in.read(f, d, i));
+    SG_CHECK_EQUAL(f, 1.5f);
+    SG_CHECK_EQUAL(d, -2250.0);
+    SG_CHECK_EQUAL(i, 7);
+    SG_VERIFY(in.read(i));
+    SG_CHECK_EQUAL(i, 12);
+    SG_VERIFY(in.read(d));
+    SG_CHECK_EQUAL(d, 0.1);
+    SG_VERIFY(in.atEnd());
+
+    // Reading past the end fails and leaves the value untouched
+    d = 3.0;
+    SG_VERIFY(!in.read(d));
+    SG_CHECK_EQUAL(d, 3.0);
+    SG_VERIFY(in.fail());
+
+    // Like a stream, a failure is sticky
+    NumberScanner bad("1 x 2");
+    SG_VERIFY(bad.read(i));
+    SG_VERIFY(!bad.read(i));
+    SG_VERIFY(!bad.read(i));
+    SG_CHECK_EQUAL(i, 1);
+
+    // Windows line endings are whitespace
+    NumberScanner crlf("4 5\r");
+    SG_VERIFY(crlf.read(i, i));
+    SG_VERIFY(crlf.atEnd());
+}
+
+void test_same_as_stream()
+{
+    const char* lines[] = {
+        "-3.14159265358979 2.718281828 1e-7 -0 123456789.125",
+        "52.5074589 13.3776743 0.000001 179.999999 -89.5",
+        "1 2 3 4 5.5",
+    };
+
+    for (const char* line : lines) {
+        std::istringstream stream(line);
+        NumberScanner scanner(line);
+        double a, b;
+        float fa, fb;
+        while (stream >> a) {
+            SG_VERIFY(scanner.read(b));
+            SG_CHECK_EQUAL(a, b);
+        }
+        SG_VERIFY(scanner.atEnd());
+
+        std::istringstream fstream(line);
+        NumberScanner fscanner(line);
+        while (fstream >> fa) {
+            SG_VERIFY(fscanner.read(fb));
+            SG_CHECK_EQUAL(fa, fb);
+        }
+    }
+}
+
+void test_file(const SGPath& path)
+{
+    ListFileReader reader(path);
+    SG_VERIFY(reader.is_open());
+
+    std::string_view line;
+    SG_VERIFY(reader.nextLine(line));
+    SG_CHECK_EQUAL(std::string(line), "1 2 3 ");
+    SG_VERIFY(reader.nextLine(line));
+    SG_CHECK_EQUAL(std::string(line), "");
+    SG_VERIFY(reader.nextLine(line));
+    SG_CHECK_EQUAL(std::string(line), "");
+    SG_VERIFY(reader.nextLine(line));
+    SG_CHECK_EQUAL(std::string(line), "4 5");
+    SG_VERIFY(!reader.nextLine(line));
+}
+
+void test_files(const simgear::Dir& dir)
+{
+    const char* contents = "1 2 3 # a comment\n# only a comment\n\n4 5";
+
+    SGPath plain = dir.file("plain.txt");
+    {
+        sg_ofstream out(plain);
+        out << contents;
+    }
+    test_file(plain);
+
+    SGPath gzipped = dir.file("gzipped.txt.gz");
+    {
+        sg_gzofstream out(gzipped);
+        out << contents;
+    }
+    test_file(gzipped);
+
+    ListFileReader missing(dir.file("missing.txt"));
+    SG_VERIFY(!missing.is_open());
+}
+
+// Compare reading a building list with the reader and with the
+// std::getline/std::stringstream loop the scenery loaders used.
+void benchmark(const simgear::Dir& dir)
+{
+    SGPath path = dir.file("buildings.txt");
+    {
+        sg_ofstream out(path);
+        std::srand(42);
+        for (int i = 0; i < 50000; ++i) {
+            out << (std::rand() % 200000)/10.0 - 10000.0 << " "
+                << (std::rand() % 200000)/10.0 - 10000.0 << " "
+                << (std::rand() % 20000)/10.0 << " "
+                << (std::rand() % 3600)/10.0 << " " << i % 3 << " "
+                << 10.5 << " " << 8.25 << " " << 6.0 << " " << 0.0 << " "
+                << 2 << " " << 0 << " " << 2 << " " << i % 6 << " " << i % 4
+                << " # building " << i << "\n";
+        }
+    }
+
+    const int passes = 5;
+    double sumStream = 0, sumReader = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; ++pass) {
+        sg_gzifstream stream(path);
+        while (!stream.eof()) {
+            std::string line;
+            std::getline(stream, line);
+            std::string::size_type hash_pos = line.find('#');
+            if (hash_pos != std::string::npos)
+                line.resize(hash_pos);
+            std::stringstream in(line);
+            float x = 0, y = 0, z = 0, r = 0, w = 0, d = 0, h = 0, p = 0;
+            int b = 0, s = 0, o = 0, f = 0, wt = 0, rt = 0;
+            in >> x >> y >> z >> r >> b;
+            if (in.fail())
+                continue;
+            in >> w >> d >> h >> p >> s >> o >> f >> wt >> rt;
+            sumStream += x + y + z + r + b + w + d + h + p + s + o + f + wt + rt;
+        }
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; ++pass) {
+        ListFileReader reader(path);
+        std::string_view line;
+        while (reader.nextLine(line)) {
+            NumberScanner in(line);
+            float x = 0, y = 0, z = 0, r = 0, w = 0, d = 0, h = 0, p = 0;
+            int b = 0, s = 0, o = 0, f = 0, wt = 0, rt = 0;
+            if (!in.read(x, y, z, r, b))
+                continue;
+            in.read(w, d, h, p, s, o, f, wt, rt);
+            sumReader += x + y + z + r + b + w + d + h + p + s + o + f + wt + rt;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    SG_CHECK_EQUAL(sumStream, sumReader);
+
+    double streamTime = std::chrono::duration<double>(middle - start).count();
+    double readerTime = std::chrono::duration<double>(end - middle).count();
+    std::cout << "50000 buildings: stringstream " << passes/streamTime
+              << " files/s, ListFileReader " << passes/readerTime
+              << " files/s" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    simgear::Dir dir = simgear::Dir::tempDir("ListFileReader");
+    dir.setRemoveOnDestroy();
+
+    test_numbers();
+    test_same_as_stream();
+    test_files(dir);
+    benchmark(dir);
+
+    return EXIT_SUCCESS;
+}
@@ -600,21 +600,30 @@ SGMaterialGlyph* SGMaterial::get_glyph (const std::string& name) const
 }
 
 bool SGMaterial::valid(SGVec2f loc) const
+{
+	// Check location first against the areas the material is valid for
+	// before checking against condition
+	if (!valid_area(loc))
+		return false;
+
+	if (condition) {
+		return condition->test();
+	} else {
+		return true;
+	}
+}
+
+bool SGMaterial::valid_area(SGVec2f loc) const
 {
 	SG_LOG( SG_TERRAIN, SG_BULK, "Checking materials for location ("
 			<< loc.x() << ","
 			<< loc.y() << ")");
 
-	// Check location first again the areas the material is valid for
 	AreaList::const_iterator i = areas->begin();
 
 	if (i == areas->end()) {
-		// No areas defined, so simply check against condition
-		if (condition) {
-			return condition->test();
-		} else {
-			return true;
-		}
+		// No areas defined
+		return true;
 	}
 
 	for (; i != areas->end(); i++) {
@@ -625,13 +634,8 @@ bool SGMaterial::valid(SGVec2f loc) const
 				<< i->width() << " height:"
 				<< i->height());
 		// Areas defined, so check that the tile location falls within it
-		// before checking against condition
 		if (i->contains(loc.x(), loc.y())) {
-			if (condition) {
-				return condition->test();
-			} else {
-				return true;
-			}
+			return true;
 		}
 	}
 
@@ -378,6 +378,17 @@ public:
    */
      bool valid(SGVec2f loc) const;
 
+  /**
+   * Whether the tile location is in one of the areas of this material,
+   * or the material has no areas.
+   */
+  bool valid_area(SGVec2f loc) const;
+
+  /**
+   * Get the condition of the region of this material, or 0.
+   */
+  const SGCondition* get_condition() const { return condition; }
+
   /**
    * Return pointer to glyph class, or 0 if it doesn't exist.
    */
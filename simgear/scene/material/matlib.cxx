@@ -30,8 +30,11 @@
 #include <simgear/structure/exception.hxx>
 
 #include <string.h>
+#include <algorithm>
+#include <cstdint>
 #include <string>
 #include <mutex>
+#include <unordered_map>
 #include <utility>
 
 #include <osgDB/ReadFile>
@@ -60,6 +63,85 @@ class SGMaterialLib::MatLibPrivate
 {
 public:
     std::mutex mutex;
+
+    // The edges of all region areas, sorted.  They split the world into
+    // cells, and each area contains either every point of a cell or none.
+    std::vector<float> lonEdges;
+    std::vector<float> latEdges;
+
+    // The distinct region conditions, and their index in that list
+    std::vector<const SGCondition*> conditions;
+    std::unordered_map<const SGCondition*, int> conditionIndex;
+
+    // A material and the index of its condition, or -1
+    typedef std::pair<SGMaterial*, int> Candidate;
+
+    struct Cell {
+        // For each material name, the materials with an area containing
+        // the cell, smallest regions first
+        std::unordered_map<std::string, std::vector<Candidate> > candidates;
+        // The material caches generated for this cell, by the results of
+        // the conditions, without and with texture atlas
+        std::map<std::vector<bool>, osg::ref_ptr<SGMaterialCache> > matCaches[2];
+    };
+    std::unordered_map<uint64_t, Cell> cells;
+
+    static int edgeIndex(const std::vector<float>& edges, float v)
+    {
+        // The areas include their edges, so points on an edge get a cell of
+        // their own
+        std::vector<float>::const_iterator i = std::lower_bound(edges.begin(), edges.end(), v);
+        int index = 2*(i - edges.begin());
+        return (i != edges.end() && *i == v) ? index + 1 : index;
+    }
+
+    // The cell of the location, set up on first use
+    Cell& getCell(const material_map& matlib, SGVec2f center)
+    {
+        uint64_t key = uint64_t(uint32_t(edgeIndex(lonEdges, center.x()))) << 32
+                     | uint32_t(edgeIndex(latEdges, center.y()));
+        std::unordered_map<uint64_t, Cell>::iterator it = cells.find(key);
+        if (it != cells.end())
+            return it->second;
+
+        Cell& cell = cells[key];
+        const_material_map_iterator mit = matlib.begin();
+        for (; mit != matlib.end(); ++mit) {
+            // The materials list is ordered with the smallest regions at the end
+            std::vector<Candidate>& list = cell.candidates[mit->first];
+            material_list::const_reverse_iterator iter = mit->second.rbegin();
+            for (; iter != mit->second.rend(); ++iter) {
+                if (!(*iter)->valid_area(center))
+                    continue;
+                const SGCondition* condition = (*iter)->get_condition();
+                list.push_back(Candidate(*iter, condition ? conditionIndex[condition] : -1));
+            }
+        }
+        return cell;
+    }
+
+    std::vector<bool> testConditions() const
+    {
+        std::vector<bool> results(conditions.size());
+        for (unsigned i = 0; i < conditions.size(); ++i)
+            results[i] = conditions[i]->test();
+        return results;
+    }
+
+    // The first material of that name in the cell whose condition holds
+    SGMaterial* find(const Cell& cell, const std::string& material,
+                     const std::vector<bool>& results) const
+    {
+        std::unordered_map<std::string, std::vector<Candidate> >::const_iterator it;
+        it = cell.candidates.find(material);
+        if (it == cell.candidates.end())
+            return NULL;
+        for (const Candidate& candidate : it->second) {
+            if (candidate.second < 0 || results[candidate.second])
+                return candidate.first;
+        }
+        return NULL;
+    }
 };
 
 // Constructor
@@ -118,6 +200,10 @@ bool SGMaterialLib::load( const SGPath &fg_root, const SGPath& mpath,
 					fabs(x2 - x1),
 					fabs(y2 - y1));
 			arealist->push_back(rect);
+			d->lonEdges.push_back(rect.getMin().x());
+			d->lonEdges.push_back(rect.getMax().x());
+			d->latEdges.push_back(rect.getMin().y());
+			d->latEdges.push_back(rect.getMax().y());
 			SG_LOG( SG_TERRAIN, SG_DEBUG, " Area ("
 					<< rect.x() << ","
 					<< rect.y() << ") width:"
@@ -130,6 +216,10 @@ bool SGMaterialLib::load( const SGPath &fg_root, const SGPath& mpath,
 		SGSharedPtr<const SGCondition> condition;
 		if (conditionNode) {
 			condition = sgReadCondition(prop_root, conditionNode);
+			if (condition) {
+				d->conditionIndex[condition.get()] = d->conditions.size();
+				d->conditions.push_back(condition.get());
+			}
 		}
 
 		// Now build all the materials for this set of areas and conditions
@@ -171,6 +261,12 @@ bool SGMaterialLib::load( const SGPath &fg_root, const SGPath& mpath,
         }
     }
 
+    std::sort(d->lonEdges.begin(), d->lonEdges.end());
+    d->lonEdges.erase(std::unique(d->lonEdges.begin(), d->lonEdges.end()), d->lonEdges.end());
+    std::sort(d->latEdges.begin(), d->latEdges.end());
+    d->latEdges.erase(std::unique(d->latEdges.begin(), d->latEdges.end()), d->latEdges.end());
+    d->cells.clear();
+
     return true;
 }
 
@@ -183,21 +279,17 @@ SGMaterial *SGMaterialLib::find( const string& material, const SGVec2f center )
 
 SGMaterial* SGMaterialLib::internalFind(const string& material, const SGVec2f center) const
 {
-    SGMaterial *result = NULL;
-    const_material_map_iterator it = matlib.find( material );
-    if (it != end()) {
-        // We now have a list of materials that match this
-        // name. Find the first one that matches.
-        // We start at the end of the list, as the materials
-        // list is ordered with the smallest regions at the end.
-        material_list::const_reverse_iterator iter = it->second.rbegin();
-        while (iter != it->second.rend()) {
-            result = *iter;
-            if (result->valid(center)) {
-                return result;
-            }
-            iter++;
-        }
+    // The cell lists the materials of this name whose areas contain the
+    // center, smallest regions first, so only the conditions are left.
+    const MatLibPrivate::Cell& cell = d->getCell(matlib, center);
+    std::unordered_map<std::string, std::vector<MatLibPrivate::Candidate> >::const_iterator it;
+    it = cell.candidates.find(material);
+    if (it == cell.candidates.end())
+        return NULL;
+
+    for (const MatLibPrivate::Candidate& candidate : it->second) {
+        if (candidate.second < 0 || d->conditions[candidate.second]->test())
+            return candidate.first;
     }
 
     return NULL;
@@ -245,23 +337,42 @@ SGMaterial *SGMaterialLib::find( int lc, const SGGeod& center ) const
 
 SGMaterialCache *SGMaterialLib::generateMatCache(SGVec2f center, const simgear::SGReaderWriterOptions* options)
 {
+    // All locations in a cell with the same condition results get the same
+    // materials, so they share one cache.  The texture atlas is only built
+    // for VPB and if there are options to read the textures.
+    bool withAtlas = options && SGSceneFeatures::instance()->getVPBActive();
+    std::vector<bool> results;
+    {
+        std::lock_guard<std::mutex> g(d->mutex);
+        results = d->testConditions();
+        MatLibPrivate::Cell& cell = d->getCell(matlib, center);
+        std::map<std::vector<bool>, osg::ref_ptr<SGMaterialCache> >::const_iterator it;
+        it = cell.matCaches[withAtlas].find(results);
+        if (it != cell.matCaches[withAtlas].end())
+            return it->second.get();
+    }
 
-    SGMaterialCache* newCache = new SGMaterialCache(getMaterialTextureAtlas(center, options));
+    osg::ref_ptr<SGMaterialCache> newCache = new SGMaterialCache(getMaterialTextureAtlas(center, options));
 
     std::lock_guard<std::mutex> g(d->mutex);
+    MatLibPrivate::Cell& cell = d->getCell(matlib, center);
 
     material_map::const_reverse_iterator it = matlib.rbegin();
     for (; it != matlib.rend(); ++it) {
-        newCache->insert(it->first, internalFind(it->first, center));
+        newCache->insert(it->first, d->find(cell, it->first, results));
     }
 
     // Collapse down the mapping from landclasses to materials.
     const_landclass_map_iterator lc_iter = landclasslib.begin();
     for (; lc_iter != landclasslib.end(); ++lc_iter) {
-        newCache->insert(lc_iter->first, internalFind(lc_iter->second.first, center));
+        newCache->insert(lc_iter->first, d->find(cell, lc_iter->second.first, results));
     }
 
-    return newCache;
+    // Another thread may have been quicker
+    osg::ref_ptr<SGMaterialCache>& cached = cell.matCaches[withAtlas][results];
+    if (!cached.valid())
+        cached = newCache;
+    return cached.get();
 }
 
 SGMaterialCache *SGMaterialLib::generateMatCache(SGGeod center, const simgear::SGReaderWriterOptions* options)
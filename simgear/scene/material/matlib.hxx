@@ -146,6 +146,11 @@ public:
      * To fix this, and also avoid repeated re-evaluation of the material
      * conditions, we provide factory method to generate a material library
      * cache of the valid materials based on the current state and a given position.
+     *
+     * The region areas split the world into cells with the same materials,
+     * so the caches are shared by all positions in a cell while the region
+     * conditions give the same results.  The library keeps a reference;
+     * hold the cache in a ref_ptr and never delete it.
      */
 
     SGMaterialCache *generateMatCache( SGVec2f center, const simgear::SGReaderWriterOptions* options);
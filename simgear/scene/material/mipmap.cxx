@@ -27,6 +27,8 @@
 #include <osg/Image>
 #include <osg/Vec4>
 
+#include <simgear/scene/util/ParallelFor.hxx>
+
 namespace simgear { namespace effect {
 
 EffectNameValue<MipMapFunction> mipmapFunctionsInit[] =
@@ -225,6 +227,171 @@ osg::Vec4 computeColor( osg::Vec4 colors[2][2][2], bool colorValid[2][2][2], Mip
     return result;
 }
 
+// Fast paths for the common formats, unsigned byte and float luminance,
+// RGB and RGBA.  Each destination row is computed channel by channel
+// straight from the source rows, with the reduction known at compile time,
+// so the loops are left to the compiler's vectorizer.  The arithmetic is
+// the one of computeColor(), so the result does not change.
+
+struct MipmapAverage {
+    static float init() { return 0; }
+    static float combine( float r, float v ) { return r + v; }
+    static float finish( float r, float nb ) { return r / nb; }
+};
+struct MipmapSum {
+    static float init() { return 0; }
+    static float combine( float r, float v ) { return r + v; }
+    static float finish( float r, float ) { return r; }
+};
+struct MipmapProduct {
+    static float init() { return 1; }
+    static float combine( float r, float v ) { return r * v; }
+    static float finish( float r, float ) { return r; }
+};
+struct MipmapMin {
+    static float init() { return std::numeric_limits<float>::max(); }
+    static float combine( float r, float v ) { return std::min( r, v ); }
+    static float finish( float r, float ) { return r; }
+};
+struct MipmapMax {
+    static float init() { return std::numeric_limits<float>::min(); }
+    static float combine( float r, float v ) { return std::max( r, v ); }
+    static float finish( float r, float ) { return r; }
+};
+
+// One channel of a destination row from the source rows, which are in the
+// order computeColor() visits them.  Columns and Rows are 0 if only known
+// at run time; the common case of 2 and 2 gets its own loop.
+template <typename T, int N, typename Op, int Columns, int Rows>
+void _reduceRow( const T* const rows[4], int numColumns, int numRows, int ns, int c,
+                 float readScale, float writeScale, T* dest )
+{
+    if ( Columns ) numColumns = Columns;
+    if ( Rows ) numRows = Rows;
+    for ( int i = 0; i < ns; ++i )
+    {
+        float r = Op::init();
+        float nb = 0;
+        for ( int di = 0; di < numColumns; ++di )
+            for ( int n = 0; n < numRows; ++n )
+            {
+                r = Op::combine( r, float( rows[n][( 2 * i + di ) * N + c] ) * readScale );
+                nb += 1;
+            }
+        dest[i * N + c] = Op::finish( r, nb ) * writeScale;
+    }
+}
+
+template <typename T, int N, typename Op>
+void _reduceRow( const T* const rows[4], int numColumns, int numRows, int ns, int c,
+                 float readScale, float writeScale, T* dest )
+{
+    if ( numColumns == 2 && numRows == 2 )
+        _reduceRow<T, N, Op, 2, 2>( rows, numColumns, numRows, ns, c, readScale, writeScale, dest );
+    else
+        _reduceRow<T, N, Op, 0, 0>( rows, numColumns, numRows, ns, c, readScale, writeScale, dest );
+}
+
+// A level from the one above, functions holds the function of each
+// channel in memory order
+template <typename T, int N>
+void _computeLevel( const unsigned char* src, unsigned char* dest, int s, int t, int r,
+                    unsigned int srcRowWidth, int ns, int nt, int nr, unsigned int destRowWidth,
+                    const MipMapFunction functions[4], float readScale, float writeScale )
+{
+    int numColumns = s > 1 ? 2 : 1;
+    auto computeRow = [&]( unsigned int row ) {
+        int j = 2 * ( row % nt );
+        int k = 2 * ( row / nt );
+        const T* rows[4];
+        int numRows = 0;
+        for ( int dj = 0; dj < 2 && j + dj < t; ++dj )
+            for ( int dk = 0; dk < 2 && k + dk < r; ++dk )
+                rows[numRows++] = reinterpret_cast<const T*>( src + ( ( k + dk ) * t + j + dj ) * srcRowWidth );
+        T* destRow = reinterpret_cast<T*>( dest + row * destRowWidth );
+        for ( int c = 0; c < N; ++c )
+        {
+            switch ( functions[c] )
+            {
+            case AVERAGE: _reduceRow<T, N, MipmapAverage>( rows, numColumns, numRows, ns, c, readScale, writeScale, destRow ); break;
+            case SUM: _reduceRow<T, N, MipmapSum>( rows, numColumns, numRows, ns, c, readScale, writeScale, destRow ); break;
+            case PRODUCT: _reduceRow<T, N, MipmapProduct>( rows, numColumns, numRows, ns, c, readScale, writeScale, destRow ); break;
+            case MIN: _reduceRow<T, N, MipmapMin>( rows, numColumns, numRows, ns, c, readScale, writeScale, destRow ); break;
+            case MAX: _reduceRow<T, N, MipmapMax>( rows, numColumns, numRows, ns, c, readScale, writeScale, destRow ); break;
+            default:
+                for ( int i = 0; i < ns; ++i )
+                    destRow[i * N + c] = 0;
+                break;
+            }
+        }
+    };
+
+    // Spreading small levels over threads costs more than it gains
+    unsigned int numRows = nt * nr;
+    if ( ns * numRows >= 256 * 256 )
+        parallelFor( numRows, computeRow );
+    else
+        for ( unsigned int row = 0; row < numRows; ++row )
+            computeRow( row );
+}
+
+typedef void (*LevelFunction)( const unsigned char*, unsigned char*, int, int, int, unsigned int,
+                               int, int, int, unsigned int, const MipMapFunction[4], float, float );
+
+// The fast path for the format of the image, or 0.  Fills in the function
+// of each channel in memory order.
+LevelFunction levelFunction( const osg::Image* image, MipMapTuple attrs, MipMapFunction functions[4] )
+{
+    int nbComponents;
+    switch ( image->getPixelFormat() )
+    {
+    case GL_DEPTH_COMPONENT:
+    case GL_LUMINANCE:
+        nbComponents = 1;
+        functions[0] = std::get<0>(attrs);
+        break;
+    case GL_RGB:
+    case GL_RGBA:
+        nbComponents = image->getPixelFormat() == GL_RGB ? 3 : 4;
+        functions[0] = std::get<0>(attrs);
+        functions[1] = std::get<1>(attrs);
+        functions[2] = std::get<2>(attrs);
+        functions[3] = std::get<3>(attrs);
+        break;
+    case GL_BGR:
+    case GL_BGRA:
+        nbComponents = image->getPixelFormat() == GL_BGR ? 3 : 4;
+        functions[0] = std::get<2>(attrs);
+        functions[1] = std::get<1>(attrs);
+        functions[2] = std::get<0>(attrs);
+        functions[3] = std::get<3>(attrs);
+        break;
+    default:
+        return 0;
+    }
+
+    switch ( image->getDataType() )
+    {
+    case GL_UNSIGNED_BYTE:
+        switch ( nbComponents )
+        {
+        case 1: return _computeLevel<unsigned char, 1>;
+        case 3: return _computeLevel<unsigned char, 3>;
+        case 4: return _computeLevel<unsigned char, 4>;
+        }
+        break;
+    case GL_FLOAT:
+        switch ( nbComponents )
+        {
+        case 1: return _computeLevel<float, 1>;
+        case 3: return _computeLevel<float, 3>;
+        case 4: return _computeLevel<float, 4>;
+        }
+        break;
+    }
+    return 0;
+}
+
 void dumpMipmap( std::string n, int s, int t, int r, int c, unsigned char *d, const osg::Image::MipmapDataType &o )
 {
     std::ofstream ofs( (n + ".dump").c_str() );
@@ -307,6 +474,10 @@ osg::Image* computeMipmap( osg::Image* image, MipMapTuple attrs )
         s = image->s();
         t = image->t();
         r = image->r();
+        MipMapFunction functions[4];
+        LevelFunction fastLevel = levelFunction( image, attrs, functions );
+        float readScale = image->getDataType() == GL_FLOAT ? 1.0f : 1.0f/255.0f;
+        float writeScale = image->getDataType() == GL_FLOAT ? 1.0f : 255.0f;
         for ( int m = 0; m < nb-1; ++m )
         {
             unsigned char *src = data;
@@ -319,68 +490,79 @@ osg::Image* computeMipmap( osg::Image* image, MipMapTuple attrs )
             int nt = t >> 1; if ( nt == 0 ) nt = 1;
             int nr = r >> 1; if ( nr == 0 ) nr = 1;
 
-            for ( int k = 0; k < r; k += 2 )
+            if ( fastLevel )
             {
-                for ( int j = 0; j < t; j += 2 )
+                fastLevel( src, dest, s, t, r,
+                           osg::Image::computeRowWidthInBytes( s, image->getPixelFormat(), image->getDataType(), image->getPacking() ),
+                           ns, nt, nr,
+                           osg::Image::computeRowWidthInBytes( ns, image->getPixelFormat(), image->getDataType(), image->getPacking() ),
+                           functions, readScale, writeScale );
+            }
+            else
+            {
+                for ( int k = 0; k < r; k += 2 )
                 {
-                    for ( int i = 0; i < s; i += 2 )
+                    for ( int j = 0; j < t; j += 2 )
                     {
-                        osg::Vec4 colors[2][2][2];
-                        bool colorValid[2][2][2];
-                        colorValid[0][0][0] = false; colorValid[0][0][1] = false; colorValid[0][1][0] = false; colorValid[0][1][1] = false;
-                        colorValid[1][0][0] = false; colorValid[1][0][1] = false; colorValid[1][1][0] = false; colorValid[1][1][1] = false;
-                        if ( true )
-                        {
-                            unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i, j, k );
-                            colors[0][0][0] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
-                            colorValid[0][0][0] = true;
-                        }
-                        if ( i + 1 < s )
+                        for ( int i = 0; i < s; i += 2 )
                         {
-                            unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i + 1, j, k );
-                            colors[0][0][1] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
-                            colorValid[0][0][1] = true;
-                        }
-                        if ( j + 1 < t )
-                        {
-                            unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i, j + 1, k );
-                            colors[0][1][0] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
-                            colorValid[0][1][0] = true;
-                        }
-                        if ( i + 1 < s && j + 1 < t )
-                        {
-                            unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i + 1, j + 1, k );
-                            colors[0][1][1] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
-                            colorValid[0][1][1] = true;
-                        }
-                        if ( k + 1 < r )
-                        {
-                            unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i, j, k + 1 );
-                            colors[1][0][0] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
-                            colorValid[1][0][0] = true;
-                        }
-                        if ( i + 1 < s && k + 1 < r )
-                        {
-                            unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i + 1, j, k + 1 );
-                            colors[1][0][1] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
-                            colorValid[1][0][1] = true;
-                        }
-                        if ( j + 1 < t && k + 1 < r )
-                        {
-                            unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i, j + 1, k + 1 );
-                            colors[1][1][0] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
-                            colorValid[1][1][0] = true;
-                        }
-                        if ( i + 1 < s && j + 1 < t && k + 1 < r )
-                        {
-                            unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i + 1, j + 1, k + 1 );
-                            colors[1][1][1] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
-                            colorValid[1][1][1] = true;
-                        }
+                            osg::Vec4 colors[2][2][2];
+                            bool colorValid[2][2][2];
+                            colorValid[0][0][0] = false; colorValid[0][0][1] = false; colorValid[0][1][0] = false; colorValid[0][1][1] = false;
+                            colorValid[1][0][0] = false; colorValid[1][0][1] = false; colorValid[1][1][0] = false; colorValid[1][1][1] = false;
+                            if ( true )
+                            {
+                                unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i, j, k );
+                                colors[0][0][0] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
+                                colorValid[0][0][0] = true;
+                            }
+                            if ( i + 1 < s )
+                            {
+                                unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i + 1, j, k );
+                                colors[0][0][1] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
+                                colorValid[0][0][1] = true;
+                            }
+                            if ( j + 1 < t )
+                            {
+                                unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i, j + 1, k );
+                                colors[0][1][0] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
+                                colorValid[0][1][0] = true;
+                            }
+                            if ( i + 1 < s && j + 1 < t )
+                            {
+                                unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i + 1, j + 1, k );
+                                colors[0][1][1] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
+                                colorValid[0][1][1] = true;
+                            }
+                            if ( k + 1 < r )
+                            {
+                                unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i, j, k + 1 );
+                                colors[1][0][0] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
+                                colorValid[1][0][0] = true;
+                            }
+                            if ( i + 1 < s && k + 1 < r )
+                            {
+                                unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i + 1, j, k + 1 );
+                                colors[1][0][1] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
+                                colorValid[1][0][1] = true;
+                            }
+                            if ( j + 1 < t && k + 1 < r )
+                            {
+                                unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i, j + 1, k + 1 );
+                                colors[1][1][0] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
+                                colorValid[1][1][0] = true;
+                            }
+                            if ( i + 1 < s && j + 1 < t && k + 1 < r )
+                            {
+                                unsigned char *ptr = imageData( src, image->getPixelFormat(), image->getDataType(), s, t, image->getPacking(), i + 1, j + 1, k + 1 );
+                                colors[1][1][1] = getColor( ptr, image->getPixelFormat(), image->getDataType() );
+                                colorValid[1][1][1] = true;
+                            }
 
-                        unsigned char *ptr = imageData( dest, image->getPixelFormat(), image->getDataType(), ns, nt, image->getPacking(), i/2, j/2, k/2 );
-                        osg::Vec4 color = computeColor( colors, colorValid, attrs, image->getPixelFormat() );
-                        setColor( ptr, image->getPixelFormat(), image->getDataType(), color );
+                            unsigned char *ptr = imageData( dest, image->getPixelFormat(), image->getDataType(), ns, nt, image->getPacking(), i/2, j/2, k/2 );
+                            osg::Vec4 color = computeColor( colors, colorValid, attrs, image->getPixelFormat() );
+                            setColor( ptr, image->getPixelFormat(), image->getDataType(), color );
+                        }
                     }
                 }
             }
@@ -0,0 +1,98 @@
+#include <simgear_config.h>
+#include <simgear/compiler.h>
+#include <simgear/misc/test_macros.hxx>
+
+#include "mipmap.hxx"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <osg/Image>
+
+using namespace simgear::effect;
+
+void test_rgba_float()
+{
+    osg::ref_ptr<osg::Image> image = new osg::Image;
+    image->allocateImage(2, 2, 1, GL_RGBA, GL_FLOAT, 1);
+    const float texels[16] = {
+        0.25f, 0.5f,  0.5f,  0.5f,   0.5f, 0.25f, 0.75f, 0.5f,
+        0.75f, 1.0f,  0.25f, 0.5f,   1.0f, 0.75f, 1.0f,  0.5f
+    };
+    memcpy(image->data(), texels, sizeof(texels));
+
+    osg::ref_ptr<osg::Image> mipmap = computeMipmap(image, MipMapTuple(AVERAGE, MIN, MAX, PRODUCT));
+    SG_CHECK_EQUAL(mipmap->getNumMipmapLevels(), 2);
+    const float* level1 = reinterpret_cast<const float*>(mipmap->getMipmapData(1));
+    SG_CHECK_EQUAL(level1[0], 0.625f);
+    SG_CHECK_EQUAL(level1[1], 0.25f);
+    SG_CHECK_EQUAL(level1[2], 1.0f);
+    SG_CHECK_EQUAL(level1[3], 0.0625f);
+}
+
+void test_bgr_byte()
+{
+    // The functions are given for red, green and blue
+    osg::ref_ptr<osg::Image> image = new osg::Image;
+    image->allocateImage(2, 2, 1, GL_BGR, GL_UNSIGNED_BYTE, 1);
+    const unsigned char texels[12] = {
+        0, 255, 0,     255, 255, 0,
+        255, 0, 255,   255, 255, 0
+    };
+    memcpy(image->data(), texels, sizeof(texels));
+
+    osg::ref_ptr<osg::Image> mipmap = computeMipmap(image, MipMapTuple(MAX, MIN, AVERAGE, AUTOMATIC));
+    const unsigned char* level1 = mipmap->getMipmapData(1);
+    SG_CHECK_EQUAL(int(level1[0]), 191);
+    SG_CHECK_EQUAL(int(level1[1]), 0);
+    SG_CHECK_EQUAL(int(level1[2]), 255);
+}
+
+void test_luminance_levels()
+{
+    // One bright texel survives every level with max
+    osg::ref_ptr<osg::Image> image = new osg::Image;
+    image->allocateImage(8, 4, 1, GL_LUMINANCE, GL_UNSIGNED_BYTE, 4);
+    memset(image->data(), 0, image->getTotalSizeInBytes());
+    image->data(5, 2)[0] = 255;
+
+    osg::ref_ptr<osg::Image> mipmap = computeMipmap(image, MipMapTuple(MAX, AUTOMATIC, AUTOMATIC, AUTOMATIC));
+    SG_CHECK_EQUAL(mipmap->getNumMipmapLevels(), 4);
+    // Level 1 is 4x2 with rows of 4 bytes
+    SG_CHECK_EQUAL(int(mipmap->getMipmapData(1)[1 * 4 + 2]), 255);
+    SG_CHECK_EQUAL(int(mipmap->getMipmapData(1)[1 * 4 + 3]), 0);
+    SG_CHECK_EQUAL(int(mipmap->getMipmapData(2)[0]), 0);
+    SG_CHECK_EQUAL(int(mipmap->getMipmapData(2)[1]), 255);
+    SG_CHECK_EQUAL(int(mipmap->getMipmapData(3)[0]), 255);
+}
+
+void benchmark()
+{
+    for (int size = 256; size <= 4096; size *= 2) {
+        osg::ref_ptr<osg::Image> image = new osg::Image;
+        image->allocateImage(size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE, 1);
+        for (unsigned int i = 0; i < image->getTotalSizeInBytes(); ++i)
+            image->data()[i] = (i * 2654435761u) >> 24;
+
+        auto start = std::chrono::steady_clock::now();
+        osg::ref_ptr<osg::Image> mipmap = computeMipmap(image, MipMapTuple(AVERAGE, AVERAGE, AVERAGE, MAX));
+        auto end = std::chrono::steady_clock::now();
+        std::cout << size << "x" << size << " RGBA8: "
+                  << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+    }
+}
+
+int main (int ac, char ** av)
+{
+    test_rgba_float();
+    test_bgr_byte();
+    test_luminance_levels();
+
+    // Time the mipmaps of a few texture sizes when asked for
+    if (ac > 1 && std::string(av[1]) == "--benchmark")
+        benchmark();
+
+    return 0;
+}
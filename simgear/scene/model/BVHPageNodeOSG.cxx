@@ -33,7 +33,13 @@
 #include <osg/PagedLOD>
 #include <osg/ProxyNode>
 #include <osg/Transform>
+#include <osgDB/FileUtils>
 #include <osgDB/ReadFile>
+#include <osgDB/Registry>
+
+#include <atomic>
+#include <mutex>
+#include <set>
 
 #include <simgear/scene/material/mat.hxx>
 #include <simgear/scene/material/matlib.hxx>
@@ -42,12 +48,79 @@
 #include <simgear/scene/util/SGSceneUserData.hxx>
 #include <simgear/math/SGGeometry.hxx>
 
+#include <simgear/bvh/BVHCacheFile.hxx>
+#include <simgear/bvh/BVHFlatGeometryBuilder.hxx>
 #include <simgear/bvh/BVHStaticGeometryBuilder.hxx>
+#include <simgear/misc/sg_hash.hxx>
+#include <simgear/misc/strutils.hxx>
+#include <simgear/scene/util/SGReaderWriterOptions.hxx>
 
 #include "PrimitiveCollector.hxx"
 
 namespace simgear {
 
+namespace {
+
+std::mutex _cacheDirectoryMutex;
+SGPath _cacheDirectory;
+std::atomic<bool> _compressGeometry(false);
+
+// One cache file per model file
+SGPath
+cacheFilePath(const SGPath& cacheDirectory, const std::string& fileName)
+{
+    sha1nfo info;
+    sha1_init(&info);
+    sha1_write(&info, fileName.data(), fileName.size());
+    return cacheDirectory / (strutils::encodeHex(sha1_result(&info), HASH_LENGTH) + ".bvh");
+}
+
+// Records the data files found while a model is loaded, the cache file
+// keeps their size and modification time to notice changes. Files served
+// from the osgDB object cache are not looked up again and not recorded,
+// material properties are looked up by name when a tree is read.
+class SourceRecorder : public osgDB::FindFileCallback {
+public:
+    SourceRecorder(osgDB::FindFileCallback* next) :
+        _next(next)
+    { }
+
+    virtual std::string findDataFile(const std::string& filename,
+                                     const osgDB::Options* options,
+                                     osgDB::CaseSensitivity caseSensitivity)
+    {
+        std::string fileName;
+        if (_next.valid())
+            fileName = _next->findDataFile(filename, options, caseSensitivity);
+        else
+            fileName = osgDB::Registry::instance()->findDataFileImplementation(filename, options, caseSensitivity);
+        if (!fileName.empty()) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _fileNames.insert(fileName);
+        }
+        return fileName;
+    }
+
+    BVHCacheFile::PathList getSources() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        BVHCacheFile::PathList sources;
+        for (const std::string& fileName : _fileNames) {
+            SGPath path = SGPath::fromUtf8(fileName);
+            if (path.isFile())
+                sources.push_back(path);
+        }
+        return sources;
+    }
+
+private:
+    osg::ref_ptr<osgDB::FindFileCallback> _next;
+    mutable std::mutex _mutex;
+    std::set<std::string> _fileNames;
+};
+
+}
+
 class BVHPageNodeOSG::_NodeVisitor : public osg::NodeVisitor {
 public:
     struct _PrimitiveCollector : public PrimitiveCollector {
@@ -113,9 +186,14 @@ public:
     _NodeVisitor(bool flatten, const osg::Matrix& localToWorldMatrix = osg::Matrix()) :
         osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ACTIVE_CHILDREN),
         _localToWorldMatrix(localToWorldMatrix),
-        _geometryBuilder(new BVHStaticGeometryBuilder),
         _flatten(flatten)
     {
+        if (_compressGeometry) {
+            _flatGeometryBuilder = new BVHFlatGeometryBuilder;
+            _flatGeometryBuilder->setCompressed(true);
+        } else {
+            _geometryBuilder = new BVHStaticGeometryBuilder;
+        }
         setTraversalMask(SG_NODEMASK_TERRAIN_BIT);
     }
     virtual ~_NodeVisitor()
@@ -124,9 +202,27 @@ public:
 
     void addTriangle(const osg::Vec3d& v1, const osg::Vec3d& v2, const osg::Vec3d& v3)
     {
-        _geometryBuilder->addTriangle(toVec3f(toSG(_localToWorldMatrix.preMult(v1))),
-                                      toVec3f(toSG(_localToWorldMatrix.preMult(v2))),
-                                      toVec3f(toSG(_localToWorldMatrix.preMult(v3))));
+        SGVec3f w1 = toVec3f(toSG(_localToWorldMatrix.preMult(v1)));
+        SGVec3f w2 = toVec3f(toSG(_localToWorldMatrix.preMult(v2)));
+        SGVec3f w3 = toVec3f(toSG(_localToWorldMatrix.preMult(v3)));
+        if (_flatGeometryBuilder.valid())
+            _flatGeometryBuilder->addTriangle(w1, w2, w3);
+        else
+            _geometryBuilder->addTriangle(w1, w2, w3);
+    }
+
+    const BVHMaterial* getCurrentMaterial() const
+    {
+        if (_flatGeometryBuilder.valid())
+            return _flatGeometryBuilder->getCurrentMaterial();
+        return _geometryBuilder->getCurrentMaterial();
+    }
+    void setCurrentMaterial(const BVHMaterial* material)
+    {
+        if (_flatGeometryBuilder.valid())
+            _flatGeometryBuilder->setCurrentMaterial(material);
+        else
+            _geometryBuilder->setCurrentMaterial(material);
     }
 
     void setCenter(const osg::Vec3& center)
@@ -143,15 +239,15 @@ public:
 
     virtual void apply(osg::Geode& geode)
     {
-        const BVHMaterial* oldMaterial = _geometryBuilder->getCurrentMaterial();
+        const BVHMaterial* oldMaterial = getCurrentMaterial();
         if (const BVHMaterial* material = SGMaterialLib::findMaterial(&geode))
-            _geometryBuilder->setCurrentMaterial(material);
+            setCurrentMaterial(material);
 
         _PrimitiveCollector primitiveCollector(*this);
         for(unsigned i = 0; i < geode.getNumDrawables(); ++i)
             geode.getDrawable(i)->accept(primitiveCollector);
 
-        _geometryBuilder->setCurrentMaterial(oldMaterial);
+        setCurrentMaterial(oldMaterial);
     }
 
     virtual void apply(osg::Node& node)
@@ -290,9 +386,14 @@ public:
     {
         // Flush any pendig leaf nodes
         if (_geometryBuilder.valid()) {
-            _nodeBin.addNode(_geometryBuilder->buildTree());
+            _nodeBin.addNode(_geometryBuilder->buildTree(BVHPager::getBuildThreads()));
             _geometryBuilder.clear();
         }
+        if (_flatGeometryBuilder.valid()) {
+            _flatGeometryBuilder->setNumThreads(BVHPager::getBuildThreads());
+            _nodeBin.addNode(_flatGeometryBuilder->buildTree());
+            _flatGeometryBuilder.clear();
+        }
 
         return _nodeBin.getNode(matrix*_centerMatrix);
     }
@@ -308,6 +409,7 @@ private:
     _NodeBin _nodeBin;
 
     SGSharedPtr<BVHStaticGeometryBuilder> _geometryBuilder;
+    SGSharedPtr<BVHFlatGeometryBuilder> _flatGeometryBuilder;
 
     bool _flatten;
 };
@@ -353,8 +455,56 @@ private:
 SGSharedPtr<BVHNode>
 BVHPageNodeOSG::load(const std::string& name, const osg::ref_ptr<const osg::Referenced>& options)
 {
+    const osgDB::Options* osgOptions = dynamic_cast<const osgDB::Options*>(options.get());
+
+    // Try the tree built in an earlier session. The cache file is valid
+    // as long as the files read to build it did not change.
+    SGPath cacheDirectory = getCacheDirectory();
+    SGPath cachePath;
+    std::string sourceFile;
+    if (!cacheDirectory.isNull()) {
+        std::string fileName = osgDB::findDataFile(name, osgOptions);
+        if (!fileName.empty()) {
+            cachePath = cacheFilePath(cacheDirectory, fileName);
+            sourceFile = fileName;
+        }
+    }
+    if (!sourceFile.empty()) {
+        const SGReaderWriterOptions* sgOptions;
+        sgOptions = dynamic_cast<const SGReaderWriterOptions*>(options.get());
+        SGMaterialLibPtr matlib = sgOptions ? sgOptions->getMaterialLib() : SGMaterialLibPtr();
+        auto materialLookup = [&](const std::string& materialName) -> const BVHMaterial* {
+            if (!matlib)
+                return 0;
+            return matlib->find(materialName, sgOptions->getLocation());
+        };
+        // The cache file is named by a hash of the file name, the full
+        // name as the source key guards against collisions
+        SGSharedPtr<BVHNode> cached;
+        cached = BVHCacheFile::read(cachePath, sourceFile, materialLookup);
+        if (cached.valid())
+            return cached;
+    }
+
+    // Note the files the loaders find
+    osg::ref_ptr<SourceRecorder> sourceRecorder;
+    osg::ref_ptr<osgDB::Options> recordingOptions;
+    if (!sourceFile.empty()) {
+        osgDB::FindFileCallback* next = osgDB::Registry::instance()->getFindFileCallback();
+        if (osgOptions) {
+            recordingOptions = static_cast<osgDB::Options*>(osgOptions->clone(osg::CopyOp()));
+            if (osgOptions->getFindFileCallback())
+                next = osgOptions->getFindFileCallback();
+        } else {
+            recordingOptions = new osgDB::Options;
+        }
+        sourceRecorder = new SourceRecorder(next);
+        recordingOptions->setFindFileCallback(sourceRecorder.get());
+        osgOptions = recordingOptions.get();
+    }
+
     osg::ref_ptr<osg::Node> node;
-    node = osgDB::readRefNodeFile(name, dynamic_cast<const osgDB::Options*>(options.get()));
+    node = osgDB::readRefNodeFile(name, osgOptions);
 
     if (!node.valid())
         return SGSharedPtr<BVHNode>();
@@ -364,7 +514,47 @@ BVHPageNodeOSG::load(const std::string& name, const osg::ref_ptr<const osg::Refe
     if (flatten)
         nodeVisitor.setCenter(node->getBound()._center);
     node->accept(nodeVisitor);
-    return nodeVisitor.getNode();
+    SGSharedPtr<BVHNode> bvhNode = nodeVisitor.getNode();
+
+    if (bvhNode.valid() && !sourceFile.empty()) {
+        auto materialName = [](const BVHMaterial* material) -> std::string {
+            const SGMaterial* sgMaterial = dynamic_cast<const SGMaterial*>(material);
+            if (!sgMaterial || sgMaterial->get_names().empty())
+                return std::string();
+            return sgMaterial->get_names().front();
+        };
+        // trees with paged or moving parts are not cached
+        BVHCacheFile::PathList sources = sourceRecorder->getSources();
+        sources.push_back(SGPath::fromUtf8(sourceFile));
+        BVHCacheFile::write(cachePath, *bvhNode, sourceFile, materialName, sources);
+    }
+    return bvhNode;
+}
+
+void
+BVHPageNodeOSG::setCacheDirectory(const SGPath& cacheDirectory)
+{
+    std::lock_guard<std::mutex> lock(_cacheDirectoryMutex);
+    _cacheDirectory = cacheDirectory;
+}
+
+SGPath
+BVHPageNodeOSG::getCacheDirectory()
+{
+    std::lock_guard<std::mutex> lock(_cacheDirectoryMutex);
+    return _cacheDirectory;
+}
+
+void
+BVHPageNodeOSG::setCompressGeometry(bool compress)
+{
+    _compressGeometry = compress;
+}
+
+bool
+BVHPageNodeOSG::getCompressGeometry()
+{
+    return _compressGeometry;
 }
 
 BVHPageNodeOSG::BVHPageNodeOSG(const std::string& name,
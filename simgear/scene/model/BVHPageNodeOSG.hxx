@@ -20,6 +20,8 @@
 
 #include <string>
 
+#include <simgear/misc/sg_path.hxx>
+
 #include "../../bvh/BVHPageNode.hxx"
 
 #include <osg/ref_ptr>
@@ -43,6 +45,18 @@ public:
     static SGSharedPtr<BVHNode>
     load(const std::string& name, const osg::ref_ptr<const osg::Referenced>& options);
 
+    /// Trees built by load() are stored in this directory and read back
+    /// on later loads of the same model file, as long as its content did
+    /// not change. Empty, the default, disables the cache.
+    static void setCacheDirectory(const SGPath& cacheDirectory);
+    static SGPath getCacheDirectory();
+
+    /// Build the trees of loaded models as compressed geometry, which
+    /// takes about a third less memory for somewhat slower queries.
+    /// Off by default.
+    static void setCompressGeometry(bool compress);
+    static bool getCompressGeometry();
+
 protected:
     virtual SGSphered computeBoundingSphere() const;
     virtual void invalidateBound();
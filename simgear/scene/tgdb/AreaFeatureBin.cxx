@@ -27,8 +27,8 @@
 #include <osgDB/FileUtils>
 
 #include <simgear/debug/logstream.hxx>
-#include <simgear/io/iostreams/sgstream.hxx>
 #include <simgear/math/SGGeod.hxx>
+#include <simgear/misc/ListFileReader.hxx>
 #include <simgear/scene/util/OsgMath.hxx>
 
 #include "AreaFeatureBin.hxx"
@@ -46,27 +46,20 @@ AreaFeatureBin::AreaFeatureBin(const SGPath& absoluteFileName, const std::string
         return;
     }
 
-    sg_gzifstream stream(absoluteFileName);
-    if (!stream.is_open()) {
+    ListFileReader reader(absoluteFileName);
+    if (!reader.is_open()) {
         SG_LOG(SG_TERRAIN, SG_ALERT, "Unable to open " << absoluteFileName);
         return;
     }
 
-    while (!stream.eof()) {
-        // read a line.  Each line defines a single line feature, consisting of a width followed by a series of lon/lat positions.
-        // Or a comment, starting with #
-        std::string line;
-        std::getline(stream, line);
-
+    // read a line.  Each line defines a single line feature, consisting of a width followed by a series of lon/lat positions.
+    // Or a comment, starting with #, which the reader strips
+    std::string_view line;
+    while (reader.nextLine(line)) {
         if (line.length() == 0) continue;
 
-        // strip comments
-        std::string::size_type hash_pos = line.find('#');
-        if (hash_pos != std::string::npos)
-            line.resize(hash_pos);
-
         // and process further
-        std::stringstream in(line);
+        NumberScanner in(line);
 
         // Area format is Area A B C D lon0 lat0 lon1 lat1 lon2 lat2 lon3 lat4....
         // where:
@@ -75,20 +68,16 @@ AreaFeatureBin::AreaFeatureBin(const SGPath& absoluteFileName, const std::string
         // lon[n], lat[n] are pairs of lon/lat defining straight road segments
         int attributes = 0;
         float area=0, a=0, b=0, c=0, d=0;
-        std::list<osg::Vec3d> nodes;
-
-        in >> area >> attributes >> a >> b >> c >> d;
+        std::vector<osg::Vec3d> nodes;
 
-        if (in.bad() || in.fail()) {
+        if (!in.read(area, attributes, a, b, c, d)) {
             SG_LOG(SG_TERRAIN, SG_WARN, "Error parsing area entry in: " << absoluteFileName << " line: \"" << line << "\"");
             continue;
         }
 
         while (true) {
             double lon = 0.0f, lat=0.0f;
-            in >> lon >> lat;
-
-            if (in.bad() || in.fail()) {
+            if (!in.read(lon, lat)) {
                 break;
             }
 
@@ -103,8 +92,6 @@ AreaFeatureBin::AreaFeatureBin(const SGPath& absoluteFileName, const std::string
             SG_LOG(SG_TERRAIN, SG_WARN, "AreaFeature definition with fewer than three lon/lat nodes : " << absoluteFileName << " line: \"" << line << "\"");
         }
     }
-
-    stream.close();
 };
 
 
@@ -41,26 +41,29 @@ public:
     ~AreaFeatureBin() = default;
 
     struct AreaFeature {
-        const std::list<osg::Vec3d> _nodes;
+        const std::vector<osg::Vec3d> _nodes;
         const float _area;
         const int _attributes;
         const float _a;
         const float _b;
         const float _c;
         const float _d;
-        AreaFeature(const std::list<osg::Vec3d> nodes, const float area, const int attributes, const float a, const float b, const float c, const float d) :
+        // Bounds of the nodes, to skip features that do not touch a tile
+        osg::BoundingBoxd _bounds;
+        AreaFeature(const std::vector<osg::Vec3d>& nodes, const float area, const int attributes, const float a, const float b, const float c, const float d) :
           _nodes(nodes), _area(area), _attributes(attributes), _a(a), _b(b), _c(c), _d(d)
         {
+            for (const auto& n : _nodes) _bounds.expandBy(n);
         }
     };
 
-    typedef std::list<AreaFeature> AreaFeatureList;
+    typedef std::vector<AreaFeature> AreaFeatureList;
 
     void insert(const AreaFeature& t) { 
         _areaFeatureList.push_back(t); 
     }
 
-    const AreaFeatureList getAreaFeatures() const {
+    const AreaFeatureList& getAreaFeatures() const {
         return _areaFeatureList;
     }
 
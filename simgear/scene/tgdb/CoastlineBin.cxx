@@ -27,8 +27,8 @@
 #include <osgDB/FileUtils>
 
 #include <simgear/debug/logstream.hxx>
-#include <simgear/io/iostreams/sgstream.hxx>
 #include <simgear/math/SGGeod.hxx>
+#include <simgear/misc/ListFileReader.hxx>
 #include <simgear/scene/util/OsgMath.hxx>
 
 #include "CoastlineBin.hxx"
@@ -45,40 +45,26 @@ CoastlineBin::CoastlineBin(const SGPath& absoluteFileName)
         return;
     }
 
-    sg_gzifstream stream(absoluteFileName);
-    if (!stream.is_open()) {
+    ListFileReader reader(absoluteFileName);
+    if (!reader.is_open()) {
         SG_LOG(SG_TERRAIN, SG_ALERT, "Unable to open " << absoluteFileName);
         return;
     }
 
-    while (!stream.eof()) {
-        // read a line.  Each line defines a coast line feature, consisting of a series of lon/lat positions.
-        // Or a comment, starting with #
-        std::string line;
-        std::getline(stream, line);
-
-        // strip comments
-        std::string::size_type hash_pos = line.find('#');
-        if (hash_pos != std::string::npos)
-            line.resize(hash_pos);
-
+    // read a line.  Each line defines a coast line feature, consisting of a series of lon/lat positions.
+    // Or a comment, starting with #, which the reader strips
+    std::string_view line;
+    while (reader.nextLine(line)) {
         if (line.length() == 0) continue;
 
         // and process further
-        std::stringstream in(line);
-
-        if (in.bad() || in.fail()) {
-            SG_LOG(SG_TERRAIN, SG_WARN, "Error parsing area entry in: " << absoluteFileName << " line: \"" << line << "\"");
-            continue;
-        }
+        NumberScanner in(line);
 
-        std::list<osg::Vec3d> nodes;
+        std::vector<osg::Vec3d> nodes;
 
         while (true) {
             double lon = 0.0f, lat=0.0f;
-            in >> lon >> lat;
-
-            if (in.bad() || in.fail()) {
+            if (!in.read(lon, lat)) {
                 break;
             }
 
@@ -93,8 +79,6 @@ CoastlineBin::CoastlineBin(const SGPath& absoluteFileName)
             SG_LOG(SG_TERRAIN, SG_WARN, "Coastline definition with fewer than two lon/lat nodes : " << absoluteFileName << " line: \"" << line << "\"");
         }
     }
-
-    stream.close();
 };
 
 
@@ -41,20 +41,23 @@ public:
     ~CoastlineBin() = default;
 
     struct Coastline {
-        const std::list<osg::Vec3d> _nodes;
-        Coastline(const std::list<osg::Vec3d> nodes) :
+        const std::vector<osg::Vec3d> _nodes;
+        // Bounds of the nodes, to skip coastlines that do not touch a tile
+        osg::BoundingBoxd _bounds;
+        Coastline(const std::vector<osg::Vec3d>& nodes) :
           _nodes(nodes)
         {
+            for (const auto& n : _nodes) _bounds.expandBy(n);
         }
     };
 
-    typedef std::list<Coastline> CoastlineList;
+    typedef std::vector<Coastline> CoastlineList;
 
     void insert(const Coastline& t) { 
         _coastFeatureList.push_back(t); 
     }
 
-    const CoastlineList getCoastlines() const {
+    const CoastlineList& getCoastlines() const {
         return _coastFeatureList;
     }
 
@@ -31,7 +31,7 @@
 #include <osg/StateSet>
 
 #include <simgear/debug/logstream.hxx>
-#include <simgear/io/iostreams/sgstream.hxx>
+#include <simgear/misc/ListFileReader.hxx>
 #include <simgear/misc/sg_path.hxx>
 #include <simgear/scene/util/RenderConstants.hxx>
 #include <simgear/scene/util/SGEnlargeBoundingBox.hxx>
@@ -86,8 +86,8 @@ LightBin::LightBin(const SGPath& absoluteFileName) {
         return;
     }
 
-    sg_gzifstream stream(absoluteFileName);
-    if (!stream.is_open()) {
+    ListFileReader reader(absoluteFileName);
+    if (!reader.is_open()) {
         SG_LOG(SG_TERRAIN, SG_ALERT, "Unable to open " << absoluteFileName);
         return;
     }
@@ -96,29 +96,25 @@ LightBin::LightBin(const SGPath& absoluteFileName) {
     // size, intensity, color, directionality and animations
     float props[19];
 
-    while (!stream.eof()) {
-        // read a line.  Each line defines a single light position and its properties,
-        // and may have a comment, starting with #
-        std::string line;
-        std::getline(stream, line);
-
-        // strip comments
-        std::string::size_type hash_pos = line.find('#');
-        if (hash_pos != std::string::npos)
-            line.resize(hash_pos);
-
+    // read a line.  Each line defines a single light position and its properties,
+    // and may have a comment, starting with #, which the reader strips
+    std::string_view line;
+    while (reader.nextLine(line)) {
         if (line.empty()) {
             continue; // skip blank lines
         }
 
         // and process further
-        std::stringstream in(line);
+        NumberScanner in(line);
 
         int number_of_props = 0;
-        while(!in.eof()) {
-            in >> props[number_of_props++];
+        while (number_of_props < 19 && !in.atEnd() && in.read(props[number_of_props])) {
+            number_of_props++;
         }
 
+        // Anything left over is an error, whatever the count
+        if (!in.atEnd()) number_of_props = -1;
+
         if (number_of_props == 10) {
             // Omnidirectional
             insert(
@@ -168,8 +164,6 @@ LightBin::LightBin(const SGPath& absoluteFileName) {
                 continue;
         }
     }
-
-    stream.close();
 }
 
 Effect* getLightEffect(double average_size, double average_intensity, const SGReaderWriterOptions* options)
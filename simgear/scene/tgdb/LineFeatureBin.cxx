@@ -27,8 +27,8 @@
 #include <osgDB/FileUtils>
 
 #include <simgear/debug/logstream.hxx>
-#include <simgear/io/iostreams/sgstream.hxx>
 #include <simgear/math/SGGeod.hxx>
+#include <simgear/misc/ListFileReader.hxx>
 #include <simgear/scene/util/OsgMath.hxx>
 
 #include "LineFeatureBin.hxx"
@@ -46,27 +46,20 @@ LineFeatureBin::LineFeatureBin(const SGPath& absoluteFileName, const std::string
         return;
     }
 
-    sg_gzifstream stream(absoluteFileName);
-    if (!stream.is_open()) {
+    ListFileReader reader(absoluteFileName);
+    if (!reader.is_open()) {
         SG_LOG(SG_TERRAIN, SG_ALERT, "Unable to open " << absoluteFileName);
         return;
     }
 
-    while (!stream.eof()) {
-        // read a line.  Each line defines a single line feature, consisting of a width followed by a series of lon/lat positions.
-        // Or a comment, starting with #
-        std::string line;
-        std::getline(stream, line);
-
+    // read a line.  Each line defines a single line feature, consisting of a width followed by a series of lon/lat positions.
+    // Or a comment, starting with #, which the reader strips
+    std::string_view line;
+    while (reader.nextLine(line)) {
         if (line.length() == 0) continue;
 
-        // strip comments
-        std::string::size_type hash_pos = line.find('#');
-        if (hash_pos != std::string::npos)
-            line.resize(hash_pos);
-
         // and process further
-        std::stringstream in(line);
+        NumberScanner in(line);
 
         // Line format is W attr A B C D lon0 lat0 lon1 lat1 lon2 lat2 lon3 lat4....
         // where:
@@ -77,20 +70,16 @@ LineFeatureBin::LineFeatureBin(const SGPath& absoluteFileName, const std::string
         float w = 0.0f;
         int attributes = 0;
         float a=0, b=0, c=0, d=0;
-        std::list<osg::Vec3d> nodes;
-
-        in >> w >> attributes >> a >> b >> c >> d;
+        std::vector<osg::Vec3d> nodes;
 
-        if (in.bad() || in.fail()) {
+        if (!in.read(w, attributes, a, b, c, d)) {
             SG_LOG(SG_TERRAIN, SG_WARN, "Error parsing road entry in: " << absoluteFileName << " line: \"" << line << "\"");
             continue;
         }
 
         while (true) {
             double lon = 0.0f, lat=0.0f;
-            in >> lon >> lat;
-
-            if (in.bad() || in.fail()) {
+            if (!in.read(lon, lat)) {
                 break;
             }
 
@@ -105,8 +94,6 @@ LineFeatureBin::LineFeatureBin(const SGPath& absoluteFileName, const std::string
             SG_LOG(SG_TERRAIN, SG_WARN, "LineFeature definition with fewer than two lon/lat nodes : " << absoluteFileName << " line: \"" << line << "\"");
         }
     }
-
-    stream.close();
 };
 
 
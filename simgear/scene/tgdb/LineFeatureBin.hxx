@@ -41,26 +41,29 @@ public:
     ~LineFeatureBin() = default;
 
     struct LineFeature {
-        const std::list<osg::Vec3d> _nodes;
+        const std::vector<osg::Vec3d> _nodes;
         const float _width;
         const int _attributes;
         const float _a;
         const float _b;
         const float _c;
         const float _d;
-        LineFeature(const std::list<osg::Vec3d> nodes, const float w, const int attributes=0, const float a=0.0, const float b=0.0, const float c=0.0, const float d=0.0) :
+        // Bounds of the nodes, to skip features that do not touch a tile
+        osg::BoundingBoxd _bounds;
+        LineFeature(const std::vector<osg::Vec3d>& nodes, const float w, const int attributes=0, const float a=0.0, const float b=0.0, const float c=0.0, const float d=0.0) :
           _nodes(nodes), _width(w), _attributes(attributes), _a(a), _b(b), _c(c), _d(d)
         {
+            for (const auto& n : _nodes) _bounds.expandBy(n);
         }
     };
 
-    typedef std::list<LineFeature> LineFeatureList;
+    typedef std::vector<LineFeature> LineFeatureList;
 
     void insert(const LineFeature& t) { 
         _lineFeatureList.push_back(t); 
     }
 
-    const LineFeatureList getLineFeatures() const {
+    const LineFeatureList& getLineFeatures() const {
         return _lineFeatureList;
     }
 
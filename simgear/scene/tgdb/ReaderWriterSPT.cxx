@@ -24,6 +24,10 @@
 #include "ReaderWriterSPT.hxx"
 
 #include <cassert>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <tuple>
 
 #include <osg/Version>
 #include <osg/CullFace>
@@ -338,60 +342,118 @@ ReaderWriterSPT::createPagedLOD(const BucketBox& bucketBox, const LocalOptions&
     return pagedLOD;
 }
 
-osg::ref_ptr<osg::Node>
-ReaderWriterSPT::createSeaLevelTile(const BucketBox& bucketBox, const LocalOptions& options) const
+// The sea level geometry is rotationally symmetric about the earth axis,
+// so all boxes of the same latitude, size and levels share it.  The
+// template is built at longitude offset zero, the tiles rotate it in place.
+namespace {
+struct SeaLevelTemplate : public osg::Referenced {
+    SGVec3f center;
+    osg::ref_ptr<osg::Vec3Array> vertices;
+    osg::ref_ptr<osg::Vec3Array> normals;
+    osg::ref_ptr<osg::Vec2Array> texCoords;
+    osg::ref_ptr<osg::Vec4Array> colors;
+    osg::ref_ptr<osg::DrawArrays> drawArrays;
+};
+
+// Keyed by latitude offset, size and width and height level
+typedef std::tuple<unsigned, unsigned, unsigned, unsigned, unsigned> SeaLevelTemplateKey;
+std::map<SeaLevelTemplateKey, osg::ref_ptr<SeaLevelTemplate> > seaLevelTemplates;
+std::mutex seaLevelTemplatesMutex;
+
+osg::ref_ptr<SeaLevelTemplate>
+getSeaLevelTemplate(const BucketBox& bucketBox)
 {
-    if (options._options->getPluginStringData("SimGear::FG_EARTH") != "ON")
-        return 0;
+    // The level of the width depends on the longitude offset
+    unsigned widthLevel = bucketBox.getWidthLevel();
+    unsigned heightLevel = bucketBox.getHeightLevel();
+    SeaLevelTemplateKey key(bucketBox.getOffset(1), bucketBox.getSize(0), bucketBox.getSize(1),
+                            widthLevel, heightLevel);
+    {
+        std::lock_guard<std::mutex> lock(seaLevelTemplatesMutex);
+        std::map<SeaLevelTemplateKey, osg::ref_ptr<SeaLevelTemplate> >::iterator i;
+        i = seaLevelTemplates.find(key);
+        if (i != seaLevelTemplates.end())
+            return i->second;
+    }
 
-    SGSpheref sphere = bucketBox.getBoundingSphere();
+    BucketBox box(bucketBox);
+    box.setOffset(0, 0);
+
+    osg::ref_ptr<SeaLevelTemplate> seaLevelTemplate = new SeaLevelTemplate;
+    seaLevelTemplate->center = box.getBoundingSphere().getCenter();
     osg::Matrixd transform;
-    transform.makeTranslate(toOsg(-sphere.getCenter()));
+    transform.makeTranslate(toOsg(-seaLevelTemplate->center));
 
     osg::Vec3Array* vertices = new osg::Vec3Array;
     osg::Vec3Array* normals = new osg::Vec3Array;
     osg::Vec2Array* texCoords = new osg::Vec2Array;
 
-    unsigned widthLevel = bucketBox.getWidthLevel();
-    unsigned heightLevel = bucketBox.getHeightLevel();
-
-    unsigned incx = bucketBox.getWidthIncrement(widthLevel + 2);
-    incx = std::min(incx, bucketBox.getSize(0));
+    unsigned incx = box.getWidthIncrement(widthLevel + 2);
+    incx = std::min(incx, box.getSize(0));
     for (unsigned i = 0; incx != 0;) {
-        unsigned incy = bucketBox.getHeightIncrement(heightLevel + 2);
-        incy = std::min(incy, bucketBox.getSize(1));
+        unsigned incy = box.getHeightIncrement(heightLevel + 2);
+        incy = std::min(incy, box.getSize(1));
         for (unsigned j = 0; incy != 0;) {
             SGVec3f v[6], n[6];
             SGVec2f t[6];
-            unsigned num = bucketBox.getTileTriangles(i, j, incx, incy, v, n, t);
+            unsigned num = box.getTileTriangles(i, j, incx, incy, v, n, t);
             for (unsigned k = 0; k < num; ++k) {
                 vertices->push_back(transform.preMult(toOsg(v[k])));
                 normals->push_back(toOsg(n[k]));
                 texCoords->push_back(toOsg(t[k]));
             }
             j += incy;
-            incy = std::min(incy, bucketBox.getSize(1) - j);
+            incy = std::min(incy, box.getSize(1) - j);
         }
         i += incx;
-        incx = std::min(incx, bucketBox.getSize(0) - i);
+        incx = std::min(incx, box.getSize(0) - i);
     }
+    seaLevelTemplate->vertices = vertices;
+    seaLevelTemplate->normals = normals;
+    seaLevelTemplate->texCoords = texCoords;
 
-    osg::Vec4Array* colors = new osg::Vec4Array;
-    colors->push_back(osg::Vec4(1, 1, 1, 1));
+    seaLevelTemplate->colors = new osg::Vec4Array;
+    seaLevelTemplate->colors->push_back(osg::Vec4(1, 1, 1, 1));
+
+    seaLevelTemplate->drawArrays = new osg::DrawArrays(osg::DrawArrays::TRIANGLES, 0, vertices->size());
+    seaLevelTemplate->drawArrays->setDataVariance(osg::Object::STATIC);
+
+    std::lock_guard<std::mutex> lock(seaLevelTemplatesMutex);
+    osg::ref_ptr<SeaLevelTemplate>& cached = seaLevelTemplates[key];
+    if (!cached.valid())
+        cached = seaLevelTemplate;
+    return cached;
+}
+}
+
+osg::ref_ptr<osg::Node>
+ReaderWriterSPT::createSeaLevelTile(const BucketBox& bucketBox, const LocalOptions& options) const
+{
+    if (options._options->getPluginStringData("SimGear::FG_EARTH") != "ON")
+        return 0;
+
+    osg::ref_ptr<SeaLevelTemplate> seaLevelTemplate = getSeaLevelTemplate(bucketBox);
+
+    // The texture coordinates are in absolute offsets, compute the same
+    // values as BucketBox::getTileTriangles() for this longitude
+    unsigned offset0 = bucketBox.getOffset(0);
+    const osg::Vec2Array& templateTexCoords = *seaLevelTemplate->texCoords;
+    osg::Vec2Array* texCoords = new osg::Vec2Array(templateTexCoords.size());
+    for (unsigned k = 0; k < templateTexCoords.size(); ++k) {
+        unsigned x = std::lround(templateTexCoords[k][0]*(360*8));
+        (*texCoords)[k].set((offset0 + x)*1.0/(360*8), templateTexCoords[k][1]);
+    }
 
     osg::Geometry* geometry = new osg::Geometry;
     geometry->setDataVariance(osg::Object::STATIC);
     geometry->setUseVertexBufferObjects(true);
-    geometry->setVertexArray(vertices);
-    geometry->setNormalArray(normals);
+    geometry->setVertexArray(seaLevelTemplate->vertices.get());
+    geometry->setNormalArray(seaLevelTemplate->normals.get());
     geometry->setNormalBinding(osg::Geometry::BIND_PER_VERTEX);
-    geometry->setColorArray(colors);
+    geometry->setColorArray(seaLevelTemplate->colors.get());
     geometry->setColorBinding(osg::Geometry::BIND_OVERALL);
     geometry->setTexCoordArray(0, texCoords);
-
-    osg::DrawArrays* drawArrays = new osg::DrawArrays(osg::DrawArrays::TRIANGLES, 0, vertices->size());
-    drawArrays->setDataVariance(osg::Object::STATIC);
-    geometry->addPrimitiveSet(drawArrays);
+    geometry->addPrimitiveSet(seaLevelTemplate->drawArrays.get());
 
     osg::Geode* geode = new osg::Geode;
     geode->setDataVariance(osg::Object::STATIC);
@@ -399,7 +461,11 @@ ReaderWriterSPT::createSeaLevelTile(const BucketBox& bucketBox, const LocalOptio
     osg::ref_ptr<osg::StateSet> stateSet = getLowLODStateSet(options);
     geode->setStateSet(stateSet.get());
 
-    transform.makeTranslate(toOsg(sphere.getCenter()));
+    // Move the template back to its center and rotate it to the longitude
+    // of this box, one offset is 1/8 degree
+    osg::Matrixd transform;
+    transform = osg::Matrixd::translate(toOsg(seaLevelTemplate->center))
+        * osg::Matrixd::rotate(SGMiscd::deg2rad(offset0*0.125), osg::Vec3d(0, 0, 1));
     osg::MatrixTransform* matrixTransform = new osg::MatrixTransform(transform);
     matrixTransform->setDataVariance(osg::Object::STATIC);
     matrixTransform->addChild(geode);
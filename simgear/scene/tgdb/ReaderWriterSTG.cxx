@@ -23,6 +23,9 @@
 #  include <simgear_config.h>
 #endif
 #include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
 #include "ReaderWriterSTG.hxx"
 
 #include <osg/LOD>
@@ -43,6 +46,8 @@
 #include <simgear/debug/logstream.hxx>
 #include <simgear/math/SGGeometry.hxx>
 #include <simgear/math/sg_random.hxx>
+#include <simgear/misc/strutils.hxx>
+#include <simgear/timing/timestamp.hxx>
 
 #include <simgear/io/iostreams/sgstream.hxx>
 #include <simgear/scene/util/OptionsReadFileCallback.hxx>
@@ -115,6 +120,151 @@ using TokenCallbackMap = std::map<std::string,ReaderWriterSTG::STGObjectCallback
 static TokenCallbackMap globalStgObjectCallbacks = {};
 static OpenThreads::Mutex globalStgObjectCallbackLock;
 
+/**
+ * One line of a STG file, split at white space, without the comment.
+ */
+struct STGLine {
+    std::string token;
+    std::string name;
+    string_list fields;
+};
+typedef std::vector<STGLine> STGLineList;
+
+/**
+ * Reads the fields following the name of a STG line like a stream does.
+ * A value past the end of the line is left as it is and fails the reader.
+ */
+class STGFieldReader {
+public:
+    STGFieldReader(const string_list& fields) : _fields(fields), _next(0) { }
+
+    STGFieldReader& operator>>(std::string& value)
+    {
+        if (_next < _fields.size())
+            value = _fields[_next];
+        ++_next;
+        return *this;
+    }
+    STGFieldReader& operator>>(double& value)
+    {
+        if (_next < _fields.size())
+            value = std::strtod(_fields[_next].c_str(), nullptr);
+        ++_next;
+        return *this;
+    }
+    STGFieldReader& operator>>(float& value)
+    {
+        if (_next < _fields.size())
+            value = std::strtof(_fields[_next].c_str(), nullptr);
+        ++_next;
+        return *this;
+    }
+    STGFieldReader& operator>>(int& value)
+    {
+        if (_next < _fields.size())
+            value = std::atoi(_fields[_next].c_str());
+        ++_next;
+        return *this;
+    }
+    explicit operator bool() const { return _next <= _fields.size(); }
+
+private:
+    const string_list& _fields;
+    size_t _next;
+};
+
+/**
+ * The STG files split into lines, keyed by path and checked against the
+ * modification time and size, so the tiles paged in again do not read them
+ * again.
+ */
+struct STGCacheEntry {
+    time_t modTime;
+    size_t size;
+    unsigned lastUse;
+    std::shared_ptr<const STGLineList> lines;
+};
+static std::map<std::string, STGCacheEntry> stgCache;
+static unsigned stgCacheClock = 0;
+static OpenThreads::Mutex stgCacheLock;
+static const size_t maxSTGCacheEntries = 1024;
+
+static std::atomic<unsigned> numSTGFilesParsed(0);
+static std::atomic<unsigned> numSTGCacheHits(0);
+static std::atomic<double> stgParseTimeMSecs(0);
+static std::atomic<unsigned> numSTGOptions(0);
+static std::atomic<unsigned> numSTGSharedOptions(0);
+
+static std::shared_ptr<const STGLineList> readSTGLines(const SGPath& absoluteFileName)
+{
+    std::string key = absoluteFileName.utf8Str();
+    time_t modTime = absoluteFileName.modTime();
+    size_t size = absoluteFileName.sizeInBytes();
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(stgCacheLock);
+        auto i = stgCache.find(key);
+        if (i != stgCache.end() && i->second.modTime == modTime && i->second.size == size) {
+            i->second.lastUse = ++stgCacheClock;
+            ++numSTGCacheHits;
+            return i->second.lines;
+        }
+    }
+
+    sg_gzifstream stream(absoluteFileName);
+    if (!stream.is_open()) {
+        return nullptr;
+    }
+
+    SGTimeStamp start = SGTimeStamp::now();
+    auto lines = std::make_shared<STGLineList>();
+    std::string line;
+    while (!stream.eof()) {
+        std::getline(stream, line);
+
+        // strip comments
+        std::string::size_type hash_pos = line.find('#');
+        if (hash_pos != std::string::npos)
+            line.resize(hash_pos);
+
+        string_list fields = strutils::split(line);
+        // No comment
+        if (fields.empty())
+            continue;
+
+        // Then there is always a name
+        STGLine stgLine;
+        stgLine.token = fields[0];
+        if (fields.size() > 1)
+            stgLine.name = fields[1];
+        fields.erase(fields.begin(), fields.begin() + std::min<size_t>(fields.size(), 2));
+        stgLine.fields.swap(fields);
+        lines->push_back(std::move(stgLine));
+    }
+
+    double msecs = (SGTimeStamp::now() - start).toMSecs();
+    double total = stgParseTimeMSecs;
+    while (!stgParseTimeMSecs.compare_exchange_weak(total, total + msecs))
+        ;
+    ++numSTGFilesParsed;
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(stgCacheLock);
+    if (stgCache.size() >= maxSTGCacheEntries && !stgCache.count(key)) {
+        // Drop the entry used longest ago
+        auto oldest = stgCache.begin();
+        for (auto i = stgCache.begin(); i != stgCache.end(); ++i) {
+            if (i->second.lastUse < oldest->second.lastUse)
+                oldest = i;
+        }
+        stgCache.erase(oldest);
+    }
+    STGCacheEntry& entry = stgCache[key];
+    entry.modTime = modTime;
+    entry.size = size;
+    entry.lastUse = ++stgCacheClock;
+    entry.lines = lines;
+    return lines;
+}
+
 struct ReaderWriterSTG::_ModelBin {
     struct _Object {
         SGPath _errorLocation;
@@ -421,6 +571,7 @@ struct ReaderWriterSTG::_ModelBin {
     {
         osg::ref_ptr<SGReaderWriterOptions> sharedOptions;
         sharedOptions = SGReaderWriterOptions::copyOrCreate(options);
+        ++numSTGOptions;
         sharedOptions->getDatabasePathList().clear();
 
         SGPath path = filePath;
@@ -451,6 +602,7 @@ struct ReaderWriterSTG::_ModelBin {
     {
         osg::ref_ptr<SGReaderWriterOptions> staticOptions;
         staticOptions = SGReaderWriterOptions::copyOrCreate(options);
+        ++numSTGOptions;
         staticOptions->getDatabasePathList().clear();
 
         staticOptions->getDatabasePathList().push_back(filePath);
@@ -468,6 +620,26 @@ struct ReaderWriterSTG::_ModelBin {
         return staticOptions.release();
     }
 
+    // The options of an object, shared with the previous objects that got
+    // the same key.  Only SGReaderWriterXML hands the SGModelData to the model
+    // it loads, so XML models still get options of their own if there is
+    // model data.
+    template<typename Create>
+    osg::ref_ptr<SGReaderWriterOptions> objectOptions(const std::string& key, const std::string& name,
+                                                       const osgDB::Options* options, Create create)
+    {
+        const SGReaderWriterOptions* sgOptions = dynamic_cast<const SGReaderWriterOptions*>(options);
+        if (sgOptions && sgOptions->getModelData() && SGPath(name).lower_extension() == "xml")
+            return create();
+
+        osg::ref_ptr<SGReaderWriterOptions>& opt = _optionsMap[key];
+        if (opt.valid())
+            ++numSTGSharedOptions;
+        else
+            opt = create();
+        return opt;
+    }
+
     double elevation(osg::Group& group, const SGGeod& geod)
     {
         SGVec3d start = SGVec3d::fromGeod(SGGeod::fromGeodM(geod, 10000));
@@ -503,8 +675,8 @@ struct ReaderWriterSTG::_ModelBin {
             return false;
         }
 
-        sg_gzifstream stream(absoluteFileName);
-        if (!stream.is_open()) {
+        std::shared_ptr<const STGLineList> lines = readSTGLines(absoluteFileName);
+        if (!lines) {
             return false;
         }
 
@@ -533,29 +705,10 @@ struct ReaderWriterSTG::_ModelBin {
         // do only load terrain btg files
         bool onlyTerrain = options->getPluginStringData("SimGear::FG_ONLY_TERRAIN") == "ON";
 
-        while (!stream.eof()) {
-            // read a line
-            std::string line;
-            std::getline(stream, line);
-
-            // strip comments
-            std::string::size_type hash_pos = line.find('#');
-            if (hash_pos != std::string::npos)
-                line.resize(hash_pos);
-
-            // and process further
-            std::stringstream in(line);
-
-            std::string token;
-            in >> token;
-
-            // No comment
-            if (token.empty())
-                continue;
-
-            // Then there is always a name
-            std::string name;
-            in >> name;
+        for (const STGLine& line : *lines) {
+            const std::string& token = line.token;
+            const std::string& name = line.name;
+            STGFieldReader in(line.fields);
 
             SGPath path = filePath;
             path.append(name);
@@ -570,7 +723,9 @@ struct ReaderWriterSTG::_ModelBin {
                         obj._errorLocation = absoluteFileName;
                         obj._token = token;
                         obj._name = path.utf8Str();
-                        obj._options = staticOptions(filePath, options);
+                        obj._options = objectOptions("base " + filePath, name, options, [&]() {
+                            return staticOptions(filePath, options);
+                        });
                         _objectList.push_back(obj);
                     }
                 }
@@ -580,7 +735,9 @@ struct ReaderWriterSTG::_ModelBin {
                     obj._errorLocation = absoluteFileName;
                     obj._token = token;
                     obj._name = path.utf8Str();
-                    obj._options = staticOptions(filePath, options);
+                    obj._options = objectOptions("base " + filePath, name, options, [&]() {
+                        return staticOptions(filePath, options);
+                    });
                     _objectList.push_back(obj);
                 }
             } else if (!onlyTerrain) {
@@ -593,15 +750,16 @@ struct ReaderWriterSTG::_ModelBin {
                 else if (lrand < 0.4) range = range * 1.5;
 
                 if (token == "OBJECT_STATIC" || token == "OBJECT_STATIC_AGL") {
+                    bool ac = SGPath(name).lower_extension() == "ac";
                     osg::ref_ptr<SGReaderWriterOptions> opt;
-                    opt = staticOptions(filePath, options);
-                    if (SGPath(name).lower_extension() == "ac")
-                            opt->setInstantiateEffects(true);
-                    else
-                            opt->setInstantiateEffects(false);
+                    opt = objectOptions((ac ? "static ac " : "static ") + absoluteFileName.utf8Str(), name, options, [&]() {
+                        osg::ref_ptr<SGReaderWriterOptions> staticOpt = staticOptions(filePath, options);
+                        staticOpt->setInstantiateEffects(ac);
+                        staticOpt->addErrorContext("terrain-stg", absoluteFileName.utf8Str());
+                        return staticOpt;
+                    });
                     _ObjectStatic obj;
 
-                    opt->addErrorContext("terrain-stg", absoluteFileName.utf8Str());
                     obj._errorLocation = absoluteFileName;
                     obj._token = token;
                     obj._name = name;
@@ -613,12 +771,13 @@ struct ReaderWriterSTG::_ModelBin {
                     checkInsideBucket(absoluteFileName, obj._lon, obj._lat);
                     _objectStaticList.push_back(obj);
                 } else if (token == "OBJECT_SHARED" || token == "OBJECT_SHARED_AGL") {
+                    bool ac = SGPath(name).lower_extension() == "ac";
                     osg::ref_ptr<SGReaderWriterOptions> opt;
-                    opt = sharedOptions(filePath, options);
-                    if (SGPath(name).lower_extension() == "ac")
-                            opt->setInstantiateEffects(true);
-                    else
-                            opt->setInstantiateEffects(false);
+                    opt = objectOptions((ac ? "shared ac " : "shared ") + filePath, name, options, [&]() {
+                        osg::ref_ptr<SGReaderWriterOptions> sharedOpt = sharedOptions(filePath, options);
+                        sharedOpt->setInstantiateEffects(ac);
+                        return sharedOpt;
+                    });
                     _ObjectStatic obj;
                     obj._errorLocation = absoluteFileName;
                     obj._token = token;
@@ -764,6 +923,9 @@ struct ReaderWriterSTG::_ModelBin {
 
     std::map<std::string, osg::ref_ptr<osg::Node> > tile_map;
 
+    /// The options shared by the objects, see objectOptions()
+    std::map<std::string, osg::ref_ptr<SGReaderWriterOptions> > _optionsMap;
+
     osg::Node* load(const SGBucket& bucket, const osgDB::Options* opt)
     {
         osg::ref_ptr<SGReaderWriterOptions> options;
@@ -1035,6 +1197,17 @@ ReaderWriterSTG::readNode(const std::string& fileName, const osgDB::Options* opt
 }
 
 
+ReaderWriterSTG::Statistics ReaderWriterSTG::getStatistics()
+{
+    Statistics statistics;
+    statistics.numFilesParsed = numSTGFilesParsed;
+    statistics.numCacheHits = numSTGCacheHits;
+    statistics.parseTimeMSecs = stgParseTimeMSecs;
+    statistics.numOptions = numSTGOptions;
+    statistics.numSharedOptions = numSTGSharedOptions;
+    return statistics;
+}
+
 void ReaderWriterSTG::setSTGObjectHandler(const std::string &token, STGObjectCallback callback)
 {
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(globalStgObjectCallbackLock);
@@ -47,6 +47,16 @@ public:
     //add/remove a callback that is invoked for unknown STG token
     static void setSTGObjectHandler(const std::string &token, STGObjectCallback callback);
     static void removeSTGObjectHandler(const std::string &token, STGObjectCallback callback);
+
+    // Counters of the STG files read so far, for statistics
+    struct Statistics {
+        unsigned numFilesParsed;    // STG files read and split into lines
+        unsigned numCacheHits;      // STG files taken from the parse cache
+        double parseTimeMSecs;      // time spent reading and splitting
+        unsigned numOptions;        // model options created
+        unsigned numSharedOptions;  // objects that reused the options of another
+    };
+    static Statistics getStatistics();
 private:
     struct _ModelBin;
 };
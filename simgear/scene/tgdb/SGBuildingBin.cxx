@@ -42,10 +42,10 @@
 #include <osgDB/FileUtils>
 
 #include <simgear/debug/logstream.hxx>
-#include <simgear/io/iostreams/sgstream.hxx>
 #include <simgear/math/SGLimits.hxx>
 #include <simgear/math/SGMisc.hxx>
 #include <simgear/math/sg_random.hxx>
+#include <simgear/misc/ListFileReader.hxx>
 #include <simgear/misc/sg_path.hxx>
 #include <simgear/scene/model/model.hxx>
 #include <simgear/props/props.hxx>
@@ -424,29 +424,22 @@ typedef QuadTreeBuilder<LOD*, SGBuildingBin::BuildingInstance, MakeBuildingLeaf,
       return;
     }
 
-    sg_gzifstream stream(absoluteFileName);
-    if (!stream.is_open()) {
+    ListFileReader reader(absoluteFileName);
+    if (!reader.is_open()) {
       SG_LOG(SG_TERRAIN, SG_ALERT, "Unable to open " << absoluteFileName);
       return;
     }
 
-    while (!stream.eof()) {
-      // read a line.  Each line defines a single building position, and may have
-      // a comment, starting with #
-      std::string line;
-      std::getline(stream, line);
-
-      // strip comments
-      std::string::size_type hash_pos = line.find('#');
-      if (hash_pos != std::string::npos)
-          line.resize(hash_pos);
-
+    // read a line.  Each line defines a single building position, and may have
+    // a comment, starting with #, which the reader strips
+    std::string_view line;
+    while (reader.nextLine(line)) {
       if (line.empty()) {
           continue; // skip blank lines
       }
 
       // and process further
-      std::stringstream in(line);
+      NumberScanner in(line);
 
       // Line format is X Y Z R B W D H P S O F WT RT
       // where:
@@ -468,15 +461,13 @@ typedef QuadTreeBuilder<LOD*, SGBuildingBin::BuildingInstance, MakeBuildingLeaf,
       // RT is the texture index to use (integer) for roofs. Buildings with the same RT value will have the same roof texture assigned.  There are 6 small, 6 medium and 4 large textures.
       float x = 0.0f, y = 0.0f, z = 0.0f, r = 0.0f, w = 0.0f, d = 0.0f, h = 0.0f, p = 0.0f;
       int b = 0, s = 0, o = 0, f = 0, wt = 0, rt = 0;
-      in >> x >> y >> z >> r >> b;
-
-      if (in.bad() || in.fail()) {
+      if (!in.read(x, y, z, r, b)) {
           SG_LOG(SG_TERRAIN, SG_WARN, "Error parsing build entry in: " << absoluteFileName << " line: \"" << line << "\"");
           continue;
       }
 
       // these might fail, so check them after we look at failbit
-      in >> w >> d >> h >> p >> s >> o >> f >> wt >> rt;
+      in.read(w, d, h, p, s, o, f, wt, rt);
 
       //SG_LOG(SG_TERRAIN, SG_ALERT, "Building entry " << x << " " << y << " " << z << " " << b );
       SGVec3f loc = SGVec3f(x,y,z);
@@ -496,8 +487,6 @@ typedef QuadTreeBuilder<LOD*, SGBuildingBin::BuildingInstance, MakeBuildingLeaf,
         insert(loc, rot, type, w, d, h, p, f, s, o, wt, rt);
       }
     }
-
-    stream.close();
   };
 
   // Set up the building set based on the material definitions
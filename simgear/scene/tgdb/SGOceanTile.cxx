@@ -26,6 +26,9 @@
 #include "SGOceanTile.hxx"
 
 #include <math.h>
+#include <map>
+#include <mutex>
+#include <tuple>
 #include <simgear/compiler.h>
 
 #include <osg/Geode>
@@ -60,17 +63,24 @@ using namespace simgear;
 // mesh; the points for the top apron come last. This order should
 // help with things like vertex caching in the OpenGL driver, though
 // it may be superfluous for such a small mesh.
+//
+// The vertices and normals are relative to the tile center in its
+// horizontal frame, so they are the same for all buckets of a latitude
+// band; only the texture coordinates depend on the longitude. They are
+// computed once per band, see OceanTemplate.
 namespace
 {
 class OceanMesh {
 public:
-    OceanMesh(int latP, int lonP):
+    // The vertices and normals are passed in, either new arrays to compute
+    // or the ones of the latitude band
+    OceanMesh(int latP, int lonP, osg::Vec3Array* v, osg::Vec3Array* n):
         latPoints(latP),
         lonPoints(lonP),
         geoPoints(latPoints * lonPoints + 2 * (lonPoints + latPoints)),
         geod_nodes(latPoints * lonPoints),
-        vl(new osg::Vec3Array(geoPoints)),
-        nl(new osg::Vec3Array(geoPoints)),
+        vl(v),
+        nl(n),
         tl(new osg::Vec2Array(geoPoints)),
         vlArray(*vl, lonPoints + 2, lonPoints, 1),
         nlArray(*nl, lonPoints + 2, lonPoints, 1),
@@ -99,27 +109,28 @@ public:
 
     osg::Vec3Array* vl;
     osg::Vec3Array* nl;
-    osg::Vec2Array* tl;
+    osg::ref_ptr<osg::Vec2Array> tl;
     VectorArrayAdapter<osg::Vec3Array> vlArray;
     VectorArrayAdapter<osg::Vec3Array> nlArray;
     VectorArrayAdapter<osg::Vec2Array> tlArray;
 
-    void calcMesh(const SGVec3d& cartCenter, const SGQuatd& orient,
-                  double clon, double clat,
-                  double height, double width, double tex_width);
+    void calcGeod(double clon, double clat, double height, double width);
+    void calcVertices(const SGVec3d& cartCenter, const SGQuatd& orient);
+    void calcTexCoords(double clat, double tex_width);
+    template<typename F>
+    void forEachApronPt(F f) const;
     void calcApronPt(int latIdx, int lonIdx, int latInner, int lonInner,
-                     int destIdx, double tex_width);
-    void calcApronPts(double tex_width);
+                     int destIdx);
+    void calcApronTexCoord(int latIdx, int lonIdx, int latInner, int lonInner,
+                           int destIdx, double tex_width);
     
 };
 
-void OceanMesh::calcMesh(const SGVec3d& cartCenter, const SGQuatd& orient,
-                         double clon, double clat,
-                         double height, double width, double tex_width)
+void OceanMesh::calcGeod(double clon, double clat, double height, double width)
 {
-    // Calculate vertices. By splitting the tile up into 4 quads on a
-    // side we avoid curvature-of-the-earth problems; the error should
-    // be less than .5 meters.
+    // By splitting the tile up into 4 quads on a side we avoid
+    // curvature-of-the-earth problems; the error should be less than
+    // .5 meters.
     double longInc = width * .25;
     double latInc = height * .25;
     double startLat = clat - height * .5;
@@ -129,13 +140,32 @@ void OceanMesh::calcMesh(const SGVec3d& cartCenter, const SGQuatd& orient,
         for (int i = 0; i < lonPoints; i++) {
             int index = (j * lonPoints) + i;
             geod[index] = SGGeod::fromDeg(startLon + i * longInc, lat);
+        }
+    }
+}
+
+void OceanMesh::calcVertices(const SGVec3d& cartCenter, const SGQuatd& orient)
+{
+    for (int j = 0; j < latPoints; j++) {
+        for (int i = 0; i < lonPoints; i++) {
+            int index = (j * lonPoints) + i;
             SGVec3d cart = SGVec3d::fromGeod(geod[index]);
             rel[index] = orient.transform(cart - cartCenter);
             normals[index] = toVec3f(orient.transform(normalize(cart)));
         }
     }
-    
-    // Calculate texture coordinates
+
+    for (int j = 0; j < latPoints; j++) {
+        for (int i = 0; i < lonPoints; ++i) {
+            int index = (j * lonPoints) + i;
+            vlArray(j, i) = toOsg(rel[index]);
+            nlArray(j, i) = toOsg(normals[index]);
+        }
+    }
+}
+
+void OceanMesh::calcTexCoords(double clat, double tex_width)
+{
     typedef std::vector<SGGeod> GeodVector;
     
     GeodVector geod_nodes(latPoints * lonPoints);
@@ -159,9 +189,6 @@ void OceanMesh::calcMesh(const SGVec3d& cartCenter, const SGQuatd& orient,
   
     for (int j = 0; j < latPoints; j++) {
         for (int i = 0; i < lonPoints; ++i) {
-            int index = (j * lonPoints) + i;
-            vlArray(j, i) = toOsg(rel[index]);
-            nlArray(j, i) = toOsg(normals[index]);
             tlArray(j, i) = toOsg(texsArray(j, i));
         }
     }
@@ -174,7 +201,7 @@ void OceanMesh::calcMesh(const SGVec3d& cartCenter, const SGQuatd& orient,
 // normals of the apron polygons will be the same as the those of
 // the points on the edge to better disguise the apron.
 void OceanMesh::calcApronPt(int latIdx, int lonIdx, int latInner, int lonInner,
-                            int destIdx, double tex_width)
+                            int destIdx)
 {
     static const float downDist = 150.0f;
     static const float outDist = 40.0f;
@@ -203,6 +230,13 @@ void OceanMesh::calcApronPt(int latIdx, int lonIdx, int latInner, int lonInner,
     (*vl)[destIdx]
         = edgePt - nlArray(latIdx, lonIdx) * downDist + outVec * outDist;
     (*nl)[destIdx] = nlArray(latIdx, lonIdx);
+}
+
+void OceanMesh::calcApronTexCoord(int latIdx, int lonIdx, int latInner, int lonInner,
+                                  int destIdx, double tex_width)
+{
+    static const float downDist = 150.0f;
+    static const float outDist = 40.0f;
     static const float apronDist
         = sqrtf(downDist * downDist  + outDist * outDist);
     float texDelta = apronDist / tex_width;
@@ -223,18 +257,19 @@ void OceanMesh::calcApronPt(int latIdx, int lonIdx, int latInner, int lonInner,
     }
 }
 
-void OceanMesh::calcApronPts(double tex_width)
+// Call f(latIdx, lonIdx, latInner, lonInner, destIdx) for every apron point
+template<typename F>
+void OceanMesh::forEachApronPt(F f) const
 {
     for (int i = 0; i < lonPoints; i++)
-        calcApronPt(0, i, 1, i, i, tex_width);
+        f(0, i, 1, i, i);
     int topApronOffset = latPoints + (2 + lonPoints) * latPoints;
     for (int i = 0; i < lonPoints; i++)
-        calcApronPt(latPoints - 1, i, latPoints - 2, i,
-                    i + topApronOffset, tex_width);
+        f(latPoints - 1, i, latPoints - 2, i, i + topApronOffset);
     for (int i = 0; i < latPoints; i++) {
-        calcApronPt(i, 0, i, 1, lonPoints + i * (lonPoints + 2), tex_width);
-        calcApronPt(i, lonPoints - 1, i, lonPoints - 2,
-                    lonPoints + i * (lonPoints + 2) + 1 + lonPoints, tex_width);
+        f(i, 0, i, 1, lonPoints + i * (lonPoints + 2));
+        f(i, lonPoints - 1, i, lonPoints - 2,
+          lonPoints + i * (lonPoints + 2) + 1 + lonPoints);
     }
 }
 
@@ -271,6 +306,65 @@ void fillDrawElementsWithApron(short height, short width,
     fillDrawElementsRow(width, topApronBottom, topApronBottom + width + 1,
                         elements);
 }
+
+// The geometry shared by the ocean tiles of a latitude band
+struct OceanTemplate : public osg::Referenced {
+    osg::ref_ptr<osg::Vec3Array> vl;
+    osg::ref_ptr<osg::Vec3Array> nl;
+    osg::ref_ptr<osg::Vec4Array> cl;
+    osg::ref_ptr<osg::DrawElementsUShort> drawElements;
+};
+
+// Keyed by center latitude, height, width and the points of the mesh
+typedef std::tuple<double, double, double, int, int> OceanTemplateKey;
+std::map<OceanTemplateKey, osg::ref_ptr<OceanTemplate> > oceanTemplates;
+std::mutex oceanTemplatesMutex;
+
+osg::ref_ptr<OceanTemplate> getOceanTemplate(const SGBucket& b, int latPoints, int lonPoints)
+{
+    OceanTemplateKey key(b.get_center_lat(), b.get_height(), b.get_width(),
+                         latPoints, lonPoints);
+    {
+        std::lock_guard<std::mutex> lock(oceanTemplatesMutex);
+        std::map<OceanTemplateKey, osg::ref_ptr<OceanTemplate> >::iterator it;
+        it = oceanTemplates.find(key);
+        if (it != oceanTemplates.end())
+            return it->second;
+    }
+
+    osg::ref_ptr<OceanTemplate> oceanTemplate = new OceanTemplate;
+    int geoPoints = latPoints * lonPoints + 2 * (lonPoints + latPoints);
+    oceanTemplate->vl = new osg::Vec3Array(geoPoints);
+    oceanTemplate->nl = new osg::Vec3Array(geoPoints);
+    OceanMesh grid(latPoints, lonPoints, oceanTemplate->vl.get(), oceanTemplate->nl.get());
+
+    // Calculate center point
+    SGVec3d cartCenter = SGVec3d::fromGeod(b.get_center());
+    SGGeod geodPos = SGGeod::fromCart(cartCenter);
+    SGQuatd hlOr = SGQuatd::fromLonLat(geodPos)*SGQuatd::fromEulerDeg(0, 0, 180);
+
+    grid.calcGeod(b.get_center_lon(), b.get_center_lat(), b.get_height(), b.get_width());
+    grid.calcVertices(cartCenter, hlOr);
+    grid.forEachApronPt([&grid](int latIdx, int lonIdx, int latInner, int lonInner, int destIdx) {
+        grid.calcApronPt(latIdx, lonIdx, latInner, lonInner, destIdx);
+    });
+
+    oceanTemplate->cl = new osg::Vec4Array;
+    oceanTemplate->cl->push_back(osg::Vec4(1, 1, 1, 1));
+
+    // Allocate the indices for triangles in the mesh and the apron
+    oceanTemplate->drawElements
+        = new osg::DrawElementsUShort(GL_TRIANGLES,
+                                      6 * ((latPoints - 1) * (lonPoints + 1)
+                                           + 2 * (latPoints - 1)));
+    fillDrawElementsWithApron(latPoints, lonPoints, oceanTemplate->drawElements->begin());
+
+    std::lock_guard<std::mutex> lock(oceanTemplatesMutex);
+    osg::ref_ptr<OceanTemplate>& cached = oceanTemplates[key];
+    if (!cached.valid())
+        cached = oceanTemplate;
+    return cached;
+}
 }
 
 osg::Node* SGOceanTile(const SGBucket& b, SGMaterialLib *matlib, int latPoints, int lonPoints)
@@ -293,7 +387,11 @@ osg::Node* SGOceanTile(const SGBucket& b, SGMaterialLib *matlib, int latPoints,
     } else {
         SG_LOG( SG_TERRAIN, SG_ALERT, "Ack! unknown use material name = Ocean");
     }
-    OceanMesh grid(latPoints, lonPoints);
+    // The vertices, normals, color and indices are shared by the
+    // latitude band, only the texture coordinates are computed here
+    osg::ref_ptr<OceanTemplate> oceanTemplate = getOceanTemplate(b, latPoints, lonPoints);
+    OceanMesh grid(latPoints, lonPoints, oceanTemplate->vl.get(), oceanTemplate->nl.get());
+
     // Calculate center point
     SGVec3d cartCenter = SGVec3d::fromGeod(b.get_center());
     SGGeod geodPos = SGGeod::fromCart(cartCenter);
@@ -304,28 +402,21 @@ osg::Node* SGOceanTile(const SGBucket& b, SGMaterialLib *matlib, int latPoints,
     double height = b.get_height();
     double width = b.get_width();
 
-    grid.calcMesh(cartCenter, hlOr, clon, clat, height, width, tex_width);
-    grid.calcApronPts(tex_width);
-  
-    osg::Vec4Array* cl = new osg::Vec4Array;
-    cl->push_back(osg::Vec4(1, 1, 1, 1));
+    grid.calcGeod(clon, clat, height, width);
+    grid.calcTexCoords(clat, tex_width);
+    grid.forEachApronPt([&grid, tex_width](int latIdx, int lonIdx, int latInner, int lonInner, int destIdx) {
+        grid.calcApronTexCoord(latIdx, lonIdx, latInner, lonInner, destIdx, tex_width);
+    });
   
     osg::Geometry* geometry = new osg::Geometry;
     geometry->setDataVariance(osg::Object::STATIC);
-    geometry->setVertexArray(grid.vl);
-    geometry->setNormalArray(grid.nl);
+    geometry->setVertexArray(oceanTemplate->vl.get());
+    geometry->setNormalArray(oceanTemplate->nl.get());
     geometry->setNormalBinding(osg::Geometry::BIND_PER_VERTEX);
-    geometry->setColorArray(cl);
+    geometry->setColorArray(oceanTemplate->cl.get());
     geometry->setColorBinding(osg::Geometry::BIND_OVERALL);
-    geometry->setTexCoordArray(0, grid.tl);
-
-    // Allocate the indices for triangles in the mesh and the apron
-    osg::DrawElementsUShort* drawElements
-        = new osg::DrawElementsUShort(GL_TRIANGLES,
-                                      6 * ((latPoints - 1) * (lonPoints + 1)
-                                           + 2 * (latPoints - 1)));
-    fillDrawElementsWithApron(latPoints, lonPoints, drawElements->begin());
-    geometry->addPrimitiveSet(drawElements);
+    geometry->setTexCoordArray(0, grid.tl.get());
+    geometry->addPrimitiveSet(oceanTemplate->drawElements.get());
 
     EffectGeode* geode = new EffectGeode;
     geode->setName("Ocean tile");
@@ -30,6 +30,8 @@
 #include <osg/Texture2D>
 #include <osg/ref_ptr>
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 
 #include <simgear/math/sg_random.hxx>
 #include <simgear/scene/util/OsgMath.hxx>
@@ -77,6 +79,52 @@ struct SGVertNormTex {
     }
   };
 
+  // Hash and equality matching the equivalence of less: texture
+  // coordinates only take part if both vertices have them, so they
+  // are left out of the hash.
+  struct hash
+  {
+    static inline size_t bits( float f )
+    {
+      // -0 and 0 are equal
+      if (f == 0) return 0;
+      uint32_t u;
+      memcpy(&u, &f, sizeof(u));
+      return u;
+    }
+
+    inline size_t operator() (const SGVertNormTex& v) const
+    {
+      uint64_t h = 0;
+      for (unsigned i = 0; i < 3; ++i) {
+        h = (h ^ bits(v.vertex[i])) * 0x9e3779b97f4a7c15ull;
+        h = (h ^ bits(v.normal[i])) * 0x9e3779b97f4a7c15ull;
+      }
+      return size_t(h ^ (h >> 32));
+    }
+  };
+
+  struct equal
+  {
+    inline bool tc_is_equal ( const SGVertNormTex& l,
+                              const SGVertNormTex& r,
+                              int   idx ) const
+    {
+        if ( (l.tc_mask & r.tc_mask) & 1<<idx ) {
+            return l.texCoord[idx] == r.texCoord[idx];
+        }
+        return true;
+    }
+
+    inline bool operator() (const SGVertNormTex& l,
+                            const SGVertNormTex& r) const
+    {
+      return l.vertex == r.vertex && l.normal == r.normal &&
+             tc_is_equal( l, r, 0 ) && tc_is_equal( l, r, 1 ) &&
+             tc_is_equal( l, r, 2 ) && tc_is_equal( l, r, 3 );
+    }
+  };
+
   void SetVertex( const SGVec3f& v )          { vertex = v; }
   const SGVec3f& GetVertex( void ) const      { return vertex; }
   
@@ -35,6 +35,7 @@
 #include <simgear/scene/util/QuadTreeBuilder.hxx>
 #include <simgear/scene/util/SGReaderWriterOptions.hxx>
 #include <simgear/scene/util/OptionsReadFileCallback.hxx>
+#include <simgear/scene/util/ParallelFor.hxx>
 #include <simgear/scene/util/SGNodeMasks.hxx>
 #include <simgear/debug/ErrorReportingCallback.hxx>
 
@@ -638,10 +639,11 @@ public:
     {        
         unsigned int i;
         
-        // generate a repeatable random seed
-        mt seed;
-        mt_init(&seed, unsigned(586));
-        
+        // Every SGTriangleInfo has its own random seed, so the points of
+        // the materials are generated in parallel and then added to the
+        // bins in material order, the same as one after the other.
+        std::vector<osg::Texture2D*> masks(matTris.size());
+        std::vector<unsigned> tasks;
         for ( i=0; i<matTris.size(); i++ ) {
             SGMaterial *mat = matTris[i].getMaterial();
             if (!mat)
@@ -650,7 +652,29 @@ public:
             float wood_coverage = mat->get_wood_coverage();
             if ((wood_coverage <= 0) || (vegetation_density <= 0))
                 continue;
-            
+
+            masks[i] = mat->get_one_object_mask(matTris[i].getTextureIndex());
+            tasks.push_back(i);
+        }
+
+        std::vector<std::vector<SGVec3f> > randomPoints(matTris.size());
+        std::vector<std::vector<SGVec3f> > randomPointNormals(matTris.size());
+        parallelFor(tasks.size(), [&](unsigned task) {
+            unsigned m = tasks[task];
+            SGMaterial *mat = matTris[m].getMaterial();
+            matTris[m].addRandomTreePoints(mat->get_wood_coverage(),
+                                           masks[m],
+                                           vegetation_density,
+                                           mat->get_cos_tree_max_density_slope_angle(),
+                                           mat->get_cos_tree_zero_density_slope_angle(),
+                                           mat->get_is_plantation(),
+                                           randomPoints[m],
+                                           randomPointNormals[m]);
+        });
+
+        for (unsigned m : tasks) {
+            SGMaterial *mat = matTris[m].getMaterial();
+
             // Attributes that don't vary by tree but do vary by material
             bool found = false;
             TreeBin* bin = NULL;
@@ -681,20 +705,9 @@ public:
                 randomForest.push_back(bin);
             }
             
-            std::vector<SGVec3f> randomPoints;
-            std::vector<SGVec3f> randomPointNormals;
-            matTris[i].addRandomTreePoints(wood_coverage,
-                                           mat->get_one_object_mask(matTris[i].getTextureIndex()),
-                                           vegetation_density,
-                                           mat->get_cos_tree_max_density_slope_angle(),
-                                           mat->get_cos_tree_zero_density_slope_angle(),
-                                           mat->get_is_plantation(),
-                                           randomPoints,
-                                           randomPointNormals);
-            
             std::vector<SGVec3f>::iterator k;
             std::vector<SGVec3f>::iterator j;
-            for (k = randomPoints.begin(), j = randomPointNormals.begin(); k != randomPoints.end(); ++k, ++j) {
+            for (k = randomPoints[m].begin(), j = randomPointNormals[m].begin(); k != randomPoints[m].end(); ++k, ++j) {
 	              bin->insert(*k, *j);
             }
         }
@@ -717,6 +730,10 @@ public:
         mt seed;
         mt_init(&seed, unsigned(123));
 
+        // As for the forest, the points are generated in parallel and the
+        // colors are assigned in material order.
+        std::vector<osg::Texture2D*> masks(matTris.size());
+        std::vector<unsigned> tasks;
         for ( i=0; i<matTris.size(); i++ ) {
             SGMaterial *mat = matTris[i].getMaterial();
             if (!mat)
@@ -727,11 +744,20 @@ public:
                 continue;
                         
             int texIndex = matTris[i].getTextureIndex();
-            
-            std::vector<SGVec3f> randomPoints;
-            matTris[i].addRandomSurfacePoints(coverage, 3, mat->get_one_object_mask(texIndex), randomPoints);
+            masks[i] = mat->get_one_object_mask(texIndex);
+            tasks.push_back(i);
+        }
+
+        std::vector<std::vector<SGVec3f> > randomPoints(matTris.size());
+        parallelFor(tasks.size(), [&](unsigned task) {
+            unsigned m = tasks[task];
+            float coverage = matTris[m].getMaterial()->get_light_coverage();
+            matTris[m].addRandomSurfacePoints(coverage, 3, masks[m], randomPoints[m]);
+        });
+
+        for (unsigned m : tasks) {
             std::vector<SGVec3f>::iterator j;
-            for (j = randomPoints.begin(); j != randomPoints.end(); ++j) {
+            for (j = randomPoints[m].begin(); j != randomPoints[m].end(); ++j) {
                 float zombie = mt_rand(&seed);
                 // factor = sg_random() ^ 2, range = 0 .. 1 concentrated towards 0
                 float factor = mt_rand(&seed);
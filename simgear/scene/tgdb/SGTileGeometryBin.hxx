@@ -8,6 +8,7 @@
 #include <simgear/scene/material/EffectGeode.hxx>
 #include <simgear/scene/material/matlib.hxx>
 #include <simgear/scene/material/mat.hxx>
+#include <simgear/scene/util/ParallelFor.hxx>
 
 #include "SGTexturedTriangleBin.hxx"
 
@@ -226,6 +227,15 @@ public:
     }
   }
 
+  // The groups of one material, in file order
+  struct MaterialGroups {
+    MaterialGroups() : triangles(0), numTriangles(0), tc0Scale(1, 1) {}
+    std::vector<unsigned> tris, strips, fans;
+    SGTexturedTriangleBin* triangles;
+    unsigned numTriangles;
+    SGVec2f tc0Scale;
+  };
+
   bool
   insertSurfaceGeometry(const SGBinObject& obj, SGMaterialCache* matcache)
   {
@@ -235,41 +245,72 @@ public:
              "Group list sizes for triangles do not match!");
       return false;
     }
-
-    for (unsigned grp = 0; grp < obj.get_tris_v().size(); ++grp) {
-      std::string materialName = obj.get_tri_materials()[grp];
-      SGVec2f tc0Scale = getTexCoordScale(materialName, matcache);
-      SGVec2f tc1Scale(1.0, 1.0);
-      addTriangleGeometry(materialTriangleMap[materialName],
-                          obj, grp, tc0Scale, tc1Scale );
-    }
-
     if (obj.get_strips_n().size() < obj.get_strips_v().size() ||
         obj.get_strips_tcs().size() < obj.get_strips_v().size()) {
       SG_LOG(SG_TERRAIN, SG_ALERT,
              "Group list sizes for strips do not match!");
       return false;
     }
-    for (unsigned grp = 0; grp < obj.get_strips_v().size(); ++grp) {
-      std::string materialName = obj.get_strip_materials()[grp];
-      SGVec2f tc0Scale = getTexCoordScale(materialName, matcache);
-      SGVec2f tc1Scale(1.0, 1.0);
-      addStripGeometry(materialTriangleMap[materialName],
-                          obj, grp, tc0Scale, tc1Scale);
-    }
-
     if (obj.get_fans_n().size() < obj.get_fans_v().size() ||
         obj.get_fans_tcs().size() < obj.get_fans_v().size()) {
       SG_LOG(SG_TERRAIN, SG_ALERT,
              "Group list sizes for fans do not match!");
       return false;
     }
+
+    // Sort the groups by material.  Each material bin only depends on its
+    // own groups, so the bins can be built in parallel and still come out
+    // the same as if all groups were added one after the other.
+    std::map<std::string,MaterialGroups> materialGroups;
+    for (unsigned grp = 0; grp < obj.get_tris_v().size(); ++grp) {
+      MaterialGroups& groups = materialGroups[obj.get_tri_materials()[grp]];
+      groups.tris.push_back(grp);
+      groups.numTriangles += obj.get_tris_v()[grp].size()/3;
+    }
+    for (unsigned grp = 0; grp < obj.get_strips_v().size(); ++grp) {
+      MaterialGroups& groups = materialGroups[obj.get_strip_materials()[grp]];
+      groups.strips.push_back(grp);
+      if (obj.get_strips_v()[grp].size() > 2)
+        groups.numTriangles += obj.get_strips_v()[grp].size() - 2;
+    }
     for (unsigned grp = 0; grp < obj.get_fans_v().size(); ++grp) {
-      std::string materialName = obj.get_fan_materials()[grp];
-      SGVec2f tc0Scale = getTexCoordScale(materialName, matcache);
+      MaterialGroups& groups = materialGroups[obj.get_fan_materials()[grp]];
+      groups.fans.push_back(grp);
+      if (obj.get_fans_v()[grp].size() > 2)
+        groups.numTriangles += obj.get_fans_v()[grp].size() - 2;
+    }
+
+    // Everything shared is looked up here, the tasks only touch their bin.
+    // Sizing the bins up front saves rehashing the vertex and edge tables.
+    std::vector<MaterialGroups*> tasks;
+    unsigned numTriangles = 0;
+    std::map<std::string,MaterialGroups>::iterator i;
+    for (i = materialGroups.begin(); i != materialGroups.end(); ++i) {
+      MaterialGroups& groups = i->second;
+      groups.triangles = &materialTriangleMap[i->first];
+      groups.triangles->reserve(groups.triangles->getNumTriangles() + groups.numTriangles);
+      groups.tc0Scale = getTexCoordScale(i->first, matcache);
+      tasks.push_back(&groups);
+      numTriangles += groups.numTriangles;
+    }
+
+    auto insertGroups = [&obj, &tasks](unsigned task) {
+      const MaterialGroups& groups = *tasks[task];
       SGVec2f tc1Scale(1.0, 1.0);
-      addFanGeometry(materialTriangleMap[materialName],
-                       obj, grp, tc0Scale, tc1Scale );
+      for (unsigned grp : groups.tris)
+        addTriangleGeometry(*groups.triangles, obj, grp, groups.tc0Scale, tc1Scale);
+      for (unsigned grp : groups.strips)
+        addStripGeometry(*groups.triangles, obj, grp, groups.tc0Scale, tc1Scale);
+      for (unsigned grp : groups.fans)
+        addFanGeometry(*groups.triangles, obj, grp, groups.tc0Scale, tc1Scale);
+    };
+
+    // Not worth a thread for small tiles
+    if (numTriangles < 4096) {
+      for (unsigned task = 0; task < tasks.size(); ++task)
+        insertGroups(task);
+    } else {
+      parallelFor(tasks.size(), insertGroups);
     }
     return true;
   }
@@ -285,7 +326,12 @@ public:
         group->setName("surfaceGeometryGroup");
     }
 
-    //osg::Geode* geode = new osg::Geode;
+    // The materials and effects are looked up one after the other, the
+    // geometries and their generated arrays are built in parallel.
+    std::vector<const SGTexturedTriangleBin*> triangles;
+    std::vector<osg::ref_ptr<EffectGeode> > geodes;
+    std::vector<bool> includeNormals;
+    unsigned numTriangles = 0;
     SGMaterialTriangleMap::const_iterator i;
     for (i = materialTriangleMap.begin(); i != materialTriangleMap.end(); ++i) {
       SGMaterial *mat = NULL;
@@ -312,11 +358,30 @@ public:
               include_normals = false;
       }
 
-      osg::Geometry* geometry = i->second.buildGeometry(useVBOs, include_normals);
-      eg->runGenerators(geometry);  // Generate extra data needed by effect
-      eg->addDrawable(geometry);
+      triangles.push_back(&i->second);
+      geodes.push_back(eg);
+      includeNormals.push_back(include_normals);
+      numTriangles += i->second.getNumTriangles();
+    }
+
+    std::vector<osg::ref_ptr<osg::Geometry> > geometries(geodes.size());
+    auto build = [&](unsigned k) {
+      geometries[k] = triangles[k]->buildGeometry(useVBOs, includeNormals[k]);
+      geodes[k]->runGenerators(geometries[k].get());  // Generate extra data needed by effect
+    };
+
+    // Not worth a thread for small tiles
+    if (numTriangles < 4096) {
+      for (unsigned k = 0; k < geodes.size(); ++k)
+        build(k);
+    } else {
+      parallelFor(geodes.size(), build);
+    }
+
+    for (unsigned k = 0; k < geodes.size(); ++k) {
+      geodes[k]->addDrawable(geometries[k].get());
       if (group) {
-        group->addChild(eg);
+        group->addChild(geodes[k].get());
       }
     }
 
@@ -22,8 +22,9 @@
 #ifndef SG_TRIANGLE_BIN_HXX
 #define SG_TRIANGLE_BIN_HXX
 
+#include <stdint.h>
+#include <list>
 #include <vector>
-#include <map>
 #include "SGVertexArrayBin.hxx"
 
 template<typename T>
@@ -36,19 +37,38 @@ public:
   typedef SGVec3<index_type> triangle_ref;
   typedef std::vector<triangle_ref> TriangleVector;
   typedef std::vector<index_type> TriangleList;
-  typedef std::map<edge_ref,TriangleList> EdgeMap;
+
+  SGTriangleBin()
+#ifdef BUILD_EDGE_MAP
+    : _edgeMask(0), _numEdgeKeys(0)
+#endif
+  { }
+
+  /// Make room for numTriangles triangles.  The number of distinct
+  /// vertices is not known up front, a connected mesh has about as many
+  /// vertices as triangles.
+  void reserve(index_type numTriangles)
+  {
+    SGVertexArrayBin<T>::reserve(numTriangles);
+    _triangleVector.reserve(numTriangles);
+#ifdef BUILD_EDGE_MAP
+    _edgeNext.reserve(3*numTriangles);
+    if (_edgeSlots.size() < 6*numTriangles)
+      rehashEdges(6*numTriangles);
+#endif
+  }
 
   void insert(const value_type& v0, const value_type& v1, const value_type& v2)
   {
     index_type i0 = SGVertexArrayBin<T>::insert(v0);
     index_type i1 = SGVertexArrayBin<T>::insert(v1);
     index_type i2 = SGVertexArrayBin<T>::insert(v2);
-    index_type triangleIndex = _triangleVector.size();
     _triangleVector.push_back(triangle_ref(i0, i1, i2));
 #ifdef BUILD_EDGE_MAP
-    _edgeMap[edge_ref(i0, i1)].push_back(triangleIndex);
-    _edgeMap[edge_ref(i1, i2)].push_back(triangleIndex);
-    _edgeMap[edge_ref(i2, i0)].push_back(triangleIndex);
+    index_type edge = 3*(_triangleVector.size() - 1);
+    insertEdge(edge);
+    insertEdge(edge + 1);
+    insertEdge(edge + 2);
 #endif
   }
 
@@ -84,17 +104,13 @@ public:
         edge_ref edge = edgeStack.back();
         edgeStack.pop_back();
         
-        typename EdgeMap::const_iterator emiList[2] = {
-          _edgeMap.find(edge),
-          _edgeMap.find(edge_ref(edge[1], edge[0]))
+        index_type emiList[2] = {
+          findEdge(edge),
+          findEdge(edge_ref(edge[1], edge[0]))
         };
         for (unsigned ei = 0; ei < 2; ++ei) {
-          typename EdgeMap::const_iterator emi = emiList[ei];
-          if (emi == _edgeMap.end())
-            continue;
-
-          for (unsigned ti = 0; ti < emi->second.size(); ++ti) {
-            index_type triangleIndex = emi->second[ti];
+          for (index_type e = emiList[ei]; e != emptySlot(); e = _edgeNext[e]) {
+            index_type triangleIndex = e/3;
             if (processedTriangles[triangleIndex])
               continue;
 
@@ -114,9 +130,86 @@ public:
 #endif
 
 private:
+#ifdef BUILD_EDGE_MAP
+  // The directed edges are numbered 3*triangle + k, edge k running from
+  // vertex k to vertex k + 1 of the triangle.  The open addressing
+  // table maps each distinct edge to the last one inserted, _edgeNext
+  // chains the triangles sharing it.
+  static index_type emptySlot()
+  { return ~index_type(0); }
+
+  edge_ref getEdge(index_type edge) const
+  {
+    const triangle_ref& triangleRef = _triangleVector[edge/3];
+    unsigned k = edge % 3;
+    return edge_ref(triangleRef[k], triangleRef[(k + 1) % 3]);
+  }
+
+  static size_t hashEdge(const edge_ref& edge)
+  {
+    uint64_t h = (uint64_t(edge[0]) * 0x9e3779b97f4a7c15ull) ^ uint64_t(edge[1]);
+    h *= 0xbf58476d1ce4e5b9ull;
+    return size_t(h ^ (h >> 31));
+  }
+
+  index_type findEdge(const edge_ref& edge) const
+  {
+    if (_edgeSlots.empty())
+      return emptySlot();
+    for (size_t slot = hashEdge(edge) & _edgeMask; ; slot = (slot + 1) & _edgeMask) {
+      index_type e = _edgeSlots[slot];
+      if (e == emptySlot() || getEdge(e) == edge)
+        return e;
+    }
+  }
+
+  void insertEdge(index_type e)
+  {
+    // Keep the table at most half full
+    if (_edgeSlots.size() < 2*(_numEdgeKeys + 1))
+      rehashEdges(2*(_numEdgeKeys + 1));
+
+    edge_ref edge = getEdge(e);
+    for (size_t slot = hashEdge(edge) & _edgeMask; ; slot = (slot + 1) & _edgeMask) {
+      index_type head = _edgeSlots[slot];
+      if (head == emptySlot()) {
+        ++_numEdgeKeys;
+      } else if (getEdge(head) != edge) {
+        continue;
+      }
+      _edgeNext.push_back(head);
+      _edgeSlots[slot] = e;
+      return;
+    }
+  }
+
+  void rehashEdges(index_type minSlots)
+  {
+    index_type numSlots = 16;
+    while (numSlots < minSlots)
+      numSlots *= 2;
+    std::vector<index_type> slots(numSlots, emptySlot());
+    size_t mask = numSlots - 1;
+    for (size_t i = 0; i < _edgeSlots.size(); ++i) {
+      index_type head = _edgeSlots[i];
+      if (head == emptySlot())
+        continue;
+      size_t slot = hashEdge(getEdge(head)) & mask;
+      while (slots[slot] != emptySlot())
+        slot = (slot + 1) & mask;
+      slots[slot] = head;
+    }
+    _edgeSlots.swap(slots);
+    _edgeMask = mask;
+  }
+#endif
+
   TriangleVector _triangleVector;
 #ifdef BUILD_EDGE_MAP
-  EdgeMap _edgeMap;
+  std::vector<index_type> _edgeSlots;
+  std::vector<index_type> _edgeNext;
+  size_t _edgeMask;
+  index_type _numEdgeKeys;
 #endif
 };
 
@@ -23,27 +23,52 @@
 #define SG_VERTEX_ARRAY_BIN_HXX
 
 #include <vector>
-#include <map>
+#include <cstddef>
 
+// Deduplicates vertices with an open addressing hash table: the slots
+// hold indices into the value vector, collisions probe the next slot.
+// T needs to provide hash and equal functors.
 template<typename T>
 class SGVertexArrayBin {
 public:
   typedef T value_type;
-  typedef typename value_type::less less;
+  typedef typename value_type::hash hash;
+  typedef typename value_type::equal equal;
   typedef std::vector<value_type> ValueVector;
   typedef typename ValueVector::size_type index_type;
-  typedef std::map<value_type, index_type, less> ValueMap;
+
+  SGVertexArrayBin() :
+    _mask(0)
+  { }
+
+  /// Make room for numVertices distinct vertices without rehashing.
+  void reserve(index_type numVertices)
+  {
+    _values.reserve(numVertices);
+    _hashes.reserve(numVertices);
+    if (_slots.size() < 2*numVertices)
+      rehash(2*numVertices);
+  }
 
   index_type insert(const value_type& t)
   {
-    typename ValueMap::iterator i = _valueMap.find(t);
-    if (i != _valueMap.end())
-      return i->second;
-
-    index_type index = _values.size();
-    _valueMap[t] = index;
-    _values.push_back(t);
-    return index;
+    // Keep the table at most half full
+    if (_slots.size() < 2*(_values.size() + 1))
+      rehash(2*(_values.size() + 1));
+
+    size_t h = hash()(t);
+    for (size_t slot = h & _mask; ; slot = (slot + 1) & _mask) {
+      index_type index = _slots[slot];
+      if (index == emptySlot()) {
+        index = _values.size();
+        _slots[slot] = index;
+        _values.push_back(t);
+        _hashes.push_back(h);
+        return index;
+      }
+      if (_hashes[index] == h && equal()(_values[index], t))
+        return index;
+    }
   }
 
   const value_type& getVertex(index_type index) const
@@ -56,8 +81,28 @@ public:
   { return _values.empty(); }
 
 private:
+  static index_type emptySlot()
+  { return ~index_type(0); }
+
+  void rehash(index_type minSlots)
+  {
+    index_type numSlots = 16;
+    while (numSlots < minSlots)
+      numSlots *= 2;
+    _slots.assign(numSlots, emptySlot());
+    _mask = numSlots - 1;
+    for (index_type i = 0; i < _values.size(); ++i) {
+      size_t slot = _hashes[i] & _mask;
+      while (_slots[slot] != emptySlot())
+        slot = (slot + 1) & _mask;
+      _slots[slot] = i;
+    }
+  }
+
   ValueVector _values;
-  ValueMap _valueMap;
+  std::vector<size_t> _hashes;
+  std::vector<index_type> _slots;
+  size_t _mask;
 };
 
 #endif
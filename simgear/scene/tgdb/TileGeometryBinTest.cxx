@@ -0,0 +1,220 @@
+// TileGeometryBinTest.cxx -- Tests and benchmark for the BTG triangle bins
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+// Run with BTG files as arguments to time building the triangle bins
+// of real tiles.
+
+#ifdef HAVE_CONFIG_H
+#  include <simgear_config.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <new>
+
+#include <simgear/io/sg_binobj.hxx>
+#include <simgear/misc/sg_path.hxx>
+#include <simgear/misc/test_macros.hxx>
+
+#include "SGTileGeometryBin.hxx"
+
+// Count the allocations made while the bins are built
+static std::atomic<size_t> numAllocations(0);
+static std::atomic<size_t> liveBytes(0);
+static std::atomic<size_t> peakBytes(0);
+
+void* operator new(std::size_t size)
+{
+    // Store the size in front of the block to track the live bytes
+    void* p = std::malloc(size + sizeof(std::max_align_t));
+    if (!p)
+        throw std::bad_alloc();
+    *static_cast<std::size_t*>(p) = size;
+    ++numAllocations;
+    size_t live = liveBytes += size;
+    size_t peak = peakBytes;
+    while (peak < live && !peakBytes.compare_exchange_weak(peak, live))
+        ;
+    return static_cast<char*>(p) + sizeof(std::max_align_t);
+}
+
+void operator delete(void* p) noexcept
+{
+    if (!p)
+        return;
+    p = static_cast<char*>(p) - sizeof(std::max_align_t);
+    liveBytes -= *static_cast<std::size_t*>(p);
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    operator delete(p);
+}
+
+// A n x n grid of quads, each split into two triangles, with one normal
+// and texture coordinate per vertex.  The left half of the grid is grass,
+// the right half is water, and one lone triangle is grass too.
+static void makeGrid(SGBinObject& obj, int n)
+{
+    std::vector<SGVec3d> vertices;
+    std::vector<SGVec3f> normals;
+    std::vector<SGVec2f> texCoords;
+    for (int j = 0; j <= n; ++j) {
+        for (int i = 0; i <= n; ++i) {
+            vertices.push_back(SGVec3d(10*i, 10*j, 0));
+            normals.push_back(SGVec3f(0, 0, 1));
+            texCoords.push_back(SGVec2f(i, j));
+        }
+    }
+    int lone = vertices.size();
+    vertices.push_back(SGVec3d(-100, -100, 0));
+    vertices.push_back(SGVec3d(-90, -100, 0));
+    vertices.push_back(SGVec3d(-100, -90, 0));
+    for (int k = 0; k < 3; ++k) {
+        normals.push_back(SGVec3f(0, 0, 1));
+        texCoords.push_back(SGVec2f(0, 0));
+    }
+
+    obj.set_wgs84_nodes(vertices);
+    obj.set_normals(normals);
+    obj.set_texcoords(texCoords);
+    obj.set_overlaycoords(texCoords);
+
+    SGBinObjectTriangle grass, water;
+    grass.material = "Grass";
+    water.material = "Water";
+    for (int j = 0; j < n; ++j) {
+        for (int i = 0; i < n; ++i) {
+            SGBinObjectTriangle& tri = (i < n/2 ? grass : water);
+            int v0 = j*(n + 1) + i;
+            int v1 = v0 + 1;
+            int v2 = v0 + n + 1;
+            int v3 = v2 + 1;
+            int quad[6] = { v0, v1, v3, v0, v3, v2 };
+            for (int k = 0; k < 6; ++k) {
+                tri.v_list.push_back(quad[k]);
+                tri.n_list.push_back(quad[k]);
+                tri.tc_list[0].push_back(quad[k]);
+            }
+        }
+    }
+    obj.add_triangle(grass);
+    obj.add_triangle(water);
+
+    SGBinObjectTriangle tri;
+    tri.material = "Grass";
+    for (int k = 0; k < 3; ++k) {
+        tri.v_list.push_back(lone + k);
+        tri.n_list.push_back(lone + k);
+        tri.tc_list[0].push_back(lone + k);
+    }
+    obj.add_triangle(tri);
+}
+
+void test_grid(int n)
+{
+    SGBinObject obj;
+    makeGrid(obj, n);
+
+    osg::ref_ptr<SGTileGeometryBin> tileGeometryBin = new SGTileGeometryBin;
+    SG_VERIFY(tileGeometryBin->insertSurfaceGeometry(obj, 0));
+    SG_CHECK_EQUAL(tileGeometryBin->materialTriangleMap.size(), 2);
+
+    // Shared vertices are merged, the grid halves share their middle column
+    const SGTexturedTriangleBin& grass = tileGeometryBin->materialTriangleMap["Grass"];
+    const SGTexturedTriangleBin& water = tileGeometryBin->materialTriangleMap["Water"];
+    SG_CHECK_EQUAL(grass.getNumTriangles(), n*n + 1);
+    SG_CHECK_EQUAL(grass.getNumVertices(), (n/2 + 1)*(n + 1) + 3);
+    SG_CHECK_EQUAL(water.getNumTriangles(), n*n);
+    SG_CHECK_EQUAL(water.getNumVertices(), (n/2 + 1)*(n + 1));
+
+    for (unsigned i = 0; i < grass.getNumTriangles(); ++i) {
+        const SGTexturedTriangleBin::triangle_ref& t = grass.getTriangleRef(i);
+        SG_VERIFY(t[0] != t[1] && t[1] != t[2] && t[2] != t[0]);
+    }
+
+    std::list<SGTexturedTriangleBin::TriangleVector> sets;
+    grass.getConnectedSets(sets);
+    SG_CHECK_EQUAL(sets.size(), 2);
+    SG_CHECK_EQUAL(sets.front().size(), n*n);
+    SG_CHECK_EQUAL(sets.back().size(), 1);
+
+    sets.clear();
+    water.getConnectedSets(sets);
+    SG_CHECK_EQUAL(sets.size(), 1);
+}
+
+void test_merge()
+{
+    // A vertex with a different normal is not merged
+    SGTexturedTriangleBin bin;
+    SGVertNormTex v0, v1, v2, v3;
+    v0.SetVertex(SGVec3f(0, 0, 0));
+    v0.SetNormal(SGVec3f(0, 0, 1));
+    v1.SetVertex(SGVec3f(1, 0, 0));
+    v1.SetNormal(SGVec3f(0, 0, 1));
+    v2.SetVertex(SGVec3f(0, 1, 0));
+    v2.SetNormal(SGVec3f(0, 0, 1));
+    v3 = v0;
+    v3.SetNormal(SGVec3f(0, 1, 0));
+    bin.insert(v0, v1, v2);
+    bin.insert(v3, v1, v2);
+    bin.insert(v0, v2, v1);
+    SG_CHECK_EQUAL(bin.getNumVertices(), 4);
+    SG_CHECK_EQUAL(bin.getNumTriangles(), 3);
+}
+
+void benchmark(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        SGBinObject obj;
+        if (!obj.read_bin(SGPath::fromLocal8Bit(argv[i]))) {
+            std::cerr << "Failed to read " << argv[i] << std::endl;
+            continue;
+        }
+
+        const int passes = 5;
+        size_t allocations = numAllocations;
+        size_t baseBytes = liveBytes;
+        peakBytes = baseBytes;
+        auto start = std::chrono::steady_clock::now();
+        for (int pass = 0; pass < passes; ++pass) {
+            osg::ref_ptr<SGTileGeometryBin> tileGeometryBin = new SGTileGeometryBin;
+            tileGeometryBin->insertSurfaceGeometry(obj, 0);
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        std::cout << argv[i] << ": " << ms/passes << " ms/tile, "
+                  << (numAllocations - allocations)/passes << " allocations/tile, "
+                  << (peakBytes - baseBytes)/1024 << " KiB peak" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    // The larger grid is built with one task per material
+    test_grid(16);
+    test_grid(128);
+    test_merge();
+    benchmark(argc, argv);
+
+    return EXIT_SUCCESS;
+}
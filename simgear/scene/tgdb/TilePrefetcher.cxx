@@ -0,0 +1,514 @@
+// TilePrefetcher.cxx -- Prepare the scenery ahead of the aircraft
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <simgear_config.h>
+
+#include "TilePrefetcher.hxx"
+#include "obj.hxx"
+
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string_view>
+#include <vector>
+
+#include <osgDB/FileNameUtils>
+
+#include <simgear/bucket/newbucket.hxx>
+#include <simgear/debug/logstream.hxx>
+#include <simgear/misc/ListFileReader.hxx>
+#include <simgear/misc/sg_path.hxx>
+#include <simgear/scene/material/mat.hxx>
+#include <simgear/scene/model/BVHPageNodeOSG.hxx>
+#include <simgear/scene/util/SGReaderWriterOptions.hxx>
+#include <simgear/scene/util/SGSceneFeatures.hxx>
+#include <simgear/threads/SGThread.hxx>
+
+namespace simgear {
+
+namespace {
+
+// The prefetched tiles, shared with SGLoadBTG()
+std::mutex _tilesMutex;
+std::map<std::string, SGSharedPtr<const TilePrefetcher::Tile> > _tiles;
+
+std::string_view nextToken(std::string_view& line)
+{
+    std::string_view::size_type begin = line.find_first_not_of(" \t\r");
+    if (begin == std::string_view::npos) {
+        line = std::string_view();
+        return line;
+    }
+    std::string_view::size_type end = line.find_first_of(" \t\r", begin);
+    if (end == std::string_view::npos)
+        end = line.size();
+    std::string_view token = line.substr(begin, end - begin);
+    line = line.substr(end);
+    return token;
+}
+
+// The file SGBinObject::read_bin() reads for path
+SGPath btgFile(const std::string& path)
+{
+    SGPath file = SGPath::fromUtf8(path);
+    if (!file.exists())
+        file.concat(".gz");
+    return file;
+}
+
+bool isBtg(std::string_view name)
+{
+    std::string_view::size_type pos = name.rfind(".btg");
+    return pos != std::string_view::npos &&
+        (pos + 4 == name.size() || name.substr(pos + 4) == ".gz");
+}
+
+}
+
+struct TilePrefetcher::_PrivateData {
+    enum _LaneId {
+        _DecodeLane,
+        _BVHLane,
+        _NumLanes
+    };
+
+    // The buckets waiting for a lane, in the order they are reached
+    struct _Lane {
+        _Lane() :
+            _stopping(false)
+        {
+        }
+        void _stop()
+        {
+            std::lock_guard<std::mutex> scopeLock(_mutex);
+            _stopping = true;
+            _waitCondition.notify_all();
+        }
+        void _restart()
+        {
+            std::lock_guard<std::mutex> scopeLock(_mutex);
+            _stopping = false;
+        }
+        void _set(const std::vector<SGBucket>& buckets)
+        {
+            std::lock_guard<std::mutex> scopeLock(_mutex);
+            _buckets = buckets;
+            _waitCondition.notify_one();
+        }
+        void _push(const SGBucket& bucket)
+        {
+            std::lock_guard<std::mutex> scopeLock(_mutex);
+            _buckets.push_back(bucket);
+            _waitCondition.notify_one();
+        }
+        /// Returns false once stopped
+        bool _pop(SGBucket& bucket)
+        {
+            std::unique_lock<std::mutex> scopeLock(_mutex);
+            while (_buckets.empty() || _stopping) {
+                if (_stopping)
+                    return false;
+                _waitCondition.wait(scopeLock);
+            }
+            bucket = _buckets.front();
+            _buckets.erase(_buckets.begin());
+            return true;
+        }
+        unsigned _size()
+        {
+            std::lock_guard<std::mutex> scopeLock(_mutex);
+            return static_cast<unsigned>(_buckets.size());
+        }
+    private:
+        std::mutex _mutex;
+        std::condition_variable _waitCondition;
+        std::vector<SGBucket> _buckets;
+        bool _stopping;
+    };
+
+    struct _Worker : public SGThread {
+        _Worker(_PrivateData& privateData, _LaneId lane) :
+            _privateData(privateData),
+            _lane(lane)
+        {
+        }
+        virtual void run()
+        {
+            _privateData._run(_lane);
+        }
+    private:
+        _PrivateData& _privateData;
+        _LaneId _lane;
+    };
+
+    struct _BucketState {
+        _BucketState() :
+            _done()
+        {
+        }
+        bool _done[_NumLanes];
+        std::vector<std::string> _paths;
+    };
+
+    _PrivateData(const SGReaderWriterOptions* options) :
+        _options(options),
+        _lookahead(300),
+        _corridor(15000),
+        _maxBuckets(32),
+        _started(false)
+    {
+        for (unsigned i = 0; i < _NumLanes; ++i)
+            _active[i] = -1;
+    }
+    ~_PrivateData()
+    {
+        _stop();
+        _releaseAll();
+    }
+
+    bool _start()
+    {
+        if (_started)
+            return true;
+        for (unsigned i = 0; i < _NumLanes; ++i) {
+            _lanes[i]._restart();
+            _workers[i].reset(new _Worker(*this, _LaneId(i)));
+            _workers[i]->start();
+        }
+        _started = true;
+        return true;
+    }
+
+    void _stop()
+    {
+        if (!_started)
+            return;
+        for (unsigned i = 0; i < _NumLanes; ++i)
+            _lanes[i]._stop();
+        for (unsigned i = 0; i < _NumLanes; ++i) {
+            _workers[i]->join();
+            _workers[i].reset();
+        }
+        _started = false;
+    }
+
+    void _update(const SGGeod& position, double track, double groundspeed)
+    {
+        std::vector<SGBucket> buckets;
+        double distance = std::max(groundspeed, 0.0)*_lookahead;
+        sgGetBucketsAlongTrack(position, track, distance, _corridor, buckets);
+        if (_maxBuckets < buckets.size())
+            buckets.resize(_maxBuckets);
+
+        std::vector<SGBucket> lanes[_NumLanes];
+        std::vector<std::string> released;
+        {
+            std::lock_guard<std::mutex> scopeLock(_mutex);
+
+            std::map<long, _BucketState> wanted;
+            for (const SGBucket& bucket : buckets) {
+                _BucketState& state = wanted[bucket.gen_index()];
+                std::map<long, _BucketState>::iterator i;
+                i = _buckets.find(bucket.gen_index());
+                if (i != _buckets.end())
+                    state = i->second;
+
+                // Do not queue what a worker is busy with
+                long index = bucket.gen_index();
+                if (!state._done[_DecodeLane]) {
+                    if (_active[_DecodeLane] != index)
+                        lanes[_DecodeLane].push_back(bucket);
+                } else if (!state._done[_BVHLane]) {
+                    if (_active[_BVHLane] != index)
+                        lanes[_BVHLane].push_back(bucket);
+                }
+            }
+
+            for (auto& i : _buckets) {
+                if (wanted.find(i.first) == wanted.end())
+                    released.insert(released.end(), i.second._paths.begin(),
+                                    i.second._paths.end());
+            }
+            _buckets.swap(wanted);
+        }
+
+        _release(released);
+        for (unsigned i = 0; i < _NumLanes; ++i)
+            _lanes[i]._set(lanes[i]);
+    }
+
+    void _run(_LaneId lane)
+    {
+        SGBucket bucket;
+        while (_lanes[lane]._pop(bucket)) {
+            _setActive(lane, bucket.gen_index());
+            if (lane == _DecodeLane)
+                _decode(bucket);
+            else
+                _buildBVH(bucket);
+            _setActive(lane, -1);
+        }
+    }
+
+    void _setActive(_LaneId lane, long index)
+    {
+        std::lock_guard<std::mutex> scopeLock(_mutex);
+        _active[lane] = index;
+    }
+
+    // The BTG files named in the STG files of the bucket, found the same
+    // way ReaderWriterSTG does
+    std::vector<std::string> _btgPaths(const SGBucket& bucket)
+    {
+        std::vector<std::string> paths;
+        if (!_options.valid())
+            return paths;
+
+        bool vpbActive = SGSceneFeatures::instance()->getVPBActive();
+        std::string basePath = bucket.gen_base_path();
+        std::string fileName = bucket.gen_index_str() + ".stg";
+        bool foundBase = false;
+        for (const std::string& path : _options->getDatabasePathList()) {
+            if (foundBase)
+                break;
+            for (const std::string& suffix : _options->getSceneryPathSuffixes()) {
+                SGPath stgPath = SGPath(path) / suffix / basePath / fileName;
+                ListFileReader reader(stgPath);
+                if (!reader.is_open())
+                    continue;
+
+                std::string filePath = osgDB::getFilePath(stgPath.utf8Str());
+                std::string_view line;
+                while (reader.nextLine(line)) {
+                    std::string_view token = nextToken(line);
+                    std::string_view name = nextToken(line);
+                    if (!isBtg(name))
+                        continue;
+                    if (token == "OBJECT_BASE") {
+                        if (vpbActive)
+                            continue;
+                        foundBase = true;
+                    } else if (token != "OBJECT") {
+                        continue;
+                    }
+                    SGPath btgPath = filePath;
+                    btgPath.append(std::string(name));
+                    paths.push_back(btgPath.utf8Str());
+                }
+            }
+        }
+        return paths;
+    }
+
+    void _decode(const SGBucket& bucket)
+    {
+        std::vector<std::string> paths = _btgPaths(bucket);
+        SGMaterialLibPtr matlib = _options.valid() ? _options->getMaterialLib() : SGMaterialLibPtr();
+
+        std::vector<SGSharedPtr<Tile> > tiles;
+        std::vector<std::string> tilePaths;
+        for (const std::string& path : paths) {
+            if (findTile(path).valid())
+                continue;
+
+            SGSharedPtr<Tile> tile = new Tile;
+            SGPath file = btgFile(path);
+            tile->modTime = file.modTime();
+            tile->size = file.sizeInBytes();
+            if (!tile->binObject.read_bin(path))
+                continue;
+
+            // The same material cache SGLoadBTG() would generate
+            if (matlib) {
+                SGGeod geodPos = SGGeod::fromCart(tile->binObject.get_gbs_center());
+                tile->matlib = matlib;
+                tile->matcache = matlib->generateMatCache(geodPos, _options.get());
+
+                std::set<std::string> names;
+                names.insert(tile->binObject.get_tri_materials().begin(),
+                             tile->binObject.get_tri_materials().end());
+                names.insert(tile->binObject.get_strip_materials().begin(),
+                             tile->binObject.get_strip_materials().end());
+                names.insert(tile->binObject.get_fan_materials().begin(),
+                             tile->binObject.get_fan_materials().end());
+                for (const std::string& name : names) {
+                    SGMaterial* mat = tile->matcache->find(name);
+                    if (!mat)
+                        continue;
+                    for (int i = 0; i < mat->get_num(); ++i)
+                        mat->get_one_effect(i);
+                }
+            }
+            // SGLoadBTG() uses the tile as it is
+            SGRotateBTG(tile->binObject, 0);
+            tiles.push_back(tile);
+            tilePaths.push_back(path);
+        }
+
+        bool wanted;
+        {
+            std::lock_guard<std::mutex> scopeLock(_mutex);
+            std::map<long, _BucketState>::iterator i;
+            i = _buckets.find(bucket.gen_index());
+            wanted = (i != _buckets.end());
+            if (wanted) {
+                i->second._done[_DecodeLane] = true;
+                i->second._paths = paths;
+                // Only publish while the bucket is still wanted, else nobody
+                // would release the tiles
+                std::lock_guard<std::mutex> tilesLock(_tilesMutex);
+                for (unsigned k = 0; k < tiles.size(); ++k)
+                    _tiles[tilePaths[k]] = tiles[k];
+            }
+        }
+        if (wanted)
+            _lanes[_BVHLane]._push(bucket);
+
+        SG_LOG(SG_TERRAIN, SG_DEBUG, "Prefetched " << tiles.size()
+               << " BTG files for bucket " << bucket.gen_index_str());
+    }
+
+    void _buildBVH(const SGBucket& bucket)
+    {
+        // Without the cache the tree would be built only to be thrown away
+        if (!BVHPageNodeOSG::getCacheDirectory().isNull() && _options.valid())
+            BVHPageNodeOSG::load(bucket.gen_index_str() + ".stg", _options);
+
+        std::lock_guard<std::mutex> scopeLock(_mutex);
+        std::map<long, _BucketState>::iterator i;
+        i = _buckets.find(bucket.gen_index());
+        if (i != _buckets.end())
+            i->second._done[_BVHLane] = true;
+    }
+
+    void _release(const std::vector<std::string>& paths)
+    {
+        std::lock_guard<std::mutex> tilesLock(_tilesMutex);
+        for (const std::string& path : paths)
+            _tiles.erase(path);
+    }
+
+    void _releaseAll()
+    {
+        std::vector<std::string> released;
+        {
+            std::lock_guard<std::mutex> scopeLock(_mutex);
+            for (auto& i : _buckets)
+                released.insert(released.end(), i.second._paths.begin(),
+                                i.second._paths.end());
+            _buckets.clear();
+        }
+        _release(released);
+    }
+
+    osg::ref_ptr<const SGReaderWriterOptions> _options;
+    double _lookahead;
+    double _corridor;
+    unsigned _maxBuckets;
+
+    bool _started;
+    _Lane _lanes[_NumLanes];
+    std::unique_ptr<_Worker> _workers[_NumLanes];
+
+    // The buckets of the last prediction and the ones the workers are
+    // busy with, guarded by _mutex
+    std::mutex _mutex;
+    std::map<long, _BucketState> _buckets;
+    long _active[_NumLanes];
+};
+
+TilePrefetcher::TilePrefetcher(const SGReaderWriterOptions* options) :
+    _privateData(new _PrivateData(options))
+{
+}
+
+TilePrefetcher::~TilePrefetcher()
+{
+}
+
+void
+TilePrefetcher::setLookahead(double seconds)
+{
+    _privateData->_lookahead = seconds;
+}
+
+void
+TilePrefetcher::setCorridor(double meters)
+{
+    _privateData->_corridor = meters;
+}
+
+void
+TilePrefetcher::setMaxBuckets(unsigned maxBuckets)
+{
+    _privateData->_maxBuckets = maxBuckets;
+}
+
+bool
+TilePrefetcher::start()
+{
+    return _privateData->_start();
+}
+
+void
+TilePrefetcher::stop()
+{
+    _privateData->_stop();
+}
+
+void
+TilePrefetcher::update(const SGGeod& position, double track, double groundspeed)
+{
+    _privateData->_update(position, track, groundspeed);
+}
+
+unsigned
+TilePrefetcher::getNumPending() const
+{
+    return _privateData->_lanes[_PrivateData::_DecodeLane]._size();
+}
+
+SGSharedPtr<const TilePrefetcher::Tile>
+TilePrefetcher::findTile(const std::string& path)
+{
+    std::lock_guard<std::mutex> tilesLock(_tilesMutex);
+    std::map<std::string, SGSharedPtr<const Tile> >::const_iterator i;
+    i = _tiles.find(path);
+    if (i == _tiles.end())
+        return SGSharedPtr<const Tile>();
+    return i->second;
+}
+
+void
+TilePrefetcher::releaseTile(const std::string& path, const Tile* tile)
+{
+    std::lock_guard<std::mutex> tilesLock(_tilesMutex);
+    std::map<std::string, SGSharedPtr<const Tile> >::iterator i;
+    i = _tiles.find(path);
+    if (i != _tiles.end() && i->second.get() == tile)
+        _tiles.erase(i);
+}
+
+bool
+TilePrefetcher::Tile::isCurrent(const std::string& path) const
+{
+    SGPath file = btgFile(path);
+    return file.modTime() == modTime && file.sizeInBytes() == size;
+}
+
+}
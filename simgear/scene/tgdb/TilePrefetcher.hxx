@@ -0,0 +1,108 @@
+// TilePrefetcher.hxx -- Prepare the scenery ahead of the aircraft
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef SIMGEAR_TILEPREFETCHER_HXX
+#define SIMGEAR_TILEPREFETCHER_HXX 1
+
+#include <ctime>
+#include <memory>
+#include <string>
+
+#include <osg/ref_ptr>
+
+#include <simgear/io/sg_binobj.hxx>
+#include <simgear/math/SGMath.hxx>
+#include <simgear/scene/material/matlib.hxx>
+#include <simgear/structure/SGReferenced.hxx>
+#include <simgear/structure/SGSharedPtr.hxx>
+
+namespace simgear {
+
+class SGReaderWriterOptions;
+
+// Predicts the buckets the aircraft reaches within the next minutes from its
+// position, track and groundspeed, and prepares their scenery in the
+// background before the pager asks for it.  Two worker lanes take the
+// buckets in the order they are reached:
+// - the first decodes the base and airport BTG files named in the STG files,
+//   builds the material cache of each and the effects of the materials used,
+// - the second builds the bounding volume tree of the tile, but only if the
+//   BVH cache is enabled, so the BVH pager finds it there.
+// SGLoadBTG() takes the decoded files and material caches from here instead
+// of reading them again, unless the file changed since.  Buckets that drop
+// out of the prediction are released.
+class TilePrefetcher {
+public:
+    // A decoded BTG file, already rotated by SGRotateBTG() without an
+    // orthophoto, and the material cache for its center
+    struct Tile : public SGReferenced {
+        Tile() :
+            modTime(0),
+            size(0)
+        {
+        }
+        // Whether the BTG file at path is still the one decoded
+        bool isCurrent(const std::string& path) const;
+
+        SGBinObject binObject;
+        osg::ref_ptr<SGMaterialCache> matcache;
+        SGMaterialLibPtr matlib;
+        // The modification time and size of the file when decoded
+        time_t modTime;
+        size_t size;
+    };
+
+    // The options used to load the tiles, for the scenery paths and the
+    // material library
+    TilePrefetcher(const SGReaderWriterOptions* options);
+    ~TilePrefetcher();
+
+    // How far ahead to look, 300 seconds by default
+    void setLookahead(double seconds);
+    // Buckets within this many meters of the predicted track are included,
+    // 15 km by default
+    void setCorridor(double meters);
+    // At most this many buckets are held, the closest ones, 32 by default
+    void setMaxBuckets(unsigned maxBuckets);
+
+    bool start();
+    void stop();
+
+    // Call regularly, e.g. once a second.  The track is in degrees, the
+    // groundspeed in meters per second.
+    void update(const SGGeod& position, double track, double groundspeed);
+
+    // Number of buckets waiting in the first lane, for statistics
+    unsigned getNumPending() const;
+
+    // The prefetched BTG file with the given path, as named in the STG
+    // file, or 0
+    static SGSharedPtr<const Tile> findTile(const std::string& path);
+    // Drop the prefetched BTG file with the given path if it is still tile,
+    // e.g. once the file changed
+    static void releaseTile(const std::string& path, const Tile* tile);
+
+private:
+    TilePrefetcher(const TilePrefetcher&);
+    TilePrefetcher& operator=(const TilePrefetcher&);
+
+    struct _PrivateData;
+    std::unique_ptr<_PrivateData> _privateData;
+};
+
+}
+
+#endif
@@ -39,8 +39,8 @@
 #include <osgDB/FileUtils>
 
 #include <simgear/debug/logstream.hxx>
-#include <simgear/io/iostreams/sgstream.hxx>
 #include <simgear/math/sg_random.hxx>
+#include <simgear/misc/ListFileReader.hxx>
 #include <simgear/misc/sg_path.hxx>
 #include <simgear/scene/material/Effect.hxx>
 #include <simgear/scene/material/EffectGeode.hxx>
@@ -461,48 +461,36 @@ TreeBin(mat)
         return;
     }
 
-    sg_gzifstream stream(absoluteFileName);
-    if (!stream.is_open()) {
+    ListFileReader reader(absoluteFileName);
+    if (!reader.is_open()) {
         SG_LOG(SG_TERRAIN, SG_ALERT, "Unable to open " << absoluteFileName);
         return;
     }
 
-    while (!stream.eof()) {
-        // read a line.  Each line defines a single tree position, and may have
-        // a comment, starting with #
-        std::string line;
-        std::getline(stream, line);
-
-        // strip comments
-        std::string::size_type hash_pos = line.find('#');
-        if (hash_pos != std::string::npos)
-            line.resize(hash_pos);
-
-        // and process further
-        std::stringstream in(line);
+    // read a line.  Each line defines a single tree position, and may have
+    // a comment, starting with #, which the reader strips
+    std::string_view line;
+    while (reader.nextLine(line)) {
+        NumberScanner in(line);
 
         // Line format is X Y Z A B C
         // where:
         // X,Y,Z are the cartesian coordinates of the center tree
         // A,B,C is the normal of the underlying terrain, defaulting to 0,0,1
         float x = 0.0f, y = 0.0f, z = 0.0f, a = 0.0f, b = 0.0f, c = 1.0f;
-        in >> x >> y >> z;
-
-        if (in.bad() || in.fail()) {
+        if (!in.read(x, y, z)) {
             SG_LOG(SG_TERRAIN, SG_WARN, "Error parsing tree entry in: " << absoluteFileName << " line: \"" << line << "\"");
             continue;
         }
 
         // these might fail, so check them after we look at failbit
-        in >> a >> b >> c;
+        in.read(a, b, c);
 
         SGVec3f loc = SGVec3f(x,y,z);
         SGVec3f norm = SGVec3f(a,b,c);
 
         insert(Tree(loc, norm));
     }
-
-    stream.close();
 };
 
 
@@ -0,0 +1,210 @@
+// VPBElevationConstraints.cxx -- Spatial index of VPB elevation constraints
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <simgear_config.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <osg/Geode>
+#include <osg/NodeVisitor>
+#include <osg/Transform>
+
+#include <simgear/bucket/newbucket.hxx>
+#include <simgear/bvh/BVHLineSegmentVisitor.hxx>
+#include <simgear/bvh/BVHStaticGeometryBuilder.hxx>
+#include <simgear/constants.h>
+#include <simgear/scene/model/PrimitiveCollector.hxx>
+#include <simgear/scene/util/OsgMath.hxx>
+
+#include "VPBElevationConstraints.hxx"
+
+using namespace simgear;
+
+namespace {
+
+// Collects the triangles of a node in the coordinates of its root,
+// i.e. the coordinates the constraint was previously intersected in.
+class TriangleCollectVisitor : public osg::NodeVisitor {
+public:
+    class Collector : public PrimitiveCollector {
+    public:
+        virtual void addPoint(const osg::Vec3d&)
+        { }
+        virtual void addLine(const osg::Vec3d&, const osg::Vec3d&)
+        { }
+        virtual void addTriangle(const osg::Vec3d& v1, const osg::Vec3d& v2, const osg::Vec3d& v3)
+        {
+            _vertices.push_back(toSG(v1*_matrix));
+            _vertices.push_back(toSG(v2*_matrix));
+            _vertices.push_back(toSG(v3*_matrix));
+        }
+
+        osg::Matrixd _matrix;
+        std::vector<SGVec3d> _vertices;
+    };
+
+    TriangleCollectVisitor() :
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN)
+    { }
+
+    virtual void apply(osg::Geode& geode)
+    {
+        _collector._matrix = osg::computeLocalToWorld(getNodePath());
+        for (unsigned i = 0; i < geode.getNumDrawables(); ++i)
+            geode.getDrawable(i)->accept(_collector);
+    }
+
+    const std::vector<SGVec3d>& getVertices() const
+    { return _collector._vertices; }
+
+private:
+    Collector _collector;
+};
+
+}
+
+VPBElevationConstraints::Constraint::Constraint(const osg::Node* node) :
+    _node(node),
+    _center(SGVec3d::zeros())
+{
+    // The visitor does not modify the node
+    TriangleCollectVisitor visitor;
+    const_cast<osg::Node*>(node)->accept(visitor);
+
+    const std::vector<SGVec3d>& vertices = visitor.getVertices();
+    if (vertices.empty())
+        return;
+
+    SGBoxd box;
+    for (const SGVec3d& v : vertices)
+        box.expandBy(v);
+    _center = box.getCenter();
+    _bound = SGSphered(_center, 0.5*length(box.getSize()));
+
+    SGSharedPtr<BVHStaticGeometryBuilder> builder = new BVHStaticGeometryBuilder;
+    for (size_t i = 0; i + 2 < vertices.size(); i += 3)
+        builder->addTriangle(toVec3f(vertices[i] - _center),
+                             toVec3f(vertices[i + 1] - _center),
+                             toVec3f(vertices[i + 2] - _center));
+    _bvh = builder->buildTree();
+}
+
+bool
+VPBElevationConstraints::Constraint::intersect(SGLineSegmentd& segment) const
+{
+    if (!_bvh.valid() || !intersects(_bound, segment))
+        return false;
+
+    SGLineSegmentd local(segment.getStart() - _center, segment.getEnd() - _center);
+    BVHLineSegmentVisitor visitor(local);
+    _bvh->accept(visitor);
+    if (visitor.empty())
+        return false;
+
+    segment = SGLineSegmentd(segment.getStart(), visitor.getPoint() + _center);
+    return true;
+}
+
+VPBElevationConstraints::VPBElevationConstraints()
+{
+}
+
+VPBElevationConstraints::Ptr
+VPBElevationConstraints::add(const SGSharedPtr<Constraint>& constraint) const
+{
+    std::shared_ptr<VPBElevationConstraints> constraints = std::make_shared<VPBElevationConstraints>(*this);
+    if (!constraint.valid() || constraint->empty())
+        return constraints;
+
+    constraints->_constraints.push_back(constraint);
+    constraints->index(constraint.get());
+    return constraints;
+}
+
+VPBElevationConstraints::Ptr
+VPBElevationConstraints::remove(const osg::Node* node) const
+{
+    std::shared_ptr<VPBElevationConstraints> constraints = std::make_shared<VPBElevationConstraints>();
+    for (const SGSharedPtr<Constraint>& constraint : _constraints) {
+        if (constraint->getNode() == node)
+            continue;
+        constraints->_constraints.push_back(constraint);
+        constraints->index(constraint.get());
+    }
+    return constraints;
+}
+
+// Register the constraint with every bucket its bounding sphere overlaps.
+void
+VPBElevationConstraints::index(const Constraint* constraint)
+{
+    const SGSphered& bound = constraint->getBound();
+    SGGeod center = SGGeod::fromCart(bound.getCenter());
+
+    double dlat = SGMiscd::rad2deg(bound.getRadius()/SG_EQUATORIAL_RADIUS_M);
+    double dlon = dlat/std::max(std::cos(center.getLatitudeRad()), 0.01);
+    double latMin = std::max(center.getLatitudeDeg() - dlat, -89.999);
+    double latMax = std::min(center.getLatitudeDeg() + dlat, 89.999);
+    double lonMin = center.getLongitudeDeg() - std::min(dlon, 180.0);
+    double lonMax = center.getLongitudeDeg() + std::min(dlon, 180.0);
+
+    // Step by at most one bucket so none is skipped, and always include the
+    // far edge.
+    for (double lat = latMin; ; lat = std::min(lat + SG_BUCKET_SPAN, latMax)) {
+        double width = SGBucket(SGGeod::fromDeg(center.getLongitudeDeg(), lat)).get_width();
+        for (double lon = lonMin; ; lon = std::min(lon + width, lonMax)) {
+            SGBucket bucket(SGGeod::fromDeg(SGMiscd::normalizePeriodic(-180, 180, lon), lat));
+            ConstraintList& list = _buckets[bucket.gen_index()];
+            if (std::find(list.begin(), list.end(), constraint) == list.end())
+                list.push_back(constraint);
+            if (lon >= lonMax)
+                break;
+        }
+        if (lat >= latMax)
+            break;
+    }
+}
+
+osg::Vec3d
+VPBElevationConstraints::check(const osg::Vec3d& origin, const osg::Vec3d& vertex, float vertex_gap) const
+{
+    if (_constraints.empty())
+        return vertex;
+
+    // The segment is close to vertical, so the vertex bucket holds every
+    // constraint it can intersect.
+    SGVec3d end = toSG(vertex);
+    auto i = _buckets.find(SGBucket(SGGeod::fromCart(end)).gen_index());
+    if (i == _buckets.end())
+        return vertex;
+
+    SGLineSegmentd segment(toSG(origin), end);
+    bool hit = false;
+    for (const Constraint* constraint : i->second) {
+        // Each hit shortens the segment, so the lowest intersection wins
+        if (constraint->intersect(segment))
+            hit = true;
+    }
+    if (!hit)
+        return vertex;
+
+    // Move the terrain vertex to vertex_gap below the intersection point
+    osg::Vec3d point = toOsg(segment.getEnd());
+    osg::Vec3d ray = point - origin;
+    ray.normalize();
+    return point - ray*vertex_gap;
+}
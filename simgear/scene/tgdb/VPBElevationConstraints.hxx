@@ -0,0 +1,98 @@
+// VPBElevationConstraints.hxx -- Spatial index of VPB elevation constraints
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef VPBELEVATIONCONSTRAINTS
+#define VPBELEVATIONCONSTRAINTS 1
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <osg/Node>
+#include <osg/Vec3d>
+
+#include <simgear/bvh/BVHNode.hxx>
+#include <simgear/math/SGMath.hxx>
+#include <simgear/math/SGGeometry.hxx>
+#include <simgear/structure/SGReferenced.hxx>
+#include <simgear/structure/SGSharedPtr.hxx>
+
+namespace simgear {
+
+// A set of elevation constraints, e.g. airport meshes, that the terrain mesh
+// must stay underneath.  Each constraint is converted into a bounding volume
+// tree once, and registered in every bucket its bounds overlap, so a query
+// only tests the meshes close to the vertex.
+//
+// A set is immutable: adding or removing a constraint creates a new set.
+// The VPBTechnique publishes the current set atomically, so the tile
+// builders can query it from any thread without locking.
+class VPBElevationConstraints {
+public:
+    class Constraint : public SGReferenced {
+    public:
+        // Collects the triangles of the node, in the coordinates of the node
+        Constraint(const osg::Node* node);
+
+        const osg::Node* getNode() const
+        { return _node; }
+        const SGSphered& getBound() const
+        { return _bound; }
+        bool empty() const
+        { return !_bvh.valid(); }
+
+        // Shortens the segment to the first intersection with the constraint.
+        // Returns false if there is none.
+        bool intersect(SGLineSegmentd& segment) const;
+
+    private:
+        // Only used to identify the constraint on removal, never dereferenced
+        const osg::Node* _node;
+        // The triangles are stored as floats, relative to _center
+        SGVec3d _center;
+        SGSphered _bound;
+        SGSharedPtr<BVHNode> _bvh;
+    };
+
+    typedef std::shared_ptr<const VPBElevationConstraints> Ptr;
+
+    VPBElevationConstraints();
+
+    // Copies of this set with the constraint added or removed
+    Ptr add(const SGSharedPtr<Constraint>& constraint) const;
+    Ptr remove(const osg::Node* node) const;
+
+    bool empty() const
+    { return _constraints.empty(); }
+
+    // Check the vertex against the constraints.  If the segment from origin to
+    // vertex intersects one, returns the intersection point moved vertex_gap
+    // back towards the origin, otherwise the vertex itself.
+    osg::Vec3d check(const osg::Vec3d& origin, const osg::Vec3d& vertex, float vertex_gap) const;
+
+private:
+    typedef std::vector<const Constraint*> ConstraintList;
+
+    void index(const Constraint* constraint);
+
+    std::vector<SGSharedPtr<Constraint> > _constraints;
+    // Keyed by SGBucket::gen_index()
+    std::unordered_map<long, ConstraintList> _buckets;
+};
+
+}
+
+#endif
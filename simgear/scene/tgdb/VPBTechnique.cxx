@@ -470,6 +470,8 @@ class VertexNormalGenerator
         int                             _numColumns;
         float                           _scaleHeight;
         float                           _constraint_vtx_gap;
+        // Taken once per tile, so the vertices are checked without any locking
+        VPBElevationConstraints::Ptr    _elevationConstraints;
 
         Indices                         _indices;
 
@@ -487,7 +489,8 @@ VertexNormalGenerator::VertexNormalGenerator(Locator* masterLocator, const osg::
     _numRows(numRows),
     _numColumns(numColumns),
     _scaleHeight(scaleHeight),
-    _constraint_vtx_gap(vtx_gap)
+    _constraint_vtx_gap(vtx_gap),
+    _elevationConstraints(VPBTechnique::getElevationConstraints())
 {
     int numVerticesInBody = numColumns*numRows;
     int numVerticesInSkirt = createSkirt ? numColumns*2 + numRows*2 - 4 : 0;
@@ -538,7 +541,7 @@ void VertexNormalGenerator::populateCenter(osgTerrain::Layer* elevationLayer, os
                 _masterLocator->convertLocalToModel(osg::Vec3d(ndc.x(), ndc.y(), -1000), origin);
                 _masterLocator->convertLocalToModel(ndc, model);
 
-                model = VPBTechnique::checkAgainstElevationConstraints(origin, model, _constraint_vtx_gap);
+                model = _elevationConstraints->check(origin, model, _constraint_vtx_gap);
 
                 texcoords->push_back(osg::Vec2(ndc.x(), ndc.y()));
 
@@ -778,11 +781,10 @@ void VPBTechnique::generateGeometry(BufferData& buffer, Locator* masterLocator,
 
     if (matlib) {
       SG_LOG(SG_TERRAIN, SG_DEBUG, "Applying VPB material " << loc);
-      SGMaterialCache* matcache = _options->getMaterialLib()->generateMatCache(loc, _options);
+      osg::ref_ptr<SGMaterialCache> matcache = _options->getMaterialLib()->generateMatCache(loc, _options);
       atlas = matcache->getAtlas();
       SGMaterial* landmat = matcache->find("ws30land");
       SGMaterial* watermat = matcache->find("ws30water");
-      delete matcache;
 
       if (landmat && watermat) {
         makeChild(landEffectProp.ptr(), "inherits-from")->setStringValue(landmat->get_effect_name());
@@ -1615,6 +1617,23 @@ void VPBTechnique::applyTrees(BufferData& buffer, Locator* masterLocator)
 
 }
 
+// A sphere containing the tile and the sea level points underneath it.  The feature nodes
+// are at sea level, so any feature touching the tile overlaps this sphere.
+static osg::BoundingSphered computeFeatureBound(const osg::BoundingBox& landBound, const osg::Vec3d& world, const SGGeod& loc)
+{
+    const double radius = landBound.radius();
+    return osg::BoundingSphered(world + osg::Vec3d(landBound.center()), 2.0*radius + fabs(loc.getElevationM()));
+}
+
+static bool overlaps(const osg::BoundingSphered& sphere, const osg::BoundingBoxd& box)
+{
+    if (!box.valid()) return false;
+    osg::Vec3d closest(osg::clampBetween(sphere.center().x(), box.xMin(), box.xMax()),
+                       osg::clampBetween(sphere.center().y(), box.yMin(), box.yMax()),
+                       osg::clampBetween(sphere.center().z(), box.zMin(), box.zMax()));
+    return (closest - sphere.center()).length2() <= sphere.radius2();
+}
+
 void VPBTechnique::applyLineFeatures(BufferData& buffer, Locator* masterLocator)
 {
     unsigned int line_features_lod_range = 6;
@@ -1652,98 +1671,95 @@ void VPBTechnique::applyLineFeatures(BufferData& buffer, Locator* masterLocator)
     const SGGeod loc = SGGeod::fromCart(toSG(world));
     const SGBucket bucket = SGBucket(loc);
     string material_name = "";
-    auto roads = std::find_if(_lineFeatureLists.begin(), _lineFeatureLists.end(), [bucket](BucketLineFeatureBinList b){return (b.first == bucket);});
+    const auto roadBins = _lineFeatureLists.get(bucket);
 
-    if (roads == _lineFeatureLists.end()) return;
+    if (!roadBins) return;
 
+    const osg::BoundingSphered tileBound = computeFeatureBound(buffer._landGeometry->getBoundingBox(), world, loc);
     SGMaterialCache* matcache = _options->getMaterialLib()->generateMatCache(loc, _options);
 
-    for (; roads != _lineFeatureLists.end(); ++roads) {
-        const LineFeatureBinList roadBins = roads->second;
-
-        for (auto rb = roadBins.begin(); rb != roadBins.end(); ++rb)
-        {
-            if (material_name != rb->getMaterial()) {
-                // Cache the material to reduce lookups.
-                mat = matcache->find(rb->getMaterial());
-                material_name = rb->getMaterial();
-            }
+    for (auto rb = roadBins->begin(); rb != roadBins->end(); ++rb)
+    {
+        if (material_name != rb->getMaterial()) {
+            // Cache the material to reduce lookups.
+            mat = matcache->find(rb->getMaterial());
+            material_name = rb->getMaterial();
+        }
 
-            if (!mat) {
-                SG_LOG(SG_TERRAIN, SG_ALERT, "Unable to find material " << rb->getMaterial() << " at " << loc << " " << bucket);
-                continue;
-            }    
+        if (!mat) {
+            SG_LOG(SG_TERRAIN, SG_ALERT, "Unable to find material " << rb->getMaterial() << " at " << loc << " " << bucket);
+            continue;
+        }    
 
-            const unsigned int xsize = mat->get_xsize();
-            const unsigned int ysize = mat->get_ysize();
-            const bool   light_edge_offset = mat->get_light_edge_offset();
-            const double light_edge_spacing = mat->get_light_edge_spacing_m();
-            const double light_edge_height = mat->get_light_edge_height_m();
+        const unsigned int xsize = mat->get_xsize();
+        const unsigned int ysize = mat->get_ysize();
+        const bool   light_edge_offset = mat->get_light_edge_offset();
+        const double light_edge_spacing = mat->get_light_edge_spacing_m();
+        const double light_edge_height = mat->get_light_edge_height_m();
 
-            //  Generate a geometry for this set of roads.
-            osg::Vec3Array* v = new osg::Vec3Array;
-            osg::Vec2Array* t = new osg::Vec2Array;
-            osg::Vec3Array* n = new osg::Vec3Array;
-            osg::Vec4Array* c = new osg::Vec4Array;
-            osg::Vec3Array* lights = new osg::Vec3Array;
+        //  Generate a geometry for this set of roads.
+        osg::Vec3Array* v = new osg::Vec3Array;
+        osg::Vec2Array* t = new osg::Vec2Array;
+        osg::Vec3Array* n = new osg::Vec3Array;
+        osg::Vec4Array* c = new osg::Vec4Array;
+        osg::Vec3Array* lights = new osg::Vec3Array;
 
-            auto lineFeatures = rb->getLineFeatures();
+        const auto& lineFeatures = rb->getLineFeatures();
 
-            for (auto r = lineFeatures.begin(); r != lineFeatures.end(); ++r) {
-                if (r->_width > minWidth) generateLineFeature(buffer, masterLocator, *r, world, v, t, n, lights, xsize, ysize, light_edge_spacing, light_edge_height, light_edge_offset);
-            }
+        for (auto r = lineFeatures.begin(); r != lineFeatures.end(); ++r) {
+            if (r->_width > minWidth && overlaps(tileBound, r->_bounds)) generateLineFeature(buffer, masterLocator, *r, world, v, t, n, lights, xsize, ysize, light_edge_spacing, light_edge_height, light_edge_offset);
+        }
 
-            if (v->size() == 0) continue;
-
-            c->push_back(osg::Vec4(1.0,1.0,1.0,1.0));
-
-            osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
-            geometry->setVertexArray(v);
-            geometry->setTexCoordArray(0, t, osg::Array::BIND_PER_VERTEX);
-            geometry->setTexCoordArray(1, t, osg::Array::BIND_PER_VERTEX);
-            geometry->setNormalArray(n, osg::Array::BIND_PER_VERTEX);
-            geometry->setColorArray(c, osg::Array::BIND_OVERALL);
-            geometry->setUseDisplayList( false );
-            geometry->setUseVertexBufferObjects( true );
-            geometry->addPrimitiveSet( new osg::DrawArrays( GL_TRIANGLES, 0, v->size()) );
-
-            EffectGeode* geode = new EffectGeode;
-            geode->addDrawable(geometry);
-
-            geode->setMaterial(mat);
-            geode->setEffect(mat->get_one_effect(0));
-            geode->setNodeMask(SG_NODEMASK_TERRAIN_BIT);
-            buffer._transform->addChild(geode);
-            addVegetationConstraint(geode);
-
-            if (lights->size() > 0) {
-                const double size = mat->get_light_edge_size_cm();
-                const double intensity = mat->get_light_edge_intensity_cd();
-                const SGVec4f color = mat->get_light_edge_colour();
-                const double horiz = mat->get_light_edge_angle_horizontal_deg();
-                const double vertical = mat->get_light_edge_angle_vertical_deg();
-                // Assume street lights point down.
-                osg::Vec3d up = world;
-                up.normalize();
-                const SGVec3f direction = toSG(- (osg::Vec3f) up);
-
-                std::for_each(lights->begin(), lights->end(), 
-                    [&, size, intensity, color, direction, horiz, vertical] (osg::Vec3f p) { lightbin.insert(toSG(p), size, intensity, 1, color, direction, horiz, vertical); } );
-            }
+        if (v->size() == 0) continue;
+
+        c->push_back(osg::Vec4(1.0,1.0,1.0,1.0));
+
+        osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+        geometry->setVertexArray(v);
+        geometry->setTexCoordArray(0, t, osg::Array::BIND_PER_VERTEX);
+        geometry->setTexCoordArray(1, t, osg::Array::BIND_PER_VERTEX);
+        geometry->setNormalArray(n, osg::Array::BIND_PER_VERTEX);
+        geometry->setColorArray(c, osg::Array::BIND_OVERALL);
+        geometry->setUseDisplayList( false );
+        geometry->setUseVertexBufferObjects( true );
+        geometry->addPrimitiveSet( new osg::DrawArrays( GL_TRIANGLES, 0, v->size()) );
+
+        EffectGeode* geode = new EffectGeode;
+        geode->addDrawable(geometry);
+
+        geode->setMaterial(mat);
+        geode->setEffect(mat->get_one_effect(0));
+        geode->setNodeMask(SG_NODEMASK_TERRAIN_BIT);
+        buffer._transform->addChild(geode);
+        addVegetationConstraint(geode);
+
+        if (lights->size() > 0) {
+            const double size = mat->get_light_edge_size_cm();
+            const double intensity = mat->get_light_edge_intensity_cd();
+            const SGVec4f color = mat->get_light_edge_colour();
+            const double horiz = mat->get_light_edge_angle_horizontal_deg();
+            const double vertical = mat->get_light_edge_angle_vertical_deg();
+            // Assume street lights point down.
+            osg::Vec3d up = world;
+            up.normalize();
+            const SGVec3f direction = toSG(- (osg::Vec3f) up);
+
+            std::for_each(lights->begin(), lights->end(), 
+                [&, size, intensity, color, direction, horiz, vertical] (osg::Vec3f p) { lightbin.insert(toSG(p), size, intensity, 1, color, direction, horiz, vertical); } );
         }
     }
 
     if (lightbin.getNumLights() > 0) buffer._transform->addChild(createLights(lightbin, osg::Matrix::identity(), _options));
 }
 
-void VPBTechnique::generateLineFeature(BufferData& buffer, Locator* masterLocator, LineFeatureBin::LineFeature road, osg::Vec3d modelCenter, osg::Vec3Array* v, osg::Vec2Array* t, osg::Vec3Array* n, osg::Vec3Array* lights, unsigned int xsize, unsigned int ysize, double light_edge_spacing, double light_edge_height, bool light_edge_offset)
+void VPBTechnique::generateLineFeature(BufferData& buffer, Locator* masterLocator, const LineFeatureBin::LineFeature& road, osg::Vec3d modelCenter, osg::Vec3Array* v, osg::Vec2Array* t, osg::Vec3Array* n, osg::Vec3Array* lights, unsigned int xsize, unsigned int ysize, double light_edge_spacing, double light_edge_height, bool light_edge_offset)
 {
     // We're in Earth-centered coordinates, so "up" is simply directly away from (0,0,0)
     osg::Vec3d up = modelCenter;
     up.normalize();
     TileBounds tileBounds(masterLocator, up);
 
-    std::list<osg::Vec3d> nodes = tileBounds.clipToTile(road._nodes);
+    std::vector<osg::Vec3d> nodes = tileBounds.clipToTile(road._nodes);
 
     // We need at least two node to make a road.
     if (nodes.size() < 2) return; 
@@ -1897,65 +1913,62 @@ void VPBTechnique::applyAreaFeatures(BufferData& buffer, Locator* masterLocator)
     const osg::Vec3d world = buffer._transform->getMatrix().getTrans();
     const SGGeod loc = SGGeod::fromCart(toSG(world));
     const SGBucket bucket = SGBucket(loc);
-    auto areas = std::find_if(_areaFeatureLists.begin(), _areaFeatureLists.end(), [bucket](BucketAreaFeatureBinList b){return (b.first == bucket);});
+    const auto areaBins = _areaFeatureLists.get(bucket);
 
-    if (areas == _areaFeatureLists.end()) return;
+    if (!areaBins) return;
 
+    const osg::BoundingSphered tileBound = computeFeatureBound(buffer._landGeometry->getBoundingBox(), world, loc);
     SGMaterialCache* matcache = _options->getMaterialLib()->generateMatCache(loc, _options);
 
-    for (; areas != _areaFeatureLists.end(); ++areas) {
-        const AreaFeatureBinList areaBins = areas->second;
-
-        for (auto rb = areaBins.begin(); rb != areaBins.end(); ++rb)
-        {
-            mat = matcache->find(rb->getMaterial());
-
-            if (!mat) {
-                SG_LOG(SG_TERRAIN, SG_ALERT, "Unable to find material " << rb->getMaterial() << " at " << loc << " " << bucket);
-                continue;
-            }    
-
-            unsigned int xsize = mat->get_xsize();
-            unsigned int ysize = mat->get_ysize();
-
-            //  Generate a geometry for this set of areas.
-            osg::Vec3Array* v = new osg::Vec3Array;
-            osg::Vec2Array* t = new osg::Vec2Array;
-            osg::Vec3Array* n = new osg::Vec3Array;
-            osg::Vec4Array* c = new osg::Vec4Array;
-
-            osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
-            geometry->setVertexArray(v);
-            geometry->setTexCoordArray(0, t, osg::Array::BIND_PER_VERTEX);
-            geometry->setTexCoordArray(1, t, osg::Array::BIND_PER_VERTEX);
-            geometry->setNormalArray(n, osg::Array::BIND_PER_VERTEX);
-            geometry->setColorArray(c, osg::Array::BIND_OVERALL);
-            geometry->setUseDisplayList( false );
-            geometry->setUseVertexBufferObjects( true );
-
-            auto areaFeatures = rb->getAreaFeatures();
-
-            for (auto r = areaFeatures.begin(); r != areaFeatures.end(); ++r) {
-                if (r->_area > minArea) generateAreaFeature(buffer, masterLocator, *r, world, geometry, v, t, n, xsize, ysize);
-            }
+    for (auto rb = areaBins->begin(); rb != areaBins->end(); ++rb)
+    {
+        mat = matcache->find(rb->getMaterial());
+
+        if (!mat) {
+            SG_LOG(SG_TERRAIN, SG_ALERT, "Unable to find material " << rb->getMaterial() << " at " << loc << " " << bucket);
+            continue;
+        }    
+
+        unsigned int xsize = mat->get_xsize();
+        unsigned int ysize = mat->get_ysize();
+
+        //  Generate a geometry for this set of areas.
+        osg::Vec3Array* v = new osg::Vec3Array;
+        osg::Vec2Array* t = new osg::Vec2Array;
+        osg::Vec3Array* n = new osg::Vec3Array;
+        osg::Vec4Array* c = new osg::Vec4Array;
+
+        osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+        geometry->setVertexArray(v);
+        geometry->setTexCoordArray(0, t, osg::Array::BIND_PER_VERTEX);
+        geometry->setTexCoordArray(1, t, osg::Array::BIND_PER_VERTEX);
+        geometry->setNormalArray(n, osg::Array::BIND_PER_VERTEX);
+        geometry->setColorArray(c, osg::Array::BIND_OVERALL);
+        geometry->setUseDisplayList( false );
+        geometry->setUseVertexBufferObjects( true );
+
+        const auto& areaFeatures = rb->getAreaFeatures();
+
+        for (auto r = areaFeatures.begin(); r != areaFeatures.end(); ++r) {
+            if (r->_area > minArea && overlaps(tileBound, r->_bounds)) generateAreaFeature(buffer, masterLocator, *r, world, geometry, v, t, n, xsize, ysize);
+        }
 
-            if (v->size() == 0) continue;
-            c->push_back(osg::Vec4(1.0,1.0,1.0,1.0));
+        if (v->size() == 0) continue;
+        c->push_back(osg::Vec4(1.0,1.0,1.0,1.0));
 
-            geometry->dirtyBound();
+        geometry->dirtyBound();
 
-            EffectGeode* geode = new EffectGeode;
-            geode->addDrawable(geometry);
+        EffectGeode* geode = new EffectGeode;
+        geode->addDrawable(geometry);
 
-            geode->setMaterial(mat);
-            geode->setEffect(mat->get_one_effect(0));
-            geode->setNodeMask(SG_NODEMASK_TERRAIN_BIT);
-            buffer._transform->addChild(geode);
-        }
+        geode->setMaterial(mat);
+        geode->setEffect(mat->get_one_effect(0));
+        geode->setNodeMask(SG_NODEMASK_TERRAIN_BIT);
+        buffer._transform->addChild(geode);
     }
 }
 
-void VPBTechnique::generateAreaFeature(BufferData& buffer, Locator* masterLocator, AreaFeatureBin::AreaFeature area, osg::Vec3d modelCenter, osg::Geometry* geometry, osg::Vec3Array* v, osg::Vec2Array* t, osg::Vec3Array* n, unsigned int xsize, unsigned int ysize)
+void VPBTechnique::generateAreaFeature(BufferData& buffer, Locator* masterLocator, const AreaFeatureBin::AreaFeature& area, osg::Vec3d modelCenter, osg::Geometry* geometry, osg::Vec3Array* v, osg::Vec2Array* t, osg::Vec3Array* n, unsigned int xsize, unsigned int ysize)
 {
     if (area._nodes.size() < 3) { 
         SG_LOG(SG_TERRAIN, SG_ALERT, "Coding error - AreaFeatureBin::LineFeature with fewer than three nodes"); 
@@ -2059,9 +2072,9 @@ void VPBTechnique::applyCoastline(BufferData& buffer, Locator* masterLocator)
     const osg::Vec3d world = buffer._transform->getMatrix().getTrans();
     const SGGeod loc = SGGeod::fromCart(toSG(world));
     const SGBucket bucket = SGBucket(loc);
-    auto coasts = std::find_if(_coastFeatureLists.begin(), _coastFeatureLists.end(), [bucket](BucketCoastlineBinList b){return (b.first == bucket);});
+    const auto coastBins = _coastFeatureLists.get(bucket);
 
-    if (coasts == _coastFeatureLists.end()) return;
+    if (!coastBins) return;
 
     // We're in Earth-centered coordinates, so "up" is simply directly away from (0,0,0)
     osg::Vec3d up = world;
@@ -2086,20 +2099,19 @@ void VPBTechnique::applyCoastline(BufferData& buffer, Locator* masterLocator)
     osg::Vec3Array* n = new osg::Vec3Array;
     osg::Vec4Array* c = new osg::Vec4Array;
 
-    for (; coasts != _coastFeatureLists.end(); ++coasts) {
-        const CoastlineBinList coastBins = coasts->second;
+    const osg::BoundingSphered tileBound = computeFeatureBound(buffer._landGeometry->getBoundingBox(), world, loc);
 
-        for (auto rb = coastBins.begin(); rb != coastBins.end(); ++rb)
-        {
-            auto coastFeatures = rb->getCoastlines();
-
-            for (auto r = coastFeatures.begin(); r != coastFeatures.end(); ++r) {
-                auto clipped = tileBounds.clipToTile(r->_nodes);
-                if (clipped.size() > 1) {                    
-                    // We need at least two points to render a line.
-                    LineFeatureBin::LineFeature line = LineFeatureBin::LineFeature(clipped, coastWidth);
-                    generateCoastlineFeature(buffer, masterLocator, line, world, v, t, n, xsize, ysize);
-                }
+    for (auto rb = coastBins->begin(); rb != coastBins->end(); ++rb)
+    {
+        const auto& coastFeatures = rb->getCoastlines();
+
+        for (auto r = coastFeatures.begin(); r != coastFeatures.end(); ++r) {
+            if (!overlaps(tileBound, r->_bounds)) continue;
+            auto clipped = tileBounds.clipToTile(r->_nodes);
+            if (clipped.size() > 1) {                    
+                // We need at least two points to render a line.
+                LineFeatureBin::LineFeature line = LineFeatureBin::LineFeature(clipped, coastWidth);
+                generateCoastlineFeature(buffer, masterLocator, line, world, v, t, n, xsize, ysize);
             }
         }
     }
@@ -2129,7 +2141,7 @@ void VPBTechnique::applyCoastline(BufferData& buffer, Locator* masterLocator)
     buffer._transform->addChild(geode);
 }
 
-void VPBTechnique::generateCoastlineFeature(BufferData& buffer, Locator* masterLocator, LineFeatureBin::LineFeature coastline, osg::Vec3d modelCenter, osg::Vec3Array* v, osg::Vec2Array* t, osg::Vec3Array* n, unsigned int xsize, unsigned int ysize)
+void VPBTechnique::generateCoastlineFeature(BufferData& buffer, Locator* masterLocator, const LineFeatureBin::LineFeature& coastline, osg::Vec3d modelCenter, osg::Vec3Array* v, osg::Vec2Array* t, osg::Vec3Array* n, unsigned int xsize, unsigned int ysize)
 {
     if (coastline._nodes.size() < 2) { 
         SG_LOG(SG_TERRAIN, SG_ALERT, "Coding error - LineFeatureBin::LineFeature with fewer than two nodes"); 
@@ -2311,36 +2323,32 @@ void VPBTechnique::releaseGLObjects(osg::State* state) const
 // are significantly higher vertices that lie just outside the constraint model.
 void VPBTechnique::addElevationConstraint(osg::ref_ptr<osg::Node> constraint)
 { 
-    const std::lock_guard<std::mutex> lock(VPBTechnique::_elevationConstraintMutex); // Lock the _elevationConstraintGroup for this scope
-    _elevationConstraintGroup->addChild(constraint.get()); 
+    // Build the bounding volume tree before taking the lock, it is the expensive part
+    SGSharedPtr<VPBElevationConstraints::Constraint> entry = new VPBElevationConstraints::Constraint(constraint.get());
+
+    const std::lock_guard<std::mutex> lock(VPBTechnique::_elevationConstraintMutex); // Serialize the updates of the _elevationConstraints
+    std::atomic_store(&_elevationConstraints, std::atomic_load(&_elevationConstraints)->add(entry));
 }
 
 // Remove a previously added constraint.  E.g on model unload.
 void VPBTechnique::removeElevationConstraint(osg::ref_ptr<osg::Node> constraint)
 { 
-    const std::lock_guard<std::mutex> lock(VPBTechnique::_elevationConstraintMutex); // Lock the _elevationConstraintGroup for this scope
-    _elevationConstraintGroup->removeChild(constraint.get()); 
+    const std::lock_guard<std::mutex> lock(VPBTechnique::_elevationConstraintMutex); // Serialize the updates of the _elevationConstraints
+    std::atomic_store(&_elevationConstraints, std::atomic_load(&_elevationConstraints)->remove(constraint.get()));
+}
+
+VPBElevationConstraints::Ptr VPBTechnique::getElevationConstraints()
+{
+    return std::atomic_load(&_elevationConstraints);
 }
 
 // Check a given vertex against any elevation constraints  E.g. to ensure the terrain mesh doesn't
 // poke through any airport meshes.  If such a constraint exists, the function will return a replacement
 // vertex displaces such that it lies 1m below the contraint relative to the passed in origin.  
+// When checking many vertices, get the constraints once with getElevationConstraints() instead.
 osg::Vec3d VPBTechnique::checkAgainstElevationConstraints(osg::Vec3d origin, osg::Vec3d vertex, float vtx_gap)
 {
-    const std::lock_guard<std::mutex> lock(VPBTechnique::_elevationConstraintMutex); // Lock the _elevationConstraintGroup for this scope
-    osg::ref_ptr<osgUtil::LineSegmentIntersector> intersector;
-    intersector = new osgUtil::LineSegmentIntersector(origin, vertex);
-    osgUtil::IntersectionVisitor visitor(intersector.get());
-    _elevationConstraintGroup->accept(visitor);
-
-    if (intersector->containsIntersections()) {
-        // We have an intersection with our constraints model, so move the terrain vertex to 1m below the intersection point
-        osg::Vec3d ray = intersector->getFirstIntersection().getWorldIntersectPoint() - origin;
-        ray.normalize();
-        return intersector->getFirstIntersection().getWorldIntersectPoint() - ray*vtx_gap;
-    } else {
-        return vertex;
-    }
+    return getElevationConstraints()->check(origin, vertex, vtx_gap);
 }
 
 // Add an osg object representing a vegetation contraint on the terrain mesh.  The generated terrain mesh will not include any vegetation
@@ -2374,53 +2382,37 @@ bool VPBTechnique::checkAgainstVegetationConstraints(osg::Vec3d origin, osg::Vec
 
 void VPBTechnique::clearConstraints()
 {
-    const std::lock_guard<std::mutex> elock(VPBTechnique::_elevationConstraintMutex); // Lock the _elevationConstraintGroup for this scope
-    _elevationConstraintGroup = new osg::Group();
+    const std::lock_guard<std::mutex> elock(VPBTechnique::_elevationConstraintMutex); // Serialize the updates of the _elevationConstraints
+    std::atomic_store(&_elevationConstraints, VPBElevationConstraints::Ptr(std::make_shared<VPBElevationConstraints>()));
 }
 
 void VPBTechnique::addLineFeatureList(SGBucket bucket, LineFeatureBinList roadList)
 {
     if (roadList.empty()) return;
 
-    // Block to mutex the List alone
-    {
-        const std::lock_guard<std::mutex> lock(VPBTechnique::_lineFeatureLists_mutex); // Lock the _lineFeatureLists for this scope
-        _lineFeatureLists.push_back(std::pair(bucket, roadList));
-    }
-
+    _lineFeatureLists.add(bucket, roadList);
 }
 
 void VPBTechnique::addAreaFeatureList(SGBucket bucket, AreaFeatureBinList areaList)
 {
     if (areaList.empty()) return;
 
-    // Block to mutex the List alone
-    {
-        const std::lock_guard<std::mutex> lock(VPBTechnique::_areaFeatureLists_mutex); // Lock the _lineFeatureLists for this scope
-        _areaFeatureLists.push_back(std::pair(bucket, areaList));
-    }
+    _areaFeatureLists.add(bucket, areaList);
 }
 
 void VPBTechnique::addCoastlineList(SGBucket bucket, CoastlineBinList coastline)
 {
     if (coastline.empty()) return;
 
-    // Block to mutex the List alone
-    {
-        const std::lock_guard<std::mutex> lock(VPBTechnique::_coastFeatureLists_mutex); // Lock the _lineFeatureLists for this scope
-        _coastFeatureLists.push_back(std::pair(bucket, coastline));
-    }
-
+    _coastFeatureLists.add(bucket, coastline);
 }
 
 void VPBTechnique::unloadFeatures(SGBucket bucket)
 {
     SG_LOG(SG_TERRAIN, SG_DEBUG, "Erasing all features with entry " << bucket);
-    const std::lock_guard<std::mutex> lock(VPBTechnique::_lineFeatureLists_mutex); // Lock the _lineFeatureLists for this scope
-    // C++ 20...
-    //std::erase_if(_lineFeatureLists, [bucket](BucketLineFeatureBinList p) { return p.first == bucket; } );
-    //std::erase_if(_lineFeatureLists, [bucket](BucketAreaFeatureBinList p) { return p.first == bucket; } );
-    //std::erase_if(_coastFeatureLists, [bucket](BucketCoastlineBinList p) { return p.first == bucket; } );
+    _lineFeatureLists.erase(bucket);
+    _areaFeatureLists.erase(bucket);
+    _coastFeatureLists.erase(bucket);
 }
 
 
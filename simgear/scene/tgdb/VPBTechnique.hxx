@@ -19,7 +19,9 @@
 #ifndef VPBTECHNIQUE
 #define VPBTECHNIQUE 1
 
+#include <memory>
 #include <mutex>
+#include <unordered_map>
 
 #include <osg/MatrixTransform>
 #include <osg/Geode>
@@ -35,6 +37,7 @@
 #include <simgear/scene/tgdb/LightBin.hxx>
 #include <simgear/scene/tgdb/LineFeatureBin.hxx>
 #include <simgear/scene/tgdb/CoastlineBin.hxx>
+#include <simgear/scene/tgdb/VPBElevationConstraints.hxx>
 
 using namespace osgTerrain;
 
@@ -98,6 +101,10 @@ class VPBTechnique : public TerrainTechnique
         static void removeElevationConstraint(osg::ref_ptr<osg::Node> constraint);
         static osg::Vec3d checkAgainstElevationConstraints(osg::Vec3d origin, osg::Vec3d vertex, float vertex_gap);
 
+        // The currently published constraints.  The returned set is never modified, so a tile
+        // builder can hold on to it and query it without locking.
+        static VPBElevationConstraints::Ptr getElevationConstraints();
+
         static void clearConstraints();
 
         // LineFeatures and AreaFeatures are draped over the underlying mesh.
@@ -142,7 +149,7 @@ class VPBTechnique : public TerrainTechnique
         virtual void applyLineFeatures(BufferData& buffer, Locator* masterLocator);
         virtual void generateLineFeature(BufferData& buffer, 
             Locator* masterLocator, 
-            LineFeatureBin::LineFeature road, 
+            const LineFeatureBin::LineFeature& road, 
             osg::Vec3d modelCenter, 
             osg::Vec3Array* v, 
             osg::Vec2Array* t, 
@@ -157,7 +164,7 @@ class VPBTechnique : public TerrainTechnique
         virtual void applyAreaFeatures(BufferData& buffer, Locator* masterLocator);
         virtual void generateAreaFeature(BufferData& buffer, 
             Locator* masterLocator, 
-            AreaFeatureBin::AreaFeature area, 
+            const AreaFeatureBin::AreaFeature& area, 
             osg::Vec3d modelCenter, 
             osg::Geometry* geometry,
             osg::Vec3Array* v, 
@@ -169,7 +176,7 @@ class VPBTechnique : public TerrainTechnique
         virtual void applyCoastline(BufferData& buffer, Locator* masterLocator);
         virtual void generateCoastlineFeature(BufferData& buffer, 
             Locator* masterLocator, 
-            LineFeatureBin::LineFeature coastLine, 
+            const LineFeatureBin::LineFeature& coastLine, 
             osg::Vec3d modelCenter, 
             osg::Vec3Array* v, 
             osg::Vec2Array* t, 
@@ -199,22 +206,50 @@ class VPBTechnique : public TerrainTechnique
         osg::ref_ptr<SGReaderWriterOptions> _options;
         osg::ref_ptr<osg::Group>            _vegetationConstraintGroup;
 
-        inline static osg::ref_ptr<osg::Group>  _elevationConstraintGroup = new osg::Group();
-        inline static std::mutex _elevationConstraintMutex;  // protects the _elevationConstraintGroup;
-
-
-        typedef std::pair<SGBucket, LineFeatureBinList> BucketLineFeatureBinList;
-        typedef std::pair<SGBucket, AreaFeatureBinList> BucketAreaFeatureBinList;
-        typedef std::pair<SGBucket, CoastlineBinList> BucketCoastlineBinList;
+        // Only accessed through std::atomic_load/std::atomic_store
+        inline static VPBElevationConstraints::Ptr _elevationConstraints = std::make_shared<VPBElevationConstraints>();
+        inline static std::mutex _elevationConstraintMutex;  // serializes updates of the _elevationConstraints;
 
-        inline static std::list<BucketLineFeatureBinList>  _lineFeatureLists;
-        inline static std::mutex _lineFeatureLists_mutex;  // protects the _lineFeatureLists;
 
-        inline static std::list<BucketAreaFeatureBinList>  _areaFeatureLists;
-        inline static std::mutex _areaFeatureLists_mutex;  // protects the _areaFeatureLists;
+        // Feature lists indexed by SGBucket::gen_index().  A stored list is never modified,
+        // adding to a bucket replaces its list, so the lock is only held for the lookup and
+        // the tile is generated from the returned list.
+        template <typename FeatureBinList>
+        class BucketFeatureLists
+        {
+        public:
+            typedef std::shared_ptr<const FeatureBinList> Ptr;
+
+            void add(const SGBucket& bucket, const FeatureBinList& list)
+            {
+                const std::lock_guard<std::mutex> lock(_mutex); // Lock the _lists for this scope
+                Ptr& entry = _lists[bucket.gen_index()];
+                auto merged = entry ? std::make_shared<FeatureBinList>(*entry) : std::make_shared<FeatureBinList>();
+                merged->insert(merged->end(), list.begin(), list.end());
+                entry = merged;
+            }
+
+            Ptr get(const SGBucket& bucket) const
+            {
+                const std::lock_guard<std::mutex> lock(_mutex); // Lock the _lists for this scope
+                auto i = _lists.find(bucket.gen_index());
+                return i == _lists.end() ? Ptr() : i->second;
+            }
+
+            void erase(const SGBucket& bucket)
+            {
+                const std::lock_guard<std::mutex> lock(_mutex); // Lock the _lists for this scope
+                _lists.erase(bucket.gen_index());
+            }
+
+        private:
+            mutable std::mutex _mutex;  // protects the _lists
+            std::unordered_map<long, Ptr> _lists;
+        };
 
-        inline static std::list<BucketCoastlineBinList>  _coastFeatureLists;
-        inline static std::mutex _coastFeatureLists_mutex;  // protects the _areaFeatureLists;
+        inline static BucketFeatureLists<LineFeatureBinList> _lineFeatureLists;
+        inline static BucketFeatureLists<AreaFeatureBinList> _areaFeatureLists;
+        inline static BucketFeatureLists<CoastlineBinList> _coastFeatureLists;
 };
 
 };
@@ -43,9 +43,9 @@ TileBounds::TileBounds(Locator *locator, osg::Vec3d up) {
     west  = (v00 - v01) ^ up;
 }
 
-std::list<osg::Vec3d> TileBounds::clipToTile(std::list<osg::Vec3d> points) {
+std::vector<osg::Vec3d> TileBounds::clipToTile(const std::vector<osg::Vec3d>& points) {
 
-    std::list<osg::Vec3d> lreturn;
+    std::vector<osg::Vec3d> lreturn;
 
     bool last_in = false;
     auto last_pt = points.begin();
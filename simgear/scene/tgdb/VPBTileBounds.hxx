@@ -28,7 +28,7 @@ using namespace osgTerrain;
 class TileBounds {
     public:
         TileBounds(Locator *locator, osg::Vec3d up);
-        virtual std::list<osg::Vec3d> clipToTile(std::list<osg::Vec3d> points);
+        virtual std::vector<osg::Vec3d> clipToTile(const std::vector<osg::Vec3d>& points);
     
     protected:
 
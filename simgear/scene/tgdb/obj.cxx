@@ -41,54 +41,29 @@
 
 #include "SGTileGeometryBin.hxx"        // for original tile loading
 #include "SGTileDetailsCallback.hxx"    // for tile details ( random objects, and lighting )
+#include "TilePrefetcher.hxx"
 
 
 using namespace simgear;
 
-osg::Node*
-SGLoadBTG(const std::string& path, const simgear::SGReaderWriterOptions* options)
-{
-    SGBinObject tile;
-    if (!tile.read_bin(path))
-      return NULL;
-
-    SGMaterialLibPtr matlib;
-    osg::ref_ptr<SGMaterialCache> matcache;
-    bool useVBOs = false;
-    double object_range = SG_OBJECT_RANGE_ROUGH;
-    double tile_min_expiry = SG_TILE_MIN_EXPIRY;
-    bool usePhotoscenery = false;
+namespace {
 
-    if (options) {
-      matlib = options->getMaterialLib();
-      useVBOs = (options->getPluginStringData("SimGear::USE_VBOS") == "ON");
-      SGPropertyNode* propertyNode = options->getPropertyNode().get();
+// The orientation of the local horizontal frame at the tile center
+SGQuatd btgRotation(const SGVec3d& center)
+{
+    SGGeod geodPos = SGGeod::fromCart(center);
+    return SGQuatd::fromLonLat(geodPos)*SGQuatd::fromEulerDeg(0, 0, 180);
+}
 
-      object_range = propertyNode->getDoubleValue("/sim/rendering/static-lod/rough", object_range);
-      tile_min_expiry= propertyNode->getDoubleValue("/sim/rendering/plod-minimum-expiry-time-secs", tile_min_expiry);
-      usePhotoscenery = propertyNode->getBoolValue("/sim/rendering/photoscenery/enabled", usePhotoscenery);
-    }
+}
 
+void
+SGRotateBTG(SGBinObject& tile, const Orthophoto* orthophoto)
+{
     SGVec3d center = tile.get_gbs_center();
-    SGGeod geodPos = SGGeod::fromCart(center);
-    SGQuatd hlOr = SGQuatd::fromLonLat(geodPos)*SGQuatd::fromEulerDeg(0, 0, 180);
-    if (matlib)
-    	matcache = matlib->generateMatCache(geodPos, options);
-
+    SGQuatd hlOr = btgRotation(center);
     std::vector<SGVec3d> nodes = tile.get_wgs84_nodes();
-
     std::vector<SGVec2f> satellite_overlay_coords;
-    osg::ref_ptr<Orthophoto> orthophoto = nullptr;
-
-    if (usePhotoscenery) {
-      try {
-        const long index = lexical_cast<long>(osgDB::getSimpleFileName(osgDB::getNameLessExtension(path)));
-        orthophoto = OrthophotoManager::instance()->getOrthophoto(index);
-      } catch (bad_lexical_cast&) {
-        orthophoto = OrthophotoManager::instance()->getOrthophoto(nodes, center);
-      }
-    }
-    
 
     // rotate the tiles so that the bounding boxes get nearly axis aligned.
     // this will help the collision tree's bounding boxes a bit ...
@@ -113,6 +88,65 @@ SGLoadBTG(const std::string& path, const simgear::SGReaderWriterOptions* options
     for (unsigned i = 0; i < normals.size(); ++i)
       normals[i] = hlOrf.transform(normals[i]);
     tile.set_normals(normals);
+}
+
+osg::Node*
+SGLoadBTG(const std::string& path, const simgear::SGReaderWriterOptions* options)
+{
+    // Take the tile from the prefetcher if it got here first, unless the
+    // file changed since
+    SGSharedPtr<const TilePrefetcher::Tile> prefetched = TilePrefetcher::findTile(path);
+    if (prefetched.valid() && !prefetched->isCurrent(path)) {
+      TilePrefetcher::releaseTile(path, prefetched.get());
+      prefetched.clear();
+    }
+
+    SGMaterialLibPtr matlib;
+    osg::ref_ptr<SGMaterialCache> matcache;
+    bool useVBOs = false;
+    double object_range = SG_OBJECT_RANGE_ROUGH;
+    double tile_min_expiry = SG_TILE_MIN_EXPIRY;
+    bool usePhotoscenery = false;
+
+    if (options) {
+      matlib = options->getMaterialLib();
+      useVBOs = (options->getPluginStringData("SimGear::USE_VBOS") == "ON");
+      SGPropertyNode* propertyNode = options->getPropertyNode().get();
+
+      object_range = propertyNode->getDoubleValue("/sim/rendering/static-lod/rough", object_range);
+      tile_min_expiry= propertyNode->getDoubleValue("/sim/rendering/plod-minimum-expiry-time-secs", tile_min_expiry);
+      usePhotoscenery = propertyNode->getBoolValue("/sim/rendering/photoscenery/enabled", usePhotoscenery);
+    }
+
+    // The prefetched tiles have no overlay texture coordinates, the
+    // photoscenery reads the file again
+    SGBinObject readTile;
+    osg::ref_ptr<Orthophoto> orthophoto = nullptr;
+    bool usePrefetched = prefetched.valid() && !usePhotoscenery;
+    if (!usePrefetched) {
+      if (!readTile.read_bin(path))
+        return NULL;
+
+      if (usePhotoscenery) {
+        try {
+          const long index = lexical_cast<long>(osgDB::getSimpleFileName(osgDB::getNameLessExtension(path)));
+          orthophoto = OrthophotoManager::instance()->getOrthophoto(index);
+        } catch (bad_lexical_cast&) {
+          orthophoto = OrthophotoManager::instance()->getOrthophoto(readTile.get_wgs84_nodes(),
+                                                                    readTile.get_gbs_center());
+        }
+      }
+      SGRotateBTG(readTile, orthophoto.get());
+    }
+    const SGBinObject& tile = usePrefetched ? prefetched->binObject : readTile;
+
+    SGVec3d center = tile.get_gbs_center();
+    SGGeod geodPos = SGGeod::fromCart(center);
+    SGQuatd hlOr = btgRotation(center);
+    if (prefetched.valid() && matlib && prefetched->matlib == matlib)
+      matcache = prefetched->matcache;
+    else if (matlib)
+    	matcache = matlib->generateMatCache(geodPos, options);
 
     // tile surface    
     osg::ref_ptr<SGTileGeometryBin> tileGeometryBin = new SGTileGeometryBin();
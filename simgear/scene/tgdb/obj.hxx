@@ -43,8 +43,10 @@ using std::string;
 using boost::lexical_cast;
 using boost::bad_lexical_cast;
 
+class SGBinObject;
 class SGMaterialLib;
 namespace simgear {
+class Orthophoto;
 class SGReaderWriterOptions;
 }
 
@@ -52,4 +54,11 @@ osg::Node*
 SGLoadBTG(const std::string& path, 
           const simgear::SGReaderWriterOptions* options);
 
+// Rotate the nodes and normals of a tile as read from a BTG file so that
+// the bounding boxes get nearly axis aligned, the form SGLoadBTG() builds
+// the geometry from.  The overlay texture coordinates are set from the
+// orthophoto, or to zero without one.
+void
+SGRotateBTG(SGBinObject& tile, const simgear::Orthophoto* orthophoto);
+
 #endif // _SG_OBJ_HXX
@@ -394,6 +394,7 @@ public:
     void writeCompletedTilesPersistentCache() const;
 
     HTTP::Client _http;
+    DNS::Client _dns; ///< kept alive so cached answers get refreshed
     SyncSlot _syncSlots[NUM_SYNC_SLOTS];
 
     bool _stop, _running;
@@ -537,11 +538,11 @@ std::string SGTerraSync::WorkerThread::dnsSelectServerForService(const std::stri
     naptrRequest->qflags = "U";
     DNS::Request_ptr r(naptrRequest);
 
-    DNS::Client dnsClient;
-    dnsClient.makeRequest(r);
+    // usually answered from the DNS cache without blocking
+    _dns.makeRequest(r);
     SG_LOG(SG_TERRASYNC,SG_DEBUG,"DNS NAPTR query for '" << _dnsdn << "' '" << naptrRequest->qservice << "'" );
     while (!r->isComplete() && !r->isTimeout()) {
-        dnsClient.update(0);
+        _dns.update(0);
     }
 
     if( naptrRequest->entries.empty() ) {
@@ -602,6 +603,11 @@ void SGTerraSync::WorkerThread::run()
     }
 
     initCompletedTilesPersistentCache();
+    if (!_persistentCachePath.isNull()) {
+        // warm DNS answers, so a restart does not wait on the network
+        DNS::Cache::instance()->setPersistentPath(_persistentCachePath.dirPath() / "terrasync-dns-cache");
+    }
+
     runInternal();
 
     {
@@ -843,6 +849,9 @@ void SGTerraSync::WorkerThread::runInternal()
             SG_LOG(SG_TERRASYNC, SG_WARN, "failure doing HTTP update" << e.getFormattedMessage());
         }
 
+        // background refresh of cached server records
+        _dns.update(0);
+
         {
             std::lock_guard<std::mutex> g(_stateLock);
             _state._transfer_rate = _http.transferRateBytesPerSec();
@@ -0,0 +1,166 @@
+// ParallelFor.cxx -- run independent loop iterations on several threads
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the
+// Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+// Boston, MA  02110-1301, USA.
+
+#include "ParallelFor.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace simgear
+{
+
+namespace
+{
+
+// One parallelFor() call, the iterations are taken by the caller and
+// any pool thread that finds the job in the queue
+struct Job {
+    Job(unsigned count, const std::function<void(unsigned)>& f) :
+        _count(count),
+        _f(f),
+        _next(0),
+        _active(0)
+    { }
+
+    bool exhausted() const
+    { return _count <= _next; }
+
+    void work()
+    {
+        for (unsigned i = _next++; i < _count; i = _next++) {
+            try {
+                _f(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(_errorMutex);
+                if (!_error)
+                    _error = std::current_exception();
+            }
+        }
+    }
+
+    const unsigned _count;
+    const std::function<void(unsigned)>& _f;
+    std::atomic<unsigned> _next;
+    // pool threads working on the job, guarded by the pool mutex
+    unsigned _active;
+    std::exception_ptr _error;
+    std::mutex _errorMutex;
+};
+
+thread_local bool inPoolThread = false;
+
+class Pool {
+public:
+    Pool() :
+        _stop(false)
+    {
+        unsigned numThreads = std::thread::hardware_concurrency();
+        for (unsigned i = 1; i < numThreads; ++i)
+            _threads.emplace_back([this]() { run(); });
+    }
+    ~Pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _workCondition.notify_all();
+        for (std::thread& thread : _threads)
+            thread.join();
+    }
+
+    bool empty() const
+    { return _threads.empty(); }
+
+    void execute(Job& job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _jobs.push_back(&job);
+        }
+        if (job._count - 1 < _threads.size()) {
+            for (unsigned i = 1; i < job._count; ++i)
+                _workCondition.notify_one();
+        } else {
+            _workCondition.notify_all();
+        }
+
+        job.work();
+
+        // wait for the pool threads still running an iteration
+        std::unique_lock<std::mutex> lock(_mutex);
+        std::deque<Job*>::iterator i = std::find(_jobs.begin(), _jobs.end(), &job);
+        if (i != _jobs.end())
+            _jobs.erase(i);
+        _doneCondition.wait(lock, [&job]() { return job._active == 0; });
+    }
+
+private:
+    void run()
+    {
+        inPoolThread = true;
+        std::unique_lock<std::mutex> lock(_mutex);
+        for (;;) {
+            _workCondition.wait(lock, [this]() { return _stop || !_jobs.empty(); });
+            if (_stop)
+                return;
+            Job* job = _jobs.front();
+            if (job->exhausted()) {
+                _jobs.pop_front();
+                continue;
+            }
+            ++job->_active;
+            lock.unlock();
+            job->work();
+            lock.lock();
+            if (--job->_active == 0)
+                _doneCondition.notify_all();
+        }
+    }
+
+    std::mutex _mutex;
+    std::condition_variable _workCondition;
+    std::condition_variable _doneCondition;
+    std::deque<Job*> _jobs;
+    std::vector<std::thread> _threads;
+    bool _stop;
+};
+
+}
+
+void parallelForRun(unsigned count, const std::function<void(unsigned)>& f)
+{
+    static Pool pool;
+    if (count < 2 || pool.empty() || inPoolThread) {
+        for (unsigned i = 0; i < count; ++i)
+            f(i);
+        return;
+    }
+
+    Job job(count, f);
+    pool.execute(job);
+    if (job._error)
+        std::rethrow_exception(job._error);
+}
+
+}
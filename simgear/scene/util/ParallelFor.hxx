@@ -0,0 +1,50 @@
+// ParallelFor.hxx -- run independent loop iterations on several threads
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the
+// Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+// Boston, MA  02110-1301, USA.
+
+#ifndef SIMGEAR_PARALLELFOR_HXX
+#define SIMGEAR_PARALLELFOR_HXX 1
+
+#include <functional>
+
+namespace simgear
+{
+
+/**
+ * Run f(i) for every i in [0, count) on the calling thread and the shared
+ * worker pool, see parallelFor().
+ */
+void parallelForRun(unsigned count, const std::function<void(unsigned)>& f);
+
+/**
+ * Call f(i) for every i in [0, count), spread over the calling thread and
+ * a worker pool shared by all callers. The pool is created on first use
+ * with std::thread::hardware_concurrency() - 1 threads, so several
+ * threads calling this at once do not oversubscribe the cpu. Calls made
+ * from within a pool thread run inline.
+ * The iterations must be independent; which thread runs which one is not
+ * defined, so anything that must be reproducible has to depend on i only.
+ * The first exception thrown by f is rethrown once all threads are done.
+ */
+template<typename F>
+void parallelFor(unsigned count, const F& f)
+{
+    parallelForRun(count, [&f](unsigned i) { f(i); });
+}
+
+}
+
+#endif